@@ -2,28 +2,33 @@
 #define _CLOUD_H_
 
 #include <netdb.h>
+#include "event.h"
+#include "h2.h"
+#include "parse.h"
 
-#define CLOUD_SEND_BUF_LEN   (2048)
-#define CLOUD_RECV_BUF_LEN   (1048576)
+#define CLOUD_SEND_BUF_LEN   (8192)
+#define CLOUD_RECV_BUF_LEN   (65536)
 
 #define CLOUD_TCP_PORT_HTTP  (80)
 #define CLOUD_TCP_PORT_HTTPS (443)
 
+#define CLOUD_RESOLUTION_DELAY_MS (50)
+#define CLOUD_ATTEMPT_DELAY_MS    (250)
+#define CLOUD_NO_DEADLINE         (0xFFFFFFFF)
+
 //
 // Socket Type
 //
 typedef int32_t CLOUD_SOCKET;
 
 //
-// Socket address, internet style.
+// Socket address, IPv4 or IPv6.
 //
-typedef struct
+typedef union
 {
-   uint8_t            sin_family;
-   uint8_t            sin_len;
-   uint16_t           sin_port;
-   struct in_addr     sin_addr;
-   uint8_t            sin_zero[8];
+   struct sockaddr     sa;
+   struct sockaddr_in  sin;
+   struct sockaddr_in6 sin6;
 }
 CLOUD_SOCKADDR_T;
 
@@ -39,6 +44,7 @@ CLOUD_SOCKADDR_T;
 typedef enum
 {
    CLOUD_SESSION_IDLE,
+   CLOUD_SESSION_RESOLVE_PENDING,
    CLOUD_SESSION_CREATE_SUCCESS,
    CLOUD_SESSION_CONNECT_PENDING,
    CLOUD_SESSION_CONNECT_SUCCESS,
@@ -62,10 +68,69 @@ typedef struct
 }
 CLOUD_DIAGS_T;
 
+//!
+//! Cloud Session Deadlines in milliseconds (0 = no deadline)
+//!
+typedef struct
+{
+   uint32_t dnsMs;                    //!< Name resolution
+   uint32_t connectMs;                //!< TCP connect
+   uint32_t firstByteMs;              //!< From end of send to first byte received
+   uint32_t totalMs;                  //!< Whole transaction
+   uint32_t idleMs;                   //!< Between bytes of a request or response once they flow
+}
+CLOUD_DEADLINES_T;
+
 //
-// Cloud Session Structure
+// Cloud Connection Attempt, raced against the session socket
 //
 typedef struct
+{
+   CLOUD_SOCKET handle;               //!< Socket of the attempt
+   CLOUD_SOCKADDR_T addr;             //!< Address of the other family, AF_UNSPEC if none
+   EVENT_HANDLER_T handler;           //!< Event loop handler of the attempt
+   int req;                           //!< io_uring connect request of the attempt
+}
+CLOUD_ATTEMPT_T;
+
+//
+// Cloud Response Callback, called for each response of a pipeline
+//
+struct CLOUD_SESSION;
+typedef void (*CLOUD_RESPONSE_CB_T)(struct CLOUD_SESSION *s, int index, int httpStatus, void *arg);
+
+//
+// Cloud Body Callback, called with the payload of a response as it arrives
+//
+typedef void (*CLOUD_BODY_CB_T)(struct CLOUD_SESSION *s, int index, const char *data, size_t len, void *arg);
+
+//
+// Cloud Splice Callback, moves up to len payload bytes straight from the
+// socket. Returns the bytes moved, 0 if the socket was closed, or -1 with
+// errno set, EOPNOTSUPP to have the bytes received and passed to the body
+// callback instead.
+//
+typedef ssize_t (*CLOUD_SPLICE_CB_T)(struct CLOUD_SESSION *s, int index, int fd, size_t len, void *arg);
+
+//
+// Cloud Upgrade Callback, takes over the connection once the server has
+// switched protocols. Called first with no data when the 101 response is
+// received, then with the bytes received on the connection. Returns false
+// to fail the session.
+//
+typedef bool (*CLOUD_UPGRADE_CB_T)(struct CLOUD_SESSION *s, const char *data, size_t len, void *arg);
+
+//
+// Cloud Wake Callback, called when the status of a session changes, its
+// response completes or its name lookup may have finished, so that its
+// owner runs only then
+//
+typedef void (*CLOUD_WAKE_CB_T)(void *arg);
+
+//
+// Cloud Session Structure
+//
+typedef struct CLOUD_SESSION
 {
    char *name;                        //!< Session name for debug printing
    CLOUD_SOCKET handle;               //!< Handle to this socket.
@@ -76,13 +141,45 @@ typedef struct
    int totalBytesRcvd;                //!< Total bytes received. *valid only during recv operations.
    int httpStatus;                    //!< HTTP return status code
    uint32_t errorTime;                //!< OS time of last error.
-   uint32_t transStart;               //!< OS time at start of transaction.
+   uint32_t transStart;               //!< Monotonic ms time at start of transaction.
    char* sendBuf;                     //!< Pointer to the send buffer used by this socket
    char* recvBuf;                     //!< Pointer to the recv buffer used by this socket
    size_t recvBufLen;                 //!< Recv buffer length
    bool recvComplete;                 //!< WebSockets data callback indicating a recv() is complete
    bool timeout;                      //!< Send/recv timeout
    CLOUD_DIAGS_T *diags;              //!< Cloud session diagnostics structure
+   EVENT_HANDLER_T handler;           //!< Event loop handler of this socket
+   CLOUD_DEADLINES_T deadlines;       //!< Per-phase deadlines
+   uint32_t phaseStart;               //!< Monotonic ms time of the last status change.
+   uint32_t recvTime;                 //!< Monotonic ms time bytes were last received.
+   uint32_t sendTime;                 //!< Monotonic ms time bytes were last sent.
+   int sendQueued;                    //!< Sent bytes the peer had not acknowledged at the last check.
+   bool keepAlive;                    //!< Server allows the connection to be reused
+   bool reused;                       //!< Transaction runs on a kept alive connection
+   int requestCount;                  //!< Requests pipelined in the send buffer (0 = 1)
+   int responsesRcvd;                 //!< Responses received for the pipelined requests
+   CLOUD_RESPONSE_CB_T responseCb;    //!< Called as each response of the pipeline completes
+   void *responseArg;                 //!< Response and body callback argument
+   CLOUD_BODY_CB_T bodyCb;            //!< Called with the payload bytes of each response
+   CLOUD_SPLICE_CB_T spliceCb;        //!< Called to move payload bytes without receiving them
+   CLOUD_UPGRADE_CB_T upgradeCb;      //!< Takes over the connection on a 101 response, NULL to refuse
+   bool upgraded;                     //!< Connection switched protocols, the send buffer queues writes
+   bool http2;                        //!< Requests go out as HTTP/2 streams, with prior knowledge
+   H2_T *h2;                          //!< HTTP/2 state of the connection, allocated on first use
+   struct CLOUD_SESSION *next;        //!< Next session waiting for its server name
+   WHEEL_TIMER_T timer;               //!< Due at the next deadline of the session
+   CLOUD_WAKE_CB_T wakeCb;            //!< Tells the owner of the session, NULL for none
+   void *wakeArg;                     //!< Wake callback argument
+   CLOUD_SOCKADDR_T serverAddr;       //!< Resolved server address
+   CLOUD_ATTEMPT_T fallback;          //!< Connect attempt to the other address family
+   char *serverName;                  //!< Server name given to cloud_initSession()
+   bool watched;                      //!< Socket is driven by the event loop
+   int connectReq;                    //!< io_uring connect request in flight
+   int sendReq;                       //!< io_uring send request in flight
+   int recvReq;                       //!< io_uring multishot receive armed on the socket
+   PARSE_RESPONSE_T response;         //!< Parser of the response being received
+   int sendFileFd;                    //!< File sent after the send buffer
+   int sendFileLen;                   //!< Bytes of the file to send, 0 if none. Part of totalBytesToSend.
 }
 CLOUD_SESSION_T;
 
@@ -92,8 +189,11 @@ CLOUD_SESSION_T;
 void cloud_init(void);
 bool cloud_initSession(CLOUD_SESSION_T *s, char *serverName, uint16_t serverPort);
 void cloud_closeSession(CLOUD_SESSION_T *s);
+void cloud_releaseSession(CLOUD_SESSION_T *s);
 void cloud_sessionConnectAndSend(CLOUD_SESSION_T *s);
-bool cloud_sessionSendRecvAll(CLOUD_SESSION_T *s, uint32_t timeoutSec);
+bool cloud_sessionSendRecvAll(CLOUD_SESSION_T *s);
+bool cloud_sessionWrite(CLOUD_SESSION_T *s, const char *data, size_t len);
 void cloud_resetSessionStatus(CLOUD_SESSION_T *s);
+void cloud_processEvents(uint32_t timeoutMs);
 
 #endif /* _CLOUD_H_ */
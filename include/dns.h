@@ -0,0 +1,58 @@
+#ifndef _DNS_H_
+#define _DNS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <netinet/in.h>
+
+#define DNS_CACHE_SIZE      (64)
+#define DNS_NAME_LEN        (128)
+#define DNS_PORT            (53)
+#define DNS_RETRY_MS        (400)
+#define DNS_RETRY_LIMIT     (3)
+#define DNS_NEGATIVE_TTL    (10)
+#define DNS_MAX_TTL         (86400)
+#define DNS_FAMILY_COUNT    (2)
+
+//
+// DNS Lookup Status
+//
+typedef enum
+{
+   DNS_PENDING,
+   DNS_RESOLVED,
+   DNS_FAILED,
+}
+DNS_STATUS_T;
+
+//
+// Resolved Address
+//
+typedef struct
+{
+   int family;                        //!< AF_INET or AF_INET6
+   union
+   {
+      struct in_addr in4;
+      struct in6_addr in6;
+   } u;
+}
+DNS_ADDR_T;
+
+//
+// Lookup Done Callback, called when queries have been answered or given up
+//
+typedef void (*DNS_DONE_CB_T)(void);
+
+//
+// Function Prototypes
+//
+bool dns_init(void);
+void dns_setDoneCallback(DNS_DONE_CB_T callback);
+void dns_prefetch(char *name);
+DNS_STATUS_T dns_lookup(char *name, int family, DNS_ADDR_T *addr);
+int  dns_getPreferredFamily(char *name);
+void dns_setPreferredFamily(char *name, int family);
+uint32_t dns_processTimers(void);
+
+#endif /* _DNS_H_ */
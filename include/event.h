@@ -0,0 +1,42 @@
+#ifndef _EVENT_H_
+#define _EVENT_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/epoll.h>
+#include "wheel.h"
+
+#define EVENT_MAX_EVENTS  (256)
+
+//
+// Event readiness callback
+//
+typedef void (*EVENT_CALLBACK_T)(void *arg, uint32_t events);
+
+//
+// Event Handler Structure
+//
+typedef struct
+{
+   int fd;                            //!< File descriptor watched by this handler
+   uint32_t events;                   //!< Current epoll interest set
+   bool registered;                   //!< True while the descriptor is in the epoll set
+   EVENT_CALLBACK_T callback;         //!< Called with the ready events
+   void *arg;                         //!< Callback argument
+}
+EVENT_HANDLER_T;
+
+//
+// Function Prototypes
+//
+bool event_init(void);
+void event_initHandler(EVENT_HANDLER_T *h, EVENT_CALLBACK_T callback, void *arg);
+bool event_addHandler(EVENT_HANDLER_T *h, int fd, uint32_t events);
+bool event_modifyHandler(EVENT_HANDLER_T *h, uint32_t events);
+void event_removeHandler(EVENT_HANDLER_T *h);
+void event_wake(void);
+void event_addTimer(WHEEL_TIMER_T *timer, uint32_t delayMs);
+void event_cancelTimer(WHEEL_TIMER_T *timer);
+int  event_wait(int timeoutMs);
+
+#endif /* _EVENT_H_ */
@@ -3,34 +3,29 @@
 
 #include "public.h"
 
-//
-// Private Variables
-//
-extern int fsm_state;
-extern bool initialized;
-extern bool data_sending;
-
-/* Transition input word extern */
-extern uint32_t fsm_trans_input;
+/* Transition input word bits, below the timer bits */
+#define FSM_INPUT_INITIALIZED   0x00000001
+#define FSM_INPUT_SENDING       0x00000002
+#define FSM_INPUT_SESSION_ERROR 0x00000004
+#define FSM_INPUT_RUN           0x00000008
 
 /* Input word processing function prototype */
-void fsm_process_inputs(void);
+void fsm_process_inputs(uint32_t *input_word, void *context);
 
 /* Entry action prototypes */
-void init_state_entry(void);
-void idle_state_entry(void);
-void send_state_entry(void);
+void init_state_entry(void *context);
+void idle_state_entry(void *context);
+void send_state_entry(void *context);
 
 /* Activity function prototypes */
-void init_state_act(void);
-void idle_state_act(void);
-void send_state_act(void);
+void init_state_act(void *context);
+void idle_state_act(void *context);
+void send_state_act(void *context);
 
 /* Exit action prototypes */
-void send_state_exit(void);
+void send_state_exit(void *context);
 
 /* Transition action prototypes */
-void idle_state_to_send_state1(void);
-void send_state_to_send_state2(void);
+void idle_state_to_send_state1(void *context);
 
 #endif /* _PRIVATE_H_ */
@@ -11,7 +11,8 @@ extern const FSM_CONFIG_T fsm_config;
 #define FSM_IDLE_STATE 1
 #define FSM_SEND_STATE 2
 
-/* State machine loop delay in seconds */
-#define FSM_LOOP_DELAY 1
+/* Run the state machine of a task on its own workspace */
+void fsm_start(FSM_WORKSPACE_T *workspace, void *context);
+void fsm_run(FSM_WORKSPACE_T *workspace);
 
 #endif /* _PUBLIC_H_ */
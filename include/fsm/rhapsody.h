@@ -11,6 +11,13 @@
 //
 #define FSM_TRANS_END 255
 
+/* Timers of each instance, up to 31, timer index i (from 0) sets input bit 31 - i when it expires */
+#ifndef FSM_TIMER_MAX
+#define FSM_TIMER_MAX 3
+#endif
+#define FSM_TIMER_INPUT(index) (0x80000000u >> (index))
+#define FSM_TIMER_INPUT_MASK   ((uint32_t)(0xffffffff00000000ull >> FSM_TIMER_MAX))
+
 //
 // Macros for setting/clearing bits in the input word
 //
@@ -18,26 +25,29 @@
 #define CLR_INP_BIT(input_word,bit_mask) input_word &= ~(bit_mask)
 
 //
-// FSM workspace structure for persistent data
+// FSM timer, counting the process calls since it started
+//
+typedef struct
+{
+   uint32_t count;
+   uint32_t timeout;
+   uint32_t timeout_backup;
+   uint8_t  enable; /* Indicates whether the timer is enabled or not */
+}
+FSM_TIMER_T;
+
+//
+// FSM workspace structure for persistent data, one for each instance
 //
 typedef struct
 {
-   uint32_t timer1;
-   uint32_t timer1_timeout;
-   uint32_t timer1_timeout_backup;
-   uint32_t timer2;
-   uint32_t timer2_timeout;
-   uint32_t timer2_timeout_backup;
-   uint32_t timer3;
-   uint32_t timer3_timeout;
-   uint32_t timer3_timeout_backup;
+   FSM_TIMER_T timer[FSM_TIMER_MAX];
+   uint32_t trans_input; /* Transition input word */
    uint32_t last_input_word; /* Last input word */
    uint32_t last_event_trans_cond_mask; /* Last condition mask that caused an event */
-   uint8_t  timer1_enable; /* Indicates whether timer1 is enabled or not */
-   uint8_t  timer2_enable; /* Indicates whether timer2 is enabled or not */
-   uint8_t  timer3_enable; /* Indicates whether timer3 is enabled or not */
    uint8_t  current_state;
    uint8_t  transition; /* Flag to indicate that a transition just occurred */
+   void     *context; /* Passed to the functions of the instance */
 }
 FSM_WORKSPACE_T;
 
@@ -50,7 +60,7 @@ typedef struct
    uint8_t  next_state;
    uint32_t trans_cond_mask; /* Transition condition mask (use 0 for don't care bits) */
    uint32_t trans_dont_care_mask; /* Transition don't care mask to indicate don't care conditions with a 0 */
-   void (*trans_funct_ptr)(void); /* Function to run upon state transition to next state */
+   void (*trans_funct_ptr)(void *context); /* Function to run upon state transition to next state */
 }
 FSM_TRANS_CONFIG_T;
 
@@ -60,83 +70,216 @@ FSM_TRANS_CONFIG_T;
 //
 typedef struct
 {
-   void (*entry_action_funct_ptr)(void); /* Function to run upon state entry */
-   void (*activity_funct_ptr)(void); /* Function to run while in the state */
-   void (*exit_action_funct_ptr)(void); /* Function to run upon state entry */
+   void (*entry_action_funct_ptr)(void *context); /* Function to run upon state entry */
+   void (*activity_funct_ptr)(void *context); /* Function to run while in the state */
+   void (*exit_action_funct_ptr)(void *context); /* Function to run upon state exit */
    const FSM_TRANS_CONFIG_T *state_trans_config_ptr; /* Pointer to current state transition config */
 }
 FSM_STATE_CONFIG_T;
 
 
 //
-// State machine main configuration structure
+// State machine main configuration structure, shared by all instances
 //
 typedef struct
 {
    uint8_t   initial_state;
-   uint32_t* trans_input_ptr;
    const FSM_STATE_CONFIG_T *state_config_ptr;
-   FSM_WORKSPACE_T *workspace_ptr;
-   void (*process_inputs_funct_ptr)(void); /* Function to process the input word bits */
-   void (*power_up_trans_funct_ptr)(void); /* Function for power up if needed */
+   void (*process_inputs_funct_ptr)(uint32_t *input_word, void *context); /* Function to process the input word bits */
+   void (*power_up_trans_funct_ptr)(void *context); /* Function for power up if needed */
 }
 FSM_CONFIG_T;
 
 //
 // FSM Main Routines
 //
+// They are inline so that an instance run with a constant configuration
+// compiles down to its own tables and functions.
+//
 
-#ifdef __cplusplus
-extern "C" {
-#endif
+//!
+//! Start an instance in the initial state, its entry action runs on the
+//! first process call
+//!
+static inline void fsm_init(FSM_WORKSPACE_T *ws, const FSM_CONFIG_T *cfg, void *context)
+{
+   int i;
+
+   for (i = 0; i < FSM_TIMER_MAX; i++)
+   {
+      ws->timer[i].count = 0;
+      ws->timer[i].timeout = 0;
+      ws->timer[i].timeout_backup = 0;
+      ws->timer[i].enable = 0;
+   }
+   ws->trans_input = 0;
+   ws->last_input_word = 0xffffffff;
+   ws->last_event_trans_cond_mask = 0xffffffff;
+   ws->current_state = cfg->initial_state;
+   ws->transition = 1;
+   ws->context = context;
+   if (cfg->power_up_trans_funct_ptr != NULL)
+   {
+      cfg->power_up_trans_funct_ptr(context);
+   }
+}
 
-void fsm_init(const FSM_CONFIG_T *fsm_config_ptr);
-void fsm_process(const FSM_CONFIG_T *fsm_config_ptr);
+//!
+//! Run an instance once: count its timers, run the entry action after a
+//! transition and the activity of the state, then take the first transition
+//! whose condition matches the input word. Transitions are only looked for
+//! when the input word changed, and one back to the same state is not taken
+//! again for the same condition.
+//!
+static inline void fsm_process(FSM_WORKSPACE_T *ws, const FSM_CONFIG_T *cfg)
+{
+   const FSM_STATE_CONFIG_T *state;
+   const FSM_TRANS_CONFIG_T *trans;
+   FSM_TIMER_T *timer;
+   int i;
 
-//
-// Timer 1 Routines
-//
-void fsm_timer1_enable(uint32_t timeout, const FSM_CONFIG_T *fsm_config_ptr);
-void fsm_timer1_new_timeout(uint32_t timeout, const FSM_CONFIG_T *fsm_config_ptr);
-void fsm_timer1_restart_with_timeout_and_old_time(uint32_t restartvalue, uint32_t timeout, const FSM_CONFIG_T *fsm_config_ptr);
-void fsm_timer1_disable(const FSM_CONFIG_T *fsm_config_ptr);
-void fsm_timer1_stop(const FSM_CONFIG_T *fsm_config_ptr);
-void fsm_timer1_start(const FSM_CONFIG_T *fsm_config_ptr);
-uint32_t fsm_timer1_get_elapsed(const FSM_CONFIG_T *fsm_config_ptr);
-uint32_t fsm_timer1_get_timeout(const FSM_CONFIG_T *fsm_config_ptr);
+   for (i = 0; i < FSM_TIMER_MAX; i++)
+   {
+      timer = &ws->timer[i];
+      if (timer->enable)
+      {
+         if ((timer->count < timer->timeout) && (timer->count < timer->timeout_backup))
+         {
+            timer->count++;
+         }
+         else
+         {
+            SET_INP_BIT(ws->trans_input, FSM_TIMER_INPUT(i));
+         }
+      }
+   }
 
-//
-// Timer 2 Routines
-//
-void fsm_timer2_enable(uint32_t timeout, const FSM_CONFIG_T *fsm_config_ptr);
-void fsm_timer2_new_timeout(uint32_t timeout, const FSM_CONFIG_T *fsm_config_ptr);
-void fsm_timer2_restart_with_timeout_and_old_time(uint32_t restartvalue, uint32_t timeout, const FSM_CONFIG_T *fsm_config_ptr);
-void fsm_timer2_disable(const FSM_CONFIG_T *fsm_config_ptr);
-void fsm_timer2_stop(const FSM_CONFIG_T *fsm_config_ptr);
-void fsm_timer2_start(const FSM_CONFIG_T *fsm_config_ptr);
-uint32_t fsm_timer2_get_elapsed(const FSM_CONFIG_T *fsm_config_ptr);
-uint32_t fsm_timer2_get_timeout(const FSM_CONFIG_T *fsm_config_ptr);
+   state = &cfg->state_config_ptr[ws->current_state];
+   if (ws->transition)
+   {
+      if (state->entry_action_funct_ptr != NULL)
+      {
+         state->entry_action_funct_ptr(ws->context);
+      }
+      ws->transition = 0;
+   }
+   if (state->activity_funct_ptr != NULL)
+   {
+      state->activity_funct_ptr(ws->context);
+   }
+   if (cfg->process_inputs_funct_ptr != NULL)
+   {
+      cfg->process_inputs_funct_ptr(&ws->trans_input, ws->context);
+   }
+
+   if (ws->trans_input == ws->last_input_word)
+   {
+      return;
+   }
+   ws->last_input_word = ws->trans_input;
+   for (trans = state->state_trans_config_ptr; trans->next_state != FSM_TRANS_END; trans++)
+   {
+      if (((ws->trans_input ^ trans->trans_cond_mask) & trans->trans_dont_care_mask) != 0)
+      {
+         continue;
+      }
+      if ((ws->last_event_trans_cond_mask == trans->trans_cond_mask) &&
+          (ws->current_state == trans->next_state))
+      {
+         continue;
+      }
+      ws->last_event_trans_cond_mask = trans->trans_cond_mask;
+      if (ws->current_state != trans->next_state)
+      {
+         ws->last_input_word = 0xffffffff;
+         ws->last_event_trans_cond_mask = 0xffffffff;
+         ws->current_state = trans->next_state;
+      }
+      if (state->exit_action_funct_ptr != NULL)
+      {
+         state->exit_action_funct_ptr(ws->context);
+      }
+      if (trans->trans_funct_ptr != NULL)
+      {
+         trans->trans_funct_ptr(ws->context);
+      }
+      ws->transition = 1;
+      break;
+   }
+}
 
 //
-// Timer 3 Routines
+// Timer Routines, counting process calls. Each clears the expired bit of
+// the timer from the input word.
 //
-void fsm_timer3_enable(uint32_t timeout, const FSM_CONFIG_T *fsm_config_ptr);
-void fsm_timer3_new_timeout(uint32_t timeout, const FSM_CONFIG_T *fsm_config_ptr);
-void fsm_timer3_restart_with_timeout_and_old_time(uint32_t restartvalue, uint32_t timeout, const FSM_CONFIG_T *fsm_config_ptr);
-void fsm_timer3_disable(const FSM_CONFIG_T *fsm_config_ptr);
-void fsm_timer3_stop(const FSM_CONFIG_T *fsm_config_ptr);
-void fsm_timer3_start(const FSM_CONFIG_T *fsm_config_ptr);
-uint32_t fsm_timer3_get_elapsed(const FSM_CONFIG_T *fsm_config_ptr);
-uint32_t fsm_timer3_get_timeout(const FSM_CONFIG_T *fsm_config_ptr);
+static inline void fsm_timer_enable(FSM_WORKSPACE_T *ws, int index, uint32_t timeout)
+{
+   CLR_INP_BIT(ws->trans_input, FSM_TIMER_INPUT(index));
+   ws->timer[index].count = 0;
+   ws->timer[index].timeout = timeout;
+   ws->timer[index].timeout_backup = timeout;
+   ws->timer[index].enable = 1;
+}
+
+static inline void fsm_timer_new_timeout(FSM_WORKSPACE_T *ws, int index, uint32_t timeout)
+{
+   CLR_INP_BIT(ws->trans_input, FSM_TIMER_INPUT(index));
+   ws->timer[index].timeout = timeout;
+   ws->timer[index].timeout_backup = timeout;
+   ws->timer[index].enable = 1;
+}
+
+static inline void fsm_timer_restart_with_timeout_and_old_time(FSM_WORKSPACE_T *ws, int index,
+                                                               uint32_t restartvalue, uint32_t timeout)
+{
+   CLR_INP_BIT(ws->trans_input, FSM_TIMER_INPUT(index));
+   ws->timer[index].timeout = timeout;
+   ws->timer[index].timeout_backup = timeout;
+   ws->timer[index].count = restartvalue;
+   ws->timer[index].enable = 1;
+}
+
+static inline void fsm_timer_disable(FSM_WORKSPACE_T *ws, int index)
+{
+   CLR_INP_BIT(ws->trans_input, FSM_TIMER_INPUT(index));
+   ws->timer[index].count = 0;
+   ws->timer[index].enable = 0;
+}
+
+static inline void fsm_timer_stop(FSM_WORKSPACE_T *ws, int index)
+{
+   CLR_INP_BIT(ws->trans_input, FSM_TIMER_INPUT(index));
+   ws->timer[index].enable = 0;
+}
+
+static inline void fsm_timer_start(FSM_WORKSPACE_T *ws, int index)
+{
+   CLR_INP_BIT(ws->trans_input, FSM_TIMER_INPUT(index));
+   ws->timer[index].enable = 1;
+}
+
+static inline uint32_t fsm_timer_get_elapsed(const FSM_WORKSPACE_T *ws, int index)
+{
+   return ws->timer[index].count;
+}
+
+static inline uint32_t fsm_timer_get_timeout(const FSM_WORKSPACE_T *ws, int index)
+{
+   return ws->timer[index].timeout;
+}
 
 //
 // State and Transition Routines
 //
-uint8_t fsm_get_current_state(const FSM_CONFIG_T *fsm_config_ptr);
-void fsm_clear_trans_history(const FSM_CONFIG_T *fsm_config_ptr);
+static inline uint8_t fsm_get_current_state(const FSM_WORKSPACE_T *ws)
+{
+   return ws->current_state;
+}
 
-#ifdef __cplusplus
+static inline void fsm_clear_trans_history(FSM_WORKSPACE_T *ws)
+{
+   ws->last_input_word = 0xffffffff;
+   ws->last_event_trans_cond_mask = 0xffffffff;
 }
-#endif
 
 #endif /* _RHAPSODY_H_ */
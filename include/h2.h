@@ -0,0 +1,114 @@
+#ifndef _H2_H_
+#define _H2_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "hpack.h"
+#include "parse.h"
+
+#define H2_FRAME_HEADER_LEN  (9)
+#define H2_FRAME_LEN         (16384)
+#define H2_BLOCK_LEN         (16384)
+#define H2_STREAM_MAX        (32)
+#define H2_WINDOW_LEN        (1048576)
+#define H2_STREAM_WINDOW     (65536)
+
+//
+// Response Header Callback, called with the header of each response once
+// it is passed on
+//
+typedef void (*H2_HEADERS_CB_T)(void *arg, int index, const PARSE_RESPONSE_T *r);
+
+//
+// Response Data Callback, called with the payload of the response being
+// passed on
+//
+typedef void (*H2_DATA_CB_T)(void *arg, int index, const char *data, size_t len);
+
+//
+// Response End Callback, called once a response is complete
+//
+typedef void (*H2_END_CB_T)(void *arg, int index);
+
+//
+// Write Callback, called with the frames to send while responses are
+// being received. Returns false if they cannot be sent.
+//
+typedef bool (*H2_WRITE_CB_T)(void *arg, const char *data, size_t len);
+
+//
+// HTTP/2 Stream, one for each request of a transaction
+//
+typedef struct
+{
+   PARSE_RESPONSE_T response;         //!< Header fields of the final response
+   bool headers;                      //!< Final response header received
+   bool ended;                        //!< Server ended the stream
+   bool done;                         //!< End passed to the end callback
+   uint64_t received;                 //!< DATA frame bytes received, padding included
+   uint64_t granted;                  //!< Flow control window granted in total
+   char *buf;                         //!< Payload held until the response is passed on
+   size_t bufLen;                     //!< Bytes of payload held
+}
+H2_STREAM_T;
+
+//
+// HTTP/2 Connection, the client side of a cleartext connection opened
+// with prior knowledge
+//
+// The requests of a transaction go out at once, one stream each, and the
+// server sends the responses side by side. The callbacks take one
+// response at a time: a complete response is passed on first, whatever
+// the order of the requests, otherwise the first one with a header. The
+// payload of the others is held meanwhile, at most H2_STREAM_WINDOW bytes
+// each, as their windows are only granted again once they are passed on.
+//
+typedef struct
+{
+   const char *name;                  //!< Connection name for debug printing
+   bool prefaceSent;                  //!< Connection preface and settings are sent
+   bool ackPending;                   //!< Settings of the server still to be acknowledged
+   bool goaway;                       //!< Server is closing the connection
+   HPACK_TABLE_T encoder;             //!< Dynamic table of the request headers
+   HPACK_TABLE_T decoder;             //!< Dynamic table of the response headers
+   uint32_t tableLimit;               //!< Header table size set by the server
+   bool tableUpdate;                  //!< Table size change to announce in the next block
+   uint32_t nextId;                   //!< Identifier of the next stream
+   uint32_t firstId;                  //!< Identifier of the stream of the first request
+   int streamCount;                   //!< Streams of the transaction
+   int current;                       //!< Stream whose response is passed on, -1 if none
+   H2_STREAM_T streams[H2_STREAM_MAX];
+   PARSE_RESPONSE_T discard;          //!< Target of header blocks that are not kept
+   PARSE_RESPONSE_T *target;          //!< Target of the header block being decoded
+   uint8_t header[H2_FRAME_HEADER_LEN]; //!< Header of the frame being received
+   size_t headerLen;                  //!< Bytes of the frame header received
+   uint32_t frameLen;                 //!< Payload length of the frame
+   uint8_t frameType;                 //!< Type of the frame
+   uint8_t frameFlags;                //!< Flags of the frame
+   uint32_t frameId;                  //!< Stream identifier of the frame
+   uint32_t payloadLen;               //!< Bytes of the payload received
+   uint8_t padLen;                    //!< Padding at the end of a DATA frame
+   uint8_t payload[H2_FRAME_LEN];     //!< Payload of a frame other than DATA
+   uint8_t block[H2_BLOCK_LEN];       //!< Header block being received
+   size_t blockLen;                   //!< Bytes of the header block received
+   uint32_t blockId;                  //!< Stream of the header block, 0 if none
+   bool blockEnd;                     //!< Header block ends its stream
+   uint32_t connConsumed;             //!< Bytes received on the connection not yet granted again
+   H2_HEADERS_CB_T headersCb;         //!< Called with the header of each response
+   H2_DATA_CB_T dataCb;               //!< Called with the payload of each response
+   H2_END_CB_T endCb;                 //!< Called as each response completes
+   H2_WRITE_CB_T writeCb;             //!< Called with frames to send
+   void *arg;                         //!< Argument passed back to the callbacks
+}
+H2_T;
+
+//
+// Function Prototypes
+//
+void h2_init(H2_T *c, const char *name, H2_HEADERS_CB_T headersCb, H2_DATA_CB_T dataCb,
+             H2_END_CB_T endCb, H2_WRITE_CB_T writeCb, void *arg);
+int  h2_request(H2_T *c, char *buf, int len, int bufLen);
+bool h2_recv(H2_T *c, const char *data, size_t len);
+
+#endif /* _H2_H_ */
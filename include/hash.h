@@ -0,0 +1,29 @@
+#ifndef _HASH_H_
+#define _HASH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define HASH_STRIPE_LEN  (32)
+
+//
+// Streaming XXH64 state, a fast non-cryptographic hash to recognise
+// content that has not changed
+//
+typedef struct
+{
+   uint64_t total;                    //!< Bytes hashed so far
+   uint64_t acc[4];                   //!< Accumulators of the stripe lanes
+   uint8_t mem[HASH_STRIPE_LEN];      //!< Bytes of a stripe that is not complete
+   size_t memLen;                     //!< Bytes waiting in mem
+}
+HASH_T;
+
+//
+// Function Prototypes
+//
+void hash_init(HASH_T *h);
+void hash_update(HASH_T *h, const void *data, size_t len);
+uint64_t hash_final(const HASH_T *h);
+
+#endif /* _HASH_H_ */
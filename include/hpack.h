@@ -0,0 +1,45 @@
+#ifndef _HPACK_H_
+#define _HPACK_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define HPACK_TABLE_LEN       (4096)
+#define HPACK_ENTRY_OVERHEAD  (32)
+#define HPACK_ENTRY_MAX       (HPACK_TABLE_LEN / HPACK_ENTRY_OVERHEAD)
+
+//
+// Header Field Callback, called with each field of a decoded header block.
+// A name or value longer than HPACK_TABLE_LEN is cut short.
+//
+typedef void (*HPACK_FIELD_CB_T)(void *arg, const char *name, size_t nameLen,
+                                 const char *value, size_t valueLen);
+
+//
+// HPACK Dynamic Table
+//
+// One is kept by each side of a connection for each direction. The
+// newest entry comes first, both in the lengths and in the data.
+//
+typedef struct
+{
+   uint32_t maxSize;                  //!< Size limit of the table
+   uint32_t size;                     //!< Size of the entries, 32 bytes more each than their text
+   int count;                         //!< Number of entries
+   uint16_t nameLen[HPACK_ENTRY_MAX]; //!< Name length of each entry
+   uint16_t valueLen[HPACK_ENTRY_MAX];//!< Value length of each entry
+   char data[HPACK_TABLE_LEN];        //!< Name and value of each entry
+}
+HPACK_TABLE_T;
+
+//
+// Function Prototypes
+//
+void   hpack_initTable(HPACK_TABLE_T *t, uint32_t maxSize);
+size_t hpack_encodeField(HPACK_TABLE_T *t, uint8_t *out, size_t outLen, const char *name,
+                         size_t nameLen, const char *value, size_t valueLen);
+size_t hpack_encodeSizeUpdate(HPACK_TABLE_T *t, uint8_t *out, size_t outLen, uint32_t maxSize);
+bool   hpack_decode(HPACK_TABLE_T *t, const uint8_t *block, size_t len, HPACK_FIELD_CB_T cb, void *arg);
+
+#endif /* _HPACK_H_ */
@@ -1,6 +1,10 @@
 #ifndef _PARSE_H_
 #define _PARSE_H_
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
 //
 // HTTP Response Code Defines
 //
@@ -21,6 +25,7 @@
 
 #define HTTP_MULTIPLE_CHOICE        300
 #define HTTP_MOVED_PERMANENTLY      301
+#define HTTP_NOT_MODIFIED           304
 #define HTTP_TEMPORARY_REDIRECT     307
 #define HTTP_PERMANENT_REDIRECT     308
 
@@ -30,6 +35,7 @@
 #define HTTP_NOT_FOUND              404
 #define HTTP_REQUEST_TIMEOUT        408
 #define HTTP_LENGTH_REQUIRED        411
+#define HTTP_RANGE_NOT_SATISFIABLE  416
 
 #define HTTP_INTERNAL_ERROR         500
 #define HTTP_NOT_IMPLEMENTED        501
@@ -38,17 +44,78 @@
 #define HTTP_GATEWAY_TIMEOUT        504
 #define HTTP_VERSION_NOT_SUPPORTED  505
 
+#define PARSE_LINE_LEN              (256)
+#define PARSE_VALIDATOR_LEN         (128)
+#define PARSE_ACCEPT_LEN            (32)
+#define PARSE_MAX_HEADER_LEN        (65536)
+
+//
+// HTTP Response Parser State
+//
+typedef enum
+{
+   PARSE_STATUS_LINE,
+   PARSE_HEADER_LINE,
+   PARSE_BODY_LENGTH,
+   PARSE_BODY_CLOSE,
+   PARSE_CHUNK_SIZE,
+   PARSE_CHUNK_DATA,
+   PARSE_CHUNK_END,
+   PARSE_TRAILER,
+   PARSE_DONE,
+   PARSE_ERROR,
+}
+PARSE_STATE_T;
+
+//
+// Body Callback, called with each span of payload bytes as it is parsed
+//
+typedef void (*PARSE_BODY_CB_T)(void *arg, const char *data, size_t len);
+
+//
+// HTTP Response Parser
+//
+// Fed with the bytes of a response as they arrive. Offsets are counted
+// from the first byte of the response.
+//
+typedef struct
+{
+   PARSE_STATE_T state;               //!< What the next byte belongs to
+   int statusCode;                    //!< Status code of the status line
+   int minorVersion;                  //!< 0 for HTTP/1.0, 1 for HTTP/1.1
+   bool keepAlive;                    //!< Server allows the connection to be reused
+   bool chunked;                      //!< Body uses chunked transfer coding
+   bool connClose;                    //!< "Connection: close" was sent
+   bool connKeep;                     //!< "Connection: keep-alive" was sent
+   bool eventStream;                  //!< Body is a text/event-stream of Server-Sent Events
+   bool waitApplied;                  //!< "Preference-Applied: wait" was sent, the request was held
+   bool upgradeWebSocket;             //!< "Upgrade: websocket" was sent
+   int64_t contentLength;             //!< Content-Length, -1 if not sent
+   int64_t rangeFirst;                //!< First byte of Content-Range, -1 if not sent
+   int64_t rangeLast;                 //!< Last byte of Content-Range, -1 if not sent
+   int64_t rangeTotal;                //!< Complete length of Content-Range, -1 if unknown
+   char etag[PARSE_VALIDATOR_LEN];    //!< ETag validator, empty if not sent
+   char lastModified[PARSE_VALIDATOR_LEN]; //!< Last-Modified validator, empty if not sent
+   char websocketAccept[PARSE_ACCEPT_LEN]; //!< Sec-WebSocket-Accept, empty if not sent
+   uint64_t remaining;                //!< Bytes left in the body or chunk
+   size_t headerLen;                  //!< Length of the header, start of the body
+   size_t length;                     //!< Bytes of the response consumed so far
+   size_t lineLen;                    //!< Bytes of the current line kept
+   char line[PARSE_LINE_LEN];         //!< Current line, truncated when longer
+}
+PARSE_RESPONSE_T;
+
 //
 // Function Prototypes
 //
-char* parse_getContentStart(char* strPtr);
-int  parse_getContentLength(char* strPtr);
-bool parse_contentLengthFound(char* strPtr);
-bool parse_entireContentReceived(char* strPtr, size_t bytesRcvd);
-bool parse_fullDataChunkFound(char* strPtr);
-bool parse_fullHeaderFound(char* strPtr);
-int  parse_getStatusCode(char* strPtr);
-bool parse_goodStatusCode(int code);
-bool parse_transferEncodingChunkedFound(char* strPtr);
+void   parse_initResponse(PARSE_RESPONSE_T *r);
+size_t parse_response(PARSE_RESPONSE_T *r, const char *data, size_t len, PARSE_BODY_CB_T cb, void *arg);
+uint64_t parse_bodyRemaining(const PARSE_RESPONSE_T *r);
+void   parse_skipBody(PARSE_RESPONSE_T *r, size_t len);
+bool   parse_responseDone(const PARSE_RESPONSE_T *r);
+bool   parse_responseFailed(const PARSE_RESPONSE_T *r);
+bool   parse_endOfStream(PARSE_RESPONSE_T *r);
+void   parse_field(PARSE_RESPONSE_T *r, const char *name, size_t nameLen, const char *value);
+bool   parse_goodStatusCode(int code);
 
 #endif /* _PARSE_H_ */
@@ -0,0 +1,26 @@
+#ifndef _POOL_H_
+#define _POOL_H_
+
+#include "cloud.h"
+
+#define POOL_MAX_ORIGINS   (16)
+#define POOL_MAX_SESSIONS  (8)
+#define POOL_MAX_INFLIGHT  (64)
+#define POOL_MAX_DEDICATED (1024)
+
+//
+// Release Callback, told of each session given back to the pool
+//
+typedef void (*POOL_RELEASE_CB_T)(void);
+
+//
+// Function Prototypes
+//
+CLOUD_SESSION_T* pool_acquireSession(char *serverName, uint16_t serverPort);
+bool pool_isAvailable(const char *serverName, uint16_t serverPort);
+CLOUD_SESSION_T* pool_acquireDedicated(char *serverName, uint16_t serverPort, CLOUD_SESSION_T **session);
+void pool_releaseSession(CLOUD_SESSION_T *s);
+void pool_setReleaseCallback(POOL_RELEASE_CB_T callback);
+void pool_setLimits(int processMax, int originMax, int dedicatedMax);
+
+#endif /* _POOL_H_ */
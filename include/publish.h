@@ -0,0 +1,62 @@
+#ifndef _PUBLISH_H_
+#define _PUBLISH_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define PUBLISH_MAGIC        (0x57504231)
+#define PUBLISH_NAME_LEN     (64)
+#define PUBLISH_DATA_LEN     (1048576)
+#define PUBLISH_READ_TRIES   (1000)
+
+//
+// Shared Segment Layout
+//
+// The content is guarded by a seqlock. The writer makes the sequence odd
+// while it replaces the content and even again when it is done, so a
+// reader that sees the same even sequence before and after copying has a
+// consistent copy.
+//
+typedef struct
+{
+   uint32_t magic;                    //!< PUBLISH_MAGIC once the segment is set up
+   uint32_t capacity;                 //!< Bytes available for the content
+   uint64_t sequence;                 //!< Seqlock sequence, odd while being written
+   uint64_t version;                  //!< Incremented with every publication
+   uint64_t timestamp;                //!< Time of the publication, ms since the epoch
+   uint64_t length;                   //!< Bytes of content
+   char data[];                       //!< Content
+}
+PUBLISH_SEGMENT_T;
+
+//
+// Handle of a writer or reader of a shared segment
+//
+typedef struct
+{
+   PUBLISH_SEGMENT_T *seg;            //!< Mapped segment, NULL if none
+   size_t mapLen;                     //!< Bytes mapped
+   size_t capacity;                   //!< Bytes of content the mapping holds
+}
+PUBLISH_T;
+
+//
+// Function Prototypes
+//
+
+/* Writer */
+bool publish_open(PUBLISH_T *p, const char *name, size_t capacity);
+bool publish_update(PUBLISH_T *p, const char *data, size_t len);
+bool publish_file(PUBLISH_T *p, const char *path);
+
+/* Reader */
+bool publish_attach(PUBLISH_T *p, const char *name);
+uint64_t publish_version(const PUBLISH_T *p);
+ssize_t publish_read(const PUBLISH_T *p, char *buf, size_t len, uint64_t *version,
+                     uint64_t *timestamp);
+
+void publish_close(PUBLISH_T *p);
+
+#endif /* _PUBLISH_H_ */
@@ -0,0 +1,96 @@
+#ifndef _SEGMENT_H_
+#define _SEGMENT_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "cloud.h"
+#include "sink.h"
+
+#define SEGMENT_MAX           (8)
+#define SEGMENT_PROBE_LEN     (1048576)
+#define SEGMENT_SAVE_LEN      (4194304)
+#define SEGMENT_RETRY_LIMIT   (3)
+#define SEGMENT_STATE_SUFFIX  ".seg"
+
+//
+// Segment Request Callback, writes the request for bytes first to last
+// of the file into the buffer and returns its length, -1 if it does not
+// fit in CLOUD_SEND_BUF_LEN bytes. A validator that is not empty is sent
+// as If-Range, so that the server sends the whole file if it changed.
+//
+typedef int (*SEGMENT_REQUEST_CB_T)(char *buf, uint64_t first, uint64_t last,
+                                    const char *validator, void *arg);
+
+//
+// Segmented Download Status
+//
+typedef enum
+{
+   SEGMENT_PENDING,
+   SEGMENT_COMPLETED,
+   SEGMENT_FAILED,
+}
+SEGMENT_STATUS_T;
+
+//
+// Byte range of the file still to be fetched
+//
+typedef struct
+{
+   uint64_t next;                     //!< Next byte to fetch
+   uint64_t end;                      //!< One past the last byte of the range
+   int failures;                      //!< Requests in a row that fetched nothing
+}
+SEGMENT_RANGE_T;
+
+//
+// Connection fetching one range at a time
+//
+typedef struct
+{
+   CLOUD_SESSION_T *session;          //!< Session of the connection, NULL if idle
+   int range;                         //!< Range being fetched
+   bool sent;                         //!< Request of the range has been sent
+   int accepted;                      //!< Response matches the range, 1 yes, 0 no, -1 not checked
+   uint64_t start;                    //!< First byte asked for by the request
+}
+SEGMENT_SLOT_T;
+
+//
+// Segmented Download, fetches the ranges of a file over parallel
+// connections and writes each range at its offset of the file
+//
+typedef struct
+{
+   SINK_T sink;                       //!< File the ranges are written to
+   char statePath[SINK_PATH_LEN];     //!< Ranges still to fetch, kept to resume the download
+   char *serverName;                  //!< Server of the file
+   uint16_t serverPort;               //!< Server port number
+   CLOUD_DEADLINES_T deadlines;       //!< Deadlines of each range request
+   SEGMENT_REQUEST_CB_T requestCb;    //!< Builds the request of a range
+   CLOUD_WAKE_CB_T wakeCb;            //!< Runs the owner when a connection has something to act on
+   void *requestArg;                  //!< Argument passed back to the request and wake callbacks
+   int connections;                   //!< Connections to use
+   SEGMENT_SLOT_T slots[SEGMENT_MAX];
+   SEGMENT_RANGE_T ranges[SEGMENT_MAX + 1];
+   int rangeCount;                    //!< Ranges the file is split into
+   int64_t total;                     //!< Length of the file, -1 until known
+   char validator[PARSE_VALIDATOR_LEN]; //!< Strong ETag or Last-Modified of the file, empty if not sent
+   bool changed;                      //!< File changed on the server since the ranges were fetched
+   int restarts;                      //!< Times the download started over for a changed file
+   bool whole;                        //!< Server ignores ranges, the file is fetched in one piece
+   uint64_t unsaved;                  //!< Bytes fetched since the state was last saved
+}
+SEGMENT_DOWNLOAD_T;
+
+//
+// Function Prototypes
+//
+void segment_init(SEGMENT_DOWNLOAD_T *d, SEGMENT_REQUEST_CB_T requestCb,
+                  CLOUD_WAKE_CB_T wakeCb, const CLOUD_DEADLINES_T *deadlines, void *arg);
+bool segment_begin(SEGMENT_DOWNLOAD_T *d, const char *path, char *serverName,
+                   uint16_t serverPort, int connections);
+SEGMENT_STATUS_T segment_process(SEGMENT_DOWNLOAD_T *d);
+void segment_end(SEGMENT_DOWNLOAD_T *d);
+
+#endif /* _SEGMENT_H_ */
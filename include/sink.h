@@ -0,0 +1,53 @@
+#ifndef _SINK_H_
+#define _SINK_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include "hash.h"
+
+#define SINK_PATH_LEN      (256)
+#define SINK_BUF_LEN       (65536)
+#define SINK_PIPE_LEN      (262144)
+#define SINK_TEMP_SUFFIX   ".part"
+
+//
+// File Sink, writes a download to a temporary file that replaces the
+// target file once the download is complete
+//
+typedef struct
+{
+   bool active;                       //!< A download is being written
+   int fd;                            //!< Temporary file, -1 until created
+   char path[SINK_PATH_LEN];          //!< Target file
+   char tempPath[SINK_PATH_LEN];      //!< Temporary file next to the target
+   int64_t expected;                  //!< Expected length, -1 if unknown
+   uint64_t written;                  //!< Bytes written so far
+   bool failed;                       //!< A write failed, the download is dropped
+   size_t bufLen;                     //!< Bytes waiting in the write buffer
+   char *buf;                         //!< Write buffer, allocated by the first small write
+   int pipeFd[2];                     //!< Pipe that splices pass through, -1 until needed
+   HASH_T hash;                       //!< Hash of the bytes written in order
+   bool hashValid;                    //!< Every byte went through the hash
+}
+SINK_T;
+
+//
+// Function Prototypes
+//
+void sink_init(SINK_T *k);
+bool sink_open(SINK_T *k, const char *path, int64_t expected);
+bool sink_openAt(SINK_T *k, const char *path, bool keep);
+bool sink_reserve(SINK_T *k, uint64_t size);
+bool sink_isOpen(const SINK_T *k);
+bool sink_write(SINK_T *k, const char *data, size_t len);
+ssize_t sink_splice(SINK_T *k, int fd, size_t len);
+bool sink_pwrite(SINK_T *k, uint64_t offset, const char *data, size_t len);
+ssize_t sink_spliceAt(SINK_T *k, int fd, size_t len, uint64_t offset);
+bool sink_digest(const SINK_T *k, uint64_t *digest);
+bool sink_commit(SINK_T *k);
+void sink_close(SINK_T *k);
+void sink_abort(SINK_T *k);
+
+#endif /* _SINK_H_ */
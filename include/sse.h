@@ -0,0 +1,64 @@
+#ifndef _SSE_H_
+#define _SSE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define SSE_FIELD_LEN      (16)
+#define SSE_VALUE_LEN      (128)
+#define SSE_DEFAULT_EVENT  "message"
+
+//
+// Event Data Callback, called with the data of the event being received
+// as it arrives. Data lines are joined with "\n".
+//
+typedef void (*SSE_DATA_CB_T)(void *arg, const char *data, size_t len);
+
+//
+// Event Callback, called when an event with data is complete
+//
+typedef void (*SSE_EVENT_CB_T)(void *arg, const char *event, const char *id);
+
+//
+// Server-Sent Events Parser State
+//
+typedef enum
+{
+   SSE_FIELD,
+   SSE_VALUE_START,
+   SSE_VALUE,
+}
+SSE_STATE_T;
+
+//
+// Server-Sent Events Parser
+//
+// Fed with the payload of a text/event-stream response as it arrives.
+// The data of an event is passed on as it is found rather than collected,
+// so events may be of any length.
+//
+typedef struct
+{
+   SSE_STATE_T state;                 //!< What the next byte belongs to
+   bool crSeen;                       //!< Last line ended with CR, a LF may follow
+   char field[SSE_FIELD_LEN];         //!< Name of the field of the current line
+   size_t fieldLen;                   //!< Bytes of the field name kept
+   char value[SSE_VALUE_LEN];         //!< Value of an "event" or "id" field
+   size_t valueLen;                   //!< Bytes of the value kept
+   int dataLines;                     //!< Data lines of the event being received
+   char event[SSE_VALUE_LEN];         //!< Type of the event being received
+   char lastId[SSE_VALUE_LEN];        //!< Last event ID, kept across streams
+   SSE_DATA_CB_T dataCb;              //!< Called with the data of an event
+   SSE_EVENT_CB_T eventCb;            //!< Called when an event is complete
+   void *arg;                         //!< Argument passed back to the callbacks
+}
+SSE_PARSER_T;
+
+//
+// Function Prototypes
+//
+void sse_init(SSE_PARSER_T *p, SSE_DATA_CB_T dataCb, SSE_EVENT_CB_T eventCb, void *arg);
+void sse_reset(SSE_PARSER_T *p);
+void sse_parse(SSE_PARSER_T *p, const char *data, size_t len);
+
+#endif /* _SSE_H_ */
@@ -2,6 +2,16 @@
 #define _TASK_H_
 
 #include <stdbool.h>
+#include <stdint.h>
+#include "rhapsody.h"
+#include "cloud.h"
+#include "parse.h"
+#include "publish.h"
+#include "segment.h"
+#include "sink.h"
+#include "sse.h"
+#include "wheel.h"
+#include "ws.h"
 
 #define SERVER_NAME_DEF  "192.168.112.1"
 #ifdef WEBPOLL
@@ -16,6 +26,7 @@
 
 #define SERVER_NAME_LEN  128
 #define TARGET_FILE_LEN  64
+#define TARGET_FILE_MAX  8
 #define DEVICE_NAME_LEN  32
 #define DEVICE_ADDR_LEN  18
 
@@ -32,24 +43,108 @@ typedef enum
 }
 SEND_STATUS_T;
 
+//
+// Task Context, everything one target device needs to run its own state
+// machine, so that one process can run any number of them
+//
+typedef struct TASK
+{
+   FSM_WORKSPACE_T workspace;         //!< State machine workspace of the task
+   WHEEL_TIMER_T timer;               //!< Runs the task when it is due
+   struct TASK *runNext;              //!< Next task in the run queue
+   bool runQueued;                    //!< Task is in the run queue
+   struct TASK *waitNext;             //!< Next task waiting for a session
+   int state;                         //!< Task state
+   SEND_STATUS_T sendStatus;          //!< Send sub-state
+   bool initialized;                  //!< INIT state is done
+   bool dataSending;                  //!< A transaction is due or running
+   bool completed;                    //!< Task has nothing more to do
+   int sendErrors;                    //!< Failed transactions in a row
+   int sendLen;                       //!< Bytes of the requests to send
+   bool retryPending;                 //!< Last transaction failed, the next one waits
+   uint32_t retryStart;               //!< Time of the failure in milliseconds
+   char deviceName[DEVICE_NAME_LEN];
+   char deviceAddr[DEVICE_ADDR_LEN];
+   char serverName[SERVER_NAME_LEN];
+   int serverPort;
+   char targetFiles[TARGET_FILE_MAX][TARGET_FILE_LEN];
+   int targetCount;
+   CLOUD_SESSION_T *sendSession;      //!< Session of the running transaction
+#ifndef WEBGET
+   uint32_t sendDelay;                //!< Time between polls or pings in milliseconds
+   uint32_t timerStart;               //!< Start of the poll or ping timer in milliseconds
+   uint32_t timerDelay;               //!< Time from the timer start to the next poll in milliseconds
+   uint32_t timerCount;               //!< Polls started
+   char channelPath[TARGET_FILE_LEN]; //!< WebSocket channel path, empty to poll
+   WS_T channel;
+   bool http2;                        //!< Polls are sent as HTTP/2 streams
+   CLOUD_SESSION_T *ownSession;       //!< Dedicated session of a channel or subscription, NULL until made
+#endif
+#ifdef DOWNLOAD
+   char localDir[DEVICE_NAME_LEN];    //!< Directory of the local files, empty for the current one
+   char localFiles[TARGET_FILE_MAX][SINK_PATH_LEN]; //!< Local copy of each target file
+   SINK_T sink;                       //!< Target file being written
+   int sinkIndex;                     //!< Target of the sink, -1 if none
+   char etags[TARGET_FILE_MAX][PARSE_VALIDATOR_LEN];
+   char dates[TARGET_FILE_MAX][PARSE_VALIDATOR_LEN];
+   uint64_t hashes[TARGET_FILE_MAX];  //!< Content hash of each local file
+   bool hashed[TARGET_FILE_MAX];      //!< Content hash is known
+   uint32_t unchangedCount;           //!< Polls that found a file unchanged
+#endif
+#ifdef WEBPOLL
+   char publishName[PUBLISH_NAME_LEN];
+   PUBLISH_T publish;
+   int subscribeWait;                 //!< Longest wait of a subscription in seconds, 0 to poll
+   bool subscribeHeld;                //!< Server held the request, renew it at once
+   SSE_PARSER_T events;
+#endif
+#ifdef WEBGET
+   char uploadFile[TARGET_FILE_LEN];
+   bool uploadPost;
+   int uploadFd;
+   SEGMENT_DOWNLOAD_T segments;
+   int segmentCount;                  //!< Connections of a segmented download, 0 for none
+#endif
+}
+TASK_T;
+
 //
 // Function Prototypes
 //
-void initEntry(void);
-void initActivity(void);
-void idleEntry(void);
-void idleActivity(void);
-void sendEntry(void);
-void sendActivity(void);
-void sendExit(void);
-
-void resetSessionStatus(void);
-bool checkSessionError(void);
-
-bool get_task_completed(void);
-void set_server_name(char *name);
-void set_target_file(char *file);
-void set_device_addr(char *addr);
-void set_device_name(char *name);
+void task_init(TASK_T *t);
+void task_start(TASK_T *t);
+bool task_runDue(void);
+int  task_getRunning(void);
+
+void task_initEntry(TASK_T *t);
+void task_initActivity(TASK_T *t);
+void task_idleEntry(TASK_T *t);
+void task_idleActivity(TASK_T *t);
+void task_sendEntry(TASK_T *t);
+void task_sendActivity(TASK_T *t);
+void task_sendExit(TASK_T *t);
+void task_resetSessionStatus(TASK_T *t);
+bool task_checkSessionError(TASK_T *t);
+
+bool get_task_completed(TASK_T *t);
+void set_server_name(TASK_T *t, char *name);
+void set_target_file(TASK_T *t, char *file);
+#ifdef WEBGET
+void set_upload_file(TASK_T *t, char *file);
+void set_upload_post(TASK_T *t, bool post);
+void set_segment_count(TASK_T *t, int count);
+#endif
+#ifndef WEBGET
+void set_channel_path(TASK_T *t, char *path);
+void set_send_delay(TASK_T *t, uint32_t delayMs);
+void set_http2(TASK_T *t, bool http2);
+#endif
+#ifdef WEBPOLL
+void set_local_dir(TASK_T *t, char *dir);
+void set_publish_name(TASK_T *t, char *name);
+void set_subscribe_wait(TASK_T *t, int seconds);
+#endif
+void set_device_addr(TASK_T *t, char *addr);
+void set_device_name(TASK_T *t, char *name);
 
 #endif /* _TASK_H_ */
@@ -0,0 +1,38 @@
+#ifndef _URING_H_
+#define _URING_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/socket.h>
+
+#define URING_SQ_ENTRIES     (256)
+#define URING_CQ_ENTRIES     (4096)
+#define URING_MAX_REQUESTS   (4096)
+#define URING_BUF_COUNT      (64)
+#define URING_BUF_LEN        (4096)
+#define URING_BUF_GROUP      (0)
+#define URING_NO_REQUEST     (0)
+
+//
+// Completion callback
+//
+// res is the result of the operation, or -errno. For a multishot receive
+// data points to the received bytes, which are only valid during the call,
+// and more is false on the last completion of the request.
+//
+typedef void (*URING_CALLBACK_T)(void *arg, int fd, int res, const char *data, bool more);
+
+//
+// Function Prototypes
+//
+bool uring_init(void);
+bool uring_isActive(void);
+int  uring_connect(int fd, const struct sockaddr *addr, socklen_t addrLen, URING_CALLBACK_T cb, void *arg);
+int  uring_send(int fd, const void *buf, size_t len, int flags, URING_CALLBACK_T cb, void *arg);
+int  uring_recvMultishot(int fd, URING_CALLBACK_T cb, void *arg);
+void uring_cancel(int *req);
+void uring_close(int fd);
+void uring_submit(void);
+
+#endif /* _URING_H_ */
@@ -8,7 +8,9 @@
 // Function Prototypes
 //
 uint32_t utils_getCurrentTime(void);
+uint32_t utils_getCurrentTimeMs(void);
 void utils_sysLog(int level, const char* fmt, ... );
 bool utils_isTimerExpired(uint32_t start_time, uint32_t delta_time);
+uint32_t utils_getTimeLeftMs(uint32_t start_time, uint32_t delta_time);
 
 #endif /* _UTILS_H_ */
@@ -0,0 +1,61 @@
+#ifndef _WHEEL_H_
+#define _WHEEL_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define WHEEL_LEVELS     (4)
+#define WHEEL_SLOT_BITS  (6)
+#define WHEEL_SLOTS      (1 << WHEEL_SLOT_BITS)
+#define WHEEL_DELAY_MAX  ((1u << (WHEEL_LEVELS * WHEEL_SLOT_BITS)) - 1)
+#define WHEEL_NO_TIMER   (0xFFFFFFFF)
+
+//
+// Timer Callback, called once the timer is due
+//
+typedef void (*WHEEL_CALLBACK_T)(void *arg);
+
+//
+// Wheel Timer, kept by its owner and linked into a slot of the wheel
+// while it is pending
+//
+typedef struct WHEEL_TIMER
+{
+   struct WHEEL_TIMER *next;          //!< Next timer in the slot
+   struct WHEEL_TIMER **pprev;        //!< Link to this timer in the slot, NULL if not pending
+   uint32_t due;                      //!< Time the timer is due in milliseconds
+   uint16_t slot;                     //!< Level and slot of the wheel holding the timer
+   WHEEL_CALLBACK_T callback;         //!< Called when the timer is due
+   void *arg;                         //!< Callback argument
+}
+WHEEL_TIMER_T;
+
+//
+// Hierarchical Timing Wheel
+//
+// Level 0 has a slot for each of the next 64 milliseconds, each level
+// above a slot for 64 slots of the level below. A timer goes into the
+// lowest level whose span holds it and moves down as the wheel turns, so
+// adding and cancelling are O(1) whatever the number of timers.
+//
+typedef struct
+{
+   uint32_t now;                      //!< Time up to which the timers have been run
+   int count;                         //!< Pending timers
+   uint64_t occupied[WHEEL_LEVELS];   //!< Slots holding timers, a bit each
+   WHEEL_TIMER_T *slots[WHEEL_LEVELS][WHEEL_SLOTS];
+}
+WHEEL_T;
+
+//
+// Function Prototypes
+//
+void     wheel_init(WHEEL_T *w, uint32_t now);
+void     wheel_initTimer(WHEEL_TIMER_T *timer, WHEEL_CALLBACK_T callback, void *arg);
+void     wheel_add(WHEEL_T *w, WHEEL_TIMER_T *timer, uint32_t due);
+void     wheel_cancel(WHEEL_T *w, WHEEL_TIMER_T *timer);
+bool     wheel_isPending(const WHEEL_TIMER_T *timer);
+uint32_t wheel_nextDue(const WHEEL_T *w, uint32_t now);
+void     wheel_advance(WHEEL_T *w, uint32_t now);
+
+#endif /* _WHEEL_H_ */
@@ -0,0 +1,92 @@
+#ifndef _WS_H_
+#define _WS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "cloud.h"
+
+#define WS_KEY_LEN        (25)
+#define WS_HEADER_LEN     (14)
+#define WS_CONTROL_LEN    (125)
+#define WS_FRAME_LEN      (4096)
+
+#define WS_CLOSE_NORMAL   (1000)
+#define WS_CLOSE_PROTOCOL (1002)
+
+//
+// WebSocket Frame Opcodes
+//
+typedef enum
+{
+   WS_CONTINUATION = 0x0,
+   WS_TEXT = 0x1,
+   WS_BINARY = 0x2,
+   WS_CLOSE = 0x8,
+   WS_PING = 0x9,
+   WS_PONG = 0xA,
+}
+WS_OPCODE_T;
+
+//
+// WebSocket Channel Status
+//
+typedef enum
+{
+   WS_CONNECTING,
+   WS_OPEN,
+   WS_CLOSING,
+}
+WS_STATUS_T;
+
+//
+// WebSocket Message Callback, called with the payload of a text or binary
+// message as its frames arrive, and once more with no payload and last
+// set when the message is complete
+//
+typedef void (*WS_MESSAGE_CB_T)(void *arg, WS_OPCODE_T opcode, const char *data, size_t len, bool last);
+
+//
+// WebSocket Pong Callback, called when the server answers a ping
+//
+typedef void (*WS_PONG_CB_T)(void *arg, uint32_t rttMs);
+
+//
+// WebSocket Channel, a client connection upgraded from a cloud session
+//
+typedef struct
+{
+   CLOUD_SESSION_T *session;          //!< Upgraded session, NULL until the upgrade
+   WS_STATUS_T status;                //!< Status of the channel
+   char key[WS_KEY_LEN];              //!< Sec-WebSocket-Key of the handshake
+   uint8_t header[WS_HEADER_LEN];     //!< Header of the frame being received
+   size_t headerLen;                  //!< Bytes of the header received
+   size_t headerNeed;                 //!< Bytes of the header known to be needed
+   bool inPayload;                    //!< Next byte belongs to the payload
+   WS_OPCODE_T opcode;                //!< Opcode of the frame being received
+   bool fin;                          //!< Frame being received ends its message
+   uint64_t remaining;                //!< Payload bytes left in the frame
+   WS_OPCODE_T message;               //!< Opcode of the fragmented message being received, 0 if none
+   char control[WS_CONTROL_LEN];      //!< Payload of the control frame being received
+   size_t controlLen;                 //!< Bytes of the control payload received
+   uint32_t pingTime;                 //!< Monotonic ms time of the last ping
+   uint32_t pings;                    //!< Pings sent on this connection
+   uint32_t pongs;                    //!< Pongs received on this connection
+   WS_MESSAGE_CB_T messageCb;         //!< Called with the messages received
+   WS_PONG_CB_T pongCb;               //!< Called with the pongs received
+   void *arg;                         //!< Argument passed back to the callbacks
+}
+WS_T;
+
+//
+// Function Prototypes
+//
+void ws_init(WS_T *w, WS_MESSAGE_CB_T messageCb, WS_PONG_CB_T pongCb, void *arg);
+const char* ws_newKey(WS_T *w);
+bool ws_upgraded(CLOUD_SESSION_T *s, const char *data, size_t len, void *arg);
+bool ws_isOpen(const WS_T *w);
+bool ws_send(WS_T *w, WS_OPCODE_T opcode, const char *data, size_t len);
+bool ws_ping(WS_T *w);
+void ws_close(WS_T *w, uint16_t code);
+
+#endif /* _WS_H_ */
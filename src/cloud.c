@@ -5,40 +5,214 @@
 //!
 //******************************************************************************
 
+#define _GNU_SOURCE
 #include <errno.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stddef.h>
 #include <stdbool.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <arpa/inet.h>
+#include <linux/sockios.h>
+#include <sys/ioctl.h>
 #include <sys/socket.h>
+#include <sys/sendfile.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
 #include "cloud.h"
+#include "dns.h"
+#include "event.h"
 #include "parse.h"
+#include "uring.h"
 #include "utils.h"
 
-//
-// Local Defines
-//
-#define SEND_TIMEOUT_MS   (1000)
-#define RECV_TIMEOUT_MS   (1000)
-#define CONN_TIMEOUT_MS   (5000)
-
 //
 // Local Variables
 //
-static CLOUD_SOCKADDR_T serverIpAddr;
+static CLOUD_SESSION_T *resolvingSessions = NULL;
 
 //
 // Local Function Prototypes
 //
-static bool cloud_isSocketReady(CLOUD_SESSION_T *s);
 static void cloud_setSessionStatus(CLOUD_SESSION_T *s, CLOUD_SESSION_STATUS_T status);
+static void cloud_setSessionTimer(CLOUD_SESSION_T *s);
 static void cloud_setSocketError(CLOUD_SESSION_T *s, int errCode);
 static void cloud_startSessionAttempt(CLOUD_SESSION_T *s);
 static bool cloud_packetIsSuccessful(CLOUD_SESSION_T *s);
+static void cloud_sessionRecv(CLOUD_SESSION_T *s);
+static bool cloud_startRecv(CLOUD_SESSION_T *s);
+static void cloud_recvResult(CLOUD_SESSION_T *s, const char *data, ssize_t retVal, int errCode);
+static void cloud_updateSessionEvents(CLOUD_SESSION_T *s);
+static void cloud_sessionEvent(void *arg, uint32_t events);
+static void cloud_reopenSession(CLOUD_SESSION_T *s);
+static bool cloud_openSocket(CLOUD_SESSION_T *s);
+void cloud_sessionSend(CLOUD_SESSION_T *s);
+static void cloud_sendResult(CLOUD_SESSION_T *s, ssize_t retVal, int errCode);
+static void cloud_uringSend(CLOUD_SESSION_T *s);
+static void cloud_uringSent(void *arg, int fd, int res, const char *data, bool more);
+static void cloud_connectFailed(CLOUD_SESSION_T *s, int errCode);
+static void cloud_connectWon(CLOUD_SESSION_T *s);
+static void cloud_fallbackResult(CLOUD_SESSION_T *s, int errCode);
+static void cloud_uringConnected(void *arg, int fd, int res, const char *data, bool more);
+static void cloud_uringRecv(void *arg, int fd, int res, const char *data, bool more);
+static void cloud_upgrade(CLOUD_SESSION_T *s, const char *data, size_t len);
+static void cloud_upgradeData(CLOUD_SESSION_T *s, const char *data, size_t len);
+static void cloud_flushWrites(CLOUD_SESSION_T *s);
+static bool cloud_writesQueued(const CLOUD_SESSION_T *s);
+static bool cloud_startHttp2(CLOUD_SESSION_T *s);
+static void cloud_h2Recv(CLOUD_SESSION_T *s, const char *data, size_t len);
+static void cloud_h2Headers(void *arg, int index, const PARSE_RESPONSE_T *r);
+static void cloud_h2Data(void *arg, int index, const char *data, size_t len);
+static void cloud_h2End(void *arg, int index);
+static bool cloud_h2Write(void *arg, const char *data, size_t len);
+
+//!
+//! Add a session to the event loop.
+//!
+//! With io_uring the socket is driven by its completions instead of
+//! epoll readiness, so it is only added to the list.
+//!
+//! @return  true if the session is watched, otherwise false
+//!
+static bool cloud_watchSession(CLOUD_SESSION_T *s)
+{
+   event_initHandler(&s->handler, cloud_sessionEvent, s);
+   if (!uring_isActive() && !event_addHandler(&s->handler, s->handle, 0))
+   {
+      return false;
+   }
+   s->watched = true;
+
+   return true;
+}
+
+//!
+//! Remove a session from the event loop.
+//!
+static void cloud_unwatchSession(CLOUD_SESSION_T *s)
+{
+   if (s->watched)
+   {
+      event_removeHandler(&s->handler);
+      uring_cancel(&s->connectReq);
+      uring_cancel(&s->sendReq);
+      uring_cancel(&s->recvReq);
+      s->watched = false;
+   }
+}
+
+//!
+//! Tell the owner of a session that it has something to act on.
+//!
+static void cloud_wakeOwner(CLOUD_SESSION_T *s)
+{
+   if (NULL != s->wakeCb)
+   {
+      s->wakeCb(s->wakeArg);
+   }
+}
+
+//!
+//! Keep a session in the list of those waiting for their server name while
+//! it is in resolve pending.
+//!
+static void cloud_setResolving(CLOUD_SESSION_T *s, bool resolving)
+{
+   CLOUD_SESSION_T **pp;
+
+   for (pp = &resolvingSessions; NULL != *pp; pp = &(*pp)->next)
+   {
+      if (*pp == s)
+      {
+         if (!resolving)
+         {
+            *pp = s->next;
+            s->next = NULL;
+         }
+         return;
+      }
+   }
+   if (resolving)
+   {
+      s->next = resolvingSessions;
+      resolvingSessions = s;
+   }
+}
+
+//!
+//! Resolver callback, wakes the owners of the sessions waiting for their
+//! server name to look it up again.
+//!
+static void cloud_nameResolved(void)
+{
+   CLOUD_SESSION_T *s;
+
+   for (s = resolvingSessions; NULL != s; s = s->next)
+   {
+      cloud_wakeOwner(s);
+   }
+}
+
+//!
+//! Close a socket, batched with the other submissions when using io_uring.
+//!
+static void cloud_closeSocket(CLOUD_SOCKET handle)
+{
+   if (CLOUD_INVALID_SOCKET == handle)
+   {
+      return;
+   }
+   if (uring_isActive())
+   {
+      uring_close(handle);
+   }
+   else
+   {
+      close(handle);
+   }
+}
+
+//!
+//! Get the length of a socket address.
+//!
+static socklen_t cloud_getAddrLen(const CLOUD_SOCKADDR_T *addr)
+{
+   return (AF_INET6 == addr->sa.sa_family) ? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in);
+}
+
+//!
+//! Format the IP address of a socket address for logging.
+//!
+static const char* cloud_addrToString(const CLOUD_SOCKADDR_T *addr, char *buf, socklen_t len)
+{
+   const void *ip;
+
+   ip = (AF_INET6 == addr->sa.sa_family) ? (const void *)&addr->sin6.sin6_addr :
+                                           (const void *)&addr->sin.sin_addr;
+   if (NULL == inet_ntop(addr->sa.sa_family, ip, buf, len))
+   {
+      strcpy(buf, "?");
+   }
+
+   return buf;
+}
+
+//!
+//! Drop the connect attempt to the other address family.
+//!
+static void cloud_cancelFallback(CLOUD_SESSION_T *s)
+{
+   if (CLOUD_INVALID_SOCKET != s->fallback.handle)
+   {
+      event_removeHandler(&s->fallback.handler);
+      uring_cancel(&s->fallback.req);
+      cloud_closeSocket(s->fallback.handle);
+      s->fallback.handle = CLOUD_INVALID_SOCKET;
+   }
+   s->fallback.addr.sa.sa_family = AF_UNSPEC;
+}
 
 //!
 //! Handle a socket error.
@@ -46,102 +220,339 @@ static bool cloud_packetIsSuccessful(CLOUD_SESSION_T *s);
 static void cloud_handleSocketError(CLOUD_SESSION_T *s, int errCode)
 {
    cloud_setSocketError(s, errCode);
-   close(s->handle);
+   cloud_cancelFallback(s);
+   cloud_unwatchSession(s);
+   cloud_closeSocket(s->handle);
    s->handle = CLOUD_INVALID_SOCKET;
 }
 
 //!
 //! Cloud connect.
 //!
+//! The socket is non-blocking, so this normally leaves the session in
+//! connect pending until the event loop reports the outcome.
+//!
 static void cloud_startConnect(CLOUD_SESSION_T *s)
 {
    ssize_t retVal;
 
-   retVal = connect(s->handle, (struct sockaddr *)&serverIpAddr, sizeof(CLOUD_SOCKADDR_T));
-   if (retVal <= 0)
+   /* An unconnected socket reports hang up, so only watch it from here on */
+   if (!cloud_watchSession(s))
    {
-      if ((EINPROGRESS == errno) || (EWOULDBLOCK == errno))
-      {
-         cloud_setSessionStatus(s, CLOUD_SESSION_CONNECT_PENDING);
-      }
-      else if (retVal == 0)
-      {
-         cloud_setSessionStatus(s, CLOUD_SESSION_CONNECT_SUCCESS);
-      }
-      else
+      cloud_handleSocketError(s, errno);
+      return;
+   }
+   if (uring_isActive())
+   {
+      s->connectReq = uring_connect(s->handle, &s->serverAddr.sa, cloud_getAddrLen(&s->serverAddr),
+                                    cloud_uringConnected, s);
+      if (URING_NO_REQUEST == s->connectReq)
       {
-         utils_sysLog(LOG_ERR, "%s>> connect errno: %s\n", s->name, strerror(errno));
-         cloud_handleSocketError(s, errno);
+         cloud_handleSocketError(s, ENOBUFS);
+         return;
       }
+      cloud_setSessionStatus(s, CLOUD_SESSION_CONNECT_PENDING);
+      return;
+   }
+   retVal = connect(s->handle, &s->serverAddr.sa, cloud_getAddrLen(&s->serverAddr));
+   if (retVal == 0)
+   {
+      cloud_connectWon(s);
+   }
+   else if ((EINPROGRESS == errno) || (EWOULDBLOCK == errno))
+   {
+      cloud_setSessionStatus(s, CLOUD_SESSION_CONNECT_PENDING);
+   }
+   else
+   {
+      cloud_connectFailed(s, errno);
    }
 }
 
 //!
-//! Determine if the socket is ready.
+//! Get and clear the pending error of the socket.
 //!
-static bool cloud_isSocketReady(CLOUD_SESSION_T *s)
+//! @return  0 if the socket is ready, otherwise the error code
+//!
+static int cloud_getSocketError(CLOUD_SOCKET handle)
 {
-   ssize_t retVal;
    socklen_t optLen;
    int optVal;
 
-   optVal = -1;
+   optVal = 0;
    optLen = sizeof (optVal);
-   retVal = getsockopt(s->handle, SOL_SOCKET, SO_ERROR, &optVal, &optLen);
-   return ((retVal == 0) && (optVal == 0));
+   if (getsockopt(handle, SOL_SOCKET, SO_ERROR, &optVal, &optLen) < 0)
+   {
+      optVal = errno;
+   }
+   return optVal;
 }
 
 //!
 //! Cloud finish the session connect.
 //!
+//! Called once the event loop reports the socket writable, which is when
+//! a pending connect has either completed or failed.
+//!
 static void cloud_finishConnect(CLOUD_SESSION_T *s)
 {
-   ssize_t retVal;
-   fd_set writefds;
-   struct timeval tv;
+   int errCode = cloud_getSocketError(s->handle);
+
+   if (0 == errCode)
+   {
+      cloud_connectWon(s);
+   }
+   else if (EINPROGRESS == errCode)
+   {
+      cloud_setSessionStatus(s, CLOUD_SESSION_CONNECT_PENDING);
+   }
+   else
+   {
+      cloud_connectFailed(s, errCode);
+   }
+}
+
+//!
+//! Complete the connect race with the session socket connected.
+//!
+//! The address family that connected is remembered for the host, so the
+//! next connection to it tries that family first.
+//!
+static void cloud_connectWon(CLOUD_SESSION_T *s)
+{
+   cloud_cancelFallback(s);
+   if (NULL != s->serverName)
+   {
+      dns_setPreferredFamily(s->serverName, s->serverAddr.sa.sa_family);
+   }
+   cloud_setSessionStatus(s, CLOUD_SESSION_CONNECT_SUCCESS);
+   if (uring_isActive())
+   {
+      /* Armed for the life of the connection, an idle close shows up here too */
+      s->recvReq = uring_recvMultishot(s->handle, cloud_uringRecv, s);
+   }
+}
+
+//!
+//! Handle a failed connect of the session socket.
+//!
+//! If the server has an address of the other family, the connect carries
+//! on with it right away, taking over the attempt that is already racing
+//! or starting one, instead of failing the session.
+//!
+static void cloud_connectFailed(CLOUD_SESSION_T *s, int errCode)
+{
+   char addrStr[INET6_ADDRSTRLEN];
 
-   FD_ZERO(&writefds);
-   FD_SET(s->handle, &writefds);
-   tv.tv_sec = CONN_TIMEOUT_MS / 1000;
-   tv.tv_usec = 0;
-   retVal = select(s->handle+1, NULL, &writefds, NULL, &tv);
-   if (retVal >= 0)
+   utils_sysLog(LOG_ERR, "%s>> connect to %s errno: %s\n", s->name,
+                cloud_addrToString(&s->serverAddr, addrStr, sizeof(addrStr)), strerror(errCode));
+   if (AF_UNSPEC == s->fallback.addr.sa.sa_family)
+   {
+      cloud_handleSocketError(s, errCode);
+      return;
+   }
+   cloud_unwatchSession(s);
+   cloud_closeSocket(s->handle);
+   s->handle = CLOUD_INVALID_SOCKET;
+   s->serverAddr = s->fallback.addr;
+   s->fallback.addr.sa.sa_family = AF_UNSPEC;
+   if (CLOUD_INVALID_SOCKET != s->fallback.handle)
    {
-      if (FD_ISSET(s->handle, &writefds))
+      event_removeHandler(&s->fallback.handler);
+      s->handle = s->fallback.handle;
+      s->connectReq = s->fallback.req;
+      s->fallback.handle = CLOUD_INVALID_SOCKET;
+      s->fallback.req = URING_NO_REQUEST;
+      if (!cloud_watchSession(s))
       {
-         if (cloud_isSocketReady(s))
-         {
-            cloud_setSessionStatus(s, CLOUD_SESSION_CONNECT_SUCCESS);
-         }
-         else
-         {
-            cloud_setSessionStatus(s, CLOUD_SESSION_CONNECT_PENDING);
-         }
+         cloud_handleSocketError(s, errno);
+         return;
+      }
+      cloud_updateSessionEvents(s);
+   }
+   else if (cloud_openSocket(s))
+   {
+      cloud_startConnect(s);
+   }
+}
+
+//!
+//! Handle the outcome of the connect attempt to the other address family.
+//!
+//! When it connects first it replaces the session socket.
+//!
+static void cloud_fallbackResult(CLOUD_SESSION_T *s, int errCode)
+{
+   char addrStr[INET6_ADDRSTRLEN];
+
+   if (EINPROGRESS == errCode)
+   {
+      return;
+   }
+   if (0 != errCode)
+   {
+      utils_sysLog(LOG_ERR, "%s>> connect to %s errno: %s\n", s->name,
+                   cloud_addrToString(&s->fallback.addr, addrStr, sizeof(addrStr)), strerror(errCode));
+      cloud_cancelFallback(s);
+      return;
+   }
+   utils_sysLog(LOG_DEBUG, "%s>> connected to %s first\n", s->name,
+                cloud_addrToString(&s->fallback.addr, addrStr, sizeof(addrStr)));
+   cloud_unwatchSession(s);
+   cloud_closeSocket(s->handle);
+   event_removeHandler(&s->fallback.handler);
+   s->fallback.req = URING_NO_REQUEST;
+   s->handle = s->fallback.handle;
+   s->serverAddr = s->fallback.addr;
+   s->fallback.handle = CLOUD_INVALID_SOCKET;
+   s->fallback.addr.sa.sa_family = AF_UNSPEC;
+   if (!cloud_watchSession(s))
+   {
+      cloud_handleSocketError(s, errno);
+      return;
+   }
+   cloud_connectWon(s);
+   /* The socket is writable, no need to wait for another event */
+   cloud_sessionSend(s);
+   cloud_updateSessionEvents(s);
+}
+
+//!
+//! Event loop callback of the connect attempt to the other address family.
+//!
+static void cloud_fallbackEvent(void *arg, uint32_t events)
+{
+   CLOUD_SESSION_T *s = (CLOUD_SESSION_T *)arg;
+
+   cloud_fallbackResult(s, cloud_getSocketError(s->fallback.handle));
+}
+
+//!
+//! io_uring completion of a connect, of the session socket or of the
+//! attempt to the other address family.
+//!
+static void cloud_uringConnected(void *arg, int fd, int res, const char *data, bool more)
+{
+   CLOUD_SESSION_T *s = (CLOUD_SESSION_T *)arg;
+
+   if (fd == s->handle)
+   {
+      s->connectReq = URING_NO_REQUEST;
+      if (CLOUD_SESSION_CONNECT_PENDING != s->status)
+      {
+         return;
+      }
+      if (0 == res)
+      {
+         cloud_connectWon(s);
+         cloud_sessionSend(s);
       }
       else
       {
-         utils_sysLog(LOG_ERR, "%s>> connect FD_ISSET errno: %s\n", s->name, strerror(errno));
-         cloud_handleSocketError(s, errno);
+         cloud_connectFailed(s, -res);
       }
    }
-   else
+   else if (fd == s->fallback.handle)
    {
-      utils_sysLog(LOG_ERR, "%s>> connect select errno: %s\n", s->name, strerror(errno));
-      cloud_handleSocketError(s, errno);
+      s->fallback.req = URING_NO_REQUEST;
+      cloud_fallbackResult(s, -res);
+   }
+}
+
+//!
+//! Get the time until the connect attempt to the other address family is
+//! due, CLOUD_ATTEMPT_DELAY_MS after the session socket started connecting
+//! or half of the connect deadline if that is shorter.
+//!
+//! @return  Milliseconds left, 0 if due, or CLOUD_NO_DEADLINE if there is
+//!          no attempt to start
+//!
+static uint32_t cloud_getFallbackDelay(CLOUD_SESSION_T *s, uint32_t now)
+{
+   uint32_t elapsed;
+   uint32_t delay = CLOUD_ATTEMPT_DELAY_MS;
+
+   if ((CLOUD_SESSION_CONNECT_PENDING != s->status) ||
+       (AF_UNSPEC == s->fallback.addr.sa.sa_family) ||
+       (CLOUD_INVALID_SOCKET != s->fallback.handle))
+   {
+      return CLOUD_NO_DEADLINE;
+   }
+   if ((s->deadlines.connectMs > 0) && ((s->deadlines.connectMs / 2) < delay))
+   {
+      delay = s->deadlines.connectMs / 2;
+   }
+   elapsed = now - s->phaseStart;
+
+   return (elapsed < delay) ? (delay - elapsed) : 0;
+}
+
+//!
+//! Start the connect attempt to the other address family once the session
+//! socket has been connecting for CLOUD_ATTEMPT_DELAY_MS, or half of the
+//! connect deadline if that is shorter. The connect deadline restarts with
+//! the attempt, while the session socket keeps racing it.
+//!
+//! @param[in] *s pointer to a Cloud session structure object.
+//! @param[in] now  Current time in milliseconds
+//!
+//! @return  Milliseconds until the attempt is due, or CLOUD_NO_DEADLINE
+//!
+static uint32_t cloud_checkFallback(CLOUD_SESSION_T *s, uint32_t now)
+{
+   char addrStr[INET6_ADDRSTRLEN];
+   uint32_t left = cloud_getFallbackDelay(s, now);
+   int retVal;
+
+   if (0 != left)
+   {
+      return left;
+   }
+   utils_sysLog(LOG_DEBUG, "%s>> no connection after %u ms, also trying %s\n", s->name, now - s->phaseStart,
+                cloud_addrToString(&s->fallback.addr, addrStr, sizeof(addrStr)));
+   s->fallback.handle = socket(s->fallback.addr.sa.sa_family,
+                               SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_TCP);
+   if (CLOUD_INVALID_SOCKET == s->fallback.handle)
+   {
+      utils_sysLog(LOG_ERR, "%s>> fallback socket errno: %s\n", s->name, strerror(errno));
+      cloud_cancelFallback(s);
+      return CLOUD_NO_DEADLINE;
+   }
+   event_initHandler(&s->fallback.handler, cloud_fallbackEvent, s);
+   if (uring_isActive())
+   {
+      s->fallback.req = uring_connect(s->fallback.handle, &s->fallback.addr.sa,
+                                      cloud_getAddrLen(&s->fallback.addr), cloud_uringConnected, s);
+      if (URING_NO_REQUEST != s->fallback.req)
+      {
+         s->phaseStart = now;
+         return CLOUD_NO_DEADLINE;
+      }
+      cloud_cancelFallback(s);
+      return CLOUD_NO_DEADLINE;
+   }
+   retVal = connect(s->fallback.handle, &s->fallback.addr.sa, cloud_getAddrLen(&s->fallback.addr));
+   if (((0 == retVal) || (EINPROGRESS == errno)) &&
+       event_addHandler(&s->fallback.handler, s->fallback.handle, EPOLLOUT))
+   {
+      s->phaseStart = now;
+      return CLOUD_NO_DEADLINE;
    }
+   utils_sysLog(LOG_ERR, "%s>> connect to %s errno: %s\n", s->name, addrStr, strerror(errno));
+   cloud_cancelFallback(s);
+
+   return CLOUD_NO_DEADLINE;
 }
 
 //!
 //! Wrapper function to perform a connect on a Cloud socket for non-blocking
-//! operations. After connect() is called, a short blocking call to select() is
-//! done to wait for the socket to be ready for write operations.
+//! operations. After connect() is called, the session waits in connect
+//! pending until the event loop reports the socket ready for write operations.
 //!
 //! @param[in] s socket handle number
 //!
 void cloud_sessionConnect(CLOUD_SESSION_T *s)
 {
-   ssize_t retVal;
-
    if ((CLOUD_SESSION_IDLE != s->status) &&
        (CLOUD_SESSION_CREATE_SUCCESS != s->status) &&
        (CLOUD_SESSION_CONNECT_PENDING != s->status))
@@ -157,8 +568,7 @@ void cloud_sessionConnect(CLOUD_SESSION_T *s)
    {
       cloud_startConnect(s);
    }
-   if ((CLOUD_SESSION_CONNECT_PENDING == s->status) ||
-       (CLOUD_SESSION_CONNECT_SUCCESS == s->status))
+   else
    {
       cloud_finishConnect(s);
    }
@@ -166,8 +576,8 @@ void cloud_sessionConnect(CLOUD_SESSION_T *s)
 
 //!
 //! Wrapper function to send data on a socket for non-blocking socket operations.
-//! Check whether the socket is ready to send data using a select() call then
-//! send the data through the socket.
+//! The first attempt is made right away, the remainder is sent as the event
+//! loop reports the socket ready for write operations.
 //!
 //! This function returns CALS_FAIL if the socket is not ready for send or if an
 //! error occurs during the send operation.  If no error occured, the number of
@@ -177,15 +587,19 @@ void cloud_sessionConnect(CLOUD_SESSION_T *s)
 //!        socket! The caller is responsible to make successive calls to this
 //!        function to send the remaining data out.
 //!
+//! When a file is attached with sendFileFd and sendFileLen, it is sent
+//! after the send buffer with sendfile(), and totalBytesSent counts the
+//! bytes of both.
+//!
 //! @param[in] *s pointer to a Cloud session structure object.
 //!
 void cloud_sessionSend(CLOUD_SESSION_T *s)
 {
    ssize_t retVal;
-   struct  timeval tv;
-   fd_set  writefds;
    size_t  start_index;
    int32_t remain_bytes_to_send;
+   int32_t buf_bytes_to_send;
+   off_t offset;
 
    if ((CLOUD_SESSION_IDLE != s->status) &&
        (CLOUD_SESSION_FAILED != s->status) &&
@@ -202,107 +616,383 @@ void cloud_sessionSend(CLOUD_SESSION_T *s)
    {
       cloud_setSessionStatus(s, CLOUD_SESSION_SEND_PENDING);
       s->totalBytesSent = 0;
+      s->sendTime = utils_getCurrentTimeMs();
+      s->sendQueued = 0;
    }
-   FD_ZERO(&writefds);
-   FD_SET(s->handle, &writefds);
-   tv.tv_sec = SEND_TIMEOUT_MS / 1000;
-   tv.tv_usec = 0;
-   retVal = select(s->handle+1, NULL, &writefds, NULL, &tv);
-   if (retVal >= 0)
+   start_index = s->totalBytesSent;
+   remain_bytes_to_send = s->totalBytesToSend - s->totalBytesSent;
+   buf_bytes_to_send = s->totalBytesToSend - s->sendFileLen - s->totalBytesSent;
+   if (remain_bytes_to_send < 0)
    {
-      if (FD_ISSET(s->handle, &writefds))
-      {
-         start_index = s->totalBytesSent;
-         remain_bytes_to_send = s->totalBytesToSend - s->totalBytesSent;
-         if (remain_bytes_to_send < 0)
-         {
-            return;
-         }
-         retVal = send(s->handle, &(s->sendBuf[start_index]), remain_bytes_to_send, 0);
-         if (CLOUD_SOCKET_ERROR == retVal)
-         {
-            if ((EINPROGRESS != errno) && (EWOULDBLOCK != errno))
-            {
-               utils_sysLog(LOG_ERR, "%s>> send failed errno: %s\n", s->name, strerror(errno));
-               cloud_handleSocketError(s, errno);
-            }
-         }
-         else
-         {
-            s->totalBytesSent += retVal;
-            if (s->totalBytesSent == s->totalBytesToSend)
-            {
-               cloud_setSessionStatus(s, CLOUD_SESSION_SEND_SUCCESS);
-               s->totalBytesSent = 0;
-            }
-         }
-      }
-      else
+      return;
+   }
+   if (uring_isActive())
+   {
+      /* The completion sends the remainder, if any */
+      if (URING_NO_REQUEST == s->sendReq)
       {
-         utils_sysLog(LOG_ERR, "%s>> send FD_ISSET errno: %s\n", s->name, strerror(errno));
+         cloud_uringSend(s);
       }
+      return;
+   }
+   if (buf_bytes_to_send > 0)
+   {
+      /* MSG_MORE holds the header back so the start of the file can share its segment */
+      retVal = send(s->handle, &(s->sendBuf[start_index]), buf_bytes_to_send,
+                    MSG_NOSIGNAL | ((s->sendFileLen > 0) ? MSG_MORE : 0));
    }
    else
    {
-      utils_sysLog(LOG_ERR, "%s>> send select errno: %s\n", s->name, strerror(errno));
+      /* The file goes from the page cache to the socket without a copy */
+      offset = -buf_bytes_to_send;
+      retVal = sendfile(s->handle, s->sendFileFd, &offset, remain_bytes_to_send);
+      if (0 == retVal)
+      {
+         /* The file is shorter than announced */
+         retVal = CLOUD_SOCKET_ERROR;
+         errno = EIO;
+      }
    }
+   cloud_sendResult(s, retVal, errno);
 }
 
 //!
-//! Parse the receive buffer and do one of the following:
+//! Queue the next io_uring send of a session.
 //!
-//! A) If header contains content-length:
-//!    Compare the size of the body to the number of bytes specified by
-//!    content-length.
-//!    If the size matches, true is returned.  Otherwise false is returned.
-//! B) If header contains transfer-encoding: chunked.
-//!    Parse the body of the message and search for a chunk of size 0,
-//!    indicating the end of the packet. If a chunk size of 0 is found,
-//!    true is returned. Otherwise, false is returned.
-//! C) Buffer does not contain a full header yet (cannot find \r\n\r\n
-//!    termination)
-//!    Return false.
-//! D) Buffer contains none of these in the header:
-//!    Set the session as failed, we can not accept it..
+//! The send buffer is sent first, then the file in pieces read into the
+//! receive buffer, which is free while sending since io_uring receives
+//! land in the provided buffers.
 //!
 //! @param[in] *s pointer to a Cloud session structure object.
 //!
-static bool cloud_recvComplete(CLOUD_SESSION_T *s)
+static void cloud_uringSend(CLOUD_SESSION_T *s)
 {
-   bool complete = false;
+   int32_t buf_bytes_to_send = s->totalBytesToSend - s->sendFileLen - s->totalBytesSent;
+   const char *data = &(s->sendBuf[s->totalBytesSent]);
+   ssize_t len = buf_bytes_to_send;
 
-   if (parse_fullHeaderFound(s->recvBuf))
+   if (buf_bytes_to_send <= 0)
    {
-      s->httpStatus = parse_getStatusCode(s->recvBuf);
-      s->diags->lastHttpStatus = s->httpStatus;
-      if (parse_transferEncodingChunkedFound(s->recvBuf))
-      {
-         complete = parse_fullDataChunkFound(s->recvBuf);
-      }
-      else if (parse_contentLengthFound(s->recvBuf))
+      len = s->totalBytesToSend - s->totalBytesSent;
+      if ((size_t)len > s->recvBufLen)
       {
-         complete = parse_entireContentReceived(s->recvBuf, s->totalBytesRcvd);
+         len = s->recvBufLen;
       }
-      else
+      len = pread(s->sendFileFd, s->recvBuf, len, -buf_bytes_to_send);
+      if (len <= 0)
       {
-         complete = true;
+         utils_sysLog(LOG_ERR, "%s>> read of request body failed\n", s->name);
+         cloud_handleSocketError(s, (len < 0) ? errno : EIO);
+         return;
       }
+      data = s->recvBuf;
+   }
+   s->sendReq = uring_send(s->handle, data, len, MSG_NOSIGNAL, cloud_uringSent, s);
+   if (URING_NO_REQUEST == s->sendReq)
+   {
+      cloud_handleSocketError(s, ENOBUFS);
    }
-
-   return complete;
 }
 
 //!
-//! Wrapper function to receive data on a socket for non-blocking socket
-//! operations.
+//! Account for the outcome of a send.
 //!
-//! Check whether the socket has any pending data to read using a select()
-//! call with a short timeout. If the socket is ready, read the data from
-//! the socket.
+//! @param[in] *s pointer to a Cloud session structure object.
+//! @param[in] retVal  Bytes sent, or CLOUD_SOCKET_ERROR
+//! @param[in] errCode  Error code when retVal is CLOUD_SOCKET_ERROR
 //!
-//! This function returns CALS_FAIL if he socket is not ready for receive
-//! operations or if an error occured during the receive call. Otherwise,
-//! the number of bytes received is returned.
+static void cloud_sendResult(CLOUD_SESSION_T *s, ssize_t retVal, int errCode)
+{
+   if (CLOUD_SOCKET_ERROR == retVal)
+   {
+      if (s->reused && ((EPIPE == errCode) || (ECONNRESET == errCode)))
+      {
+         cloud_reopenSession(s);
+      }
+      else if ((EINPROGRESS != errCode) && (EWOULDBLOCK != errCode))
+      {
+         utils_sysLog(LOG_ERR, "%s>> send failed errno: %s\n", s->name, strerror(errCode));
+         cloud_handleSocketError(s, errCode);
+      }
+   }
+   else
+   {
+      s->totalBytesSent += retVal;
+      s->sendTime = utils_getCurrentTimeMs();
+      if (s->totalBytesSent == s->totalBytesToSend)
+      {
+         cloud_setSessionStatus(s, CLOUD_SESSION_SEND_SUCCESS);
+         s->totalBytesSent = 0;
+      }
+   }
+}
+
+//!
+//! Account for a complete response.
+//!
+//! The response is passed to the response callback and the parser is made
+//! ready for the next pipelined response. The first failed HTTP status of
+//! the pipeline is kept as the status of the transaction. Interim 1XX
+//! responses are dropped.
+//!
+//! @param[in] *s pointer to a Cloud session structure object.
+//! @param[in] index  Request the response answers, the next one of the
+//!                   pipeline unless HTTP/2 streams complete out of order
+//!
+//! @return  true if this was the last response, otherwise false
+//!
+static bool cloud_responseReceived(CLOUD_SESSION_T *s, int index)
+{
+   PARSE_RESPONSE_T *r = &s->response;
+   bool complete = false;
+   int requests;
+
+   requests = (s->requestCount > 0) ? s->requestCount : 1;
+   if (r->statusCode >= HTTP_SUCCESS)
+   {
+      s->diags->lastHttpStatus = r->statusCode;
+      s->keepAlive = r->keepAlive;
+      if ((0 == s->responsesRcvd) || parse_goodStatusCode(s->httpStatus))
+      {
+         s->httpStatus = r->statusCode;
+      }
+      if (NULL != s->responseCb)
+      {
+         s->responseCb(s, index, r->statusCode, s->responseArg);
+      }
+      s->responsesRcvd++;
+      complete = (s->responsesRcvd >= requests);
+   }
+   if (!complete)
+   {
+      parse_initResponse(r);
+   }
+
+   return complete;
+}
+
+//!
+//! Pass the payload bytes found by the response parser to the body callback.
+//!
+static void cloud_responseBody(void *arg, const char *data, size_t len)
+{
+   CLOUD_SESSION_T *s = (CLOUD_SESSION_T *)arg;
+
+   if ((NULL != s->bodyCb) && (s->response.statusCode >= HTTP_SUCCESS))
+   {
+      s->bodyCb(s, s->responsesRcvd, data, len, s->responseArg);
+   }
+}
+
+//!
+//! Parse newly received bytes.
+//!
+//! The response parser keeps its place between receives, so the bytes are
+//! looked at once and need not be kept after this call. It finds the end
+//! of a response from its content-length, from the terminating chunk of a
+//! chunked body, or from the header alone for responses without a body.
+//! The payload is passed to the body callback as it is found, with the
+//! chunk framing of a chunked body removed. Bytes after the last pipelined
+//! response are dropped.
+//!
+//! @param[in] *s pointer to a Cloud session structure object.
+//! @param[in] data  Received bytes, NULL if there are none
+//! @param[in] len  Number of received bytes
+//!
+//! @return  true once the last pipelined response is received, otherwise false
+//!
+static bool cloud_recvComplete(CLOUD_SESSION_T *s, const char *data, size_t len)
+{
+   PARSE_RESPONSE_T *r = &s->response;
+   bool complete = false;
+   size_t used;
+
+   while (!complete)
+   {
+      used = parse_response(r, data, len, cloud_responseBody, s);
+      data += used;
+      len -= used;
+      if (parse_responseFailed(r))
+      {
+         utils_sysLog(LOG_ERR, "%s>> malformed response\n", s->name);
+         cloud_handleSocketError(s, EPROTO);
+         break;
+      }
+      if (!parse_responseDone(r))
+      {
+         break;
+      }
+      if ((HTTP_SWITCHING_PROTOCOLS == r->statusCode) && (NULL != s->upgradeCb))
+      {
+         cloud_upgrade(s, data, len);
+         break;
+      }
+      complete = cloud_responseReceived(s, s->responsesRcvd);
+   }
+
+   return complete;
+}
+
+//!
+//! Hand the connection over to the upgrade callback once the server has
+//! switched protocols. The response ends the HTTP transaction, the session
+//! keeps receiving for the new protocol until the connection is closed.
+//!
+//! @param[in] *s pointer to a Cloud session structure object.
+//! @param[in] data  Bytes received after the response
+//! @param[in] len  Number of bytes received after the response
+//!
+static void cloud_upgrade(CLOUD_SESSION_T *s, const char *data, size_t len)
+{
+   s->diags->lastHttpStatus = HTTP_SWITCHING_PROTOCOLS;
+   s->httpStatus = HTTP_SWITCHING_PROTOCOLS;
+   s->keepAlive = false;
+   s->upgraded = true;
+   s->responsesRcvd++;
+   /* The send buffer is free to queue the writes of the new protocol */
+   s->totalBytesToSend = 0;
+   s->totalBytesSent = 0;
+   if (!s->upgradeCb(s, NULL, 0, s->responseArg))
+   {
+      cloud_handleSocketError(s, EPROTO);
+   }
+   else if (len > 0)
+   {
+      cloud_upgradeData(s, data, len);
+   }
+}
+
+//!
+//! Pass bytes received on an upgraded connection to the upgrade callback.
+//!
+//! @param[in] *s pointer to a Cloud session structure object.
+//! @param[in] data  Received bytes
+//! @param[in] len  Number of received bytes
+//!
+static void cloud_upgradeData(CLOUD_SESSION_T *s, const char *data, size_t len)
+{
+   if (!s->upgradeCb(s, data, len, s->responseArg))
+   {
+      utils_sysLog(LOG_ERR, "%s>> protocol error on upgraded connection\n", s->name);
+      cloud_handleSocketError(s, EPROTO);
+   }
+}
+
+//!
+//! Get the HTTP/2 frames of the requests in the send buffer ready. A new
+//! connection gets a new HTTP/2 state, a kept alive one carries on with
+//! its header tables and stream identifiers.
+//!
+//! @param[in] *s pointer to a Cloud session structure object.
+//!
+//! @return  true if the frames are in the send buffer, otherwise false
+//!
+static bool cloud_startHttp2(CLOUD_SESSION_T *s)
+{
+   int len;
+
+   if (NULL == s->h2)
+   {
+      s->h2 = calloc(1, sizeof(H2_T));
+      if (NULL == s->h2)
+      {
+         utils_sysLog(LOG_ERR, "%s>> no memory for HTTP/2\n", s->name);
+         return false;
+      }
+   }
+   if (!s->reused)
+   {
+      h2_init(s->h2, s->name, cloud_h2Headers, cloud_h2Data, cloud_h2End, cloud_h2Write, s);
+   }
+   len = h2_request(s->h2, s->sendBuf, s->totalBytesToSend, CLOUD_SEND_BUF_LEN);
+   if (len < 0)
+   {
+      return false;
+   }
+   s->totalBytesToSend = len;
+
+   return true;
+}
+
+//!
+//! Pass bytes received on an HTTP/2 connection to its frame parser.
+//!
+//! @param[in] *s pointer to a Cloud session structure object.
+//! @param[in] data  Received bytes
+//! @param[in] len  Number of received bytes
+//!
+static void cloud_h2Recv(CLOUD_SESSION_T *s, const char *data, size_t len)
+{
+   if (!h2_recv(s->h2, data, len))
+   {
+      cloud_handleSocketError(s, EPROTO);
+   }
+}
+
+//!
+//! Take the header of the HTTP/2 response being passed on, as if it had
+//! been parsed from the connection.
+//!
+static void cloud_h2Headers(void *arg, int index, const PARSE_RESPONSE_T *r)
+{
+   CLOUD_SESSION_T *s = (CLOUD_SESSION_T *)arg;
+
+   s->response = *r;
+}
+
+//!
+//! Pass the payload of an HTTP/2 response to the body callback.
+//!
+static void cloud_h2Data(void *arg, int index, const char *data, size_t len)
+{
+   CLOUD_SESSION_T *s = (CLOUD_SESSION_T *)arg;
+
+   if (NULL != s->bodyCb)
+   {
+      s->bodyCb(s, index, data, len, s->responseArg);
+   }
+}
+
+//!
+//! Account for a complete HTTP/2 response.
+//!
+static void cloud_h2End(void *arg, int index)
+{
+   CLOUD_SESSION_T *s = (CLOUD_SESSION_T *)arg;
+
+   s->response.keepAlive = !s->h2->goaway;
+   if (cloud_responseReceived(s, index))
+   {
+      s->recvComplete = true;
+      cloud_wakeOwner(s);
+   }
+}
+
+//!
+//! Queue the frames written by the HTTP/2 connection.
+//!
+static bool cloud_h2Write(void *arg, const char *data, size_t len)
+{
+   return cloud_sessionWrite((CLOUD_SESSION_T *)arg, data, len);
+}
+
+//!
+//! Determine if the send buffer queues writes while the session receives.
+//!
+static bool cloud_writesQueued(const CLOUD_SESSION_T *s)
+{
+   return ((s->upgraded || s->http2) && (CLOUD_SESSION_RECV_PENDING == s->status));
+}
+
+//!
+//! Wrapper function to receive data on a socket for non-blocking socket
+//! operations.
+//!
+//! Called by the event loop when the socket has pending data to read.
+//!
+//! This function returns CALS_FAIL if he socket is not ready for receive
+//! operations or if an error occured during the receive call. Otherwise,
+//! the number of bytes received is returned.
 //!
 //! Note1: A 0 return indicates that the socket has been closed remotely.
 //! Note2: It is possible that receive returns a number of bytes that does
@@ -314,10 +1004,42 @@ static bool cloud_recvComplete(CLOUD_SESSION_T *s)
 //!
 static void cloud_sessionRecv(CLOUD_SESSION_T *s)
 {
-   ssize_t retVal;
-   struct timeval tv;
-   fd_set readfds;
+   PARSE_RESPONSE_T *r = &s->response;
+   ssize_t retVal = CLOUD_SOCKET_ERROR;
+   int errCode = EOPNOTSUPP;
 
+   if (!cloud_startRecv(s))
+   {
+      return;
+   }
+   if ((NULL != s->spliceCb) && !s->http2 && (r->statusCode >= HTTP_SUCCESS) &&
+       (parse_bodyRemaining(r) > 0))
+   {
+      /* Payload bytes without framing can skip the receive buffer */
+      retVal = s->spliceCb(s, s->responsesRcvd, s->handle, (size_t)parse_bodyRemaining(r),
+                           s->responseArg);
+      errCode = errno;
+   }
+   if ((CLOUD_SOCKET_ERROR == retVal) && (EOPNOTSUPP == errCode))
+   {
+      retVal = recv(s->handle, s->recvBuf, s->recvBufLen, 0);
+      cloud_recvResult(s, s->recvBuf, retVal, errno);
+   }
+   else
+   {
+      cloud_recvResult(s, NULL, retVal, errCode);
+   }
+}
+
+//!
+//! Get the session ready to receive.
+//!
+//! @param[in] *s pointer to a Cloud session structure object.
+//!
+//! @return  true if the session can receive, otherwise false
+//!
+static bool cloud_startRecv(CLOUD_SESSION_T *s)
+{
    if ((CLOUD_SESSION_IDLE != s->status) &&
        (CLOUD_SESSION_FAILED != s->status) &&
        (CLOUD_SESSION_SEND_SUCCESS != s->status) &&
@@ -327,59 +1049,336 @@ static void cloud_sessionRecv(CLOUD_SESSION_T *s)
        * Do not perform a recv operation if the socket is not IDLE, FAILED,
        * send success or recv in progress.
        */
-      return;
+      return false;
    }
    if (CLOUD_SESSION_RECV_PENDING != s->status)
    {
+      /* The idle deadline set with the status runs from here */
+      s->recvTime = utils_getCurrentTimeMs();
       cloud_setSessionStatus(s, CLOUD_SESSION_RECV_PENDING);
       s->totalBytesRcvd = 0;
-      memset(s->recvBuf, 0, s->recvBufLen);
+      parse_initResponse(&s->response);
+      if (s->http2)
+      {
+         /* The send buffer is free to queue the frames written while receiving */
+         s->totalBytesToSend = 0;
+         s->totalBytesSent = 0;
+      }
+   }
+
+   return true;
+}
+
+//!
+//! Account for the outcome of a receive.
+//!
+//! @param[in] *s pointer to a Cloud session structure object.
+//! @param[in] data  Received bytes, NULL if they were spliced to the consumer
+//! @param[in] retVal  Bytes received, 0 if closed, or CLOUD_SOCKET_ERROR
+//! @param[in] errCode  Error code when retVal is CLOUD_SOCKET_ERROR
+//!
+static void cloud_recvResult(CLOUD_SESSION_T *s, const char *data, ssize_t retVal, int errCode)
+{
+   if (CLOUD_SOCKET_ERROR == retVal)
+   {
+      if ((EINPROGRESS != errCode) && (EWOULDBLOCK != errCode))
+      {
+         utils_sysLog(LOG_ERR, "%s>> receive errno: %s\n", s->name, strerror(errCode));
+         cloud_handleSocketError(s, errCode);
+      }
    }
-   FD_ZERO(&readfds);
-   FD_SET(s->handle, &readfds);
-   tv.tv_sec = RECV_TIMEOUT_MS / 1000;
-   tv.tv_usec = 0;
-   retVal = select(s->handle+1, &readfds, NULL, NULL, &tv);
-   if (retVal >= 0)
+   else if (0 == retVal)
    {
-      if (FD_ISSET(s->handle, &readfds))
+      s->keepAlive = false;
+      if (s->reused && (0 == s->totalBytesRcvd))
       {
-         retVal = recv(s->handle, &(s->recvBuf[s->totalBytesRcvd]), s->recvBufLen, 0);
-         if (CLOUD_SOCKET_ERROR == retVal)
+         /* The server dropped the idle connection before seeing the request */
+         cloud_reopenSession(s);
+      }
+      else
+      {
+         s->recvComplete = true;
+         cloud_wakeOwner(s);
+         utils_sysLog(LOG_INFO, "%s>> server closed socket\n", s->name);
+         /* A response without a length ends with the connection */
+         if (parse_endOfStream(&s->response) && cloud_responseReceived(s, s->responsesRcvd) &&
+             cloud_packetIsSuccessful(s))
          {
-            if ((EINPROGRESS != errno) && (EWOULDBLOCK != errno))
-            {
-               utils_sysLog(LOG_ERR, "%s>> receive errno: %d\n", s->name, strerror(errno));
-               cloud_handleSocketError(s, errno);
-            }
+            cloud_setSessionStatus(s, CLOUD_SESSION_RECV_SUCCESS);
          }
-         else if (0 == retVal)
+      }
+   }
+   else if (s->upgraded)
+   {
+      s->recvTime = utils_getCurrentTimeMs();
+      cloud_upgradeData(s, data, retVal);
+   }
+   else if (s->http2)
+   {
+      s->totalBytesRcvd += retVal;
+      s->recvTime = utils_getCurrentTimeMs();
+      cloud_h2Recv(s, data, retVal);
+      if (s->recvComplete && (CLOUD_SESSION_RECV_PENDING == s->status) &&
+          cloud_packetIsSuccessful(s))
+      {
+         cloud_setSessionStatus(s, CLOUD_SESSION_RECV_SUCCESS);
+      }
+   }
+   else
+   {
+      s->totalBytesRcvd += retVal;
+      s->recvTime = utils_getCurrentTimeMs();
+      if (NULL == data)
+      {
+         parse_skipBody(&s->response, retVal);
+      }
+      if (cloud_recvComplete(s, data, (NULL != data) ? retVal : 0))
+      {
+         s->recvComplete = true;
+         cloud_wakeOwner(s);
+         if (cloud_packetIsSuccessful(s))
          {
-            s->recvComplete = true;
-            utils_sysLog(LOG_INFO, "%s>> server closed socket\n", s->name);
+            cloud_setSessionStatus(s, CLOUD_SESSION_RECV_SUCCESS);
          }
-         else
+      }
+   }
+}
+
+//!
+//! io_uring completion of a send.
+//!
+static void cloud_uringSent(void *arg, int fd, int res, const char *data, bool more)
+{
+   CLOUD_SESSION_T *s = (CLOUD_SESSION_T *)arg;
+
+   if (fd != s->handle)
+   {
+      return;
+   }
+   s->sendReq = URING_NO_REQUEST;
+   if (cloud_writesQueued(s))
+   {
+      /* The request completed after the upgrade, writes may be waiting */
+      cloud_flushWrites(s);
+   }
+   else if (CLOUD_SESSION_SEND_PENDING == s->status)
+   {
+      cloud_sendResult(s, (res < 0) ? CLOUD_SOCKET_ERROR : res, -res);
+      if (CLOUD_SESSION_SEND_PENDING == s->status)
+      {
+         cloud_sessionSend(s);
+      }
+   }
+}
+
+//!
+//! io_uring completion of the multishot receive of a session socket.
+//!
+//! Each completion carries one chunk of data, which is parsed straight from
+//! the provided buffer as if recv() had returned it. The receive is armed
+//! again when the kernel ends it on a live connection.
+//!
+static void cloud_uringRecv(void *arg, int fd, int res, const char *data, bool more)
+{
+   CLOUD_SESSION_T *s = (CLOUD_SESSION_T *)arg;
+
+   if (fd != s->handle)
+   {
+      return;
+   }
+   if (!more)
+   {
+      s->recvReq = URING_NO_REQUEST;
+   }
+   if (-ENOBUFS == res)
+   {
+      /* All receive buffers were in use, the data is still queued on the socket */
+      s->recvReq = uring_recvMultishot(fd, cloud_uringRecv, s);
+      return;
+   }
+   if (CLOUD_SESSION_IDLE == s->status)
+   {
+      utils_sysLog(LOG_DEBUG, "%s>> server closed idle connection\n", s->name);
+      cloud_unwatchSession(s);
+      cloud_closeSocket(s->handle);
+      s->handle = CLOUD_INVALID_SOCKET;
+      return;
+   }
+   if (CLOUD_SESSION_RECV_SUCCESS == s->status)
+   {
+      /* The server closed the connection after the response */
+      s->keepAlive = false;
+      return;
+   }
+   if (s->http2 && (CLOUD_SESSION_SEND_PENDING == s->status) && (res > 0))
+   {
+      /* An HTTP/2 server sends its settings without waiting for the requests */
+      cloud_h2Recv(s, data, res);
+      if (!more && (fd == s->handle) && (URING_NO_REQUEST == s->recvReq))
+      {
+         s->recvReq = uring_recvMultishot(fd, cloud_uringRecv, s);
+      }
+      return;
+   }
+   if (!cloud_startRecv(s))
+   {
+      utils_sysLog(LOG_ERR, "%s>> unexpected receive in status %d\n", s->name, s->status);
+      cloud_handleSocketError(s, (res < 0) ? -res : EPROTO);
+      return;
+   }
+   if (res < 0)
+   {
+      cloud_recvResult(s, NULL, CLOUD_SOCKET_ERROR, -res);
+      return;
+   }
+   cloud_recvResult(s, data, res, 0);
+   if (!more && (res > 0) && (fd == s->handle) && (URING_NO_REQUEST == s->recvReq))
+   {
+      s->recvReq = uring_recvMultishot(fd, cloud_uringRecv, s);
+   }
+}
+
+//!
+//! Advance a session by one step according to its current status.
+//!
+//! @param[in] *s pointer to a Cloud session structure object.
+//!
+static void cloud_sessionProcess(CLOUD_SESSION_T *s)
+{
+   switch(s->status)
+   {
+      case CLOUD_SESSION_CONNECT_PENDING:
+      {
+         cloud_sessionConnect(s);
+         if (CLOUD_SESSION_CONNECT_SUCCESS == s->status)
+         {
+            /* The socket is writable, no need to wait for another event */
+            cloud_sessionSend(s);
+         }
+         break;
+      }
+      case CLOUD_SESSION_CONNECT_SUCCESS:
+      case CLOUD_SESSION_SEND_PENDING:
+      {
+         cloud_sessionSend(s);
+         break;
+      }
+      case CLOUD_SESSION_SEND_SUCCESS:
+      case CLOUD_SESSION_RECV_PENDING:
+      {
+         if (cloud_writesQueued(s))
          {
-            s->totalBytesRcvd += retVal;
-            if (cloud_recvComplete(s))
+            /* Writes of an upgraded connection go out while it receives */
+            cloud_flushWrites(s);
+            if (CLOUD_SESSION_FAILED == s->status)
             {
-               s->recvComplete = true;
-               if (cloud_packetIsSuccessful(s))
-               {
-                  cloud_setSessionStatus(s, CLOUD_SESSION_RECV_SUCCESS);
-               }
+               break;
             }
          }
+         cloud_sessionRecv(s);
+         break;
       }
-      else
+      default:
       {
-         utils_sysLog(LOG_ERR, "%s>> recv FD_ISSET error: %s\n", s->name, strerror(errno));
+         break;
       }
    }
-   else
+}
+
+//!
+//! Get the epoll interest set matching the current session status.
+//!
+//! @param[in] *s pointer to a Cloud session structure object.
+//!
+static uint32_t cloud_getSessionEvents(CLOUD_SESSION_T *s)
+{
+   uint32_t events = 0;
+
+   switch(s->status)
+   {
+      case CLOUD_SESSION_CONNECT_PENDING:
+      case CLOUD_SESSION_CONNECT_SUCCESS:
+      case CLOUD_SESSION_SEND_PENDING:
+      {
+         events = EPOLLOUT;
+         break;
+      }
+      case CLOUD_SESSION_SEND_SUCCESS:
+      case CLOUD_SESSION_RECV_PENDING:
+      {
+         if (!s->recvComplete)
+         {
+            events = EPOLLIN;
+         }
+         if (cloud_writesQueued(s) && (s->totalBytesSent < s->totalBytesToSend))
+         {
+            events |= EPOLLOUT;
+         }
+         break;
+      }
+      case CLOUD_SESSION_IDLE:
+      {
+         /* Kept alive between transactions, watch for the server closing it */
+         events = EPOLLRDHUP;
+         break;
+      }
+      default:
+      {
+         break;
+      }
+   }
+
+   return events;
+}
+
+//!
+//! Update the event loop interest set of a session.
+//!
+//! @param[in] *s pointer to a Cloud session structure object.
+//!
+static void cloud_updateSessionEvents(CLOUD_SESSION_T *s)
+{
+   if (s->handler.registered)
+   {
+      event_modifyHandler(&s->handler, cloud_getSessionEvents(s));
+   }
+}
+
+//!
+//! Event loop callback of a session socket.
+//!
+//! @param[in] arg  pointer to a Cloud session structure object.
+//! @param[in] events  Ready epoll events
+//!
+static void cloud_sessionEvent(void *arg, uint32_t events)
+{
+   CLOUD_SESSION_T *s = (CLOUD_SESSION_T *)arg;
+
+   if (CLOUD_SESSION_IDLE == s->status)
    {
-      utils_sysLog(LOG_ERR, "%s>> recv select errno %s\n", s->name, strerror(errno));
+      utils_sysLog(LOG_DEBUG, "%s>> server closed idle connection\n", s->name);
+      cloud_unwatchSession(s);
+      cloud_closeSocket(s->handle);
+      s->handle = CLOUD_INVALID_SOCKET;
+      return;
+   }
+   if ((events & (EPOLLERR | EPOLLHUP)) &&
+       (CLOUD_SESSION_SEND_SUCCESS != s->status) &&
+       (CLOUD_SESSION_RECV_PENDING != s->status))
+   {
+      /*
+       * Let a pending connect report its own error, anything else
+       * outside of a receive means the socket is unusable.
+       */
+      if (CLOUD_SESSION_CONNECT_PENDING != s->status)
+      {
+         utils_sysLog(LOG_ERR, "%s>> socket hang up in status %d\n", s->name, s->status);
+         cloud_handleSocketError(s, ECONNRESET);
+         return;
+      }
    }
+   cloud_sessionProcess(s);
+   cloud_updateSessionEvents(s);
 }
 
 //!
@@ -407,6 +1406,9 @@ static void cloud_startSessionAttempt(CLOUD_SESSION_T *s)
    cloud_setSessionStatus(s, CLOUD_SESSION_IDLE);
    s->totalBytesRcvd = 0;
    s->totalBytesSent = 0;
+   s->responsesRcvd = 0;
+   s->keepAlive = false;
+   s->upgraded = false;
 }
 
 //!
@@ -420,7 +1422,16 @@ static void cloud_setSessionStatus(CLOUD_SESSION_T *s, CLOUD_SESSION_STATUS_T st
    if (s->status != status)
    {
       utils_sysLog(LOG_DEBUG, "%s>> session status changed %d -> %d\n", s->name, s->status, status);
+      if ((CLOUD_SESSION_RESOLVE_PENDING == s->status) ||
+          (CLOUD_SESSION_RESOLVE_PENDING == status))
+      {
+         cloud_setResolving(s, CLOUD_SESSION_RESOLVE_PENDING == status);
+      }
       s->status = status;
+      s->phaseStart = utils_getCurrentTimeMs();
+      cloud_updateSessionEvents(s);
+      cloud_setSessionTimer(s);
+      cloud_wakeOwner(s);
    }
 }
 
@@ -430,120 +1441,241 @@ static void cloud_setSessionStatus(CLOUD_SESSION_T *s, CLOUD_SESSION_STATUS_T st
 //! @param[in] *s pointer to a Cloud session structure object.
 //! @param[in] err error code
 //!
-static void cloud_setSocketError(CLOUD_SESSION_T *s, int errCode)
+static void cloud_setSocketError(CLOUD_SESSION_T *s, int errCode)
+{
+   utils_sysLog(LOG_DEBUG, "%s>> socket error code %d\n", s->name, errCode);
+   s->errorCode = errCode;
+   s->diags->sockFailures++;
+   s->errorTime = utils_getCurrentTime();
+   s->totalBytesRcvd = 0;
+   s->totalBytesSent = 0;
+   cloud_setSessionStatus(s, CLOUD_SESSION_FAILED);
+}
+
+//!
+//! Reset the full status of a given session.
+//!
+//! Typically called in between operations (states) to reset the session
+//! to idle, clear error counts and number of bytes sent/received.
+//!
+//! @param[in] *s pointer to a Cloud session structure object.
+//!
+void cloud_resetSessionStatus(CLOUD_SESSION_T *s)
+{
+   cloud_setSessionStatus(s, CLOUD_SESSION_IDLE);
+   s->errorCode = 0;
+   s->totalBytesRcvd = 0;
+   s->totalBytesSent = 0;
+   s->httpStatus = 0;
+   s->recvComplete = false;
+   s->timeout = false;
+   s->upgraded = false;
+}
+
+//!
+//! Create the session socket for the resolved server address.
+//!
+//! @param[in] s  Pointer to session structure
+//!
+//! @return  true if the socket was created, otherwise false
+//!
+static bool cloud_openSocket(CLOUD_SESSION_T *s)
+{
+   s->handle = socket(s->serverAddr.sa.sa_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_TCP);
+   if (CLOUD_INVALID_SOCKET != s->handle)
+   {
+      cloud_setSessionStatus(s, CLOUD_SESSION_CREATE_SUCCESS);
+      return true;
+   }
+   utils_sysLog(LOG_ERR, "%s>> init session errno: %s\n", s->name, strerror(errno));
+   cloud_handleSocketError(s, errno);
+
+   return false;
+}
+
+//!
+//! Replace a kept alive connection that the server has closed.
+//!
+//! The request in the send buffer is sent again on the new connection
+//! once it is established, within the deadlines of the transaction.
+//!
+//! @param[in] s  Pointer to session structure
+//!
+static void cloud_reopenSession(CLOUD_SESSION_T *s)
+{
+   if (s->http2)
+   {
+      /* The frames are encoded for the lost connection, the requests are sent again later */
+      utils_sysLog(LOG_INFO, "%s>> kept alive HTTP/2 connection lost\n", s->name);
+      cloud_handleSocketError(s, ECONNRESET);
+      return;
+   }
+   utils_sysLog(LOG_DEBUG, "%s>> kept alive connection lost, reconnecting\n", s->name);
+   cloud_unwatchSession(s);
+   cloud_closeSocket(s->handle);
+   s->handle = CLOUD_INVALID_SOCKET;
+   s->reused = false;
+   s->totalBytesSent = 0;
+   s->totalBytesRcvd = 0;
+   s->responsesRcvd = 0;
+   if (cloud_openSocket(s))
+   {
+      cloud_sessionConnect(s);
+   }
+}
+
+//!
+//! Set a socket address from a resolved address and a port.
+//!
+static void cloud_setSockAddr(CLOUD_SOCKADDR_T *sa, const DNS_ADDR_T *addr, uint16_t port)
 {
-   utils_sysLog(LOG_DEBUG, "%s>> socket error code %d\n", s->name, errCode);
-   s->errorCode = errCode;
-   s->diags->sockFailures++;
-   s->errorTime = utils_getCurrentTime();
-   s->totalBytesRcvd = 0;
-   s->totalBytesSent = 0;
-   cloud_setSessionStatus(s, CLOUD_SESSION_FAILED);
+   memset(sa, 0, sizeof(CLOUD_SOCKADDR_T));
+   if (AF_INET6 == addr->family)
+   {
+      sa->sin6.sin6_family = AF_INET6;
+      sa->sin6.sin6_addr = addr->u.in6;
+      sa->sin6.sin6_port = htons(port);
+   }
+   else
+   {
+      sa->sin.sin_family = AF_INET;
+      sa->sin.sin_addr = addr->u.in4;
+      sa->sin.sin_port = htons(port);
+   }
 }
 
 //!
-//! Reset the full status of a given session.
+//! Look up the IPv6 and IPv4 addresses of the server.
 //!
-//! Typically called in between operations (states) to reset the session
-//! to idle, clear error counts and number of bytes sent/received.
+//! The family that won the last connection race to the host, or IPv6 for
+//! a new host, becomes the session address and the other family the
+//! fallback. When only the other family has resolved, the preferred one
+//! is given CLOUD_RESOLUTION_DELAY_MS to catch up.
 //!
-//! @param[in] *s pointer to a Cloud session structure object.
+//! @return  DNS_RESOLVED when the session address is set, DNS_PENDING
+//!          or DNS_FAILED
 //!
-void cloud_resetSessionStatus(CLOUD_SESSION_T *s)
+static DNS_STATUS_T cloud_resolveServer(CLOUD_SESSION_T *s, char *serverName, uint16_t serverPort)
 {
-   cloud_setSessionStatus(s, CLOUD_SESSION_IDLE);
-   s->errorCode = 0;
-   s->totalBytesRcvd = 0;
-   s->totalBytesSent = 0;
-   s->httpStatus = 0;
-   s->recvComplete = false;
-   s->timeout = false;
+   DNS_STATUS_T status[2];
+   DNS_ADDR_T addrs[2];
+   int families[2];
+   int i;
+
+   families[0] = dns_getPreferredFamily(serverName);
+   families[1] = (AF_INET6 == families[0]) ? AF_INET : AF_INET6;
+   for (i = 0; i < 2; i++)
+   {
+      status[i] = dns_lookup(serverName, families[i], &addrs[i]);
+   }
+   if ((DNS_PENDING == status[0]) && (DNS_RESOLVED == status[1]) &&
+       ((CLOUD_SESSION_RESOLVE_PENDING != s->status) ||
+        ((utils_getCurrentTimeMs() - s->phaseStart) < CLOUD_RESOLUTION_DELAY_MS)))
+   {
+      return DNS_PENDING;
+   }
+   s->fallback.addr.sa.sa_family = AF_UNSPEC;
+   if (DNS_RESOLVED == status[0])
+   {
+      cloud_setSockAddr(&s->serverAddr, &addrs[0], serverPort);
+      if (DNS_RESOLVED == status[1])
+      {
+         cloud_setSockAddr(&s->fallback.addr, &addrs[1], serverPort);
+      }
+      return DNS_RESOLVED;
+   }
+   if (DNS_RESOLVED == status[1])
+   {
+      cloud_setSockAddr(&s->serverAddr, &addrs[1], serverPort);
+      return DNS_RESOLVED;
+   }
+
+   return ((DNS_PENDING == status[0]) || (DNS_PENDING == status[1])) ? DNS_PENDING : DNS_FAILED;
 }
 
 //!
 //! Resolve DNS and open a socket to a server.
 //!
 //! This routine will only initialize the session if not already active.
+//! Names are resolved without blocking, so while the first lookup of a
+//! name is outstanding the session is left in resolve pending and this
+//! routine must be called again until the session leaves that status.
 //!
 //! @param[in] s  Pointer to session structure
-//! @param[in] serverName  Pointer to server name string
+//! @param[in] serverName  Pointer to server name string, must stay valid
+//!                        while the session is open
 //! @param[in] serverPort  Server port number
 //!
-//! @return  true if session successfully created, otherwise false
+//! @return  true if session successfully created or still resolving,
+//!          otherwise false
 //!
 bool cloud_initSession(CLOUD_SESSION_T *s, char *serverName, uint16_t serverPort)
 {
-   const int recvSockTimeOut = 5000;
-   struct in_addr host_addr;
-   struct in_addr* p_addr;
-   struct hostent* p_host;
+   char addrStr[INET6_ADDRSTRLEN];
    bool success = false;
-   /*
-    * Start the transaction timer here, as sometimes the socket is already active,
-    * and we want to restart the timer with every new transaction.
-    */
-   s->transStart = utils_getCurrentTime();
-   s->diags->attempts++;
+
+   if (CLOUD_SESSION_RESOLVE_PENDING != s->status)
+   {
+      /*
+       * Start the transaction timer here, as sometimes the socket is already active,
+       * and we want to restart the timer with every new transaction.
+       */
+      s->transStart = utils_getCurrentTimeMs();
+      s->diags->attempts++;
+   }
    /* Don't do anything if the session is already active. */
    if (CLOUD_INVALID_SOCKET != s->handle)
    {
       utils_sysLog(LOG_DEBUG, "%s>> session already active\n", s->name);
       return true;
    }
-   s->handle = CLOUD_INVALID_SOCKET;
    if (0 == strlen(serverName))
    {
       utils_sysLog(LOG_ERR, "%s>> empty server name string\n", s->name);
-      success = false;
+      return false;
    }
-   else
+   s->serverName = serverName;
+   switch (cloud_resolveServer(s, serverName, serverPort))
    {
-      host_addr.s_addr = inet_addr(serverName);
-      if (host_addr.s_addr == INADDR_NONE)
+      case DNS_RESOLVED:
       {
-         utils_sysLog(LOG_DEBUG, "%s>> url: %s\n", s->name, serverName);
-         memset(&serverIpAddr, 0, sizeof(CLOUD_SOCKADDR_T));
-         p_host = gethostbyname(serverName);
-         if (NULL != p_host)
+         utils_sysLog(LOG_DEBUG, "%s>> ip: %s\n", s->name,
+                      cloud_addrToString(&s->serverAddr, addrStr, sizeof(addrStr)));
+         if (AF_UNSPEC != s->fallback.addr.sa.sa_family)
          {
-            char *addr = inet_ntoa(*((struct in_addr *)(p_host->h_addr)));
-            if (NULL != addr)
-            {
-               serverIpAddr.sin_family = AF_INET;
-               serverIpAddr.sin_addr = *((struct in_addr *)(p_host->h_addr));
-               serverIpAddr.sin_port = htons(serverPort);
-            }
+            utils_sysLog(LOG_DEBUG, "%s>> fallback ip: %s\n", s->name,
+                         cloud_addrToString(&s->fallback.addr, addrStr, sizeof(addrStr)));
          }
+         utils_sysLog(LOG_DEBUG, "%s>> port: %d\n", s->name, serverPort);
+         success = cloud_openSocket(s);
+         break;
       }
-      else
-      {
-         serverIpAddr.sin_family = AF_INET;
-         serverIpAddr.sin_addr = host_addr;
-         serverIpAddr.sin_port = htons(serverPort);
-      }
-      if (0 != serverIpAddr.sin_addr.s_addr)
+      case DNS_PENDING:
       {
-         p_addr = (struct in_addr *)&serverIpAddr.sin_addr;
-         utils_sysLog(LOG_DEBUG, "%s>> ip: %s\n", s->name, inet_ntoa(*p_addr));
-         utils_sysLog(LOG_DEBUG, "%s>> port: %d\n", s->name, ntohs(serverIpAddr.sin_port));
-         s->handle = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-         setsockopt(s->handle, SOL_SOCKET, SO_RCVTIMEO, (char *)&recvSockTimeOut, sizeof(int));
-         if (CLOUD_INVALID_SOCKET != s->handle)
+         if (CLOUD_SESSION_RESOLVE_PENDING != s->status)
          {
-            cloud_setSessionStatus(s, CLOUD_SESSION_CREATE_SUCCESS);
+            utils_sysLog(LOG_DEBUG, "%s>> url: %s\n", s->name, serverName);
+            cloud_setSessionStatus(s, CLOUD_SESSION_RESOLVE_PENDING);
             success = true;
          }
+         else if ((s->deadlines.dnsMs > 0) &&
+                  ((utils_getCurrentTimeMs() - s->phaseStart) >= s->deadlines.dnsMs))
+         {
+            utils_sysLog(LOG_INFO, "%s>> DNS deadline expired\n", s->name);
+            s->timeout = true;
+            cloud_setSocketError(s, ETIMEDOUT);
+         }
          else
          {
-            utils_sysLog(LOG_ERR, "%s>> init session errno: %s\n", s->name, strerror(errno));
-            cloud_handleSocketError(s, errno);
-            success = false;
+            success = true;
          }
+         break;
       }
-      else
+      default:
       {
          utils_sysLog(LOG_ERR, "%s>> URL resolve failed\n", s->name);
-         success = false;
+         cloud_setSocketError(s, EHOSTUNREACH);
+         break;
       }
    }
 
@@ -555,14 +1687,41 @@ bool cloud_initSession(CLOUD_SESSION_T *s, char *serverName, uint16_t serverPort
 //!
 void cloud_closeSession(CLOUD_SESSION_T *s)
 {
+   cloud_cancelFallback(s);
    if (CLOUD_INVALID_SOCKET != s->handle)
    {
-      close(s->handle);
+      cloud_unwatchSession(s);
+      cloud_closeSocket(s->handle);
       s->handle = CLOUD_INVALID_SOCKET;
    }
    cloud_resetSessionStatus(s);
 }
 
+//!
+//! Release a session at the end of a transaction.
+//!
+//! The connection is kept open for the next transaction when the response
+//! was received successfully and the server allows the connection to be
+//! reused, otherwise it is closed.
+//!
+//! @param[in] s  Pointer to session structure
+//!
+void cloud_releaseSession(CLOUD_SESSION_T *s)
+{
+   /* The owner is not told of the session once it gave it up */
+   s->wakeCb = NULL;
+   s->wakeArg = NULL;
+   if ((CLOUD_SESSION_RECV_SUCCESS == s->status) && s->keepAlive &&
+       (CLOUD_INVALID_SOCKET != s->handle))
+   {
+      cloud_resetSessionStatus(s);
+   }
+   else
+   {
+      cloud_closeSession(s);
+   }
+}
+
 //!
 //! If the session is not currently connected, attempt to connect,
 //! then try to send data if connected. If already connected, attempt
@@ -570,9 +1729,22 @@ void cloud_closeSession(CLOUD_SESSION_T *s)
 //!
 void cloud_sessionConnectAndSend(CLOUD_SESSION_T *s)
 {
-   /* Capture the transaction start time, used for a session timeout */
-   s->transStart = utils_getCurrentTime();
+   /* Capture the transaction start time, used for the total deadline */
+   s->transStart = utils_getCurrentTimeMs();
+   s->responsesRcvd = 0;
 
+   /* An idle session with an open socket is a kept alive connection */
+   s->reused = ((CLOUD_SESSION_IDLE == s->status) && s->watched);
+   if (s->http2 && !cloud_startHttp2(s))
+   {
+      cloud_setSocketError(s, EPROTO);
+      return;
+   }
+   if ((CLOUD_SESSION_IDLE == s->status) && (CLOUD_INVALID_SOCKET == s->handle))
+   {
+      /* The kept alive connection was closed after the session was initialized */
+      cloud_openSocket(s);
+   }
    if (CLOUD_SESSION_CREATE_SUCCESS == s->status)
    {
       cloud_sessionConnect(s);
@@ -586,58 +1758,227 @@ void cloud_sessionConnectAndSend(CLOUD_SESSION_T *s)
 }
 
 //!
-//! This function processes a send operation and wait for a receive from the
-//! server.
+//! Get the time left before the next deadline of a session expires.
 //!
-//! Note1: Prior to calling this function, a call to cloud_sessionSend()
-//!        must have been done to set the socket status to either send in
-//!        progress or send complete.
-//! Note2: If the socket has been configured as non-blocking, this function
-//!        needs to be called continuously until true is returned.
+//! The connect deadline runs while connect is pending, the first byte
+//! deadline runs from the end of the send, or from the last bytes the peer
+//! acknowledged, until anything is received, the idle deadline runs from
+//! the last bytes sent while the request is going out and from the last
+//! bytes received while the response is arriving, and the total deadline
+//! covers the whole transaction.
 //!
 //! @param[in] *s pointer to a Cloud session structure object.
-//! @param[in] timeoutSec  The number of timeout seconds, (0 = no timeout)
+//! @param[in] now  Current time in milliseconds
+//! @param[out] phase  Name of the phase owning the returned deadline
+//!
+//! @return  Milliseconds left, 0 if expired or CLOUD_NO_DEADLINE
 //!
-bool cloud_sessionSendRecvAll(CLOUD_SESSION_T *s, uint32_t timeoutSec)
+static uint32_t cloud_getSessionDeadline(CLOUD_SESSION_T *s, uint32_t now, const char **phase)
 {
-   bool complete = false;
+   uint32_t left = CLOUD_NO_DEADLINE;
+   uint32_t limit = 0;
+   uint32_t elapsed;
 
    switch(s->status)
    {
-      case CLOUD_SESSION_IDLE:
+      case CLOUD_SESSION_CONNECT_PENDING:
       {
-         // Should not be here if we are idle
+         limit = s->deadlines.connectMs;
+         *phase = "connect";
          break;
       }
-      case CLOUD_SESSION_CONNECT_PENDING:
+      case CLOUD_SESSION_SEND_SUCCESS:
       {
-         cloud_sessionConnect(s);
+         limit = s->deadlines.firstByteMs;
+         *phase = "first byte";
          break;
       }
-      case CLOUD_SESSION_CONNECT_SUCCESS:
-      case CLOUD_SESSION_SEND_PENDING:
+      case CLOUD_SESSION_RECV_PENDING:
       {
-         cloud_sessionSend(s);
+         /* A response that streams for long is only failed once it stalls */
+         if ((s->deadlines.idleMs > 0) && !s->recvComplete)
+         {
+            elapsed = now - s->recvTime;
+            left = (elapsed < s->deadlines.idleMs) ? (s->deadlines.idleMs - elapsed) : 0;
+            *phase = "idle";
+         }
          break;
       }
-      case CLOUD_SESSION_SEND_SUCCESS:
-      case CLOUD_SESSION_RECV_PENDING:
+      case CLOUD_SESSION_SEND_PENDING:
       {
-         cloud_sessionRecv(s);
+         /* A large request body is only failed once the peer stops taking it */
+         if (s->deadlines.idleMs > 0)
+         {
+            elapsed = now - s->sendTime;
+            left = (elapsed < s->deadlines.idleMs) ? (s->deadlines.idleMs - elapsed) : 0;
+            *phase = "send idle";
+         }
          break;
       }
-      case CLOUD_SESSION_FAILED:
+      case CLOUD_SESSION_CONNECT_SUCCESS:
       {
-         /* Do nothing, the function that indicated the failure */
          break;
       }
+      default:
+      {
+         /* No transaction in progress */
+         return left;
+      }
+   }
+   if (limit > 0)
+   {
+      elapsed = now - s->phaseStart;
+      left = (elapsed < limit) ? (limit - elapsed) : 0;
+   }
+   if ((s->deadlines.totalMs > 0) && !s->recvComplete)
+   {
+      elapsed = now - s->transStart;
+      limit = (elapsed < s->deadlines.totalMs) ? (s->deadlines.totalMs - elapsed) : 0;
+      if (limit < left)
+      {
+         left = limit;
+         *phase = "total";
+      }
+   }
+
+   return left;
+}
+
+//!
+//! Get the time until the owner of a session waiting for its server name
+//! looks it up again without an answer in between: once the preferred
+//! family has had CLOUD_RESOLUTION_DELAY_MS to catch up, and at the DNS
+//! deadline.
+//!
+//! @return  Milliseconds left, or CLOUD_NO_DEADLINE
+//!
+static uint32_t cloud_getResolveDelay(CLOUD_SESSION_T *s, uint32_t now)
+{
+   uint32_t elapsed = now - s->phaseStart;
+
+   if (CLOUD_SESSION_RESOLVE_PENDING != s->status)
+   {
+      return CLOUD_NO_DEADLINE;
+   }
+   if (elapsed < CLOUD_RESOLUTION_DELAY_MS)
+   {
+      return CLOUD_RESOLUTION_DELAY_MS - elapsed;
+   }
+   if ((s->deadlines.dnsMs > 0) && (elapsed < s->deadlines.dnsMs))
+   {
+      return s->deadlines.dnsMs - elapsed;
+   }
+
+   return CLOUD_NO_DEADLINE;
+}
+
+//!
+//! Hold the first byte deadline of a session back while the peer is still
+//! acknowledging its request. A request body handed to the socket at once
+//! can take long to drain from the send queue on a slow path, and the
+//! server cannot answer before it has it all.
+//!
+//! @param[in] *s pointer to a Cloud session structure object.
+//! @param[in] now  Current time in milliseconds
+//!
+static void cloud_checkSendQueue(CLOUD_SESSION_T *s, uint32_t now)
+{
+   int queued;
+
+   if ((CLOUD_SESSION_SEND_SUCCESS != s->status) || (0 == s->deadlines.idleMs) ||
+       (0 != ioctl(s->handle, SIOCOUTQ, &queued)))
+   {
+      return;
+   }
+   if (queued != s->sendQueued)
+   {
+      s->phaseStart = now;
+      s->sendQueued = queued;
+   }
+}
+
+//!
+//! Timer callback of a session. Fails the session if its deadline has
+//! expired, otherwise starts its fallback connect attempt or wakes its
+//! owner if they are due, and sets the timer again.
+//!
+static void cloud_sessionTimer(void *arg)
+{
+   CLOUD_SESSION_T *s = (CLOUD_SESSION_T *)arg;
+   const char *phase = "";
+   uint32_t now = utils_getCurrentTimeMs();
+
+   if (CLOUD_SESSION_RESOLVE_PENDING == s->status)
+   {
+      cloud_wakeOwner(s);
+   }
+   cloud_checkFallback(s, now);
+   cloud_checkSendQueue(s, now);
+   if (0 == cloud_getSessionDeadline(s, now, &phase))
+   {
+      utils_sysLog(LOG_INFO, "%s>> %s deadline expired\n", s->name, phase);
+      s->timeout = true;
+      cloud_handleSocketError(s, ETIMEDOUT);
+      return;
+   }
+   cloud_setSessionTimer(s);
+}
+
+//!
+//! Set the timer of a session for the nearest of its deadline, its
+//! fallback connect attempt and the next lookup of its server name. A
+//! deadline that moves on as bytes arrive is checked when the timer is
+//! due and the timer set again, so that receiving costs nothing, and
+//! sessions are never walked in turn whatever their number.
+//!
+//! @param[in] *s pointer to a Cloud session structure object.
+//!
+static void cloud_setSessionTimer(CLOUD_SESSION_T *s)
+{
+   const char *phase = "";
+   uint32_t now = utils_getCurrentTimeMs();
+   uint32_t left = cloud_getSessionDeadline(s, now, &phase);
+   uint32_t delay;
+
+   delay = cloud_getFallbackDelay(s, now);
+   if (delay < left)
+   {
+      left = delay;
+   }
+   delay = cloud_getResolveDelay(s, now);
+   if (delay < left)
+   {
+      left = delay;
+   }
+   if (CLOUD_NO_DEADLINE == left)
+   {
+      event_cancelTimer(&s->timer);
+      return;
+   }
+   if (!wheel_isPending(&s->timer))
+   {
+      /* Sessions are set up by their owners, the timer is bound on first use */
+      wheel_initTimer(&s->timer, cloud_sessionTimer, s);
    }
-   /*
-    * A second check is used here to catch success results after the above
-    * routines are called. Because it will take some time for the rhapsody
-    * state machine to come back around, we speed it up by checking for
-    * success status right after the above function calls.
-    */
+   event_addTimer(&s->timer, left);
+}
+
+//!
+//! This function checks a send operation and its receive from the server.
+//!
+//! Note1: Prior to calling this function, a call to cloud_sessionSend()
+//!        must have been done to set the socket status to either send in
+//!        progress or send complete.
+//! Note2: The socket I/O and the session deadlines are driven by
+//!        cloud_processEvents(), so this function needs to be called
+//!        continuously until true is returned.
+//!
+//! @param[in] *s pointer to a Cloud session structure object.
+//!
+bool cloud_sessionSendRecvAll(CLOUD_SESSION_T *s)
+{
+   bool complete = false;
+
    if (CLOUD_SESSION_RECV_SUCCESS == s->status)
    {
       complete = true;
@@ -647,14 +1988,179 @@ bool cloud_sessionSendRecvAll(CLOUD_SESSION_T *s, uint32_t timeoutSec)
       utils_sysLog(LOG_DEBUG, "%s>> receive not successful\n", s->name);
       complete = true;
    }
-   else if (timeoutSec > 0)
+
+   return complete;
+}
+
+//!
+//! Queue bytes to write on an upgraded or HTTP/2 connection.
+//!
+//! The bytes are sent at once as far as the socket takes them, the rest
+//! goes out as the socket drains. While HTTP/2 requests are being sent,
+//! the bytes go out after them.
+//!
+//! @param[in] *s pointer to a Cloud session structure object.
+//! @param[in] data  Bytes to write
+//! @param[in] len  Number of bytes to write
+//!
+//! @return  true if the bytes are queued, false if the connection is not
+//!          upgraded or the send buffer is full
+//!
+bool cloud_sessionWrite(CLOUD_SESSION_T *s, const char *data, size_t len)
+{
+   int pending;
+
+   if (s->http2 && (CLOUD_SESSION_SEND_PENDING == s->status) &&
+       ((size_t)s->totalBytesToSend + len <= CLOUD_SEND_BUF_LEN))
+   {
+      /* Sent after the requests */
+      memcpy(&s->sendBuf[s->totalBytesToSend], data, len);
+      s->totalBytesToSend += len;
+      return true;
+   }
+   if (!cloud_writesQueued(s))
+   {
+      return false;
+   }
+   pending = s->totalBytesToSend - s->totalBytesSent;
+   if (((size_t)s->totalBytesToSend + len > CLOUD_SEND_BUF_LEN) &&
+       (URING_NO_REQUEST == s->sendReq) && (s->totalBytesSent > 0))
+   {
+      /* Make room behind the bytes not sent yet */
+      memmove(s->sendBuf, &s->sendBuf[s->totalBytesSent], pending);
+      s->totalBytesToSend = pending;
+      s->totalBytesSent = 0;
+   }
+   if ((size_t)s->totalBytesToSend + len > CLOUD_SEND_BUF_LEN)
+   {
+      utils_sysLog(LOG_ERR, "%s>> send buffer full, %d bytes pending\n", s->name, pending);
+      return false;
+   }
+   memcpy(&s->sendBuf[s->totalBytesToSend], data, len);
+   s->totalBytesToSend += len;
+   cloud_flushWrites(s);
+   cloud_updateSessionEvents(s);
+
+   return true;
+}
+
+//!
+//! io_uring completion of a write on an upgraded connection.
+//!
+static void cloud_uringWritten(void *arg, int fd, int res, const char *data, bool more)
+{
+   CLOUD_SESSION_T *s = (CLOUD_SESSION_T *)arg;
+
+   if (fd != s->handle)
+   {
+      return;
+   }
+   s->sendReq = URING_NO_REQUEST;
+   if (!cloud_writesQueued(s))
+   {
+      return;
+   }
+   if (res < 0)
+   {
+      utils_sysLog(LOG_ERR, "%s>> send failed errno: %s\n", s->name, strerror(-res));
+      cloud_handleSocketError(s, -res);
+      return;
+   }
+   s->totalBytesSent += res;
+   cloud_flushWrites(s);
+}
+
+//!
+//! Send the bytes queued on an upgraded connection as far as the socket
+//! takes them.
+//!
+//! @param[in] *s pointer to a Cloud session structure object.
+//!
+static void cloud_flushWrites(CLOUD_SESSION_T *s)
+{
+   ssize_t retVal;
+   int pending;
+
+   if (s->totalBytesSent == s->totalBytesToSend)
+   {
+      s->totalBytesSent = 0;
+      s->totalBytesToSend = 0;
+      return;
+   }
+   pending = s->totalBytesToSend - s->totalBytesSent;
+   if (uring_isActive())
+   {
+      /* The bytes queued meanwhile go out with the next send */
+      if (URING_NO_REQUEST == s->sendReq)
+      {
+         s->sendReq = uring_send(s->handle, &s->sendBuf[s->totalBytesSent], pending,
+                                 MSG_NOSIGNAL, cloud_uringWritten, s);
+         if (URING_NO_REQUEST == s->sendReq)
+         {
+            cloud_handleSocketError(s, ENOBUFS);
+         }
+      }
+      return;
+   }
+   retVal = send(s->handle, &s->sendBuf[s->totalBytesSent], pending, MSG_NOSIGNAL);
+   if (CLOUD_SOCKET_ERROR == retVal)
    {
-      if (utils_isTimerExpired(s->transStart, timeoutSec))
+      if ((EAGAIN != errno) && (EWOULDBLOCK != errno))
       {
-         s->timeout = true;
-         utils_sysLog(LOG_INFO, "%s>> current session timed out\n", s->name);
+         utils_sysLog(LOG_ERR, "%s>> send failed errno: %s\n", s->name, strerror(errno));
+         cloud_handleSocketError(s, errno);
       }
+      return;
+   }
+   s->totalBytesSent += retVal;
+   if (s->totalBytesSent == s->totalBytesToSend)
+   {
+      s->totalBytesSent = 0;
+      s->totalBytesToSend = 0;
    }
+}
 
-   return complete;
+//!
+//! Initialize the Cloud module and its event loop.
+//!
+void cloud_init(void)
+{
+   if (!event_init())
+   {
+      utils_sysLog(LOG_ERR, "Cloud event loop not available\n");
+   }
+   else if (!dns_init())
+   {
+      utils_sysLog(LOG_ERR, "Cloud resolver not available\n");
+   }
+   dns_setDoneCallback(cloud_nameResolved);
+   /* Session I/O falls back to epoll readiness without io_uring */
+   uring_init();
+}
+
+//!
+//! Run the event loop for all active sessions until anything happens.
+//!
+//! Socket readiness is dispatched to the sessions as it happens, so any
+//! number of sessions progress in parallel while this function waits.
+//! Session deadlines are timers of the loop, run when they are due. The
+//! wait ends as soon as events are dispatched, a timer is due, or the loop
+//! is woken up with event_wake(), so the caller can act on the new state
+//! at once.
+//!
+//! @param[in] timeoutMs  Longest time to wait in milliseconds, CLOUD_NO_DEADLINE
+//!                       to wait until anything happens
+//!
+void cloud_processEvents(uint32_t timeoutMs)
+{
+   uint32_t waitMs = timeoutMs;
+   uint32_t nearest;
+
+   nearest = dns_processTimers();
+   if (nearest < waitMs)
+   {
+      waitMs = nearest;
+   }
+   uring_submit();
+   event_wait((CLOUD_NO_DEADLINE == waitMs) ? -1 : (int)waitMs);
 }
@@ -0,0 +1,891 @@
+//******************************************************************************
+//!
+//! Author:  Ying Xiong
+//! Created: Oct 2026
+//!
+//******************************************************************************
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/random.h>
+#include <sys/socket.h>
+#include "dns.h"
+#include "event.h"
+#include "utils.h"
+
+//
+// Local Defines
+//
+#define DNS_MSG_LEN          (512)
+#define DNS_HEADER_LEN       (12)
+#define DNS_FLAG_QR          (0x8000)
+#define DNS_FLAG_RD          (0x0100)
+#define DNS_RCODE_MASK       (0x000F)
+#define DNS_RCODE_NXDOMAIN   (3)
+#define DNS_TYPE_A           (1)
+#define DNS_TYPE_AAAA        (28)
+#define DNS_CLASS_IN         (1)
+#define DNS_RESOLV_CONF      "/etc/resolv.conf"
+#define DNS_HOSTS_FILE       "/etc/hosts"
+
+//
+// DNS Record of one address family
+//
+typedef struct
+{
+   DNS_ADDR_T addr;                   //!< Last answer, valid if hasAddr
+   bool hasAddr;                      //!< An answer is cached, possibly stale
+   bool failed;                       //!< Name does not exist or has no address
+   bool querying;                     //!< A query is outstanding
+   uint16_t queryId;                  //!< Id of the outstanding query
+   uint8_t attempts;                  //!< Transmissions of the outstanding query
+   uint32_t sentAt;                   //!< Monotonic ms time of the last transmission
+   uint32_t expires;                  //!< Monotonic ms time the answer expires
+}
+DNS_RECORD_T;
+
+//
+// DNS Cache Entry
+//
+typedef struct
+{
+   char name[DNS_NAME_LEN];           //!< Host name, empty if the entry is free
+   DNS_RECORD_T records[DNS_FAMILY_COUNT]; //!< IPv4 and IPv6 records
+   int preferred;                     //!< Family that connected first last time
+   uint32_t lastUsed;                 //!< Monotonic ms time of the last lookup
+}
+DNS_ENTRY_T;
+
+//
+// Name Server Address
+//
+typedef union
+{
+   struct sockaddr sa;
+   struct sockaddr_in sin;
+   struct sockaddr_in6 sin6;
+}
+DNS_SERVER_ADDR_T;
+
+//
+// Local Variables
+//
+static DNS_ENTRY_T dnsCache[DNS_CACHE_SIZE];
+static EVENT_HANDLER_T dnsHandler;
+static int dnsSocket = -1;
+static DNS_DONE_CB_T dnsDoneCallback = NULL;
+static const int dnsFamilies[DNS_FAMILY_COUNT] = { AF_INET, AF_INET6 };
+
+//!
+//! Check whether a monotonic ms time has been reached.
+//!
+static bool dns_isReached(uint32_t when, uint32_t now)
+{
+   return ((int32_t)(now - when) >= 0);
+}
+
+//!
+//! Get the record index of an address family.
+//!
+//! @return  Record index, or -1 if the family is not supported
+//!
+static int dns_getFamilyIndex(int family)
+{
+   int i;
+
+   for (i = 0; i < DNS_FAMILY_COUNT; i++)
+   {
+      if (dnsFamilies[i] == family)
+      {
+         return i;
+      }
+   }
+
+   return -1;
+}
+
+//!
+//! Format an address for logging.
+//!
+static const char* dns_addrToString(const DNS_ADDR_T *addr, char *buf, socklen_t len)
+{
+   if (NULL == inet_ntop(addr->family, &addr->u, buf, len))
+   {
+      strcpy(buf, "?");
+   }
+
+   return buf;
+}
+
+//!
+//! Parse an IPv4 or IPv6 address string of the given family.
+//!
+//! @return  true if the string is an address of that family, otherwise false
+//!
+static bool dns_parseAddr(int family, const char *str, DNS_ADDR_T *addr)
+{
+   DNS_ADDR_T parsed;
+
+   memset(&parsed, 0, sizeof(parsed));
+   parsed.family = family;
+   if (1 != inet_pton(family, str, &parsed.u))
+   {
+      return false;
+   }
+   *addr = parsed;
+
+   return true;
+}
+
+//!
+//! Read the first name server from the resolver configuration.
+//!
+static void dns_getServer(DNS_SERVER_ADDR_T *server)
+{
+   char line[256];
+   char addr[64];
+   FILE *fp;
+
+   memset(server, 0, sizeof(DNS_SERVER_ADDR_T));
+   server->sin.sin_family = AF_INET;
+   server->sin.sin_port = htons(DNS_PORT);
+   server->sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   fp = fopen(DNS_RESOLV_CONF, "r");
+   if (NULL != fp)
+   {
+      while (NULL != fgets(line, sizeof(line), fp))
+      {
+         if (1 != sscanf(line, "nameserver %63s", addr))
+         {
+            continue;
+         }
+         if (1 == inet_pton(AF_INET, addr, &server->sin.sin_addr))
+         {
+            break;
+         }
+         if (1 == inet_pton(AF_INET6, addr, &server->sin6.sin6_addr))
+         {
+            server->sin6.sin6_family = AF_INET6;
+            server->sin6.sin6_port = htons(DNS_PORT);
+            break;
+         }
+      }
+      fclose(fp);
+   }
+}
+
+//!
+//! Look a name up in the hosts file.
+//!
+//! @return  true if the name has an address of the family, otherwise false
+//!
+static bool dns_lookupHosts(char *name, int family, DNS_ADDR_T *addr)
+{
+   char line[256];
+   char *token;
+   char *savePtr;
+   DNS_ADDR_T hostAddr;
+   bool found = false;
+   FILE *fp;
+
+   fp = fopen(DNS_HOSTS_FILE, "r");
+   if (NULL == fp)
+   {
+      return false;
+   }
+   while (!found && (NULL != fgets(line, sizeof(line), fp)))
+   {
+      token = strchr(line, '#');
+      if (NULL != token)
+      {
+         *token = '\0';
+      }
+      token = strtok_r(line, " \t\r\n", &savePtr);
+      if ((NULL == token) || !dns_parseAddr(family, token, &hostAddr))
+      {
+         continue;
+      }
+      while (NULL != (token = strtok_r(NULL, " \t\r\n", &savePtr)))
+      {
+         if (0 == strcasecmp(token, name))
+         {
+            *addr = hostAddr;
+            found = true;
+            break;
+         }
+      }
+   }
+   fclose(fp);
+
+   return found;
+}
+
+//!
+//! Build an A or AAAA query for a name.
+//!
+//! @return  Query length in bytes, or -1 if the name is not valid
+//!
+static int dns_buildQuery(uint8_t *msg, uint16_t id, char *name, uint16_t type)
+{
+   uint8_t *p = msg + DNS_HEADER_LEN;
+   char *label = name;
+   char *dot;
+   size_t len;
+
+   memset(msg, 0, DNS_HEADER_LEN);
+   msg[0] = id >> 8;
+   msg[1] = id & 0xFF;
+   msg[2] = DNS_FLAG_RD >> 8;
+   msg[5] = 1;
+   while ('\0' != *label)
+   {
+      dot = strchr(label, '.');
+      len = (NULL != dot) ? (size_t)(dot - label) : strlen(label);
+      if ((0 == len) || (len > 63) || ((p - msg) + len + 6 > DNS_MSG_LEN))
+      {
+         return -1;
+      }
+      *p++ = len;
+      memcpy(p, label, len);
+      p += len;
+      label += len;
+      if ('.' == *label)
+      {
+         label++;
+      }
+   }
+   *p++ = 0;
+   *p++ = type >> 8;
+   *p++ = type & 0xFF;
+   *p++ = 0;
+   *p++ = DNS_CLASS_IN;
+
+   return (p - msg);
+}
+
+//!
+//! Get the query type of a record index.
+//!
+static uint16_t dns_getQueryType(int index)
+{
+   return (AF_INET6 == dnsFamilies[index]) ? DNS_TYPE_AAAA : DNS_TYPE_A;
+}
+
+//!
+//! Send the query of a cache record.
+//!
+static void dns_sendQuery(DNS_ENTRY_T *e, int index, uint32_t now)
+{
+   DNS_RECORD_T *r = &e->records[index];
+   uint8_t msg[DNS_MSG_LEN];
+   int len;
+
+   len = dns_buildQuery(msg, r->queryId, e->name, dns_getQueryType(index));
+   if (len < 0)
+   {
+      utils_sysLog(LOG_ERR, "DNS invalid name '%s'\n", e->name);
+      r->querying = false;
+      r->failed = true;
+      r->expires = now + DNS_NEGATIVE_TTL * 1000;
+      return;
+   }
+   if (send(dnsSocket, msg, len, 0) < 0)
+   {
+      utils_sysLog(LOG_ERR, "DNS send errno: %s\n", strerror(errno));
+   }
+   r->sentAt = now;
+   r->attempts++;
+}
+
+//!
+//! Find the record waiting for a response id.
+//!
+static DNS_ENTRY_T* dns_findQuery(uint16_t id, int *index)
+{
+   int i, j;
+
+   for (i = 0; i < DNS_CACHE_SIZE; i++)
+   {
+      for (j = 0; j < DNS_FAMILY_COUNT; j++)
+      {
+         if (dnsCache[i].records[j].querying && (dnsCache[i].records[j].queryId == id))
+         {
+            *index = j;
+            return &dnsCache[i];
+         }
+      }
+   }
+
+   return NULL;
+}
+
+//!
+//! Draw the id of a new query. The ids are random, so that a host that
+//! cannot see the queries cannot guess them to forge an answer, and none
+//! is given to two outstanding queries.
+//!
+static uint16_t dns_newId(void)
+{
+   static uint32_t state = 0;
+   uint16_t id;
+   int index;
+
+   do
+   {
+      if (getrandom(&id, sizeof(id), 0) != (ssize_t)sizeof(id))
+      {
+         /* Without the kernel source the ids are only hard to guess, not random */
+         if (0 == state)
+         {
+            state = ((uint32_t)getpid() << 16) ^ utils_getCurrentTimeMs() ^ 0x9E3779B9U;
+         }
+         state ^= state << 13;
+         state ^= state >> 17;
+         state ^= state << 5;
+         id = (uint16_t)(state >> 8);
+      }
+   }
+   while (NULL != dns_findQuery(id, &index));
+
+   return id;
+}
+
+//!
+//! Start a new query for a cache record.
+//!
+static void dns_startQuery(DNS_ENTRY_T *e, int index, uint32_t now)
+{
+   DNS_RECORD_T *r = &e->records[index];
+
+   if (!dns_init())
+   {
+      return;
+   }
+   r->queryId = dns_newId();
+   r->querying = true;
+   r->attempts = 0;
+   utils_sysLog(LOG_DEBUG, "DNS query %u type %u for %s\n", r->queryId, dns_getQueryType(index), e->name);
+   dns_sendQuery(e, index, now);
+}
+
+//!
+//! Skip a possibly compressed name in a DNS message.
+//!
+//! @return  Offset following the name, or -1 if the message is truncated
+//!
+static int dns_skipName(const uint8_t *msg, int len, int off)
+{
+   while (off < len)
+   {
+      if (0 == msg[off])
+      {
+         return off + 1;
+      }
+      if (0xC0 == (msg[off] & 0xC0))
+      {
+         return ((off + 2) <= len) ? (off + 2) : -1;
+      }
+      off += msg[off] + 1;
+   }
+
+   return -1;
+}
+
+//!
+//! Check that the question of a response matches the name and type of a
+//! record.
+//!
+static bool dns_questionMatches(const uint8_t *msg, int len, const char *name, uint16_t type)
+{
+   char qname[DNS_NAME_LEN];
+   int off = DNS_HEADER_LEN;
+   int pos = 0;
+   int labelLen;
+
+   while ((off < len) && (0 != msg[off]))
+   {
+      labelLen = msg[off++];
+      if ((0 != (labelLen & 0xC0)) || (off + labelLen > len) ||
+          (pos + labelLen + 1 >= DNS_NAME_LEN))
+      {
+         return false;
+      }
+      if (pos > 0)
+      {
+         qname[pos++] = '.';
+      }
+      memcpy(&qname[pos], &msg[off], labelLen);
+      pos += labelLen;
+      off += labelLen;
+   }
+   qname[pos] = '\0';
+   if ((off + 5) > len)
+   {
+      return false;
+   }
+
+   return ((0 == strcasecmp(qname, name)) && (type == ((msg[off + 1] << 8) | msg[off + 2])));
+}
+
+//!
+//! Apply a response to the cache record waiting for it.
+//!
+static void dns_handleResponse(const uint8_t *msg, int len)
+{
+   DNS_ENTRY_T *e;
+   DNS_RECORD_T *r;
+   char addrStr[INET6_ADDRSTRLEN];
+   uint32_t now = utils_getCurrentTimeMs();
+   uint32_t ttl = DNS_MAX_TTL;
+   uint16_t id, flags, qdCount, anCount;
+   uint16_t type, class, rdLen, qType;
+   size_t addrLen;
+   uint32_t rrTtl;
+   bool found = false;
+   int index = 0;
+   int off;
+   int i;
+
+   if (len < DNS_HEADER_LEN)
+   {
+      return;
+   }
+   id = (msg[0] << 8) | msg[1];
+   flags = (msg[2] << 8) | msg[3];
+   qdCount = (msg[4] << 8) | msg[5];
+   anCount = (msg[6] << 8) | msg[7];
+   e = dns_findQuery(id, &index);
+   qType = dns_getQueryType(index);
+   if ((NULL == e) || !(flags & DNS_FLAG_QR) || (1 != qdCount) ||
+       !dns_questionMatches(msg, len, e->name, qType))
+   {
+      utils_sysLog(LOG_DEBUG, "DNS unexpected response %u\n", id);
+      return;
+   }
+   r = &e->records[index];
+   r->querying = false;
+   if (DNS_RCODE_NXDOMAIN == (flags & DNS_RCODE_MASK))
+   {
+      utils_sysLog(LOG_INFO, "DNS name %s does not exist\n", e->name);
+      r->hasAddr = false;
+      r->failed = true;
+      r->expires = now + DNS_NEGATIVE_TTL * 1000;
+      return;
+   }
+   if (0 != (flags & DNS_RCODE_MASK))
+   {
+      /* Server failure, keep any stale answer and retry on the next lookup */
+      utils_sysLog(LOG_ERR, "DNS error %u for %s\n", flags & DNS_RCODE_MASK, e->name);
+      r->failed = !r->hasAddr;
+      r->expires = now;
+      return;
+   }
+   addrLen = (DNS_TYPE_AAAA == qType) ? sizeof(struct in6_addr) : sizeof(struct in_addr);
+   off = dns_skipName(msg, len, DNS_HEADER_LEN);
+   off = (off < 0) ? -1 : off + 4;
+   for (i = 0; (i < anCount) && (off > 0); i++)
+   {
+      off = dns_skipName(msg, len, off);
+      if ((off < 0) || (off + 10 > len))
+      {
+         break;
+      }
+      type = (msg[off] << 8) | msg[off + 1];
+      class = (msg[off + 2] << 8) | msg[off + 3];
+      rrTtl = ((uint32_t)msg[off + 4] << 24) | (msg[off + 5] << 16) | (msg[off + 6] << 8) | msg[off + 7];
+      rdLen = (msg[off + 8] << 8) | msg[off + 9];
+      off += 10;
+      if (off + rdLen > len)
+      {
+         break;
+      }
+      /* CNAME records are followed by the addresses of the canonical name */
+      if ((qType == type) && (DNS_CLASS_IN == class) && (addrLen == rdLen))
+      {
+         if (!found)
+         {
+            memset(&r->addr, 0, sizeof(DNS_ADDR_T));
+            r->addr.family = dnsFamilies[index];
+            memcpy(&r->addr.u, &msg[off], addrLen);
+         }
+         found = true;
+         if (rrTtl < ttl)
+         {
+            ttl = rrTtl;
+         }
+      }
+      off += rdLen;
+   }
+   if (found)
+   {
+      r->hasAddr = true;
+      r->failed = false;
+      r->expires = now + ttl * 1000;
+      utils_sysLog(LOG_DEBUG, "DNS %s is %s, ttl %u\n", e->name,
+                   dns_addrToString(&r->addr, addrStr, sizeof(addrStr)), ttl);
+   }
+   else
+   {
+      utils_sysLog(LOG_DEBUG, "DNS name %s has no type %u address\n", e->name, qType);
+      r->hasAddr = false;
+      r->failed = true;
+      r->expires = now + DNS_NEGATIVE_TTL * 1000;
+   }
+}
+
+//!
+//! Event loop callback of the resolver socket.
+//!
+static void dns_socketEvent(void *arg, uint32_t events)
+{
+   uint8_t msg[DNS_MSG_LEN];
+   ssize_t len;
+   bool answered = false;
+
+   for (;;)
+   {
+      len = recv(dnsSocket, msg, sizeof(msg), 0);
+      if (len < 0)
+      {
+         if ((EAGAIN != errno) && (EWOULDBLOCK != errno))
+         {
+            utils_sysLog(LOG_DEBUG, "DNS recv errno: %s\n", strerror(errno));
+            if (EINTR == errno)
+            {
+               continue;
+            }
+         }
+         break;
+      }
+      dns_handleResponse(msg, len);
+      answered = true;
+   }
+   if (answered && (NULL != dnsDoneCallback))
+   {
+      dnsDoneCallback();
+   }
+}
+
+//!
+//! Check whether any record of an entry has a query outstanding.
+//!
+static bool dns_isQuerying(const DNS_ENTRY_T *e)
+{
+   int i;
+
+   for (i = 0; i < DNS_FAMILY_COUNT; i++)
+   {
+      if (e->records[i].querying)
+      {
+         return true;
+      }
+   }
+
+   return false;
+}
+
+//!
+//! Find the cache entry of a name.
+//!
+static DNS_ENTRY_T* dns_findEntry(char *name)
+{
+   int i;
+
+   for (i = 0; i < DNS_CACHE_SIZE; i++)
+   {
+      if (('\0' != dnsCache[i].name[0]) && (0 == strcasecmp(dnsCache[i].name, name)))
+      {
+         return &dnsCache[i];
+      }
+   }
+
+   return NULL;
+}
+
+//!
+//! Find the cache entry of a name, or take a free or least recently used
+//! one for it.
+//!
+static DNS_ENTRY_T* dns_getEntry(char *name)
+{
+   DNS_ENTRY_T *e;
+   DNS_ENTRY_T *victim = NULL;
+   uint32_t now;
+   int i, j;
+
+   e = dns_findEntry(name);
+   if (NULL != e)
+   {
+      return e;
+   }
+   for (i = 0; i < DNS_CACHE_SIZE; i++)
+   {
+      e = &dnsCache[i];
+      if ('\0' == e->name[0])
+      {
+         victim = e;
+         break;
+      }
+      if (!dns_isQuerying(e) &&
+          ((NULL == victim) || ((int32_t)(e->lastUsed - victim->lastUsed) < 0)))
+      {
+         victim = e;
+      }
+   }
+   if (NULL != victim)
+   {
+      memset(victim, 0, sizeof(DNS_ENTRY_T));
+      strcpy(victim->name, name);
+      victim->preferred = AF_INET6;
+      now = utils_getCurrentTimeMs();
+      for (j = 0; j < DNS_FAMILY_COUNT; j++)
+      {
+         if (dns_lookupHosts(name, dnsFamilies[j], &victim->records[j].addr))
+         {
+            victim->records[j].hasAddr = true;
+            victim->records[j].expires = now + DNS_MAX_TTL * 1000;
+         }
+         else
+         {
+            victim->records[j].expires = now;
+         }
+      }
+   }
+
+   return victim;
+}
+
+//!
+//! Open the resolver socket and add it to the event loop.
+//!
+//! @return  true if the resolver is ready, otherwise false
+//!
+bool dns_init(void)
+{
+   DNS_SERVER_ADDR_T server;
+   char addrStr[INET6_ADDRSTRLEN];
+   socklen_t len;
+
+   if (dnsSocket >= 0)
+   {
+      return true;
+   }
+   dns_getServer(&server);
+   if (AF_INET6 == server.sa.sa_family)
+   {
+      len = sizeof(server.sin6);
+      inet_ntop(AF_INET6, &server.sin6.sin6_addr, addrStr, sizeof(addrStr));
+   }
+   else
+   {
+      len = sizeof(server.sin);
+      inet_ntop(AF_INET, &server.sin.sin_addr, addrStr, sizeof(addrStr));
+   }
+   dnsSocket = socket(server.sa.sa_family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+   if (dnsSocket < 0)
+   {
+      utils_sysLog(LOG_ERR, "DNS socket errno: %s\n", strerror(errno));
+      return false;
+   }
+   event_initHandler(&dnsHandler, dns_socketEvent, NULL);
+   if ((connect(dnsSocket, &server.sa, len) < 0) ||
+       !event_addHandler(&dnsHandler, dnsSocket, EPOLLIN))
+   {
+      utils_sysLog(LOG_ERR, "DNS server %s errno: %s\n", addrStr, strerror(errno));
+      close(dnsSocket);
+      dnsSocket = -1;
+      return false;
+   }
+   utils_sysLog(LOG_DEBUG, "DNS server %s\n", addrStr);
+
+   return true;
+}
+
+//!
+//! Look an address of one family up without blocking.
+//!
+//! IP address strings and names from the hosts file resolve at once. Other
+//! names are answered from the cache while their TTL lasts. Once the TTL
+//! has expired the stale answer is still returned while a new query
+//! refreshes it in the background, so a resolver hiccup does not stall
+//! the caller.
+//!
+//! @param[in] name  Host name or IP address string
+//! @param[in] family  AF_INET or AF_INET6
+//! @param[out] addr  Resolved address, valid when DNS_RESOLVED is returned
+//!
+//! @return  DNS_RESOLVED, DNS_PENDING while the first query is outstanding,
+//!          or DNS_FAILED
+//!
+DNS_STATUS_T dns_lookup(char *name, int family, DNS_ADDR_T *addr)
+{
+   DNS_ENTRY_T *e;
+   DNS_RECORD_T *r;
+   uint32_t now;
+   int index;
+   int i;
+
+   index = dns_getFamilyIndex(family);
+   if (index < 0)
+   {
+      return DNS_FAILED;
+   }
+   /* An address literal only resolves in its own family */
+   for (i = 0; i < DNS_FAMILY_COUNT; i++)
+   {
+      if (dns_parseAddr(dnsFamilies[i], name, addr))
+      {
+         return (i == index) ? DNS_RESOLVED : DNS_FAILED;
+      }
+   }
+   if (strlen(name) >= DNS_NAME_LEN)
+   {
+      return DNS_FAILED;
+   }
+   now = utils_getCurrentTimeMs();
+   e = dns_getEntry(name);
+   if (NULL == e)
+   {
+      utils_sysLog(LOG_ERR, "DNS cache full\n");
+      return DNS_FAILED;
+   }
+   e->lastUsed = now;
+   r = &e->records[index];
+   if (dns_isReached(r->expires, now) && !r->querying)
+   {
+      dns_startQuery(e, index, now);
+   }
+   if (r->hasAddr)
+   {
+      *addr = r->addr;
+      return DNS_RESOLVED;
+   }
+   /* A negative answer also stays in use while it is refreshed */
+   if (r->querying && !r->failed)
+   {
+      return DNS_PENDING;
+   }
+
+   return DNS_FAILED;
+}
+
+//!
+//! Set the function told when queries have been answered or given up, so
+//! that lookups left pending can be tried again without polling.
+//!
+//! @param[in] callback  Function to call, NULL for none
+//!
+void dns_setDoneCallback(DNS_DONE_CB_T callback)
+{
+   dnsDoneCallback = callback;
+}
+
+//!
+//! Start resolving the addresses of a name ahead of their first use.
+//!
+//! @param[in] name  Host name or IP address string
+//!
+void dns_prefetch(char *name)
+{
+   DNS_ADDR_T addr;
+   int i;
+
+   for (i = 0; i < DNS_FAMILY_COUNT; i++)
+   {
+      dns_lookup(name, dnsFamilies[i], &addr);
+   }
+}
+
+//!
+//! Get the address family to try first for a name.
+//!
+//! This is the family that won the last connection race to the host,
+//! IPv6 if the host has not been connected to yet.
+//!
+//! @param[in] name  Host name or IP address string
+//!
+//! @return  AF_INET or AF_INET6
+//!
+int dns_getPreferredFamily(char *name)
+{
+   DNS_ENTRY_T *e = dns_findEntry(name);
+
+   return (NULL != e) ? e->preferred : AF_INET6;
+}
+
+//!
+//! Remember the address family that connected first to a host.
+//!
+//! @param[in] name  Host name
+//! @param[in] family  AF_INET or AF_INET6
+//!
+void dns_setPreferredFamily(char *name, int family)
+{
+   DNS_ENTRY_T *e = dns_findEntry(name);
+
+   if ((NULL != e) && (e->preferred != family))
+   {
+      utils_sysLog(LOG_DEBUG, "DNS %s now prefers %s\n", name, (AF_INET6 == family) ? "IPv6" : "IPv4");
+      e->preferred = family;
+   }
+}
+
+//!
+//! Retransmit unanswered queries and give up after DNS_RETRY_LIMIT tries.
+//!
+//! @return  Milliseconds until the next retransmission, or 0xFFFFFFFF
+//!
+uint32_t dns_processTimers(void)
+{
+   DNS_RECORD_T *r;
+   uint32_t now = utils_getCurrentTimeMs();
+   uint32_t nearest = 0xFFFFFFFF;
+   uint32_t elapsed;
+   bool done = false;
+   int i, j;
+
+   for (i = 0; i < DNS_CACHE_SIZE; i++)
+   {
+      for (j = 0; j < DNS_FAMILY_COUNT; j++)
+      {
+         r = &dnsCache[i].records[j];
+         if (!r->querying)
+         {
+            continue;
+         }
+         elapsed = now - r->sentAt;
+         if (elapsed >= DNS_RETRY_MS)
+         {
+            if (r->attempts < DNS_RETRY_LIMIT)
+            {
+               dns_sendQuery(&dnsCache[i], j, now);
+               elapsed = 0;
+            }
+            else
+            {
+               /* No answer, keep any stale address and retry on the next lookup */
+               utils_sysLog(LOG_ERR, "DNS query for %s timed out\n", dnsCache[i].name);
+               r->querying = false;
+               r->failed = !r->hasAddr;
+               done = true;
+               continue;
+            }
+         }
+         if ((DNS_RETRY_MS - elapsed) < nearest)
+         {
+            nearest = DNS_RETRY_MS - elapsed;
+         }
+      }
+   }
+   if (done && (NULL != dnsDoneCallback))
+   {
+      dnsDoneCallback();
+   }
+
+   return nearest;
+}
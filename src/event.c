@@ -0,0 +1,276 @@
+//******************************************************************************
+//!
+//! Author:  Ying Xiong
+//! Created: Oct 2026
+//!
+//******************************************************************************
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include "event.h"
+#include "utils.h"
+#include "wheel.h"
+
+//
+// Local Variables
+//
+static int epollFd = -1;
+static struct epoll_event readyEvents[EVENT_MAX_EVENTS];
+static int readyCount = 0;
+static int readyIndex = 0;
+static EVENT_HANDLER_T wakeHandler;
+static WHEEL_T timers;
+
+//!
+//! Clear the wake up counter after it cut a wait short.
+//!
+static void event_wakeEvent(void *arg, uint32_t events)
+{
+   uint64_t count;
+
+   while (read(wakeHandler.fd, &count, sizeof(count)) > 0)
+   {
+   }
+}
+
+//!
+//! Create the eventfd that cuts the wait short to wake up the loop at once.
+//!
+static void event_initWakeUp(void)
+{
+   int fd;
+
+   event_initHandler(&wakeHandler, event_wakeEvent, NULL);
+   fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+   if ((fd < 0) || !event_addHandler(&wakeHandler, fd, EPOLLIN))
+   {
+      utils_sysLog(LOG_ERR, "eventfd errno: %s\n", strerror(errno));
+   }
+}
+
+//!
+//! Create the epoll instance shared by all event handlers.
+//!
+//! @return  true if the event loop is ready, otherwise false
+//!
+bool event_init(void)
+{
+   if (epollFd < 0)
+   {
+      epollFd = epoll_create1(EPOLL_CLOEXEC);
+      if (epollFd < 0)
+      {
+         utils_sysLog(LOG_ERR, "epoll create errno: %s\n", strerror(errno));
+      }
+      else
+      {
+         event_initWakeUp();
+         wheel_init(&timers, utils_getCurrentTimeMs());
+      }
+   }
+
+   return (epollFd >= 0);
+}
+
+//!
+//! Cut the current or next wait for events short.
+//!
+//! Safe to call from a signal handler.
+//!
+void event_wake(void)
+{
+   uint64_t one = 1;
+
+   if (wakeHandler.registered && (write(wakeHandler.fd, &one, sizeof(one)) < 0))
+   {
+      /* The counter is only full when the loop is already woken up */
+   }
+}
+
+//!
+//! Run a timer of the loop after a delay, replacing the delay it had if
+//! it is pending. Any number of timers wake the loop up once, when the
+//! first of them is due.
+//!
+//! @param[in] timer    Timer initialized with wheel_initTimer()
+//! @param[in] delayMs  Delay in milliseconds, 0 runs it on the next wait
+//!
+void event_addTimer(WHEEL_TIMER_T *timer, uint32_t delayMs)
+{
+   if (event_init())
+   {
+      wheel_add(&timers, timer, utils_getCurrentTimeMs() + delayMs);
+   }
+}
+
+//!
+//! Cancel a timer of the loop if it is pending.
+//!
+void event_cancelTimer(WHEEL_TIMER_T *timer)
+{
+   wheel_cancel(&timers, timer);
+}
+
+//!
+//! Initialize an event handler that is not yet watching any descriptor.
+//!
+//! @param[out] h  Pointer to event handler
+//! @param[in] callback  Function called when the descriptor is ready
+//! @param[in] arg  Argument passed back to the callback
+//!
+void event_initHandler(EVENT_HANDLER_T *h, EVENT_CALLBACK_T callback, void *arg)
+{
+   h->fd = -1;
+   h->events = 0;
+   h->registered = false;
+   h->callback = callback;
+   h->arg = arg;
+}
+
+//!
+//! Start watching a descriptor.
+//!
+//! @param[in] h  Pointer to event handler
+//! @param[in] fd  Descriptor to watch
+//! @param[in] events  Initial epoll interest set
+//!
+//! @return  true if the descriptor was added, otherwise false
+//!
+bool event_addHandler(EVENT_HANDLER_T *h, int fd, uint32_t events)
+{
+   struct epoll_event ev;
+
+   if (!event_init())
+   {
+      return false;
+   }
+   memset(&ev, 0, sizeof(ev));
+   ev.events = events;
+   ev.data.ptr = h;
+   if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) < 0)
+   {
+      utils_sysLog(LOG_ERR, "epoll add errno: %s\n", strerror(errno));
+      return false;
+   }
+   h->fd = fd;
+   h->events = events;
+   h->registered = true;
+
+   return true;
+}
+
+//!
+//! Change the interest set of a watched descriptor.
+//!
+//! Nothing is done when the interest set is unchanged, so this can be called
+//! after every status change without an extra system call.
+//!
+//! @param[in] h  Pointer to event handler
+//! @param[in] events  New epoll interest set
+//!
+//! @return  true if the handler is watching with the new set, otherwise false
+//!
+bool event_modifyHandler(EVENT_HANDLER_T *h, uint32_t events)
+{
+   struct epoll_event ev;
+
+   if (!h->registered)
+   {
+      return false;
+   }
+   if (h->events != events)
+   {
+      memset(&ev, 0, sizeof(ev));
+      ev.events = events;
+      ev.data.ptr = h;
+      if (epoll_ctl(epollFd, EPOLL_CTL_MOD, h->fd, &ev) < 0)
+      {
+         utils_sysLog(LOG_ERR, "epoll modify errno: %s\n", strerror(errno));
+         return false;
+      }
+      h->events = events;
+   }
+
+   return true;
+}
+
+//!
+//! Stop watching a descriptor.
+//!
+//! Must be called before the descriptor is closed. Events for this handler
+//! that are still queued in the current dispatch batch are dropped.
+//!
+//! @param[in] h  Pointer to event handler
+//!
+void event_removeHandler(EVENT_HANDLER_T *h)
+{
+   int i;
+
+   if (h->registered)
+   {
+      epoll_ctl(epollFd, EPOLL_CTL_DEL, h->fd, NULL);
+      for (i = readyIndex; i < readyCount; i++)
+      {
+         if (readyEvents[i].data.ptr == h)
+         {
+            readyEvents[i].data.ptr = NULL;
+         }
+      }
+      h->registered = false;
+   }
+   h->fd = -1;
+   h->events = 0;
+}
+
+//!
+//! Wait for readiness on all watched descriptors and run the callbacks,
+//! then those of the timers that are due. The wait ends when the first
+//! timer is due.
+//!
+//! @param[in] timeoutMs  Maximum wait in milliseconds (-1 = forever)
+//!
+//! @return  Number of events dispatched, or -1 on error
+//!
+int event_wait(int timeoutMs)
+{
+   EVENT_HANDLER_T *h;
+   uint32_t due;
+   int count;
+
+   if (!event_init())
+   {
+      return -1;
+   }
+   due = wheel_nextDue(&timers, utils_getCurrentTimeMs());
+   if ((WHEEL_NO_TIMER != due) && ((timeoutMs < 0) || (due < (uint32_t)timeoutMs)))
+   {
+      timeoutMs = (int)due;
+   }
+   count = epoll_wait(epollFd, readyEvents, EVENT_MAX_EVENTS, timeoutMs);
+   if (count < 0)
+   {
+      /* Interrupted, e.g. to run io_uring completion work, nothing to dispatch */
+      if (EINTR == errno)
+      {
+         return 0;
+      }
+      utils_sysLog(LOG_ERR, "epoll wait errno: %s\n", strerror(errno));
+      return -1;
+   }
+   readyCount = count;
+   for (readyIndex = 0; readyIndex < readyCount; readyIndex++)
+   {
+      h = readyEvents[readyIndex].data.ptr;
+      if ((NULL != h) && (NULL != h->callback))
+      {
+         h->callback(h->arg, readyEvents[readyIndex].events);
+      }
+   }
+   readyCount = 0;
+   readyIndex = 0;
+   wheel_advance(&timers, utils_getCurrentTimeMs());
+
+   return count;
+}
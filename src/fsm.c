@@ -0,0 +1,143 @@
+//******************************************************************************
+//!
+//! Author:  Ying Xiong
+//! Created: Oct 2026
+//!
+//******************************************************************************
+
+#include "private.h"
+#include "task.h"
+
+//
+// Transition Tables
+//
+static const FSM_TRANS_CONFIG_T init_state_trans_config[] =
+{
+   { FSM_IDLE_STATE, FSM_INPUT_INITIALIZED | FSM_INPUT_RUN,
+                     FSM_INPUT_INITIALIZED | FSM_INPUT_RUN, NULL },
+   { FSM_TRANS_END, 0, 0, NULL }
+};
+
+static const FSM_TRANS_CONFIG_T idle_state_trans_config[] =
+{
+   { FSM_SEND_STATE, FSM_INPUT_INITIALIZED | FSM_INPUT_SENDING | FSM_INPUT_RUN,
+                     FSM_INPUT_INITIALIZED | FSM_INPUT_SENDING | FSM_INPUT_RUN, idle_state_to_send_state1 },
+   { FSM_INIT_STATE, FSM_INPUT_INITIALIZED, FSM_INPUT_INITIALIZED | FSM_INPUT_RUN, NULL },
+   { FSM_INIT_STATE, 0, FSM_INPUT_INITIALIZED, NULL },
+   { FSM_TRANS_END, 0, 0, NULL }
+};
+
+static const FSM_TRANS_CONFIG_T send_state_trans_config[] =
+{
+   { FSM_INIT_STATE, FSM_INPUT_INITIALIZED, FSM_INPUT_INITIALIZED | FSM_INPUT_RUN, NULL },
+   { FSM_INIT_STATE, 0, FSM_INPUT_INITIALIZED, NULL },
+   { FSM_IDLE_STATE, 0, FSM_INPUT_SENDING, NULL },
+   { FSM_IDLE_STATE, FSM_INPUT_SESSION_ERROR, FSM_INPUT_SESSION_ERROR, NULL },
+   { FSM_TRANS_END, 0, 0, NULL }
+};
+
+//
+// State Table, indexed by state
+//
+static const FSM_STATE_CONFIG_T fsm_state_config[] =
+{
+   { init_state_entry, init_state_act, NULL, init_state_trans_config },
+   { idle_state_entry, idle_state_act, NULL, idle_state_trans_config },
+   { send_state_entry, send_state_act, send_state_exit, send_state_trans_config }
+};
+
+const FSM_CONFIG_T fsm_config =
+{
+   FSM_INIT_STATE,
+   fsm_state_config,
+   fsm_process_inputs,
+   NULL
+};
+
+//
+// Actions, run on the task of the instance
+//
+void init_state_entry(void *context)
+{
+   task_initEntry(context);
+}
+
+void idle_state_entry(void *context)
+{
+   task_idleEntry(context);
+}
+
+void send_state_entry(void *context)
+{
+   task_sendEntry(context);
+}
+
+void init_state_act(void *context)
+{
+   task_initActivity(context);
+}
+
+void idle_state_act(void *context)
+{
+   task_idleActivity(context);
+}
+
+void send_state_act(void *context)
+{
+   task_sendActivity(context);
+}
+
+void send_state_exit(void *context)
+{
+   task_sendExit(context);
+}
+
+void idle_state_to_send_state1(void *context)
+{
+   task_resetSessionStatus(context);
+}
+
+//!
+//! Set the input word from the task, keeping the bits of expired timers
+//!
+void fsm_process_inputs(uint32_t *input_word, void *context)
+{
+   TASK_T *t = context;
+
+   *input_word &= FSM_TIMER_INPUT_MASK;
+   if (t->initialized)
+   {
+      SET_INP_BIT(*input_word, FSM_INPUT_INITIALIZED);
+   }
+   if (t->dataSending)
+   {
+      SET_INP_BIT(*input_word, FSM_INPUT_SENDING);
+   }
+   if ((t->state == FSM_SEND_STATE) && task_checkSessionError(t))
+   {
+      SET_INP_BIT(*input_word, FSM_INPUT_SESSION_ERROR);
+   }
+   SET_INP_BIT(*input_word, FSM_INPUT_RUN);
+}
+
+//!
+//! Start the state machine of a task, which enters the INIT state on the
+//! first run
+//!
+//! @param[in] workspace  Workspace of the task
+//! @param[in] context    Task passed to the actions
+//!
+void fsm_start(FSM_WORKSPACE_T *workspace, void *context)
+{
+   fsm_init(workspace, &fsm_config, context);
+}
+
+//!
+//! Run the state machine of a task once
+//!
+//! @param[in] workspace  Workspace of the task
+//!
+void fsm_run(FSM_WORKSPACE_T *workspace)
+{
+   fsm_process(workspace, &fsm_config);
+}
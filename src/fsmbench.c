@@ -0,0 +1,215 @@
+/***************************************************************************************************
+ *  @file fsmbench.c
+ *    Compare the state machine engine in rhapsody.h with the prebuilt libfsm.so in transitions
+ *    per second, the engine running the INIT, IDLE and SEND tables of fsm.c
+ *
+ *  @author:     Ying Xiong
+ *  @created:    Oct, 2026
+ ***************************************************************************************************/
+
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "private.h"
+#include "task.h"
+
+#define BENCH_TRANS_DEF     10000000
+#define BENCH_INSTANCE_DEF  1024
+
+//
+// Global Variables, the task of libfsm.so, which links to these
+//
+int fsm_state = FSM_INIT_STATE;
+bool initialized = false;
+bool data_sending = false;
+static uint64_t lib_transitions;
+
+void initEntry(void)    { fsm_state = FSM_INIT_STATE; }
+void initActivity(void) { initialized = true; }
+void idleEntry(void)    { fsm_state = FSM_IDLE_STATE; lib_transitions++; }
+void idleActivity(void) { data_sending = true; }
+void sendEntry(void)    { fsm_state = FSM_SEND_STATE; lib_transitions++; }
+void sendActivity(void) { data_sending = false; }
+void sendExit(void)     { }
+void resetSessionStatus(void) { }
+bool checkSessionError(void)  { return false; }
+
+//
+// Task actions run by the tables of fsm.c, the engine that ships, which
+// only move the task from state to state
+//
+static uint64_t engine_transitions;
+
+void task_initEntry(TASK_T *t)    { t->state = FSM_INIT_STATE; }
+void task_initActivity(TASK_T *t) { t->initialized = true; }
+void task_idleEntry(TASK_T *t)    { t->state = FSM_IDLE_STATE; engine_transitions++; }
+void task_idleActivity(TASK_T *t) { t->dataSending = true; }
+void task_sendEntry(TASK_T *t)    { t->state = FSM_SEND_STATE; engine_transitions++; }
+void task_sendActivity(TASK_T *t) { t->dataSending = false; }
+void task_sendExit(TASK_T *t)     { (void)t; }
+void task_resetSessionStatus(TASK_T *t) { (void)t; }
+bool task_checkSessionError(TASK_T *t)  { (void)t; return false; }
+
+//!
+//! Get a monotonic time in seconds
+//!
+static double now(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+//!
+//! Print the rate of a run
+//!
+static void report(const char *name, uint64_t transitions, double seconds)
+{
+   printf("%-28s %12llu transitions %8.3f s %14.0f transitions/s\n", name,
+          (unsigned long long)transitions, seconds, transitions / seconds);
+}
+
+//!
+//! Run the state machine of libfsm.so, which has one workspace
+//!
+//! @return Transitions per second, 0 if the library cannot be loaded
+//!
+static double benchLibrary(const char *path, uint64_t count)
+{
+   void (*libInit)(const void *config);
+   void (*libProcess)(const void *config);
+   const void *config;
+   void *lib;
+   double start;
+   double seconds;
+
+   /* The library keeps its own tables, named as those of fsm.c */
+   lib = dlopen(path, RTLD_NOW | RTLD_DEEPBIND);
+   if (lib == NULL)
+   {
+      printf("%-28s not run, %s\n", "libfsm.so", dlerror());
+      return 0;
+   }
+   libInit = (void (*)(const void *))dlsym(lib, "fsm_init");
+   libProcess = (void (*)(const void *))dlsym(lib, "fsm_process");
+   config = dlsym(lib, "fsm_config");
+   if ((libInit == NULL) || (libProcess == NULL) || (config == NULL))
+   {
+      printf("%-28s not run, %s\n", "libfsm.so", "no state machine in it");
+      dlclose(lib);
+      return 0;
+   }
+
+   libInit(config);
+   start = now();
+   while (lib_transitions < count)
+   {
+      libProcess(config);
+   }
+   seconds = now() - start;
+   report("libfsm.so", lib_transitions, seconds);
+   dlclose(lib);
+   return lib_transitions / seconds;
+}
+
+//!
+//! Run the state machines of a number of instances of the engine in turn
+//!
+//! @return Transitions per second
+//!
+static double benchEngine(const char *name, int instances, uint64_t count)
+{
+   TASK_T *t;
+   uint64_t runs = 0;
+   double start;
+   double seconds;
+   int i;
+
+   t = calloc(instances, sizeof(TASK_T));
+   if (t == NULL)
+   {
+      printf("%-28s not run, out of memory\n", name);
+      return 0;
+   }
+   for (i = 0; i < instances; i++)
+   {
+      fsm_start(&t[i].workspace, &t[i]);
+   }
+
+   engine_transitions = 0;
+   start = now();
+   while (runs < count)
+   {
+      for (i = 0; i < instances; i++)
+      {
+         fsm_run(&t[i].workspace);
+      }
+      runs += instances;
+   }
+   seconds = now() - start;
+
+   report(name, engine_transitions, seconds);
+   free(t);
+   return engine_transitions / seconds;
+}
+
+//!
+//! Display program options
+//!
+static void usage(char *arg)
+{
+   printf("Usage: %s [-h] [-i <>] [-l <>] [-n <>]\n", arg);
+   printf("  -h  display this usage\n");
+   printf("  -i  <instances>, run the engine on this many workspaces in turn, default %d\n", BENCH_INSTANCE_DEF);
+   printf("  -l  <libfsm.so path>, default libfsm.so from the library path\n");
+   printf("  -n  <transitions>, default %d\n", BENCH_TRANS_DEF);
+}
+
+//!
+//! Main function
+//!
+int main(int argc, char* argv[])
+{
+   const char *path = "libfsm.so";
+   uint64_t count = BENCH_TRANS_DEF;
+   int instances = BENCH_INSTANCE_DEF;
+   double lib;
+   double engine;
+   int c;
+
+   while ((c = getopt(argc, argv, "hi:l:n:")) >= 0)
+   {
+      switch (c)
+      {
+         case 'i':
+            instances = atoi(optarg);
+            break;
+         case 'l':
+            path = optarg;
+            break;
+         case 'n':
+            count = strtoull(optarg, NULL, 10);
+            break;
+         default:
+            usage(argv[0]);
+            return -1;
+      }
+   }
+   if ((optind < argc) || (instances <= 0) || (count == 0))
+   {
+      usage(argv[0]);
+      return -1;
+   }
+
+   lib = benchLibrary(path, count);
+   engine = benchEngine("engine, 1 instance", 1, count);
+   benchEngine("engine, many instances", instances, count);
+   if (lib > 0)
+   {
+      printf("engine / libfsm.so: %.2f\n", engine / lib);
+   }
+   return 0;
+}
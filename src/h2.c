@@ -0,0 +1,984 @@
+//******************************************************************************
+//!
+//! Author:  Ying Xiong
+//! Created: Oct 2026
+//!
+//******************************************************************************
+
+#define _GNU_SOURCE
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "h2.h"
+#include "utils.h"
+
+//
+// Local Defines
+//
+#define H2_PREFACE_STR       "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n"
+#define H2_SCHEME_STR        "http"
+#define H2_REQUEST_LEN       (8192)
+#define H2_DEFAULT_WINDOW    (65535)
+#define H2_SETTING_LEN       (6)
+#define H2_PING_LEN          (8)
+#define H2_PRIORITY_LEN      (5)
+
+#define H2_DATA              (0x0)
+#define H2_HEADERS           (0x1)
+#define H2_PRIORITY          (0x2)
+#define H2_RST_STREAM        (0x3)
+#define H2_SETTINGS          (0x4)
+#define H2_PUSH_PROMISE      (0x5)
+#define H2_PING              (0x6)
+#define H2_GOAWAY            (0x7)
+#define H2_WINDOW_UPDATE     (0x8)
+#define H2_CONTINUATION      (0x9)
+
+#define H2_FLAG_END_STREAM   (0x01)
+#define H2_FLAG_ACK          (0x01)
+#define H2_FLAG_END_HEADERS  (0x04)
+#define H2_FLAG_PADDED       (0x08)
+#define H2_FLAG_PRIORITY     (0x20)
+
+#define H2_SETTINGS_HEADER_TABLE_SIZE    (0x1)
+#define H2_SETTINGS_ENABLE_PUSH          (0x2)
+#define H2_SETTINGS_INITIAL_WINDOW_SIZE  (0x4)
+
+//
+// Function Prototypes
+//
+static size_t h2_putFrameHeader(uint8_t *out, uint32_t len, uint8_t type, uint8_t flags, uint32_t id);
+static size_t h2_putWindowUpdate(uint8_t *out, uint32_t id, uint32_t increment);
+static int h2_frameRequests(H2_T *c, char *buf, int len, int bufLen);
+static int h2_encodeRequest(H2_T *c, const char *req, const char *end, uint8_t *out, size_t outLen);
+static bool h2_frameStart(H2_T *c);
+static bool h2_frameEnd(H2_T *c);
+static bool h2_dataBytes(H2_T *c, const char *data, size_t len);
+static bool h2_headerFragment(H2_T *c, const uint8_t *data, size_t len);
+static bool h2_headerBlock(H2_T *c);
+static bool h2_settings(H2_T *c);
+static bool h2_goaway(H2_T *c);
+static void h2_field(void *arg, const char *name, size_t nameLen, const char *value, size_t valueLen);
+static void h2_deliver(H2_T *c);
+static int h2_nextStream(const H2_T *c);
+static void h2_dropHeld(H2_T *c);
+static void h2_grantWindows(H2_T *c);
+static int h2_streamIndex(const H2_T *c, uint32_t id);
+static bool h2_fail(H2_T *c, const char *reason);
+
+//!
+//! Get a connection ready for its first transaction. Called for each new
+//! TCP connection, as the header tables and stream identifiers belong to
+//! the connection. The structure must be zeroed before its first use.
+//!
+//! @param[out] c  Pointer to HTTP/2 connection
+//! @param[in] name  Connection name for debug printing
+//! @param[in] headersCb  Called with the header of each response
+//! @param[in] dataCb  Called with the payload of each response
+//! @param[in] endCb  Called as each response completes
+//! @param[in] writeCb  Called with frames to send while receiving
+//! @param[in] arg  Argument passed back to the callbacks
+//!
+void h2_init(H2_T *c, const char *name, H2_HEADERS_CB_T headersCb, H2_DATA_CB_T dataCb,
+             H2_END_CB_T endCb, H2_WRITE_CB_T writeCb, void *arg)
+{
+   h2_dropHeld(c);
+   c->name = name;
+   c->prefaceSent = false;
+   c->ackPending = false;
+   c->goaway = false;
+   hpack_initTable(&c->encoder, HPACK_TABLE_LEN);
+   hpack_initTable(&c->decoder, HPACK_TABLE_LEN);
+   c->tableLimit = HPACK_TABLE_LEN;
+   c->tableUpdate = false;
+   c->nextId = 1;
+   c->firstId = 1;
+   c->streamCount = 0;
+   c->current = -1;
+   c->headerLen = 0;
+   c->blockLen = 0;
+   c->blockId = 0;
+   c->connConsumed = 0;
+   c->headersCb = headersCb;
+   c->dataCb = dataCb;
+   c->endCb = endCb;
+   c->writeCb = writeCb;
+   c->arg = arg;
+}
+
+//!
+//! Turn the pipelined HTTP/1.1 requests of a send buffer into the frames
+//! of one HTTP/2 stream each, in place.
+//!
+//! The request line and Host header become pseudo-header fields, header
+//! names are put in lower case and the fields that only apply to an
+//! HTTP/1.1 connection are dropped. The first transaction of a connection
+//! starts with the connection preface. Requests with a body are not
+//! supported.
+//!
+//! Requests that cannot be sent leave the connection as it was, so that
+//! its header table and stream identifiers stay in step with the server
+//! if it is used again.
+//!
+//! @param[in,out] c  Pointer to HTTP/2 connection
+//! @param[in,out] buf  Send buffer holding the requests
+//! @param[in] len  Length of the requests
+//! @param[in] bufLen  Size of the send buffer
+//!
+//! @return  Length of the frames, or -1 if the requests cannot be sent
+//!
+int h2_request(H2_T *c, char *buf, int len, int bufLen)
+{
+   HPACK_TABLE_T encoder = c->encoder;
+   bool prefaceSent = c->prefaceSent;
+   bool ackPending = c->ackPending;
+   bool tableUpdate = c->tableUpdate;
+   uint32_t connConsumed = c->connConsumed;
+   uint32_t nextId = c->nextId;
+   int n;
+
+   n = h2_frameRequests(c, buf, len, bufLen);
+   if (n < 0)
+   {
+      /* The server never sees the fields added to the table or the frames owed */
+      c->encoder = encoder;
+      c->prefaceSent = prefaceSent;
+      c->ackPending = ackPending;
+      c->tableUpdate = tableUpdate;
+      c->connConsumed = connConsumed;
+      c->nextId = nextId;
+      c->firstId = nextId;
+      c->streamCount = 0;
+      c->current = -1;
+   }
+
+   return n;
+}
+
+//!
+//! Write the frames of the requests of a send buffer over it, see
+//! h2_request().
+//!
+//! @return  Length of the frames, or -1 if the requests cannot be sent
+//!
+static int h2_frameRequests(H2_T *c, char *buf, int len, int bufLen)
+{
+   uint8_t out[H2_REQUEST_LEN];
+   const char *req = buf;
+   const char *end = buf + len;
+   const char *next;
+   size_t n = 0;
+   int used;
+   int i;
+
+   if (!c->prefaceSent)
+   {
+      memcpy(out, H2_PREFACE_STR, strlen(H2_PREFACE_STR));
+      n += strlen(H2_PREFACE_STR);
+      /* No pushed streams, and no more payload held per stream than its buffer */
+      n += h2_putFrameHeader(&out[n], 2 * H2_SETTING_LEN, H2_SETTINGS, 0, 0);
+      out[n++] = 0;
+      out[n++] = H2_SETTINGS_ENABLE_PUSH;
+      memset(&out[n], 0, 4);
+      n += 4;
+      out[n++] = 0;
+      out[n++] = H2_SETTINGS_INITIAL_WINDOW_SIZE;
+      out[n++] = (uint8_t)(H2_STREAM_WINDOW >> 24);
+      out[n++] = (uint8_t)(H2_STREAM_WINDOW >> 16);
+      out[n++] = (uint8_t)(H2_STREAM_WINDOW >> 8);
+      out[n++] = (uint8_t)H2_STREAM_WINDOW;
+      n += h2_putWindowUpdate(&out[n], 0, H2_WINDOW_LEN - H2_DEFAULT_WINDOW);
+      c->prefaceSent = true;
+   }
+   if (c->ackPending)
+   {
+      n += h2_putFrameHeader(&out[n], 0, H2_SETTINGS, H2_FLAG_ACK, 0);
+      c->ackPending = false;
+   }
+   if (c->connConsumed > 0)
+   {
+      /* Granted again here when it could not be sent with the last responses */
+      n += h2_putWindowUpdate(&out[n], 0, c->connConsumed);
+      c->connConsumed = 0;
+   }
+   h2_dropHeld(c);
+   c->firstId = c->nextId;
+   c->streamCount = 0;
+   c->current = -1;
+   while (req < end)
+   {
+      next = memmem(req, end - req, "\r\n\r\n", 4);
+      if (NULL == next)
+      {
+         utils_sysLog(LOG_ERR, "%s>> HTTP/2 request is not complete\n", c->name);
+         return -1;
+      }
+      next += 4;
+      if (c->streamCount >= H2_STREAM_MAX)
+      {
+         utils_sysLog(LOG_ERR, "%s>> HTTP/2 allows %d requests at once\n", c->name, H2_STREAM_MAX);
+         return -1;
+      }
+      used = h2_encodeRequest(c, req, next, &out[n], sizeof(out) - n);
+      if (used < 0)
+      {
+         return -1;
+      }
+      n += used;
+      i = c->streamCount++;
+      parse_initResponse(&c->streams[i].response);
+      c->streams[i].headers = false;
+      c->streams[i].ended = false;
+      c->streams[i].done = false;
+      c->streams[i].received = 0;
+      c->streams[i].granted = H2_STREAM_WINDOW;
+      c->nextId += 2;
+      req = next;
+   }
+   if (n > (size_t)bufLen)
+   {
+      utils_sysLog(LOG_ERR, "%s>> HTTP/2 frames do not fit the send buffer\n", c->name);
+      return -1;
+   }
+   memcpy(buf, out, n);
+
+   return n;
+}
+
+//!
+//! Parse the next bytes received on the connection.
+//!
+//! Frames may be split across calls. The payload of the response being
+//! passed on goes to the data callback as it arrives, without being
+//! collected, and its flow control window is granted again as it is
+//! consumed. The payload of the other responses is held until their turn.
+//!
+//! @param[in,out] c  Pointer to HTTP/2 connection
+//! @param[in] data  Newly arrived bytes
+//! @param[in] len  Number of newly arrived bytes
+//!
+//! @return  false on a connection or stream error, otherwise true
+//!
+bool h2_recv(H2_T *c, const char *data, size_t len)
+{
+   size_t n;
+
+   while (len > 0)
+   {
+      if (c->headerLen < H2_FRAME_HEADER_LEN)
+      {
+         n = H2_FRAME_HEADER_LEN - c->headerLen;
+         n = (n < len) ? n : len;
+         memcpy(&c->header[c->headerLen], data, n);
+         c->headerLen += n;
+         data += n;
+         len -= n;
+         if (c->headerLen < H2_FRAME_HEADER_LEN)
+         {
+            break;
+         }
+         if (!h2_frameStart(c) || ((0 == c->frameLen) && !h2_frameEnd(c)))
+         {
+            return false;
+         }
+         continue;
+      }
+      n = c->frameLen - c->payloadLen;
+      n = (n < len) ? n : len;
+      if (H2_DATA == c->frameType)
+      {
+         if (!h2_dataBytes(c, data, n))
+         {
+            return false;
+         }
+      }
+      else
+      {
+         memcpy(&c->payload[c->payloadLen], data, n);
+      }
+      c->payloadLen += n;
+      data += n;
+      len -= n;
+      if ((c->payloadLen == c->frameLen) && !h2_frameEnd(c))
+      {
+         return false;
+      }
+   }
+   h2_grantWindows(c);
+
+   return true;
+}
+
+//!
+//! Write a frame header.
+//!
+//! @return  Bytes written
+//!
+static size_t h2_putFrameHeader(uint8_t *out, uint32_t len, uint8_t type, uint8_t flags, uint32_t id)
+{
+   out[0] = (uint8_t)(len >> 16);
+   out[1] = (uint8_t)(len >> 8);
+   out[2] = (uint8_t)len;
+   out[3] = type;
+   out[4] = flags;
+   out[5] = (uint8_t)((id >> 24) & 0x7f);
+   out[6] = (uint8_t)(id >> 16);
+   out[7] = (uint8_t)(id >> 8);
+   out[8] = (uint8_t)id;
+
+   return H2_FRAME_HEADER_LEN;
+}
+
+//!
+//! Write a WINDOW_UPDATE frame.
+//!
+//! @return  Bytes written
+//!
+static size_t h2_putWindowUpdate(uint8_t *out, uint32_t id, uint32_t increment)
+{
+   size_t n;
+
+   n = h2_putFrameHeader(out, 4, H2_WINDOW_UPDATE, 0, id);
+   out[n++] = (uint8_t)((increment >> 24) & 0x7f);
+   out[n++] = (uint8_t)(increment >> 16);
+   out[n++] = (uint8_t)(increment >> 8);
+   out[n++] = (uint8_t)increment;
+
+   return n;
+}
+
+//!
+//! Encode one HTTP/1.1 request as the HEADERS frame of the next stream.
+//!
+//! @return  Bytes written, or -1 if the request cannot be sent
+//!
+static int h2_encodeRequest(H2_T *c, const char *req, const char *end, uint8_t *out, size_t outLen)
+{
+   uint8_t *block = &out[H2_FRAME_HEADER_LEN];
+   size_t room = outLen - H2_FRAME_HEADER_LEN;
+   size_t blockLen = 0;
+   char name[PARSE_LINE_LEN];
+   const char *line;
+   const char *lineEnd;
+   const char *sp;
+   const char *target;
+   const char *value;
+   const char *authority = "";
+   size_t authorityLen = 0;
+   size_t nameLen;
+   size_t n;
+   size_t i;
+   bool skip;
+
+   if (outLen < H2_FRAME_HEADER_LEN)
+   {
+      return -1;
+   }
+   /* The request line, "<method> <target> HTTP/1.1" */
+   lineEnd = memmem(req, end - req, "\r\n", 2);
+   sp = memchr(req, ' ', lineEnd - req);
+   target = (NULL != sp) ? (sp + 1) : NULL;
+   if ((NULL == target) || (NULL == memchr(target, ' ', lineEnd - target)))
+   {
+      utils_sysLog(LOG_ERR, "%s>> HTTP/2 request line is malformed\n", c->name);
+      return -1;
+   }
+   /* Pseudo-header fields come first, so the Host header is looked up ahead */
+   for (line = lineEnd + 2; line < end - 2; line = lineEnd + 2)
+   {
+      lineEnd = memmem(line, end - line, "\r\n", 2);
+      if ((lineEnd - line > 5) && (0 == strncasecmp(line, "Host:", 5)))
+      {
+         for (authority = line + 5; ' ' == *authority; authority++)
+         {
+         }
+         authorityLen = lineEnd - authority;
+      }
+   }
+   if (c->tableUpdate)
+   {
+      blockLen += hpack_encodeSizeUpdate(&c->encoder, block, room, c->tableLimit);
+      c->tableUpdate = false;
+   }
+   n = hpack_encodeField(&c->encoder, &block[blockLen], room - blockLen, ":method", 7, req, sp - req);
+   blockLen = (n > 0) ? (blockLen + n) : room;
+   n = hpack_encodeField(&c->encoder, &block[blockLen], room - blockLen, ":scheme", 7,
+                         H2_SCHEME_STR, strlen(H2_SCHEME_STR));
+   blockLen = (n > 0) ? (blockLen + n) : room;
+   n = hpack_encodeField(&c->encoder, &block[blockLen], room - blockLen, ":authority", 10,
+                         authority, authorityLen);
+   blockLen = (n > 0) ? (blockLen + n) : room;
+   lineEnd = memmem(req, end - req, "\r\n", 2);
+   n = hpack_encodeField(&c->encoder, &block[blockLen], room - blockLen, ":path", 5,
+                         target, (const char *)memchr(target, ' ', lineEnd - target) - target);
+   blockLen = (n > 0) ? (blockLen + n) : room;
+   for (line = lineEnd + 2; (line < end - 2) && (blockLen < room); line = lineEnd + 2)
+   {
+      lineEnd = memmem(line, end - line, "\r\n", 2);
+      value = memchr(line, ':', lineEnd - line);
+      nameLen = (NULL != value) ? (size_t)(value - line) : 0;
+      if ((0 == nameLen) || (nameLen >= sizeof(name)))
+      {
+         continue;
+      }
+      for (i = 0; i < nameLen; i++)
+      {
+         name[i] = tolower((unsigned char)line[i]);
+      }
+      for (value++; ' ' == *value; value++)
+      {
+      }
+      /* Fields of the HTTP/1.1 connection, or already sent as :authority */
+      skip = false;
+      skip |= ((4 == nameLen) && (0 == memcmp(name, "host", 4)));
+      skip |= ((10 == nameLen) && (0 == memcmp(name, "connection", 10)));
+      skip |= ((10 == nameLen) && (0 == memcmp(name, "keep-alive", 10)));
+      skip |= ((7 == nameLen) && (0 == memcmp(name, "upgrade", 7)));
+      skip |= ((17 == nameLen) && (0 == memcmp(name, "transfer-encoding", 17)));
+      if (skip)
+      {
+         continue;
+      }
+      if ((14 == nameLen) && (0 == memcmp(name, "content-length", 14)) && (0 != atoi(value)))
+      {
+         utils_sysLog(LOG_ERR, "%s>> HTTP/2 requests with a body are not supported\n", c->name);
+         return -1;
+      }
+      n = hpack_encodeField(&c->encoder, &block[blockLen], room - blockLen, name, nameLen,
+                            value, lineEnd - value);
+      blockLen = (n > 0) ? (blockLen + n) : room;
+   }
+   if ((blockLen >= room) || (blockLen > H2_FRAME_LEN))
+   {
+      utils_sysLog(LOG_ERR, "%s>> HTTP/2 request header is too large\n", c->name);
+      return -1;
+   }
+   h2_putFrameHeader(out, blockLen, H2_HEADERS, H2_FLAG_END_STREAM | H2_FLAG_END_HEADERS, c->nextId);
+
+   return H2_FRAME_HEADER_LEN + blockLen;
+}
+
+//!
+//! Interpret the header of a frame once it is received.
+//!
+//! @return  false on a connection error, otherwise true
+//!
+static bool h2_frameStart(H2_T *c)
+{
+   H2_STREAM_T *st;
+   int index;
+
+   c->frameLen = ((uint32_t)c->header[0] << 16) | ((uint32_t)c->header[1] << 8) | c->header[2];
+   c->frameType = c->header[3];
+   c->frameFlags = c->header[4];
+   c->frameId = (((uint32_t)c->header[5] & 0x7f) << 24) | ((uint32_t)c->header[6] << 16) |
+                ((uint32_t)c->header[7] << 8) | c->header[8];
+   c->payloadLen = 0;
+   c->padLen = 0;
+   if (c->frameLen > H2_FRAME_LEN)
+   {
+      return h2_fail(c, "frame is too large");
+   }
+   if ((0 != c->blockId) && ((H2_CONTINUATION != c->frameType) || (c->blockId != c->frameId)))
+   {
+      return h2_fail(c, "header block is interrupted");
+   }
+   if (H2_DATA == c->frameType)
+   {
+      /* Padding counts against the windows too */
+      c->connConsumed += c->frameLen;
+      index = h2_streamIndex(c, c->frameId);
+      if (index >= 0)
+      {
+         st = &c->streams[index];
+         st->received += c->frameLen;
+         if (st->ended)
+         {
+            return h2_fail(c, "data was sent after the end of its stream");
+         }
+         if (st->received > st->granted)
+         {
+            /* Also keeps the payload held for a stream within its buffer */
+            return h2_fail(c, "data was sent beyond the window of its stream");
+         }
+      }
+   }
+
+   return true;
+}
+
+//!
+//! Pass the payload bytes of a DATA frame on, without its padding, or hold
+//! them until their response is passed on.
+//!
+//! @return  false on a stream error, otherwise true
+//!
+static bool h2_dataBytes(H2_T *c, const char *data, size_t len)
+{
+   H2_STREAM_T *st;
+   uint32_t pos = c->payloadLen;
+   uint32_t dataEnd;
+   int index;
+
+   if ((c->frameFlags & H2_FLAG_PADDED) && (0 == pos) && (len > 0))
+   {
+      c->padLen = (uint8_t)data[0];
+      if (c->padLen >= c->frameLen)
+      {
+         return h2_fail(c, "padding is too long");
+      }
+      data++;
+      len--;
+      pos++;
+   }
+   dataEnd = c->frameLen - c->padLen;
+   if (pos >= dataEnd)
+   {
+      return true;
+   }
+   if (pos + len > dataEnd)
+   {
+      len = dataEnd - pos;
+   }
+   index = h2_streamIndex(c, c->frameId);
+   if ((index < 0) || (len == 0))
+   {
+      return true;
+   }
+   st = &c->streams[index];
+   if (!st->headers)
+   {
+      return h2_fail(c, "data was sent before the header");
+   }
+   if (index == c->current)
+   {
+      if (NULL != c->dataCb)
+      {
+         c->dataCb(c->arg, index, data, len);
+      }
+      return true;
+   }
+   if (NULL == st->buf)
+   {
+      st->buf = malloc(H2_STREAM_WINDOW);
+      if (NULL == st->buf)
+      {
+         return h2_fail(c, "has no memory to hold a response");
+      }
+   }
+   memcpy(&st->buf[st->bufLen], data, len);
+   st->bufLen += len;
+
+   return true;
+}
+
+//!
+//! Act on a frame once all of it is received.
+//!
+//! @return  false on a connection or stream error, otherwise true
+//!
+static bool h2_frameEnd(H2_T *c)
+{
+   bool success = true;
+   uint32_t offset = 0;
+   uint32_t code;
+   int index;
+
+   c->headerLen = 0;
+   switch (c->frameType)
+   {
+      case H2_DATA:
+         index = h2_streamIndex(c, c->frameId);
+         if ((index >= 0) && (c->frameFlags & H2_FLAG_END_STREAM))
+         {
+            c->streams[index].ended = true;
+            h2_deliver(c);
+         }
+         break;
+      case H2_HEADERS:
+         if (0 == c->frameId)
+         {
+            return h2_fail(c, "header block without a stream");
+         }
+         if (c->frameFlags & H2_FLAG_PADDED)
+         {
+            c->padLen = (c->frameLen > 0) ? c->payload[offset++] : 0;
+         }
+         if (c->frameFlags & H2_FLAG_PRIORITY)
+         {
+            offset += H2_PRIORITY_LEN;
+         }
+         if (offset + c->padLen > c->frameLen)
+         {
+            return h2_fail(c, "padding is too long");
+         }
+         c->blockId = c->frameId;
+         c->blockLen = 0;
+         c->blockEnd = (0 != (c->frameFlags & H2_FLAG_END_STREAM));
+         success = h2_headerFragment(c, &c->payload[offset], c->frameLen - offset - c->padLen);
+         break;
+      case H2_CONTINUATION:
+         if (0 == c->blockId)
+         {
+            return h2_fail(c, "continuation without a header block");
+         }
+         success = h2_headerFragment(c, c->payload, c->frameLen);
+         break;
+      case H2_RST_STREAM:
+         index = h2_streamIndex(c, c->frameId);
+         if ((index >= 0) && !c->streams[index].ended && (4 == c->frameLen))
+         {
+            code = ((uint32_t)c->payload[0] << 24) | ((uint32_t)c->payload[1] << 16) |
+                   ((uint32_t)c->payload[2] << 8) | c->payload[3];
+            utils_sysLog(LOG_ERR, "%s>> HTTP/2 stream %u reset, error %u\n", c->name, c->frameId, code);
+            success = false;
+         }
+         break;
+      case H2_SETTINGS:
+         success = h2_settings(c);
+         break;
+      case H2_PUSH_PROMISE:
+         success = h2_fail(c, "push was not enabled");
+         break;
+      case H2_PING:
+         if (!(c->frameFlags & H2_FLAG_ACK) && (H2_PING_LEN == c->frameLen))
+         {
+            memmove(&c->payload[H2_FRAME_HEADER_LEN], c->payload, H2_PING_LEN);
+            h2_putFrameHeader(c->payload, H2_PING_LEN, H2_PING, H2_FLAG_ACK, 0);
+            c->writeCb(c->arg, (const char *)c->payload, H2_FRAME_HEADER_LEN + H2_PING_LEN);
+         }
+         break;
+      case H2_GOAWAY:
+         success = h2_goaway(c);
+         break;
+      default:
+         /* PRIORITY, WINDOW_UPDATE and unknown frames need nothing, no data is sent */
+         break;
+   }
+
+   return success;
+}
+
+//!
+//! Add a fragment of a header block, and decode the block once it is
+//! complete.
+//!
+//! @return  false on a connection error, otherwise true
+//!
+static bool h2_headerFragment(H2_T *c, const uint8_t *data, size_t len)
+{
+   if (c->blockLen + len > H2_BLOCK_LEN)
+   {
+      return h2_fail(c, "header block is too large");
+   }
+   memcpy(&c->block[c->blockLen], data, len);
+   c->blockLen += len;
+   if (!(c->frameFlags & H2_FLAG_END_HEADERS))
+   {
+      return true;
+   }
+
+   return h2_headerBlock(c);
+}
+
+//!
+//! Decode a complete header block into the response of its stream.
+//!
+//! Interim 1XX responses are dropped. A block after the final response
+//! header is a trailer, decoded only to keep the dynamic table in step.
+//!
+//! @return  false on a connection or stream error, otherwise true
+//!
+static bool h2_headerBlock(H2_T *c)
+{
+   H2_STREAM_T *st = NULL;
+   int index;
+
+   index = h2_streamIndex(c, c->blockId);
+   if ((index >= 0) && !c->streams[index].headers)
+   {
+      st = &c->streams[index];
+      c->target = &st->response;
+   }
+   else
+   {
+      parse_initResponse(&c->discard);
+      c->target = &c->discard;
+   }
+   c->blockId = 0;
+   if (!hpack_decode(&c->decoder, c->block, c->blockLen, h2_field, c))
+   {
+      return h2_fail(c, "header block cannot be decoded");
+   }
+   if (NULL != st)
+   {
+      if (parse_responseFailed(&st->response) || (st->response.statusCode < HTTP_CONTINUE))
+      {
+         return h2_fail(c, "response header is malformed");
+      }
+      if (st->response.statusCode < HTTP_SUCCESS)
+      {
+         parse_initResponse(&st->response);
+         return true;
+      }
+      /* The frames carry the length of the body, the parser has nothing left to do */
+      st->response.state = PARSE_DONE;
+      st->response.keepAlive = true;
+      st->headers = true;
+   }
+   if ((index >= 0) && c->blockEnd)
+   {
+      c->streams[index].ended = true;
+   }
+   h2_deliver(c);
+
+   return true;
+}
+
+//!
+//! Take the settings of the server, and acknowledge them.
+//!
+//! @return  false on a connection error, otherwise true
+//!
+static bool h2_settings(H2_T *c)
+{
+   uint8_t ack[H2_FRAME_HEADER_LEN];
+   uint32_t value;
+   uint32_t i;
+   uint16_t id;
+
+   if (c->frameFlags & H2_FLAG_ACK)
+   {
+      return true;
+   }
+   if ((0 != c->frameId) || (0 != (c->frameLen % H2_SETTING_LEN)))
+   {
+      return h2_fail(c, "settings are malformed");
+   }
+   for (i = 0; i < c->frameLen; i += H2_SETTING_LEN)
+   {
+      id = ((uint16_t)c->payload[i] << 8) | c->payload[i + 1];
+      value = ((uint32_t)c->payload[i + 2] << 24) | ((uint32_t)c->payload[i + 3] << 16) |
+              ((uint32_t)c->payload[i + 4] << 8) | c->payload[i + 5];
+      if (H2_SETTINGS_HEADER_TABLE_SIZE == id)
+      {
+         /* Announced at the start of the next request header */
+         c->tableLimit = (value < HPACK_TABLE_LEN) ? value : HPACK_TABLE_LEN;
+         c->tableUpdate = (c->tableLimit != c->encoder.maxSize);
+      }
+   }
+   h2_putFrameHeader(ack, 0, H2_SETTINGS, H2_FLAG_ACK, 0);
+   c->ackPending = !c->writeCb(c->arg, (const char *)ack, sizeof(ack));
+
+   return true;
+}
+
+//!
+//! Take the notice of the server that it is closing the connection. The
+//! responses it still sends are taken, but the connection is not kept.
+//!
+//! @return  false if a response of the transaction will not be sent
+//!
+static bool h2_goaway(H2_T *c)
+{
+   uint32_t lastId;
+   uint32_t code;
+   int i;
+
+   if (c->frameLen < 8)
+   {
+      return h2_fail(c, "goaway is malformed");
+   }
+   lastId = (((uint32_t)c->payload[0] & 0x7f) << 24) | ((uint32_t)c->payload[1] << 16) |
+            ((uint32_t)c->payload[2] << 8) | c->payload[3];
+   code = ((uint32_t)c->payload[4] << 24) | ((uint32_t)c->payload[5] << 16) |
+          ((uint32_t)c->payload[6] << 8) | c->payload[7];
+   utils_sysLog(LOG_INFO, "%s>> HTTP/2 connection going away, error %u\n", c->name, code);
+   c->goaway = true;
+   for (i = 0; i < c->streamCount; i++)
+   {
+      if (!c->streams[i].ended && (c->firstId + 2 * (uint32_t)i > lastId))
+      {
+         return false;
+      }
+   }
+
+   return true;
+}
+
+//!
+//! Take a decoded header field into the response being decoded. Header
+//! values are cut short like the lines of an HTTP/1.1 header.
+//!
+static void h2_field(void *arg, const char *name, size_t nameLen, const char *value, size_t valueLen)
+{
+   H2_T *c = (H2_T *)arg;
+   char field[PARSE_LINE_LEN];
+
+   if (valueLen >= sizeof(field))
+   {
+      valueLen = sizeof(field) - 1;
+   }
+   memcpy(field, value, valueLen);
+   field[valueLen] = '\0';
+   if ((7 == nameLen) && (0 == memcmp(name, ":status", 7)))
+   {
+      c->target->statusCode = atoi(field);
+   }
+   else if ((nameLen > 0) && (':' != name[0]))
+   {
+      parse_field(c->target, name, nameLen, field);
+   }
+}
+
+//!
+//! Pass on the responses that are ready, one at a time, with the payload
+//! held for them.
+//!
+static void h2_deliver(H2_T *c)
+{
+   H2_STREAM_T *st;
+
+   for (;;)
+   {
+      if (c->current < 0)
+      {
+         c->current = h2_nextStream(c);
+         if (c->current < 0)
+         {
+            break;
+         }
+         st = &c->streams[c->current];
+         if (NULL != c->headersCb)
+         {
+            c->headersCb(c->arg, c->current, &st->response);
+         }
+         if ((st->bufLen > 0) && (NULL != c->dataCb))
+         {
+            c->dataCb(c->arg, c->current, st->buf, st->bufLen);
+         }
+         free(st->buf);
+         st->buf = NULL;
+         st->bufLen = 0;
+      }
+      st = &c->streams[c->current];
+      if (!st->ended)
+      {
+         break;
+      }
+      st->done = true;
+      if (NULL != c->endCb)
+      {
+         c->endCb(c->arg, c->current);
+      }
+      c->current = -1;
+   }
+}
+
+//!
+//! Choose the response to pass on next: a complete one, whatever the order
+//! of the requests, otherwise the first one whose header has arrived.
+//!
+//! @return  Index of the request, or -1 if no response is ready
+//!
+static int h2_nextStream(const H2_T *c)
+{
+   int next = -1;
+   int i;
+
+   for (i = 0; i < c->streamCount; i++)
+   {
+      if (c->streams[i].done || !c->streams[i].headers)
+      {
+         continue;
+      }
+      if (c->streams[i].ended)
+      {
+         return i;
+      }
+      if (next < 0)
+      {
+         next = i;
+      }
+   }
+
+   return next;
+}
+
+//!
+//! Free the payload held for the streams of the last transaction.
+//!
+static void h2_dropHeld(H2_T *c)
+{
+   int i;
+
+   for (i = 0; i < H2_STREAM_MAX; i++)
+   {
+      free(c->streams[i].buf);
+      c->streams[i].buf = NULL;
+      c->streams[i].bufLen = 0;
+   }
+}
+
+//!
+//! Grant the bytes consumed on the connection again once half of its
+//! window is used, and keep the window of the response being passed on
+//! open. The other streams are left with what they have.
+//!
+static void h2_grantWindows(H2_T *c)
+{
+   uint8_t frame[H2_FRAME_HEADER_LEN + 4];
+   H2_STREAM_T *st;
+   uint64_t left;
+
+   if (c->connConsumed >= (H2_WINDOW_LEN / 2))
+   {
+      h2_putWindowUpdate(frame, 0, c->connConsumed);
+      if (c->writeCb(c->arg, (const char *)frame, sizeof(frame)))
+      {
+         c->connConsumed = 0;
+      }
+   }
+   if (c->current < 0)
+   {
+      return;
+   }
+   st = &c->streams[c->current];
+   left = st->granted - st->received;
+   if (!st->ended && (left < (H2_WINDOW_LEN / 2)))
+   {
+      h2_putWindowUpdate(frame, c->firstId + 2 * c->current, H2_WINDOW_LEN - left);
+      if (c->writeCb(c->arg, (const char *)frame, sizeof(frame)))
+      {
+         st->granted += H2_WINDOW_LEN - left;
+      }
+   }
+}
+
+//!
+//! Get the request index of a stream of the transaction.
+//!
+//! @return  Index of the request, or -1 if the stream is not one of them
+//!
+static int h2_streamIndex(const H2_T *c, uint32_t id)
+{
+   if ((id < c->firstId) || (0 == (id & 1)) || (id >= c->firstId + 2 * (uint32_t)c->streamCount))
+   {
+      return -1;
+   }
+
+   return (id - c->firstId) / 2;
+}
+
+//!
+//! Report an error that ends the connection.
+//!
+//! @return  false
+//!
+static bool h2_fail(H2_T *c, const char *reason)
+{
+   utils_sysLog(LOG_ERR, "%s>> HTTP/2 %s\n", c->name, reason);
+
+   return false;
+}
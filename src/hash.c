@@ -0,0 +1,200 @@
+//******************************************************************************
+//!
+//! Author:  Ying Xiong
+//! Created: Oct 2026
+//!
+//******************************************************************************
+
+#include <string.h>
+#include "hash.h"
+
+//
+// Local Defines
+//
+#define PRIME64_1  0x9E3779B185EBCA87ULL
+#define PRIME64_2  0xC2B2AE3D27D4EB4FULL
+#define PRIME64_3  0x165667B19E3779F9ULL
+#define PRIME64_4  0x85EBCA77C2B2AE63ULL
+#define PRIME64_5  0x27D4EB2F165667C5ULL
+
+//!
+//! Rotate a 64 bit value left.
+//!
+static uint64_t hash_rotl(uint64_t x, int r)
+{
+   return (x << r) | (x >> (64 - r));
+}
+
+//!
+//! Read a little endian 64 bit value, the byte order of the hash.
+//!
+static uint64_t hash_read64(const uint8_t *p)
+{
+   return ((uint64_t)p[0]) | ((uint64_t)p[1] << 8) | ((uint64_t)p[2] << 16) |
+          ((uint64_t)p[3] << 24) | ((uint64_t)p[4] << 32) | ((uint64_t)p[5] << 40) |
+          ((uint64_t)p[6] << 48) | ((uint64_t)p[7] << 56);
+}
+
+//!
+//! Read a little endian 32 bit value.
+//!
+static uint32_t hash_read32(const uint8_t *p)
+{
+   return ((uint32_t)p[0]) | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+          ((uint32_t)p[3] << 24);
+}
+
+//!
+//! Mix one 8 byte lane into an accumulator.
+//!
+static uint64_t hash_round(uint64_t acc, uint64_t input)
+{
+   acc += input * PRIME64_2;
+   acc = hash_rotl(acc, 31);
+
+   return acc * PRIME64_1;
+}
+
+//!
+//! Fold an accumulator into the final hash.
+//!
+static uint64_t hash_merge(uint64_t h, uint64_t acc)
+{
+   h ^= hash_round(0, acc);
+
+   return h * PRIME64_1 + PRIME64_4;
+}
+
+//!
+//! Mix one complete 32 byte stripe into the accumulators.
+//!
+static void hash_stripe(HASH_T *h, const uint8_t *p)
+{
+   h->acc[0] = hash_round(h->acc[0], hash_read64(p));
+   h->acc[1] = hash_round(h->acc[1], hash_read64(p + 8));
+   h->acc[2] = hash_round(h->acc[2], hash_read64(p + 16));
+   h->acc[3] = hash_round(h->acc[3], hash_read64(p + 24));
+}
+
+//!
+//! Start a new hash.
+//!
+//! @param[out] h  Pointer to hash state
+//!
+void hash_init(HASH_T *h)
+{
+   h->total = 0;
+   h->acc[0] = PRIME64_1 + PRIME64_2;
+   h->acc[1] = PRIME64_2;
+   h->acc[2] = 0;
+   h->acc[3] = 0 - PRIME64_1;
+   h->memLen = 0;
+}
+
+//!
+//! Add the next bytes of the content to the hash.
+//!
+//! The content may be passed in pieces of any size, the hash is the same
+//! as for the content in one piece.
+//!
+//! @param[in,out] h  Pointer to hash state
+//! @param[in] data  Next bytes of the content
+//! @param[in] len  Number of bytes
+//!
+void hash_update(HASH_T *h, const void *data, size_t len)
+{
+   const uint8_t *p = data;
+   size_t n;
+
+   h->total += len;
+   if (h->memLen > 0)
+   {
+      n = HASH_STRIPE_LEN - h->memLen;
+      if (n > len)
+      {
+         n = len;
+      }
+      memcpy(&h->mem[h->memLen], p, n);
+      h->memLen += n;
+      p += n;
+      len -= n;
+      if (h->memLen < HASH_STRIPE_LEN)
+      {
+         return;
+      }
+      hash_stripe(h, h->mem);
+      h->memLen = 0;
+   }
+   while (len >= HASH_STRIPE_LEN)
+   {
+      hash_stripe(h, p);
+      p += HASH_STRIPE_LEN;
+      len -= HASH_STRIPE_LEN;
+   }
+   if (len > 0)
+   {
+      memcpy(h->mem, p, len);
+      h->memLen = len;
+   }
+}
+
+//!
+//! Get the hash of the content added so far. More content can still be
+//! added afterwards.
+//!
+//! @param[in] h  Pointer to hash state
+//!
+//! @return  64 bit hash of the content
+//!
+uint64_t hash_final(const HASH_T *h)
+{
+   const uint8_t *p = h->mem;
+   size_t len = h->memLen;
+   uint64_t v;
+
+   if (h->total >= HASH_STRIPE_LEN)
+   {
+      v = hash_rotl(h->acc[0], 1) + hash_rotl(h->acc[1], 7) +
+          hash_rotl(h->acc[2], 12) + hash_rotl(h->acc[3], 18);
+      v = hash_merge(v, h->acc[0]);
+      v = hash_merge(v, h->acc[1]);
+      v = hash_merge(v, h->acc[2]);
+      v = hash_merge(v, h->acc[3]);
+   }
+   else
+   {
+      v = PRIME64_5;
+   }
+   v += h->total;
+
+   while (len >= 8)
+   {
+      v ^= hash_round(0, hash_read64(p));
+      v = hash_rotl(v, 27) * PRIME64_1 + PRIME64_4;
+      p += 8;
+      len -= 8;
+   }
+   if (len >= 4)
+   {
+      v ^= (uint64_t)hash_read32(p) * PRIME64_1;
+      v = hash_rotl(v, 23) * PRIME64_2 + PRIME64_3;
+      p += 4;
+      len -= 4;
+   }
+   while (len > 0)
+   {
+      v ^= (*p) * PRIME64_5;
+      v = hash_rotl(v, 11) * PRIME64_1;
+      p++;
+      len--;
+   }
+
+   /* Avalanche */
+   v ^= v >> 33;
+   v *= PRIME64_2;
+   v ^= v >> 29;
+   v *= PRIME64_3;
+   v ^= v >> 32;
+
+   return v;
+}
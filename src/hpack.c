@@ -0,0 +1,655 @@
+//******************************************************************************
+//!
+//! Author:  Ying Xiong
+//! Created: Oct 2026
+//!
+//******************************************************************************
+
+#include <string.h>
+#include "hpack.h"
+
+#define HPACK_STATIC_COUNT    (61)
+#define HPACK_HUFFMAN_SYMBOLS (257)
+#define HPACK_HUFFMAN_BITS    (30)
+#define HPACK_HUFFMAN_EOS     (256)
+
+//
+// Static Table (RFC 7541 Appendix A), indexed from 1
+//
+static const char *hpack_staticTable[HPACK_STATIC_COUNT][2] =
+{
+   {":authority", ""}, {":method", "GET"}, {":method", "POST"}, {":path", "/"},
+   {":path", "/index.html"}, {":scheme", "http"}, {":scheme", "https"}, {":status", "200"},
+   {":status", "204"}, {":status", "206"}, {":status", "304"}, {":status", "400"},
+   {":status", "404"}, {":status", "500"}, {"accept-charset", ""},
+   {"accept-encoding", "gzip, deflate"}, {"accept-language", ""}, {"accept-ranges", ""},
+   {"accept", ""}, {"access-control-allow-origin", ""}, {"age", ""}, {"allow", ""},
+   {"authorization", ""}, {"cache-control", ""}, {"content-disposition", ""},
+   {"content-encoding", ""}, {"content-language", ""}, {"content-length", ""},
+   {"content-location", ""}, {"content-range", ""}, {"content-type", ""}, {"cookie", ""},
+   {"date", ""}, {"etag", ""}, {"expect", ""}, {"expires", ""}, {"from", ""}, {"host", ""},
+   {"if-match", ""}, {"if-modified-since", ""}, {"if-none-match", ""}, {"if-range", ""},
+   {"if-unmodified-since", ""}, {"last-modified", ""}, {"link", ""}, {"location", ""},
+   {"max-forwards", ""}, {"proxy-authenticate", ""}, {"proxy-authorization", ""},
+   {"range", ""}, {"referer", ""}, {"refresh", ""}, {"retry-after", ""}, {"server", ""},
+   {"set-cookie", ""}, {"strict-transport-security", ""}, {"transfer-encoding", ""},
+   {"user-agent", ""}, {"vary", ""}, {"via", ""}, {"www-authenticate", ""},
+};
+
+//
+// Huffman code of each symbol, right aligned, and its length in bits
+// (RFC 7541 Appendix B). Symbol 256 is EOS.
+//
+static const uint32_t hpack_huffCode[HPACK_HUFFMAN_SYMBOLS] =
+{
+   0x1ff8, 0x7fffd8, 0xfffffe2, 0xfffffe3, 0xfffffe4, 0xfffffe5,
+   0xfffffe6, 0xfffffe7, 0xfffffe8, 0xffffea, 0x3ffffffc, 0xfffffe9,
+   0xfffffea, 0x3ffffffd, 0xfffffeb, 0xfffffec, 0xfffffed, 0xfffffee,
+   0xfffffef, 0xffffff0, 0xffffff1, 0xffffff2, 0x3ffffffe, 0xffffff3,
+   0xffffff4, 0xffffff5, 0xffffff6, 0xffffff7, 0xffffff8, 0xffffff9,
+   0xffffffa, 0xffffffb, 0x14, 0x3f8, 0x3f9, 0xffa,
+   0x1ff9, 0x15, 0xf8, 0x7fa, 0x3fa, 0x3fb,
+   0xf9, 0x7fb, 0xfa, 0x16, 0x17, 0x18,
+   0x0, 0x1, 0x2, 0x19, 0x1a, 0x1b,
+   0x1c, 0x1d, 0x1e, 0x1f, 0x5c, 0xfb,
+   0x7ffc, 0x20, 0xffb, 0x3fc, 0x1ffa, 0x21,
+   0x5d, 0x5e, 0x5f, 0x60, 0x61, 0x62,
+   0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+   0x69, 0x6a, 0x6b, 0x6c, 0x6d, 0x6e,
+   0x6f, 0x70, 0x71, 0x72, 0xfc, 0x73,
+   0xfd, 0x1ffb, 0x7fff0, 0x1ffc, 0x3ffc, 0x22,
+   0x7ffd, 0x3, 0x23, 0x4, 0x24, 0x5,
+   0x25, 0x26, 0x27, 0x6, 0x74, 0x75,
+   0x28, 0x29, 0x2a, 0x7, 0x2b, 0x76,
+   0x2c, 0x8, 0x9, 0x2d, 0x77, 0x78,
+   0x79, 0x7a, 0x7b, 0x7ffe, 0x7fc, 0x3ffd,
+   0x1ffd, 0xffffffc, 0xfffe6, 0x3fffd2, 0xfffe7, 0xfffe8,
+   0x3fffd3, 0x3fffd4, 0x3fffd5, 0x7fffd9, 0x3fffd6, 0x7fffda,
+   0x7fffdb, 0x7fffdc, 0x7fffdd, 0x7fffde, 0xffffeb, 0x7fffdf,
+   0xffffec, 0xffffed, 0x3fffd7, 0x7fffe0, 0xffffee, 0x7fffe1,
+   0x7fffe2, 0x7fffe3, 0x7fffe4, 0x1fffdc, 0x3fffd8, 0x7fffe5,
+   0x3fffd9, 0x7fffe6, 0x7fffe7, 0xffffef, 0x3fffda, 0x1fffdd,
+   0xfffe9, 0x3fffdb, 0x3fffdc, 0x7fffe8, 0x7fffe9, 0x1fffde,
+   0x7fffea, 0x3fffdd, 0x3fffde, 0xfffff0, 0x1fffdf, 0x3fffdf,
+   0x7fffeb, 0x7fffec, 0x1fffe0, 0x1fffe1, 0x3fffe0, 0x1fffe2,
+   0x7fffed, 0x3fffe1, 0x7fffee, 0x7fffef, 0xfffea, 0x3fffe2,
+   0x3fffe3, 0x3fffe4, 0x7ffff0, 0x3fffe5, 0x3fffe6, 0x7ffff1,
+   0x3ffffe0, 0x3ffffe1, 0xfffeb, 0x7fff1, 0x3fffe7, 0x7ffff2,
+   0x3fffe8, 0x1ffffec, 0x3ffffe2, 0x3ffffe3, 0x3ffffe4, 0x7ffffde,
+   0x7ffffdf, 0x3ffffe5, 0xfffff1, 0x1ffffed, 0x7fff2, 0x1fffe3,
+   0x3ffffe6, 0x7ffffe0, 0x7ffffe1, 0x3ffffe7, 0x7ffffe2, 0xfffff2,
+   0x1fffe4, 0x1fffe5, 0x3ffffe8, 0x3ffffe9, 0xffffffd, 0x7ffffe3,
+   0x7ffffe4, 0x7ffffe5, 0xfffec, 0xfffff3, 0xfffed, 0x1fffe6,
+   0x3fffe9, 0x1fffe7, 0x1fffe8, 0x7ffff3, 0x3fffea, 0x3fffeb,
+   0x1ffffee, 0x1ffffef, 0xfffff4, 0xfffff5, 0x3ffffea, 0x7ffff4,
+   0x3ffffeb, 0x7ffffe6, 0x3ffffec, 0x3ffffed, 0x7ffffe7, 0x7ffffe8,
+   0x7ffffe9, 0x7ffffea, 0x7ffffeb, 0xffffffe, 0x7ffffec, 0x7ffffed,
+   0x7ffffee, 0x7ffffef, 0x7fffff0, 0x3ffffee, 0x3fffffff
+};
+
+static const uint8_t hpack_huffLen[HPACK_HUFFMAN_SYMBOLS] =
+{
+   13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,
+   28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+   6, 10, 10, 12, 13, 6, 8, 11, 10, 10, 8, 11, 8, 6, 6, 6,
+   5, 5, 5, 6, 6, 6, 6, 6, 6, 6, 7, 8, 15, 6, 12, 10,
+   13, 6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+   7, 7, 7, 7, 7, 7, 7, 7, 8, 7, 8, 13, 19, 13, 14, 6,
+   15, 5, 6, 5, 6, 5, 6, 6, 6, 5, 7, 7, 6, 6, 6, 5,
+   6, 7, 6, 5, 5, 6, 7, 7, 7, 7, 7, 15, 11, 14, 13, 28,
+   20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+   24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+   22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,
+   21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+   26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+   19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+   20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+   26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26,
+   30
+};
+
+//
+// Canonical decoding tables, the number of codes of each length and the
+// symbols ordered by code
+//
+static const uint16_t hpack_huffCount[HPACK_HUFFMAN_BITS + 1] =
+{
+   0, 0, 0, 0, 0, 10, 26, 32, 6, 0, 5, 3, 2, 6, 2, 3,
+   0, 0, 0, 3, 8, 13, 26, 29, 12, 4, 15, 19, 29, 0, 4
+};
+
+static const uint16_t hpack_huffSymbol[HPACK_HUFFMAN_SYMBOLS] =
+{
+   48, 49, 50, 97, 99, 101, 105, 111, 115, 116, 32, 37, 45, 46, 47, 51,
+   52, 53, 54, 55, 56, 57, 61, 65, 95, 98, 100, 102, 103, 104, 108, 109,
+   110, 112, 114, 117, 58, 66, 67, 68, 69, 70, 71, 72, 73, 74, 75, 76,
+   77, 78, 79, 80, 81, 82, 83, 84, 85, 86, 87, 89, 106, 107, 113, 118,
+   119, 120, 121, 122, 38, 42, 44, 59, 88, 90, 33, 34, 40, 41, 63, 39,
+   43, 124, 35, 62, 0, 36, 64, 91, 93, 126, 94, 125, 60, 96, 123, 92,
+   195, 208, 128, 130, 131, 162, 184, 194, 224, 226, 153, 161, 167, 172, 176, 177,
+   179, 209, 216, 217, 227, 229, 230, 129, 132, 133, 134, 136, 146, 154, 156, 160,
+   163, 164, 169, 170, 173, 178, 181, 185, 186, 187, 189, 190, 196, 198, 228, 232,
+   233, 1, 135, 137, 138, 139, 140, 141, 143, 147, 149, 150, 151, 152, 155, 157,
+   158, 165, 166, 168, 174, 175, 180, 182, 183, 188, 191, 197, 231, 239, 9, 142,
+   144, 145, 148, 159, 171, 206, 215, 225, 236, 237, 199, 207, 234, 235, 192, 193,
+   200, 201, 202, 205, 210, 213, 218, 219, 238, 240, 242, 243, 255, 203, 204, 211,
+   212, 214, 221, 222, 223, 241, 244, 245, 246, 247, 248, 250, 251, 252, 253, 254,
+   2, 3, 4, 5, 6, 7, 8, 11, 12, 14, 15, 16, 17, 18, 19, 20,
+   21, 23, 24, 25, 26, 27, 28, 29, 30, 31, 127, 220, 249, 10, 13, 22,
+   256
+};
+
+//
+// Function Prototypes
+//
+static size_t hpack_putInt(uint8_t *out, size_t outLen, uint8_t flags, int prefix, uint32_t value);
+static bool hpack_getInt(const uint8_t **p, const uint8_t *end, int prefix, uint32_t *value);
+static size_t hpack_putString(uint8_t *out, size_t outLen, const char *str, size_t len);
+static bool hpack_getString(const uint8_t **p, const uint8_t *end, char *out, size_t outLen, size_t *len);
+static bool hpack_huffmanDecode(const uint8_t *in, size_t inLen, char *out, size_t outLen, size_t *len);
+static bool hpack_getEntry(const HPACK_TABLE_T *t, uint32_t index, const char **name, size_t *nameLen,
+                           const char **value, size_t *valueLen);
+static void hpack_evict(HPACK_TABLE_T *t, uint32_t needed);
+static void hpack_addEntry(HPACK_TABLE_T *t, const char *name, size_t nameLen,
+                           const char *value, size_t valueLen);
+
+//!
+//! Get a dynamic table ready for the first header block of a connection.
+//!
+//! @param[out] t  Pointer to dynamic table
+//! @param[in] maxSize  Size limit of the table, at most HPACK_TABLE_LEN
+//!
+void hpack_initTable(HPACK_TABLE_T *t, uint32_t maxSize)
+{
+   t->maxSize = (maxSize < HPACK_TABLE_LEN) ? maxSize : HPACK_TABLE_LEN;
+   t->size = 0;
+   t->count = 0;
+}
+
+//!
+//! Encode a header field.
+//!
+//! A field found in the static or dynamic table takes a single index. Any
+//! other field is sent as a literal and added to the dynamic table, so
+//! the same field in later requests of the connection is an index too.
+//! Strings are Huffman coded when that makes them shorter. The name must
+//! be in lower case.
+//!
+//! @param[in,out] t  Dynamic table of the encoder
+//! @param[out] out  Buffer for the encoded field
+//! @param[in] outLen  Room in the buffer
+//! @param[in] name  Field name
+//! @param[in] nameLen  Length of the name
+//! @param[in] value  Field value
+//! @param[in] valueLen  Length of the value
+//!
+//! @return  Bytes encoded, 0 if the buffer is too small
+//!
+size_t hpack_encodeField(HPACK_TABLE_T *t, uint8_t *out, size_t outLen, const char *name,
+                         size_t nameLen, const char *value, size_t valueLen)
+{
+   const char *entryName;
+   const char *entryValue;
+   size_t entryNameLen;
+   size_t entryValueLen;
+   uint32_t nameIndex = 0;
+   uint32_t i;
+   size_t n;
+   size_t m;
+
+   for (i = 1; hpack_getEntry(t, i, &entryName, &entryNameLen, &entryValue, &entryValueLen); i++)
+   {
+      if ((entryNameLen != nameLen) || (0 != memcmp(entryName, name, nameLen)))
+      {
+         continue;
+      }
+      if ((entryValueLen == valueLen) && (0 == memcmp(entryValue, value, valueLen)))
+      {
+         return hpack_putInt(out, outLen, 0x80, 7, i);
+      }
+      if (0 == nameIndex)
+      {
+         nameIndex = i;
+      }
+   }
+   n = hpack_putInt(out, outLen, 0x40, 6, nameIndex);
+   if ((n > 0) && (0 == nameIndex))
+   {
+      m = hpack_putString(&out[n], outLen - n, name, nameLen);
+      n = (m > 0) ? (n + m) : 0;
+   }
+   if (n > 0)
+   {
+      m = hpack_putString(&out[n], outLen - n, value, valueLen);
+      n = (m > 0) ? (n + m) : 0;
+   }
+   if (n > 0)
+   {
+      hpack_addEntry(t, name, nameLen, value, valueLen);
+   }
+
+   return n;
+}
+
+//!
+//! Encode a change of the dynamic table size, sent at the start of a
+//! header block once the peer has lowered the limit.
+//!
+//! @param[in,out] t  Dynamic table of the encoder
+//! @param[out] out  Buffer for the encoded update
+//! @param[in] outLen  Room in the buffer
+//! @param[in] maxSize  New size limit of the table
+//!
+//! @return  Bytes encoded, 0 if the buffer is too small
+//!
+size_t hpack_encodeSizeUpdate(HPACK_TABLE_T *t, uint8_t *out, size_t outLen, uint32_t maxSize)
+{
+   t->maxSize = (maxSize < HPACK_TABLE_LEN) ? maxSize : HPACK_TABLE_LEN;
+   hpack_evict(t, 0);
+
+   return hpack_putInt(out, outLen, 0x20, 5, t->maxSize);
+}
+
+//!
+//! Decode a complete header block.
+//!
+//! The dynamic table is updated as the block asks, so every block of the
+//! connection has to be decoded in order, including the ones whose fields
+//! are not needed.
+//!
+//! @param[in,out] t  Dynamic table of the decoder
+//! @param[in] block  Header block, from a HEADERS frame and its CONTINUATION frames
+//! @param[in] len  Length of the block
+//! @param[in] cb  Called with each field
+//! @param[in] arg  Argument passed back to the callback
+//!
+//! @return  false if the block is malformed, otherwise true
+//!
+bool hpack_decode(HPACK_TABLE_T *t, const uint8_t *block, size_t len, HPACK_FIELD_CB_T cb, void *arg)
+{
+   const uint8_t *p = block;
+   const uint8_t *end = block + len;
+   char name[HPACK_TABLE_LEN];
+   char value[HPACK_TABLE_LEN];
+   const char *entryName;
+   const char *entryValue;
+   size_t nameLen;
+   size_t valueLen;
+   uint32_t index;
+   bool indexing;
+   bool fieldSeen = false;
+
+   while (p < end)
+   {
+      if (*p & 0x80)
+      {
+         /* Indexed field */
+         if (!hpack_getInt(&p, end, 7, &index) ||
+             !hpack_getEntry(t, index, &entryName, &nameLen, &entryValue, &valueLen))
+         {
+            return false;
+         }
+         cb(arg, entryName, nameLen, entryValue, valueLen);
+      }
+      else if (0x20 == (*p & 0xe0))
+      {
+         /* Table size update, only ahead of the fields and within our limit */
+         if (fieldSeen || !hpack_getInt(&p, end, 5, &index) || (index > HPACK_TABLE_LEN))
+         {
+            return false;
+         }
+         t->maxSize = index;
+         hpack_evict(t, 0);
+         continue;
+      }
+      else
+      {
+         /* Literal field, added to the table or not */
+         indexing = (0x40 == (*p & 0xc0));
+         if (!hpack_getInt(&p, end, indexing ? 6 : 4, &index))
+         {
+            return false;
+         }
+         if (index > 0)
+         {
+            if (!hpack_getEntry(t, index, &entryName, &nameLen, &entryValue, &valueLen))
+            {
+               return false;
+            }
+            /* The entry may be evicted when the field is added */
+            memcpy(name, entryName, nameLen);
+         }
+         else if (!hpack_getString(&p, end, name, sizeof(name), &nameLen))
+         {
+            return false;
+         }
+         if (!hpack_getString(&p, end, value, sizeof(value), &valueLen))
+         {
+            return false;
+         }
+         cb(arg, name, (nameLen < sizeof(name)) ? nameLen : sizeof(name),
+            value, (valueLen < sizeof(value)) ? valueLen : sizeof(value));
+         if (indexing)
+         {
+            /* A field cut short is too large for the table, which is emptied */
+            hpack_addEntry(t, name, nameLen, value, valueLen);
+         }
+      }
+      fieldSeen = true;
+   }
+
+   return true;
+}
+
+//!
+//! Encode an integer behind the flags in the first byte.
+//!
+//! @return  Bytes encoded, 0 if the buffer is too small
+//!
+static size_t hpack_putInt(uint8_t *out, size_t outLen, uint8_t flags, int prefix, uint32_t value)
+{
+   uint32_t max = (1u << prefix) - 1;
+   size_t n = 0;
+
+   if (0 == outLen)
+   {
+      return 0;
+   }
+   if (value < max)
+   {
+      out[n++] = flags | value;
+      return n;
+   }
+   out[n++] = flags | max;
+   value -= max;
+   while (value >= 0x80)
+   {
+      if (n >= outLen)
+      {
+         return 0;
+      }
+      out[n++] = (value & 0x7f) | 0x80;
+      value >>= 7;
+   }
+   if (n >= outLen)
+   {
+      return 0;
+   }
+   out[n++] = value;
+
+   return n;
+}
+
+//!
+//! Decode an integer behind the flags in the first byte.
+//!
+//! @return  false if the integer is cut short or too large, otherwise true
+//!
+static bool hpack_getInt(const uint8_t **p, const uint8_t *end, int prefix, uint32_t *value)
+{
+   uint32_t max = (1u << prefix) - 1;
+   int shift = 0;
+   uint8_t b;
+
+   if (*p >= end)
+   {
+      return false;
+   }
+   *value = **p & max;
+   (*p)++;
+   if (*value < max)
+   {
+      return true;
+   }
+   do
+   {
+      /* No field needs more than 28 bits */
+      if ((*p >= end) || (shift > 21))
+      {
+         return false;
+      }
+      b = **p;
+      (*p)++;
+      *value += (uint32_t)(b & 0x7f) << shift;
+      shift += 7;
+   }
+   while (b & 0x80);
+
+   return true;
+}
+
+//!
+//! Encode a string literal, Huffman coded when that is shorter.
+//!
+//! @return  Bytes encoded, 0 if the buffer is too small
+//!
+static size_t hpack_putString(uint8_t *out, size_t outLen, const char *str, size_t len)
+{
+   uint64_t bits = 0;
+   uint64_t acc = 0;
+   int accBits = 0;
+   size_t huffLen;
+   size_t n;
+   size_t i;
+   uint8_t sym;
+
+   for (i = 0; i < len; i++)
+   {
+      bits += hpack_huffLen[(uint8_t)str[i]];
+   }
+   huffLen = (bits + 7) / 8;
+   if (huffLen >= len)
+   {
+      n = hpack_putInt(out, outLen, 0x00, 7, len);
+      if ((0 == n) || (n + len > outLen))
+      {
+         return 0;
+      }
+      memcpy(&out[n], str, len);
+      return n + len;
+   }
+   n = hpack_putInt(out, outLen, 0x80, 7, huffLen);
+   if ((0 == n) || (n + huffLen > outLen))
+   {
+      return 0;
+   }
+   for (i = 0; i < len; i++)
+   {
+      sym = (uint8_t)str[i];
+      acc = (acc << hpack_huffLen[sym]) | hpack_huffCode[sym];
+      accBits += hpack_huffLen[sym];
+      while (accBits >= 8)
+      {
+         accBits -= 8;
+         out[n++] = (uint8_t)(acc >> accBits);
+      }
+      acc &= (1u << accBits) - 1;
+   }
+   if (accBits > 0)
+   {
+      /* Padded with the most significant bits of EOS, all ones */
+      out[n++] = (uint8_t)((acc << (8 - accBits)) | (0xff >> accBits));
+   }
+
+   return n;
+}
+
+//!
+//! Decode a string literal. A string longer than the buffer is cut short,
+//! its full length is still returned.
+//!
+//! @return  false if the string is malformed, otherwise true
+//!
+static bool hpack_getString(const uint8_t **p, const uint8_t *end, char *out, size_t outLen, size_t *len)
+{
+   bool huffman;
+   uint32_t n;
+
+   if (*p >= end)
+   {
+      return false;
+   }
+   huffman = (0 != (**p & 0x80));
+   if (!hpack_getInt(p, end, 7, &n) || (n > (size_t)(end - *p)))
+   {
+      return false;
+   }
+   if (huffman)
+   {
+      if (!hpack_huffmanDecode(*p, n, out, outLen, len))
+      {
+         return false;
+      }
+   }
+   else
+   {
+      *len = n;
+      memcpy(out, *p, (n < outLen) ? n : outLen);
+   }
+   *p += n;
+
+   return true;
+}
+
+//!
+//! Decode a Huffman coded string, one bit at a time with the canonical
+//! code tables.
+//!
+//! @return  false if the string holds EOS or is badly padded, otherwise true
+//!
+static bool hpack_huffmanDecode(const uint8_t *in, size_t inLen, char *out, size_t outLen, size_t *len)
+{
+   int32_t code = 0;
+   int32_t first = 0;
+   int32_t count;
+   int index = 0;
+   int bits = 0;
+   uint32_t pad = 0;
+   uint16_t sym;
+   size_t n = 0;
+   size_t i;
+   int b;
+
+   for (i = 0; i < inLen; i++)
+   {
+      for (b = 7; b >= 0; b--)
+      {
+         code |= (in[i] >> b) & 1;
+         pad = (pad << 1) | ((in[i] >> b) & 1);
+         bits++;
+         count = hpack_huffCount[bits];
+         if (code < first + count)
+         {
+            sym = hpack_huffSymbol[index + (code - first)];
+            if (HPACK_HUFFMAN_EOS == sym)
+            {
+               return false;
+            }
+            if (n < outLen)
+            {
+               out[n] = (char)sym;
+            }
+            n++;
+            code = 0;
+            first = 0;
+            index = 0;
+            bits = 0;
+            pad = 0;
+            continue;
+         }
+         if (bits >= HPACK_HUFFMAN_BITS)
+         {
+            return false;
+         }
+         index += count;
+         first = (first + count) << 1;
+         code <<= 1;
+      }
+   }
+   *len = n;
+
+   /* What is left is padding, fewer than 8 bits from the start of EOS */
+   return ((bits < 8) && (pad == ((1u << bits) - 1)));
+}
+
+//!
+//! Get the name and value of an entry of the static or dynamic table.
+//!
+//! @return  false if there is no such entry, otherwise true
+//!
+static bool hpack_getEntry(const HPACK_TABLE_T *t, uint32_t index, const char **name, size_t *nameLen,
+                           const char **value, size_t *valueLen)
+{
+   size_t offset = 0;
+   int i;
+
+   if (0 == index)
+   {
+      return false;
+   }
+   if (index <= HPACK_STATIC_COUNT)
+   {
+      *name = hpack_staticTable[index - 1][0];
+      *nameLen = strlen(*name);
+      *value = hpack_staticTable[index - 1][1];
+      *valueLen = strlen(*value);
+      return true;
+   }
+   index -= HPACK_STATIC_COUNT + 1;
+   if (index >= (uint32_t)t->count)
+   {
+      return false;
+   }
+   for (i = 0; i < (int)index; i++)
+   {
+      offset += t->nameLen[i] + t->valueLen[i];
+   }
+   *name = &t->data[offset];
+   *nameLen = t->nameLen[index];
+   *value = &t->data[offset + t->nameLen[index]];
+   *valueLen = t->valueLen[index];
+
+   return true;
+}
+
+//!
+//! Drop the oldest entries until the table has room for this many more
+//! bytes.
+//!
+static void hpack_evict(HPACK_TABLE_T *t, uint32_t needed)
+{
+   while ((t->count > 0) && (t->size + needed > t->maxSize))
+   {
+      t->count--;
+      t->size -= t->nameLen[t->count] + t->valueLen[t->count] + HPACK_ENTRY_OVERHEAD;
+   }
+}
+
+//!
+//! Add a field in front of the dynamic table. A field larger than the
+//! table empties it. The field must not point into the table.
+//!
+static void hpack_addEntry(HPACK_TABLE_T *t, const char *name, size_t nameLen,
+                           const char *value, size_t valueLen)
+{
+   uint32_t entrySize = nameLen + valueLen + HPACK_ENTRY_OVERHEAD;
+   size_t used;
+
+   if (entrySize > t->maxSize)
+   {
+      t->count = 0;
+      t->size = 0;
+      return;
+   }
+   hpack_evict(t, entrySize);
+   used = t->size - (t->count * HPACK_ENTRY_OVERHEAD);
+   memmove(&t->data[nameLen + valueLen], t->data, used);
+   memmove(&t->nameLen[1], t->nameLen, t->count * sizeof(t->nameLen[0]));
+   memmove(&t->valueLen[1], t->valueLen, t->count * sizeof(t->valueLen[0]));
+   memcpy(t->data, name, nameLen);
+   memcpy(&t->data[nameLen], value, valueLen);
+   t->nameLen[0] = nameLen;
+   t->valueLen[0] = valueLen;
+   t->count++;
+   t->size += entrySize;
+}
@@ -6,21 +6,28 @@
  *  @created:    May, 2020
  ***************************************************************************************************/
 
+#include <ctype.h>
 #include <pthread.h>
 #include <signal.h>
 #include <sched.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <strings.h>
 #include <unistd.h>
 #include <time.h>
 #include <rhapsody.h>
 #include "private.h"
+#include "cloud.h"
+#include "event.h"
+#include "pool.h"
+#include "segment.h"
 #include "utils.h"
 #include "task.h"
 
-extern void fsm_init(const FSM_CONFIG_T *fsm_config_ptr);
-extern void fsm_process(const FSM_CONFIG_T *fsm_config_ptr);
-
 volatile static int loop_done;
+static TASK_T *tasks;
+static int task_count;
 
 //!
 //! Handle interrupt signals
@@ -28,27 +35,43 @@ volatile static int loop_done;
 static void signal_handler(int signum)
 {
    loop_done = 1;
+   /* The loop may be waiting with nothing else due for a while */
+   event_wake();
 }
 
 //!
 //! Finite state machine loop
 //!
+//! Each device has its own task, all run by this one thread. A task runs
+//! when its timer is due, after it changed state, and when one of its
+//! sessions has something for it to act on. The loop sleeps until then.
+//!
 static void* fsm_loop(void* arg)
 {
+   int i;
+
    loop_done = 0;
    signal(SIGINT,  &signal_handler);
    signal(SIGQUIT, &signal_handler);
    signal(SIGTERM, &signal_handler);
+   /* A closed connection is reported by the send calls, sendfile() included */
+   signal(SIGPIPE, SIG_IGN);
 
-   fsm_init(&fsm_config);
-   while (!loop_done)
+   cloud_init();
+   for (i = 0; i < task_count; i++)
+   {
+      task_start(&tasks[i]);
+   }
+   while (!loop_done && (task_getRunning() > 0))
    {
-      fsm_process(&fsm_config);
-      if (get_task_completed())
+      if (task_runDue())
       {
-         break;
+         cloud_processEvents(0);
+      }
+      else if (task_getRunning() > 0)
+      {
+         cloud_processEvents(CLOUD_NO_DEADLINE);
       }
-      sleep(FSM_LOOP_DELAY);
    }
    pthread_exit(NULL);
 }
@@ -56,31 +79,245 @@ static void* fsm_loop(void* arg)
 //!
 //! Initialize default params
 //!
-static void init(void)
+static void init(TASK_T *t)
+{
+   task_init(t);
+   set_server_name(t, "");
+   set_target_file(t, "");
+   set_device_addr(t, "");
+   set_device_name(t, "");
+}
+
+#ifndef WEBGET
+//!
+//! Check a MAC address, six pairs of hex digits apart by ':' or '-'
+//!
+static bool valid_addr(const char *addr)
+{
+   int i;
+
+   if (strlen(addr) != DEVICE_ADDR_LEN - 1)
+   {
+      return false;
+   }
+   for (i = 0; i < DEVICE_ADDR_LEN - 1; i++)
+   {
+      if ((i % 3 == 2) ? ((addr[i] != ':') && (addr[i] != '-')) : !isxdigit((unsigned char)addr[i]))
+      {
+         return false;
+      }
+   }
+   return true;
+}
+
+//!
+//! Check a device identifier, which also names the directory of its files
+//!
+static bool valid_name(const char *name)
+{
+   return ((strlen(name) < DEVICE_NAME_LEN) && (name[0] != '.') && (strchr(name, '/') == NULL));
+}
+
+static int compare_addr(const void *a, const void *b)
+{
+   return strcasecmp((*(TASK_T * const *)a)->deviceAddr, (*(TASK_T * const *)b)->deviceAddr);
+}
+
+static int compare_name(const void *a, const void *b)
+{
+   return strcmp((*(TASK_T * const *)a)->deviceName, (*(TASK_T * const *)b)->deviceName);
+}
+
+//!
+//! Check that no two devices of the list share a MAC address, which sets
+//! the phase of their polls, or an identifier, which names their files
+//!
+//! @return true if all are unique
+//!
+static bool check_unique(int count)
 {
-   set_server_name("");
-   set_target_file("");
-   set_device_addr("");
-   set_device_name("");
+   TASK_T **sorted;
+   bool unique = true;
+   int i;
+
+   sorted = malloc(count * sizeof(TASK_T *));
+   if (sorted == NULL)
+   {
+      utils_sysLog(LOG_ERR, "Out of memory for the device list\n");
+      return false;
+   }
+   for (i = 0; i < count; i++)
+   {
+      sorted[i] = &tasks[i];
+   }
+   qsort(sorted, count, sizeof(TASK_T *), compare_addr);
+   for (i = 1; unique && (i < count); i++)
+   {
+      if (compare_addr(&sorted[i - 1], &sorted[i]) == 0)
+      {
+         utils_sysLog(LOG_ERR, "Devices %s and %s have the same MAC address %s\n",
+                      sorted[i - 1]->deviceName, sorted[i]->deviceName, sorted[i]->deviceAddr);
+         unique = false;
+      }
+   }
+   qsort(sorted, count, sizeof(TASK_T *), compare_name);
+   for (i = 1; unique && (i < count); i++)
+   {
+      if (compare_name(&sorted[i - 1], &sorted[i]) == 0)
+      {
+         utils_sysLog(LOG_ERR, "Devices %s and %s have the same identifier %s\n",
+                      sorted[i - 1]->deviceAddr, sorted[i]->deviceAddr, sorted[i]->deviceName);
+         unique = false;
+      }
+   }
+   free(sorted);
+   return unique;
 }
 
+//!
+//! Create a task for each device of a list file, with the options of the
+//! command line. Each line has the MAC address and the identifier of a
+//! device, then optionally its own time between polls in milliseconds.
+//! Blank lines and lines starting with # are skipped. A line whose MAC
+//! address or identifier is not valid, or is used by another line, fails
+//! the whole list.
+//!
+//! @param[in] file  Name of the device list file
+//! @param[in] t     Task with the options of the command line
+//!
+//! @return Number of tasks, -1 if failed
+//!
+static int load_devices(const char *file, const TASK_T *t)
+{
+   char line[256];
+   char addr[128];
+   char name[128];
+   unsigned int delay;
+   TASK_T *more;
+   FILE *fp;
+   int count = 0;
+   int size = 0;
+   int lineNo = 0;
+
+   fp = fopen(file, "r");
+   if (fp == NULL)
+   {
+      utils_sysLog(LOG_ERR, "Failed to open device list %s: %m\n", file);
+      return -1;
+   }
+   while (fgets(line, sizeof(line), fp) != NULL)
+   {
+      lineNo++;
+      if ((strchr(line, '\n') == NULL) && !feof(fp))
+      {
+         utils_sysLog(LOG_ERR, "%s:%d: line too long\n", file, lineNo);
+         count = -1;
+         break;
+      }
+      delay = 0;
+      if (sscanf(line, "%127s %127s %u", addr, name, &delay) < 2 || addr[0] == '#')
+      {
+         continue;
+      }
+      if (!valid_addr(addr) || !valid_name(name))
+      {
+         utils_sysLog(LOG_ERR, "%s:%d: need a MAC address like 00:11:22:33:44:55 and an identifier "
+                      "of at most %d characters, without '/' or a leading '.'\n",
+                      file, lineNo, DEVICE_NAME_LEN - 1);
+         count = -1;
+         break;
+      }
+      if (count == size)
+      {
+         more = realloc(tasks, (size ? size * 2 : 64) * sizeof(TASK_T));
+         if (more == NULL)
+         {
+            utils_sysLog(LOG_ERR, "Out of memory for device %s\n", name);
+            break;
+         }
+         tasks = more;
+         size = size ? size * 2 : 64;
+      }
+      tasks[count] = *t;
+      set_device_addr(&tasks[count], addr);
+      set_device_name(&tasks[count], name);
+      set_send_delay(&tasks[count], delay);
+#ifdef WEBPOLL
+      set_local_dir(&tasks[count], name);
+#endif
+      count++;
+   }
+   fclose(fp);
+   if (count == 0)
+   {
+      utils_sysLog(LOG_ERR, "No device in %s\n", file);
+      return -1;
+   }
+   if ((count < 0) || !check_unique(count))
+   {
+      return -1;
+   }
+   return count;
+}
+#endif
+
 //!
 //! Display program options
 //!
 static void usage(char *arg)
 {
-#ifdef DOWNLOAD
-   printf("Usage: %s [-h] [-f <>] [-i <>] [-m <>] [-s <>]\n", arg);
+#ifdef WEBGET
+   printf("Usage: %s [-h] [-f <>] [-i <>] [-m <>] [-n <>] [-p] [-s <>] [-u <>]\n", arg);
+#elif DOWNLOAD
+   printf("Usage: %s [-2] [-h] [-c <>] [-f <>] [-i <>] [-l <>] [-m <>] [-o <>] [-r <>] [-s <>] [-t <>] [-w <>]\n", arg);
 #else
-   printf("Usage: %s [-h] [-i <>] [-m <>] [-s <>]\n", arg);
+   printf("Usage: %s [-2] [-h] [-c <>] [-i <>] [-l <>] [-m <>] [-r <>] [-s <>] [-t <>]\n", arg);
+#endif
+#ifndef WEBGET
+   printf("  -2  send the requests of each poll as HTTP/2 streams on one connection, h2c with\n");
+   printf("      prior knowledge\n");
 #endif
    printf("  -h  display this usage\n");
+#ifndef WEBGET
+   printf("  -c  <channel path>, keep a WebSocket channel open to it instead of polling\n");
+#endif
 #ifdef DOWNLOAD
-   printf("  -f  <target file name>\n");
+   printf("  -f  <target file name>, repeat to pipeline up to %d files\n", TARGET_FILE_MAX);
 #endif
    printf("  -i  <device identifier>\n");
+#ifndef WEBGET
+   printf("  -l  <device list file>, run a task for each \"<MAC address> <identifier> [<ms>]\" line,\n");
+   printf("      each with its own time between polls if given\n");
+#endif
+#ifdef WEBPOLL
+   printf("      keeping the files of each device in a directory named after it\n");
+#endif
    printf("  -m  <device MAC address>\n");
+#ifdef WEBPOLL
+   printf("  -o  <shared memory name>, publish the first target file to it\n");
+#endif
+#ifndef WEBGET
+   printf("  -r  <requests>[,<requests per server>[,<channels>]], most requests in flight at once,\n");
+   printf("      default %d,%d, and most channels or subscriptions, each with its own connection,\n",
+          POOL_MAX_INFLIGHT, POOL_MAX_SESSIONS);
+   printf("      default %d\n", POOL_MAX_DEDICATED);
+#endif
+#ifdef WEBGET
+   printf("  -n  <connections>, fetch the first target file in ranges over up to %d connections\n", SEGMENT_MAX);
+   printf("  -p  upload with POST instead of PUT\n");
+#endif
    printf("  -s  <server URL or IP address>\n");
+#ifndef WEBGET
+   printf("  -t  <milliseconds>, time between polls, the first poll of each device is put off\n");
+   printf("      by a phase taken from its MAC address\n");
+#endif
+#ifdef WEBPOLL
+   printf("  -w  <seconds>, subscribe to the first target file, the server may hold the\n");
+   printf("      request or send events and heartbeats up to this long apart\n");
+#endif
+#ifdef WEBGET
+   printf("  -u  <local file name>, upload it to the first target file\n");
+#endif
 }
 
 //!
@@ -92,15 +329,24 @@ int main(int argc, char* argv[])
    pthread_attr_t attr;
    pthread_t thread;
    void* status;
+   TASK_T task;
+#ifndef WEBGET
+   char *devices = NULL;
+   int processMax = 0;
+   int originMax = 0;
+   int dedicatedMax = 0;
+#endif
    int c;
 
-   init();
+   init(&task);
    for (;;)
    {
-#ifdef DOWNLOAD
-      c = getopt(argc, argv, "hf:i:m:s:");
+#ifdef WEBGET
+      c = getopt(argc, argv, "hf:i:m:n:ps:u:");
+#elif DOWNLOAD
+      c = getopt(argc, argv, "2c:hf:i:l:m:o:r:s:t:w:");
 #else
-      c = getopt(argc, argv, "hi:m:s:");
+      c = getopt(argc, argv, "2c:hi:l:m:r:s:t:");
 #endif
       if (c < 0)
       {
@@ -111,20 +357,60 @@ int main(int argc, char* argv[])
          case 'h':
             usage(argv[0]);
             return -1;
+#ifndef WEBGET
+         case '2':
+            set_http2(&task, true);
+            break;
+         case 'c':
+            set_channel_path(&task, optarg);
+            break;
+         case 'l':
+            devices = optarg;
+            break;
+         case 'r':
+            if (sscanf(optarg, "%d,%d,%d", &processMax, &originMax, &dedicatedMax) < 1)
+            {
+               usage(argv[0]);
+               return -1;
+            }
+            break;
+         case 't':
+            set_send_delay(&task, strtoul(optarg, NULL, 10));
+            break;
+#endif
 #ifdef DOWNLOAD
          case 'f':
-            set_target_file(optarg);
+            set_target_file(&task, optarg);
             break;
 #endif
          case 'i':
-            set_device_name(optarg);
+            set_device_name(&task, optarg);
             break;
          case 'm':
-            set_device_addr(optarg);
+            set_device_addr(&task, optarg);
             break;
          case 's':
-            set_server_name(optarg);
+            set_server_name(&task, optarg);
+            break;
+#ifdef WEBPOLL
+         case 'o':
+            set_publish_name(&task, optarg);
+            break;
+         case 'w':
+            set_subscribe_wait(&task, atoi(optarg));
+            break;
+#endif
+#ifdef WEBGET
+         case 'u':
+            set_upload_file(&task, optarg);
             break;
+         case 'p':
+            set_upload_post(&task, true);
+            break;
+         case 'n':
+            set_segment_count(&task, atoi(optarg));
+            break;
+#endif
          default:
             usage(argv[0]);
             return -1;
@@ -135,6 +421,31 @@ int main(int argc, char* argv[])
       usage(argv[0]);
       return -1;
    }
+#ifndef WEBGET
+   if (devices != NULL)
+   {
+#ifdef WEBPOLL
+      if (task.publishName[0] != '\0')
+      {
+         utils_sysLog(LOG_ERR, "Only one device can publish to shared memory\n");
+         return -1;
+      }
+#endif
+      task_count = load_devices(devices, &task);
+      if (task_count < 0)
+      {
+         return -1;
+      }
+   }
+   else
+#endif
+   {
+      tasks = &task;
+      task_count = 1;
+   }
+#ifndef WEBGET
+   pool_setLimits(processMax, originMax, dedicatedMax);
+#endif
 #ifdef WEBALIVE
    utils_sysLog(LOG_INFO, "----- HTTP echo alive from a web server -----\n");
 #elif WEBPOLL
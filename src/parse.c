@@ -5,192 +5,590 @@
 //!
 //******************************************************************************
 
+#define _GNU_SOURCE
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
 #include "parse.h"
 
-#define CONTENT_LENGTH_STR       "Content-Length:"
-#define TRANSF_ENC_CHUNKED_STR   "Transfer-Encoding: chunked"
-#define HTTP_HEADER_TERMINATION  "\r\n\r\n"
+#define CONTENT_LENGTH_STR       "Content-Length"
+#define TRANSFER_ENCODING_STR    "Transfer-Encoding"
+#define CONTENT_RANGE_STR        "Content-Range"
+#define ETAG_STR                 "ETag"
+#define LAST_MODIFIED_STR        "Last-Modified"
+#define CONTENT_TYPE_STR         "Content-Type"
+#define EVENT_STREAM_STR         "text/event-stream"
+#define UPGRADE_STR              "Upgrade"
+#define PREFERENCE_APPLIED_STR   "Preference-Applied"
+#define WAIT_STR                 "wait"
+#define WEBSOCKET_STR            "websocket"
+#define WEBSOCKET_ACCEPT_STR     "Sec-WebSocket-Accept"
+#define BYTES_UNIT_STR           "bytes "
+#define CONNECTION_STR           "Connection"
+#define CHUNKED_STR              "chunked"
+#define CLOSE_STR                "close"
+#define KEEP_ALIVE_STR           "keep-alive"
+#define HTTP_VERSION_STR         "HTTP/1."
 #define MIN_GOOD_HTTP_STATUS     200
 #define MAX_GOOD_HTTP_STATUS     407
 
+//
+// Function Prototypes
+//
+static void parse_line(PARSE_RESPONSE_T *r);
+static void parse_statusLine(PARSE_RESPONSE_T *r);
+static void parse_headerLine(PARSE_RESPONSE_T *r);
+static void parse_headerEnd(PARSE_RESPONSE_T *r);
+static void parse_chunkSize(PARSE_RESPONSE_T *r);
+static void parse_contentRange(PARSE_RESPONSE_T *r, const char *value);
+static void parse_validator(char *validator, const char *value);
+static void parse_bodyBytes(PARSE_RESPONSE_T *r, size_t len);
+
 //!
-//! Get the start of the HTTP content.
+//! Get a response parser ready for the first byte of a response.
 //!
-//! @param[in] strPtr  Pointer to http string
-//! @return  Pointer to start of the HTTP content
+//! @param[out] r  Pointer to response parser
 //!
-char* parse_getContentStart(char* strPtr)
+void parse_initResponse(PARSE_RESPONSE_T *r)
 {
-   char* bodyStart = strstr(strPtr, HTTP_HEADER_TERMINATION) + 4;
-   return bodyStart;
+   r->state = PARSE_STATUS_LINE;
+   r->statusCode = -1;
+   r->minorVersion = 0;
+   r->keepAlive = false;
+   r->chunked = false;
+   r->connClose = false;
+   r->connKeep = false;
+   r->eventStream = false;
+   r->waitApplied = false;
+   r->upgradeWebSocket = false;
+   r->contentLength = -1;
+   r->rangeFirst = -1;
+   r->rangeLast = -1;
+   r->rangeTotal = -1;
+   r->etag[0] = '\0';
+   r->lastModified[0] = '\0';
+   r->websocketAccept[0] = '\0';
+   r->remaining = 0;
+   r->headerLen = 0;
+   r->length = 0;
+   r->lineLen = 0;
 }
 
 //!
-//! Get the content length from the specified http data buffer.
+//! Parse the next bytes of a response.
+//!
+//! Each byte is looked at once. Header, chunk size and trailer lines are
+//! collected in the parser, so they may be split across calls, while the
+//! payload bytes are passed to the body callback as they are found. For a
+//! chunked body only the chunk data is passed on. Parsing stops at the end
+//! of the response, so the bytes that are not consumed belong to the next
+//! pipelined response. The data is not NUL terminated and may hold any
+//! byte value.
 //!
-//! @param[in] strPtr  Pointer to http string
+//! @param[in,out] r  Pointer to response parser
+//! @param[in] data  Newly arrived bytes
+//! @param[in] len  Number of newly arrived bytes
+//! @param[in] cb  Body callback, or NULL
+//! @param[in] arg  Argument passed back to the body callback
 //!
-//! @return  -1 if content length not found, otherwise length in bytes
+//! @return  Number of bytes consumed
 //!
-int parse_getContentLength(char* strPtr)
+size_t parse_response(PARSE_RESPONSE_T *r, const char *data, size_t len, PARSE_BODY_CB_T cb, void *arg)
 {
-   char* tempPtr;
-   int content_length = -1;
+   const char *end;
+   size_t start = r->length;
+   size_t i = 0;
+   size_t n;
 
-   if (parse_fullHeaderFound(strPtr))
+   while ((i < len) && (PARSE_DONE != r->state) && (PARSE_ERROR != r->state))
    {
-      tempPtr = strstr(strPtr, CONTENT_LENGTH_STR);
-      if (tempPtr)
+      switch (r->state)
       {
-         tempPtr += strlen(CONTENT_LENGTH_STR); // Look past the "Content-Length"
-         content_length = strtol(tempPtr, NULL, 10);
+         case PARSE_BODY_LENGTH:
+         case PARSE_CHUNK_DATA:
+            n = len - i;
+            if (n > r->remaining)
+            {
+               n = (size_t)r->remaining;
+            }
+            if ((NULL != cb) && (n > 0))
+            {
+               cb(arg, &data[i], n);
+            }
+            i += n;
+            parse_bodyBytes(r, n);
+            break;
+
+         case PARSE_BODY_CLOSE:
+            /* The body ends when the server closes the connection */
+            if (NULL != cb)
+            {
+               cb(arg, &data[i], len - i);
+            }
+            r->length += len - i;
+            i = len;
+            break;
+
+         default:
+            end = memchr(&data[i], '\n', len - i);
+            n = (NULL != end) ? (size_t)(end - &data[i]) : (len - i);
+            if (n > (PARSE_LINE_LEN - 1 - r->lineLen))
+            {
+               /* Only the start of a long line is needed */
+               memcpy(&r->line[r->lineLen], &data[i], PARSE_LINE_LEN - 1 - r->lineLen);
+               r->lineLen = PARSE_LINE_LEN - 1;
+            }
+            else
+            {
+               memcpy(&r->line[r->lineLen], &data[i], n);
+               r->lineLen += n;
+            }
+            i += n;
+            r->length += n;
+            if (NULL != end)
+            {
+               i++;
+               r->length++;
+               parse_line(r);
+               r->lineLen = 0;
+            }
+            if (((PARSE_STATUS_LINE == r->state) || (PARSE_HEADER_LINE == r->state)) &&
+                (r->length > PARSE_MAX_HEADER_LEN))
+            {
+               r->state = PARSE_ERROR;
+            }
+            break;
       }
    }
 
-   return content_length;
+   return (r->length - start);
 }
 
 //!
-//! Determine if the header in the specified string contains "Content-Length:".
+//! Get the number of body bytes that follow without any framing.
+//!
+//! These are the rest of a body with a content-length, or the rest of the
+//! current chunk of a chunked body.
 //!
-//! @param[in] strPtr  Pointer to http string
-//! @return  true if the desired string is found, otherwise false
+//! @param[in] r  Pointer to response parser
+//! @return  Number of payload bytes, 0 if the next bytes need parsing
 //!
-bool parse_contentLengthFound(char* strPtr)
+uint64_t parse_bodyRemaining(const PARSE_RESPONSE_T *r)
 {
-   char* tempPtr;
-   bool  retval;
+   uint64_t remaining = 0;
 
-   tempPtr = strstr(strPtr, CONTENT_LENGTH_STR);
-   retval = (NULL != tempPtr);
+   if ((PARSE_BODY_LENGTH == r->state) || (PARSE_CHUNK_DATA == r->state))
+   {
+      remaining = r->remaining;
+   }
 
-   return retval;
+   return remaining;
 }
 
 //!
-//! Determine if the entire specified content length has been received.
+//! Account for payload bytes that were delivered without being parsed,
+//! e.g. moved straight from the socket to a file.
 //!
-//! @param[in] strPtr  Pointer to http string
-//! @param[in] bytesRcvd  Total number of received bytes
-//! @return  true if entire content length has been received, otherwise false
+//! @param[in,out] r  Pointer to response parser
+//! @param[in] len  Number of payload bytes, at most parse_bodyRemaining()
 //!
-bool parse_entireContentReceived(char* strPtr, size_t bytesRcvd)
+void parse_skipBody(PARSE_RESPONSE_T *r, size_t len)
 {
-   int content_length = 0;
-   bool retval = false;
-
-   content_length = parse_getContentLength(strPtr);
-   if (content_length >= 0)
+   if (len > parse_bodyRemaining(r))
    {
-      char* tempPtr = strstr(strPtr, HTTP_HEADER_TERMINATION) + 4;
-      size_t exp_bytes = (tempPtr - strPtr) + content_length;
-
-      if (exp_bytes == bytesRcvd)
-      {
-         retval = true;
-      }
+      r->state = PARSE_ERROR;
+      return;
    }
+   parse_bodyBytes(r, len);
+}
 
-   return retval;
+//!
+//! Determine if the whole response has been parsed.
+//!
+//! @param[in] r  Pointer to response parser
+//! @return  true if the response is complete, otherwise false
+//!
+bool parse_responseDone(const PARSE_RESPONSE_T *r)
+{
+   return (PARSE_DONE == r->state);
 }
 
+//!
+//! Determine if the response is malformed.
+//!
+//! @param[in] r  Pointer to response parser
+//! @return  true if the response cannot be parsed, otherwise false
+//!
+bool parse_responseFailed(const PARSE_RESPONSE_T *r)
+{
+   return (PARSE_ERROR == r->state);
+}
 
 //!
-//! Determine if the end of a data chunk is received.
+//! Tell the parser that the server closed the connection.
+//!
+//! @param[in,out] r  Pointer to response parser
+//! @return  true if the close completes the response, otherwise false
+//!
+bool parse_endOfStream(PARSE_RESPONSE_T *r)
+{
+   bool done = false;
+
+   if (PARSE_BODY_CLOSE == r->state)
+   {
+      r->state = PARSE_DONE;
+      done = true;
+   }
+
+   return done;
+}
+
 //!
-//! This function assumes that chunked encoding was found in the
-//! HTTP header.
+//! Determine if a good HTTP status code was received.
 //!
-//! @param[in] strPtr  Pointer to http string
-//! @return  true if end of chunk is received, otherwise false
+//! @param[in] code  Received status code
+//! @return  true if good HTTP status code received, otherwise false
 //!
-bool parse_fullDataChunkFound(char* strPtr)
+bool parse_goodStatusCode(int code)
 {
-   bool retval = false;
-   char* content;
+   bool good = false;
 
-   content = parse_getContentStart(strPtr);
-   if (content && strstr(content, "0\r\n\r\n"))
+   if ((code >= MIN_GOOD_HTTP_STATUS) && (code <= MAX_GOOD_HTTP_STATUS))
    {
-      retval = true;
+      good = true;
    }
 
-   return retval;
+   return good;
 }
 
 //!
-//! Determine if the end of the HTTP header is found in the specified
-//! string.
+//! Account for payload bytes of a body with a length or of a chunk.
 //!
-//! @param[in] strPtr  Pointer to http string
-//! @return  true if end of header is found, otherwise false
+//! @param[in,out] r  Pointer to response parser
+//! @param[in] len  Number of payload bytes
 //!
-bool parse_fullHeaderFound(char* strPtr)
+static void parse_bodyBytes(PARSE_RESPONSE_T *r, size_t len)
 {
-   char* tempPtr;
-   bool retval;
+   r->length += len;
+   r->remaining -= len;
+   if ((len > 0) && (0 == r->remaining))
+   {
+      r->state = (PARSE_BODY_LENGTH == r->state) ? PARSE_DONE : PARSE_CHUNK_END;
+   }
+}
 
-   tempPtr = strstr(strPtr, HTTP_HEADER_TERMINATION);
-   retval = (NULL != tempPtr);
+//!
+//! Interpret a complete line, without its line feed.
+//!
+//! @param[in,out] r  Pointer to response parser
+//!
+static void parse_line(PARSE_RESPONSE_T *r)
+{
+   if ((r->lineLen > 0) && ('\r' == r->line[r->lineLen - 1]))
+   {
+      r->lineLen--;
+   }
+   r->line[r->lineLen] = '\0';
 
-   return retval;
+   switch (r->state)
+   {
+      case PARSE_STATUS_LINE:
+         /* Empty lines before the status line are ignored */
+         if (r->lineLen > 0)
+         {
+            parse_statusLine(r);
+         }
+         break;
+
+      case PARSE_HEADER_LINE:
+         if (0 == r->lineLen)
+         {
+            parse_headerEnd(r);
+         }
+         else
+         {
+            parse_headerLine(r);
+         }
+         break;
+
+      case PARSE_CHUNK_SIZE:
+         parse_chunkSize(r);
+         break;
+
+      case PARSE_CHUNK_END:
+         r->state = (0 == r->lineLen) ? PARSE_CHUNK_SIZE : PARSE_ERROR;
+         break;
+
+      case PARSE_TRAILER:
+         if (0 == r->lineLen)
+         {
+            r->state = PARSE_DONE;
+         }
+         break;
+
+      default:
+         break;
+   }
 }
 
 //!
-//! Get the HTTP response code from the specified http string.
+//! Interpret the status line, e.g. "HTTP/1.1 200 OK".
 //!
-//! @param[in] strPtr  Pointer to http string
-//! @return  HTTP response code
+//! @param[in,out] r  Pointer to response parser
 //!
-int parse_getStatusCode(char* strPtr)
+static void parse_statusLine(PARSE_RESPONSE_T *r)
 {
-   char* tempPtr;
-   int status = -1;
+   const char *p = r->line;
+   int i;
 
-   tempPtr = strstr(strPtr, "HTTP/");
-   if (NULL != tempPtr)
+   if ((0 != strncmp(p, HTTP_VERSION_STR, strlen(HTTP_VERSION_STR))) ||
+       (r->lineLen < strlen(HTTP_VERSION_STR) + 5))
+   {
+      r->state = PARSE_ERROR;
+      return;
+   }
+   p += strlen(HTTP_VERSION_STR);
+   r->minorVersion = *p++ - '0';
+   if ((r->minorVersion < 0) || (r->minorVersion > 9) || (' ' != *p++))
    {
-      tempPtr += 8; // Look past the "HTTP/1.1"
-      status = strtol(tempPtr, NULL, 10);
+      r->state = PARSE_ERROR;
+      return;
    }
+   r->statusCode = 0;
+   for (i = 0; i < 3; i++)
+   {
+      if ((p[i] < '0') || (p[i] > '9'))
+      {
+         r->state = PARSE_ERROR;
+         return;
+      }
+      r->statusCode = (r->statusCode * 10) + (p[i] - '0');
+   }
+   r->state = PARSE_HEADER_LINE;
+}
+
+//!
+//! Split a header line into its name and value.
+//!
+//! @param[in,out] r  Pointer to response parser
+//!
+static void parse_headerLine(PARSE_RESPONSE_T *r)
+{
+   char *value;
+   size_t nameLen;
 
-   return status;
+   value = memchr(r->line, ':', r->lineLen);
+   if (NULL == value)
+   {
+      return;
+   }
+   nameLen = value - r->line;
+   value++;
+   while ((' ' == *value) || ('\t' == *value))
+   {
+      value++;
+   }
+   parse_field(r, r->line, nameLen, value);
 }
 
 //!
-//! Determine if a good HTTP status code was received.
+//! Interpret a header field, from a header line or from a decoded HTTP/2
+//! header block. Only the headers that frame the body or control the
+//! connection are looked at.
 //!
-//! @param[in] code  Received status code
-//! @return  true if good HTTP status code received, otherwise false
+//! @param[in,out] r  Pointer to response parser
+//! @param[in] name  Field name, in any case
+//! @param[in] nameLen  Length of the name
+//! @param[in] value  Field value, without leading white space
 //!
-bool parse_goodStatusCode(int code)
+void parse_field(PARSE_RESPONSE_T *r, const char *name, size_t nameLen, const char *value)
 {
-   bool good = false;
+   char *endPtr;
+   long long length;
 
-   if ((code >= MIN_GOOD_HTTP_STATUS) && (code <= MAX_GOOD_HTTP_STATUS))
+   if ((nameLen == strlen(CONTENT_LENGTH_STR)) &&
+       (0 == strncasecmp(name, CONTENT_LENGTH_STR, nameLen)))
    {
-      good = true;
+      length = strtoll(value, &endPtr, 10);
+      if ((endPtr == value) || (length < 0) ||
+          ((r->contentLength >= 0) && (r->contentLength != length)))
+      {
+         r->state = PARSE_ERROR;
+         return;
+      }
+      r->contentLength = length;
+   }
+   else if ((nameLen == strlen(TRANSFER_ENCODING_STR)) &&
+            (0 == strncasecmp(name, TRANSFER_ENCODING_STR, nameLen)))
+   {
+      r->chunked = (NULL != strcasestr(value, CHUNKED_STR));
+   }
+   else if ((nameLen == strlen(CONTENT_RANGE_STR)) &&
+            (0 == strncasecmp(name, CONTENT_RANGE_STR, nameLen)))
+   {
+      parse_contentRange(r, value);
+   }
+   else if ((nameLen == strlen(ETAG_STR)) &&
+            (0 == strncasecmp(name, ETAG_STR, nameLen)))
+   {
+      parse_validator(r->etag, value);
+   }
+   else if ((nameLen == strlen(LAST_MODIFIED_STR)) &&
+            (0 == strncasecmp(name, LAST_MODIFIED_STR, nameLen)))
+   {
+      parse_validator(r->lastModified, value);
+   }
+   else if ((nameLen == strlen(CONTENT_TYPE_STR)) &&
+            (0 == strncasecmp(name, CONTENT_TYPE_STR, nameLen)))
+   {
+      r->eventStream = (0 == strncasecmp(value, EVENT_STREAM_STR, strlen(EVENT_STREAM_STR)));
+   }
+   else if ((nameLen == strlen(PREFERENCE_APPLIED_STR)) &&
+            (0 == strncasecmp(name, PREFERENCE_APPLIED_STR, nameLen)))
+   {
+      r->waitApplied |= (NULL != strcasestr(value, WAIT_STR));
+   }
+   else if ((nameLen == strlen(UPGRADE_STR)) &&
+            (0 == strncasecmp(name, UPGRADE_STR, nameLen)))
+   {
+      r->upgradeWebSocket = (0 == strncasecmp(value, WEBSOCKET_STR, strlen(WEBSOCKET_STR)));
    }
+   else if ((nameLen == strlen(WEBSOCKET_ACCEPT_STR)) &&
+            (0 == strncasecmp(name, WEBSOCKET_ACCEPT_STR, nameLen)))
+   {
+      if (strlen(value) < PARSE_ACCEPT_LEN)
+      {
+         strcpy(r->websocketAccept, value);
+      }
+   }
+   else if ((nameLen == strlen(CONNECTION_STR)) &&
+            (0 == strncasecmp(name, CONNECTION_STR, nameLen)))
+   {
+      r->connClose |= (NULL != strcasestr(value, CLOSE_STR));
+      r->connKeep |= (NULL != strcasestr(value, KEEP_ALIVE_STR));
+   }
+}
 
-   return good;
+//!
+//! Interpret a Content-Range value, "bytes <first>-<last>/<total>" or
+//! "bytes */<total>". The total may be "*" when it is not known.
+//!
+//! @param[in,out] r  Pointer to response parser
+//! @param[in] value  Header value
+//!
+static void parse_contentRange(PARSE_RESPONSE_T *r, const char *value)
+{
+   char *endPtr;
+   long long first = -1;
+   long long last = -1;
+
+   if (0 != strncasecmp(value, BYTES_UNIT_STR, strlen(BYTES_UNIT_STR)))
+   {
+      return;
+   }
+   value += strlen(BYTES_UNIT_STR);
+   if ('*' == *value)
+   {
+      value++;
+   }
+   else
+   {
+      first = strtoll(value, &endPtr, 10);
+      if ((endPtr == value) || ('-' != *endPtr))
+      {
+         return;
+      }
+      value = endPtr + 1;
+      last = strtoll(value, &endPtr, 10);
+      if ((endPtr == value) || (first < 0) || (last < first))
+      {
+         return;
+      }
+      value = endPtr;
+   }
+   if ('/' != *value)
+   {
+      return;
+   }
+   r->rangeFirst = first;
+   r->rangeLast = last;
+   r->rangeTotal = ('*' == value[1]) ? -1 : strtoll(&value[1], NULL, 10);
+}
+
+//!
+//! Keep a cache validator to be sent back in a conditional request. A
+//! value too long to keep is dropped rather than cut short.
+//!
+//! @param[out] validator  Validator of PARSE_VALIDATOR_LEN bytes
+//! @param[in] value  Header value
+//!
+static void parse_validator(char *validator, const char *value)
+{
+   validator[0] = '\0';
+   if (strlen(value) < PARSE_VALIDATOR_LEN)
+   {
+      strcpy(validator, value);
+   }
 }
 
 //!
-//! Determine if the specified string contains "Transfer-Encoding: chunked".
+//! Decide how the body is framed once the header is complete.
+//!
+//! HTTP/1.1 connections persist unless "Connection: close" is sent,
+//! HTTP/1.0 connections only with "Connection: keep-alive". A body that
+//! is neither chunked nor has a length runs until the connection closes.
 //!
-//! @param[in] strPtr  Pointer to http string
-//! @return  true if the desired string is found, otherwise false
+//! @param[in,out] r  Pointer to response parser
 //!
-bool parse_transferEncodingChunkedFound(char* strPtr)
+static void parse_headerEnd(PARSE_RESPONSE_T *r)
 {
-   char* tempPtr;
-   bool retval;
+   r->headerLen = r->length;
+   r->keepAlive = !r->connClose && ((r->minorVersion > 0) || r->connKeep);
+
+   if (((r->statusCode >= HTTP_CONTINUE) && (r->statusCode < HTTP_SUCCESS)) ||
+       (HTTP_NO_CONTENT == r->statusCode) || (HTTP_NOT_MODIFIED == r->statusCode))
+   {
+      r->state = PARSE_DONE;
+   }
+   else if (r->chunked)
+   {
+      r->state = PARSE_CHUNK_SIZE;
+   }
+   else if (r->contentLength >= 0)
+   {
+      r->remaining = (uint64_t)r->contentLength;
+      r->state = (0 == r->remaining) ? PARSE_DONE : PARSE_BODY_LENGTH;
+   }
+   else
+   {
+      r->keepAlive = false;
+      r->state = PARSE_BODY_CLOSE;
+   }
+}
 
-   tempPtr = strstr(strPtr, TRANSF_ENC_CHUNKED_STR);
-   retval = (NULL != tempPtr);
+//!
+//! Interpret a chunk size line, e.g. "1f4;name=value".
+//!
+//! @param[in,out] r  Pointer to response parser
+//!
+static void parse_chunkSize(PARSE_RESPONSE_T *r)
+{
+   char *endPtr;
+   unsigned long long size;
 
-   return retval;
+   size = strtoull(r->line, &endPtr, 16);
+   if ((endPtr == r->line) || (('\0' != *endPtr) && (';' != *endPtr) &&
+                               (' ' != *endPtr) && ('\t' != *endPtr)))
+   {
+      r->state = PARSE_ERROR;
+   }
+   else if (0 == size)
+   {
+      r->state = PARSE_TRAILER;
+   }
+   else
+   {
+      r->remaining = size;
+      r->state = PARSE_CHUNK_DATA;
+   }
 }
@@ -0,0 +1,364 @@
+//******************************************************************************
+//!
+//! Author:  Ying Xiong
+//! Created: Oct 2026
+//!
+//******************************************************************************
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "cloud.h"
+#include "event.h"
+#include "pool.h"
+#include "task.h"
+#include "utils.h"
+
+//
+// Pool Session Slot
+//
+typedef struct
+{
+   CLOUD_SESSION_T session;           //!< Session kept by the pool
+   bool inUse;                        //!< Session is handed out to a caller
+   bool dedicated;                    //!< Session of one caller, outside the slots of its origin
+}
+POOL_SLOT_T;
+
+//
+// Pool Origin Entry, one per server and port
+//
+typedef struct
+{
+   char serverName[SERVER_NAME_LEN];  //!< Server URL or IP address
+   uint16_t serverPort;               //!< Server port number
+   CLOUD_DIAGS_T diags;               //!< Diagnostics shared by the origin sessions
+   int inFlight;                      //!< Sessions handed out, the tokens of the origin taken
+   POOL_SLOT_T slots[POOL_MAX_SESSIONS];
+}
+POOL_ORIGIN_T;
+
+//
+// Local Variables
+//
+static POOL_ORIGIN_T origins[POOL_MAX_ORIGINS];
+static int originCount = 0;
+static bool sessionWaited = false;
+static POOL_RELEASE_CB_T releaseCallback = NULL;
+static int inFlight = 0;                      /* Sessions handed out, the tokens of the process taken */
+static int processLimit = POOL_MAX_INFLIGHT;  /* Tokens of the process */
+static int originLimit = POOL_MAX_SESSIONS;   /* Tokens of each origin */
+static int dedicatedCount = 0;                /* Dedicated sessions handed out */
+static int dedicatedLimit = POOL_MAX_DEDICATED;
+
+//!
+//! Set up a session slot of an origin that has no connection yet
+//!
+static void pool_initSlot(POOL_ORIGIN_T *o, POOL_SLOT_T *slot)
+{
+   slot->session.name = o->serverName;
+   slot->session.handle = CLOUD_INVALID_SOCKET;
+   slot->session.fallback.handle = CLOUD_INVALID_SOCKET;
+   slot->session.status = CLOUD_SESSION_IDLE;
+   slot->session.diags = &o->diags;
+}
+
+//!
+//! Find the origin entry of a server
+//!
+//! @return  Pointer to the origin entry, or NULL if there is none yet
+//!
+static POOL_ORIGIN_T* pool_findOrigin(const char *serverName, uint16_t serverPort)
+{
+   POOL_ORIGIN_T *o;
+   int i;
+
+   for (i = 0; i < originCount; i++)
+   {
+      o = &origins[i];
+      if ((o->serverPort == serverPort) && (0 == strcmp(o->serverName, serverName)))
+      {
+         return o;
+      }
+   }
+
+   return NULL;
+}
+
+//!
+//! Find the origin entry of a server, creating it if needed.
+//!
+//! @return  Pointer to the origin entry, or NULL if the pool is full
+//!
+static POOL_ORIGIN_T* pool_getOrigin(char *serverName, uint16_t serverPort)
+{
+   POOL_ORIGIN_T *o;
+   int i;
+
+   o = pool_findOrigin(serverName, serverPort);
+   if (NULL != o)
+   {
+      return o;
+   }
+   if ((originCount >= POOL_MAX_ORIGINS) || (strlen(serverName) >= SERVER_NAME_LEN))
+   {
+      utils_sysLog(LOG_ERR, "No pool entry left for %s:%u\n", serverName, serverPort);
+      return NULL;
+   }
+   o = &origins[originCount++];
+   memset(o, 0, sizeof(POOL_ORIGIN_T));
+   strcpy(o->serverName, serverName);
+   o->serverPort = serverPort;
+   for (i = 0; i < POOL_MAX_SESSIONS; i++)
+   {
+      pool_initSlot(o, &o->slots[i]);
+   }
+
+   return o;
+}
+
+//!
+//! Allocate the buffers of a pool session on first use.
+//!
+static bool pool_allocBuffers(CLOUD_SESSION_T *s)
+{
+   if (NULL == s->sendBuf)
+   {
+      s->sendBuf = malloc(CLOUD_SEND_BUF_LEN);
+   }
+   if (NULL == s->recvBuf)
+   {
+      s->recvBuf = malloc(CLOUD_RECV_BUF_LEN);
+      s->recvBufLen = CLOUD_RECV_BUF_LEN;
+   }
+
+   return ((NULL != s->sendBuf) && (NULL != s->recvBuf));
+}
+
+//!
+//! Get a session to a server from the pool.
+//!
+//! A session whose connection was kept alive is preferred, so consecutive
+//! transactions to the same origin reuse the same TCP connection. The
+//! session takes a token of the process and one of the origin, so that
+//! no more requests than the limits are in flight at once.
+//!
+//! @param[in] serverName  Pointer to server name string
+//! @param[in] serverPort  Server port number
+//!
+//! @return  Pointer to the session, or NULL if none is available, with
+//!          errno EBUSY while all sessions to the server are in use or
+//!          no token is left
+//!
+CLOUD_SESSION_T* pool_acquireSession(char *serverName, uint16_t serverPort)
+{
+   POOL_ORIGIN_T *o;
+   POOL_SLOT_T *slot = NULL;
+   int i;
+
+   o = pool_getOrigin(serverName, serverPort);
+   if (NULL == o)
+   {
+      errno = ENOSPC;
+      return NULL;
+   }
+   if ((inFlight >= processLimit) || (o->inFlight >= originLimit))
+   {
+      utils_sysLog(LOG_DEBUG, "No token left for a request to %s:%u\n", serverName, serverPort);
+      sessionWaited = true;
+      errno = EBUSY;
+      return NULL;
+   }
+   for (i = 0; i < POOL_MAX_SESSIONS; i++)
+   {
+      if (!o->slots[i].inUse)
+      {
+         if (CLOUD_INVALID_SOCKET != o->slots[i].session.handle)
+         {
+            slot = &o->slots[i];
+            break;
+         }
+         if (NULL == slot)
+         {
+            slot = &o->slots[i];
+         }
+      }
+   }
+   if (NULL == slot)
+   {
+      utils_sysLog(LOG_DEBUG, "All sessions to %s:%u are busy\n", serverName, serverPort);
+      sessionWaited = true;
+      errno = EBUSY;
+      return NULL;
+   }
+   if (!pool_allocBuffers(&slot->session))
+   {
+      utils_sysLog(LOG_ERR, "No memory for session to %s:%u\n", serverName, serverPort);
+      errno = ENOMEM;
+      return NULL;
+   }
+   slot->inUse = true;
+   o->inFlight++;
+   inFlight++;
+
+   return &slot->session;
+}
+
+//!
+//! Check that a session to a server can be had from the pool now
+//!
+//! @param[in] serverName  Pointer to server name string
+//! @param[in] serverPort  Server port number
+//!
+//! @return  true if both a token of the process and one of the origin are left
+//!
+bool pool_isAvailable(const char *serverName, uint16_t serverPort)
+{
+   POOL_ORIGIN_T *o;
+
+   if (inFlight >= processLimit)
+   {
+      return false;
+   }
+   o = pool_findOrigin(serverName, serverPort);
+
+   return ((NULL == o) || (o->inFlight < originLimit));
+}
+
+//!
+//! Get the dedicated session of a caller whose requests last for long,
+//! such as a WebSocket channel or a held subscription.
+//!
+//! Such a session would keep a slot of its origin busy for as long as it
+//! lasts, so it has one of its own outside the slots and takes no token.
+//! It is made on first use, from a budget of its own, and then kept by the
+//! caller with its connection from one transaction to the next.
+//!
+//! @param[in] serverName  Pointer to server name string
+//! @param[in] serverPort  Server port number
+//! @param[in,out] session  Dedicated session of the caller, NULL until made
+//!
+//! @return  Pointer to the session, or NULL with errno ENOSPC when the
+//!          budget is used up or ENOMEM
+//!
+CLOUD_SESSION_T* pool_acquireDedicated(char *serverName, uint16_t serverPort, CLOUD_SESSION_T **session)
+{
+   POOL_ORIGIN_T *o;
+   POOL_SLOT_T *slot = (POOL_SLOT_T *)*session;
+
+   if (NULL == slot)
+   {
+      o = pool_getOrigin(serverName, serverPort);
+      if (NULL == o)
+      {
+         errno = ENOSPC;
+         return NULL;
+      }
+      if (dedicatedCount >= dedicatedLimit)
+      {
+         utils_sysLog(LOG_ERR, "No dedicated session left for %s:%u\n", serverName, serverPort);
+         errno = ENOSPC;
+         return NULL;
+      }
+      slot = calloc(1, sizeof(POOL_SLOT_T));
+      if (NULL == slot)
+      {
+         utils_sysLog(LOG_ERR, "No memory for session to %s:%u\n", serverName, serverPort);
+         errno = ENOMEM;
+         return NULL;
+      }
+      pool_initSlot(o, slot);
+      slot->dedicated = true;
+      dedicatedCount++;
+      *session = &slot->session;
+   }
+   if (!pool_allocBuffers(&slot->session))
+   {
+      utils_sysLog(LOG_ERR, "No memory for session to %s:%u\n", serverName, serverPort);
+      errno = ENOMEM;
+      return NULL;
+   }
+   slot->inUse = true;
+
+   return &slot->session;
+}
+
+//!
+//! Give a session back to the pool at the end of a transaction.
+//!
+//! The connection stays open for the next caller if the server allows it.
+//! A caller that found all sessions busy is woken up to try again.
+//!
+//! @param[in] s  Pointer to session structure
+//!
+void pool_releaseSession(CLOUD_SESSION_T *s)
+{
+   POOL_SLOT_T *slot = (POOL_SLOT_T *)s;
+   int i;
+
+   cloud_releaseSession(s);
+   slot->inUse = false;
+   if (slot->dedicated)
+   {
+      /* Kept by its caller, it took no token */
+      return;
+   }
+   for (i = 0; i < originCount; i++)
+   {
+      if ((slot >= origins[i].slots) && (slot < &origins[i].slots[POOL_MAX_SESSIONS]))
+      {
+         origins[i].inFlight--;
+         break;
+      }
+   }
+   inFlight--;
+   if (sessionWaited)
+   {
+      sessionWaited = false;
+      event_wake();
+   }
+   if (NULL != releaseCallback)
+   {
+      releaseCallback();
+   }
+}
+
+//!
+//! Set the function told of each session given back to the pool, so that
+//! callers that found all sessions busy can wait without polling.
+//!
+//! @param[in] callback  Function to call, NULL for none
+//!
+void pool_setReleaseCallback(POOL_RELEASE_CB_T callback)
+{
+   releaseCallback = callback;
+}
+
+//!
+//! Set the most requests in flight at once, in the process and to each
+//! origin. A fleet of devices behind one process then cannot hit a server
+//! all at the same time.
+//!
+//! @param[in] processMax    Tokens of the process, 0 to keep the limit
+//! @param[in] originMax     Tokens of each origin, at most POOL_MAX_SESSIONS,
+//!                          0 to keep the limit
+//! @param[in] dedicatedMax  Dedicated sessions, 0 to keep the limit
+//!
+void pool_setLimits(int processMax, int originMax, int dedicatedMax)
+{
+   if (processMax > 0)
+   {
+      processLimit = processMax;
+   }
+   if (originMax > 0)
+   {
+      originLimit = (originMax < POOL_MAX_SESSIONS) ? originMax : POOL_MAX_SESSIONS;
+   }
+   if (dedicatedMax > 0)
+   {
+      dedicatedLimit = dedicatedMax;
+   }
+}
+
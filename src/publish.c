@@ -0,0 +1,345 @@
+//******************************************************************************
+//!
+//! Author:  Ying Xiong
+//! Created: Oct 2026
+//!
+//******************************************************************************
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "publish.h"
+#include "utils.h"
+
+//
+// Function Prototypes
+//
+static int publish_openSegment(const char *name, int flags);
+static bool publish_map(PUBLISH_T *p, int fd, int prot);
+
+//!
+//! Create or take over a shared segment to publish content to.
+//!
+//! A segment of the same capacity left by an earlier writer is kept, so
+//! its version keeps counting up for the readers.
+//!
+//! @param[out] p  Pointer to publisher
+//! @param[in] name  Name of the segment, e.g. "webpoll"
+//! @param[in] capacity  Largest content to publish
+//!
+//! @return  true if the segment is ready, otherwise false
+//!
+bool publish_open(PUBLISH_T *p, const char *name, size_t capacity)
+{
+   PUBLISH_SEGMENT_T *seg;
+   int fd;
+
+   p->seg = NULL;
+   if (capacity > UINT32_MAX)
+   {
+      return false;
+   }
+   fd = publish_openSegment(name, O_RDWR | O_CREAT);
+   if (fd < 0)
+   {
+      utils_sysLog(LOG_ERR, "Shared segment '%s' errno: %s\n", name, strerror(errno));
+      return false;
+   }
+   if ((ftruncate(fd, sizeof(PUBLISH_SEGMENT_T) + capacity) < 0) ||
+       !publish_map(p, fd, PROT_READ | PROT_WRITE))
+   {
+      utils_sysLog(LOG_ERR, "Shared segment '%s' errno: %s\n", name, strerror(errno));
+      close(fd);
+      return false;
+   }
+   close(fd);
+
+   seg = p->seg;
+   if ((PUBLISH_MAGIC != seg->magic) || (capacity != seg->capacity))
+   {
+      __atomic_store_n(&seg->magic, 0, __ATOMIC_RELEASE);
+      seg->capacity = capacity;
+      seg->sequence = 0;
+      seg->version = 0;
+      seg->timestamp = 0;
+      seg->length = 0;
+      __atomic_store_n(&seg->magic, PUBLISH_MAGIC, __ATOMIC_RELEASE);
+   }
+   else if (seg->sequence & 1)
+   {
+      /* The last writer stopped halfway, its content is not trusted */
+      seg->length = 0;
+      __atomic_store_n(&seg->sequence, seg->sequence + 1, __ATOMIC_RELEASE);
+   }
+
+   return true;
+}
+
+//!
+//! Replace the published content.
+//!
+//! Readers never wait on the writer, they retry while the sequence shows
+//! the content is being replaced.
+//!
+//! @param[in] p  Pointer to publisher
+//! @param[in] data  New content
+//! @param[in] len  Bytes of new content
+//!
+//! @return  true if the content is published, otherwise false
+//!
+bool publish_update(PUBLISH_T *p, const char *data, size_t len)
+{
+   PUBLISH_SEGMENT_T *seg = p->seg;
+   struct timespec now;
+   uint64_t seq;
+
+   if (NULL == seg)
+   {
+      return false;
+   }
+   if (len > p->capacity)
+   {
+      utils_sysLog(LOG_ERR, "Cannot publish %zu bytes, the shared segment holds %zu\n",
+                   len, p->capacity);
+      return false;
+   }
+   clock_gettime(CLOCK_REALTIME, &now);
+
+   seq = seg->sequence;
+   __atomic_store_n(&seg->sequence, seq + 1, __ATOMIC_RELAXED);
+   __atomic_thread_fence(__ATOMIC_RELEASE);
+   memcpy(seg->data, data, len);
+   seg->length = len;
+   seg->version++;
+   seg->timestamp = (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+   __atomic_store_n(&seg->sequence, seq + 2, __ATOMIC_RELEASE);
+
+   return true;
+}
+
+//!
+//! Publish the content of a file.
+//!
+//! @param[in] p  Pointer to publisher
+//! @param[in] path  File to publish
+//!
+//! @return  true if the content is published, otherwise false
+//!
+bool publish_file(PUBLISH_T *p, const char *path)
+{
+   struct stat st;
+   char *data = NULL;
+   bool done = false;
+   int fd;
+
+   fd = open(path, O_RDONLY | O_CLOEXEC);
+   if ((fd < 0) || (fstat(fd, &st) < 0))
+   {
+      utils_sysLog(LOG_ERR, "Open '%s' errno: %s\n", path, strerror(errno));
+   }
+   else if (0 == st.st_size)
+   {
+      done = publish_update(p, "", 0);
+   }
+   else
+   {
+      data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (MAP_FAILED == data)
+      {
+         utils_sysLog(LOG_ERR, "Map '%s' errno: %s\n", path, strerror(errno));
+      }
+      else
+      {
+         done = publish_update(p, data, st.st_size);
+         munmap(data, st.st_size);
+      }
+   }
+   if (fd >= 0)
+   {
+      close(fd);
+   }
+
+   return done;
+}
+
+//!
+//! Attach to a shared segment to read the content published to it.
+//!
+//! @param[out] p  Pointer to reader
+//! @param[in] name  Name of the segment given to the writer
+//!
+//! @return  true if the segment is attached, otherwise false
+//!
+bool publish_attach(PUBLISH_T *p, const char *name)
+{
+   int fd;
+
+   p->seg = NULL;
+   fd = publish_openSegment(name, O_RDONLY);
+   if (fd < 0)
+   {
+      return false;
+   }
+   if (!publish_map(p, fd, PROT_READ))
+   {
+      close(fd);
+      return false;
+   }
+   close(fd);
+   if (PUBLISH_MAGIC != __atomic_load_n(&p->seg->magic, __ATOMIC_ACQUIRE))
+   {
+      /* The writer has not set the segment up yet */
+      publish_close(p);
+      errno = EAGAIN;
+      return false;
+   }
+
+   return true;
+}
+
+//!
+//! Get the version of the published content without copying it, so that
+//! a reader can poll cheaply for a change.
+//!
+//! @param[in] p  Pointer to reader
+//!
+//! @return  Version of the content, 0 if nothing is published yet
+//!
+uint64_t publish_version(const PUBLISH_T *p)
+{
+   return __atomic_load_n(&p->seg->version, __ATOMIC_ACQUIRE);
+}
+
+//!
+//! Copy the published content.
+//!
+//! Takes no lock. The copy is taken again if the writer replaced the
+//! content meanwhile, which only gives up after PUBLISH_READ_TRIES tries.
+//!
+//! @param[in] p  Pointer to reader
+//! @param[out] buf  Buffer for the content
+//! @param[in] len  Size of the buffer
+//! @param[out] version  Version of the content, may be NULL
+//! @param[out] timestamp  Publication time in ms since the epoch, may be NULL
+//!
+//! @return  Bytes of content, or -1 with errno ENOBUFS if the buffer is too
+//!          small or EAGAIN if no consistent copy could be taken
+//!
+ssize_t publish_read(const PUBLISH_T *p, char *buf, size_t len, uint64_t *version,
+                     uint64_t *timestamp)
+{
+   const PUBLISH_SEGMENT_T *seg = p->seg;
+   uint64_t seq;
+   uint64_t length;
+   uint64_t ver;
+   uint64_t stamp;
+   int i;
+
+   for (i = 0; i < PUBLISH_READ_TRIES; i++)
+   {
+      seq = __atomic_load_n(&seg->sequence, __ATOMIC_ACQUIRE);
+      if (seq & 1)
+      {
+         sched_yield();
+         continue;
+      }
+      length = __atomic_load_n(&seg->length, __ATOMIC_RELAXED);
+      ver = __atomic_load_n(&seg->version, __ATOMIC_RELAXED);
+      stamp = __atomic_load_n(&seg->timestamp, __ATOMIC_RELAXED);
+      if ((length <= p->capacity) && (length <= len))
+      {
+         memcpy(buf, seg->data, length);
+      }
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+      if (seq != __atomic_load_n(&seg->sequence, __ATOMIC_RELAXED))
+      {
+         continue;
+      }
+      if (length > len)
+      {
+         errno = ENOBUFS;
+         return -1;
+      }
+      if (NULL != version)
+      {
+         *version = ver;
+      }
+      if (NULL != timestamp)
+      {
+         *timestamp = stamp;
+      }
+      return (ssize_t)length;
+   }
+   errno = EAGAIN;
+
+   return -1;
+}
+
+//!
+//! Detach from a shared segment. The segment itself stays for the other
+//! writers and readers.
+//!
+//! @param[in,out] p  Pointer to publisher or reader
+//!
+void publish_close(PUBLISH_T *p)
+{
+   if (NULL != p->seg)
+   {
+      munmap(p->seg, p->mapLen);
+      p->seg = NULL;
+   }
+}
+
+//!
+//! Open a shared segment by name, adding the leading slash it needs. The
+//! reader side does not log but leaves errno to its caller, since a reader
+//! that comes before the writer is expected to try again.
+//!
+//! @return  Descriptor of the segment, or -1
+//!
+static int publish_openSegment(const char *name, int flags)
+{
+   char path[PUBLISH_NAME_LEN];
+
+   if ((strlen(name) + 2) > PUBLISH_NAME_LEN)
+   {
+      errno = ENAMETOOLONG;
+      return -1;
+   }
+   sprintf(path, "%s%s", ('/' == name[0]) ? "" : "/", name);
+
+   return shm_open(path, flags | O_CLOEXEC, 0644);
+}
+
+//!
+//! Map the whole of a shared segment.
+//!
+//! @return  true if the segment is mapped, otherwise false
+//!
+static bool publish_map(PUBLISH_T *p, int fd, int prot)
+{
+   struct stat st;
+   void *addr;
+
+   if ((fstat(fd, &st) < 0) || (st.st_size < (off_t)sizeof(PUBLISH_SEGMENT_T)))
+   {
+      errno = EINVAL;
+      return false;
+   }
+   addr = mmap(NULL, st.st_size, prot, MAP_SHARED, fd, 0);
+   if (MAP_FAILED == addr)
+   {
+      return false;
+   }
+   p->seg = addr;
+   p->mapLen = st.st_size;
+   p->capacity = st.st_size - sizeof(PUBLISH_SEGMENT_T);
+
+   return true;
+}
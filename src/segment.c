@@ -0,0 +1,810 @@
+//******************************************************************************
+//!
+//! Author:  Ying Xiong
+//! Created: Oct 2026
+//!
+//******************************************************************************
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "parse.h"
+#include "pool.h"
+#include "segment.h"
+#include "utils.h"
+
+//
+// Function Prototypes
+//
+static void segment_startSlots(SEGMENT_DOWNLOAD_T *d);
+static void segment_saveState(SEGMENT_DOWNLOAD_T *d);
+
+//!
+//! Initialize a segmented download that is not running.
+//!
+//! @param[out] d  Pointer to segmented download
+//! @param[in] requestCb  Builds the request of a range
+//! @param[in] wakeCb  Runs the owner, who calls segment_process(), when a
+//!                    connection has something to act on
+//! @param[in] deadlines  Deadlines of each range request
+//! @param[in] arg  Argument passed back to the request and wake callbacks
+//!
+void segment_init(SEGMENT_DOWNLOAD_T *d, SEGMENT_REQUEST_CB_T requestCb,
+                  CLOUD_WAKE_CB_T wakeCb, const CLOUD_DEADLINES_T *deadlines, void *arg)
+{
+   memset(d, 0, sizeof(SEGMENT_DOWNLOAD_T));
+   sink_init(&d->sink);
+   d->requestCb = requestCb;
+   d->wakeCb = wakeCb;
+   d->requestArg = arg;
+   d->deadlines = *deadlines;
+   d->total = -1;
+}
+
+//!
+//! Find the slot whose connection runs on a session.
+//!
+//! @return  Pointer to the slot, or NULL if the session is not in use
+//!
+static SEGMENT_SLOT_T* segment_findSlot(SEGMENT_DOWNLOAD_T *d, CLOUD_SESSION_T *s)
+{
+   int i;
+
+   for (i = 0; i < d->connections; i++)
+   {
+      if (d->slots[i].session == s)
+      {
+         return &d->slots[i];
+      }
+   }
+
+   return NULL;
+}
+
+//!
+//! Determine if a slot is fetching a range.
+//!
+static bool segment_isOwned(SEGMENT_DOWNLOAD_T *d, int range)
+{
+   int i;
+
+   for (i = 0; i < d->connections; i++)
+   {
+      if ((NULL != d->slots[i].session) && (d->slots[i].range == range))
+      {
+         return true;
+      }
+   }
+
+   return false;
+}
+
+//!
+//! Get the validator of a response that If-Range can use, a strong ETag
+//! or else Last-Modified.
+//!
+//! @return  Validator, empty if the response has none
+//!
+static const char* segment_validator(const PARSE_RESPONSE_T *r)
+{
+   if ((0 != strlen(r->etag)) && (0 != strncmp(r->etag, "W/", 2)))
+   {
+      return r->etag;
+   }
+
+   return r->lastModified;
+}
+
+//!
+//! Determine if a range response comes from another version of the file
+//! than the ranges fetched so far, by its length or its validator.
+//!
+static bool segment_isChanged(const SEGMENT_DOWNLOAD_T *d, const PARSE_RESPONSE_T *r)
+{
+   const char *validator = ('"' == d->validator[0]) ? r->etag : r->lastModified;
+
+   if ((d->total >= 0) && (r->rangeTotal >= 0) && (r->rangeTotal != d->total))
+   {
+      return true;
+   }
+
+   return (0 != strlen(d->validator)) && (0 != strlen(validator)) &&
+          (0 != strcmp(validator, d->validator));
+}
+
+//!
+//! Split the file into ranges once its length is known from the response
+//! to the first range.
+//!
+//! @param[in,out] d  Pointer to segmented download
+//! @param[in] total  Length of the file
+//! @param[in] probeEnd  One past the last byte of the first response
+//!
+static void segment_split(SEGMENT_DOWNLOAD_T *d, uint64_t total, uint64_t probeEnd)
+{
+   uint64_t first;
+   uint64_t size;
+   uint64_t rest;
+   uint64_t parts;
+
+   d->total = (int64_t)total;
+   if (probeEnd > total)
+   {
+      probeEnd = total;
+   }
+   d->ranges[0].end = probeEnd;
+   d->rangeCount = 1;
+
+   /* The first connection is busy with the first range, the others share the rest */
+   rest = total - probeEnd;
+   parts = (d->connections > 1) ? (d->connections - 1) : 1;
+   if (parts > rest)
+   {
+      parts = rest;
+   }
+   if (parts > 0)
+   {
+      size = (rest + parts - 1) / parts;
+      for (first = probeEnd; first < total; first += size)
+      {
+         d->ranges[d->rangeCount].next = first;
+         d->ranges[d->rangeCount].end = ((total - first) > size) ? (first + size) : total;
+         d->ranges[d->rangeCount].failures = 0;
+         d->rangeCount++;
+      }
+   }
+   sink_reserve(&d->sink, total);
+   utils_sysLog(LOG_INFO, "Fetching %llu bytes of '%s' in %d ranges\n",
+                (unsigned long long)total, d->sink.path, d->rangeCount);
+   segment_saveState(d);
+}
+
+//!
+//! Check the response of a slot against the range it asked for, once per
+//! response. The first response also tells the length of the file, or
+//! that the server ignores ranges.
+//!
+//! @return  true if the payload belongs to the range, otherwise false
+//!
+static bool segment_accept(SEGMENT_DOWNLOAD_T *d, SEGMENT_SLOT_T *slot, CLOUD_SESSION_T *s)
+{
+   PARSE_RESPONSE_T *r = &s->response;
+   SEGMENT_RANGE_T *range = &d->ranges[slot->range];
+
+   if (slot->accepted >= 0)
+   {
+      return (slot->accepted > 0);
+   }
+   slot->accepted = 0;
+   if (((HTTP_PARTIAL_CONTENT == r->statusCode) && !d->whole && segment_isChanged(d, r)) ||
+       ((HTTP_SUCCESS == r->statusCode) && !d->whole && (d->total >= 0)))
+   {
+      /* The If-Range did not match, or the server sends ranges of a new version */
+      utils_sysLog(LOG_INFO, "Received http status %d for bytes %llu-%llu of '%s' that changed\n",
+                   r->statusCode, (unsigned long long)range->next,
+                   (unsigned long long)(range->end - 1), d->sink.path);
+      d->changed = true;
+   }
+   else if ((HTTP_PARTIAL_CONTENT == r->statusCode) && !d->whole &&
+            (r->rangeFirst == (int64_t)range->next) && (r->rangeTotal >= 0))
+   {
+      slot->accepted = 1;
+      if (d->total < 0)
+      {
+         strcpy(d->validator, segment_validator(r));
+         segment_split(d, r->rangeTotal, r->rangeLast + 1);
+         segment_startSlots(d);
+      }
+   }
+   else if ((HTTP_PARTIAL_CONTENT == r->statusCode) && d->whole &&
+            (r->rangeFirst == (int64_t)range->next) && (r->rangeTotal == d->total))
+   {
+      /* The If-Range matched, the file sent in one piece goes on where it stopped */
+      slot->accepted = 1;
+      utils_sysLog(LOG_INFO, "Resuming '%s' at %llu\n", d->sink.path,
+                   (unsigned long long)range->next);
+   }
+   else if ((HTTP_SUCCESS == r->statusCode) &&
+            (d->whole || ((0 == range->next) && (d->total < 0))))
+   {
+      /* The whole file is sent, it cannot be shared */
+      slot->accepted = 1;
+      if (!d->whole)
+      {
+         utils_sysLog(LOG_INFO, "Server sends '%s' in one piece\n", d->sink.path);
+         unlink(d->statePath);
+         d->whole = true;
+      }
+      range->next = 0;
+      strcpy(d->validator, segment_validator(r));
+      d->rangeCount = 1;
+      d->total = r->chunked ? -1 : r->contentLength;
+      range->end = (d->total >= 0) ? (uint64_t)d->total : UINT64_MAX;
+      if (d->total >= 0)
+      {
+         sink_reserve(&d->sink, d->total);
+      }
+   }
+   else if ((HTTP_RANGE_NOT_SATISFIABLE == r->statusCode) && (d->total < 0) &&
+            (0 == r->rangeTotal))
+   {
+      /* An empty file has no first range */
+      segment_split(d, 0, 0);
+   }
+   else
+   {
+      utils_sysLog(LOG_INFO, "Received http status %d for bytes %llu-%llu of '%s'\n",
+                   r->statusCode, (unsigned long long)range->next,
+                   (unsigned long long)(range->end - 1), d->sink.path);
+      if ((HTTP_BAD_REQUEST <= r->statusCode) && (HTTP_INTERNAL_ERROR > r->statusCode))
+      {
+         /* Asking again will not change the answer */
+         range->failures = SEGMENT_RETRY_LIMIT;
+      }
+   }
+
+   return (slot->accepted > 0);
+}
+
+//!
+//! Account for bytes of a range written to the file.
+//!
+static void segment_advance(SEGMENT_DOWNLOAD_T *d, SEGMENT_RANGE_T *range, size_t len)
+{
+   range->next += len;
+   d->unsaved += len;
+   if (d->unsaved >= SEGMENT_SAVE_LEN)
+   {
+      segment_saveState(d);
+   }
+}
+
+//!
+//! Write the payload of a range response at its offset of the file
+//!
+static void segment_body(CLOUD_SESSION_T *s, int index, const char *data, size_t len, void *arg)
+{
+   SEGMENT_DOWNLOAD_T *d = (SEGMENT_DOWNLOAD_T *)arg;
+   SEGMENT_SLOT_T *slot = segment_findSlot(d, s);
+   SEGMENT_RANGE_T *range;
+
+   if ((NULL == slot) || !segment_accept(d, slot, s))
+   {
+      return;
+   }
+   range = &d->ranges[slot->range];
+   /* Bytes past the range asked for are dropped */
+   if (len > (range->end - range->next))
+   {
+      len = range->end - range->next;
+   }
+   if ((len > 0) && sink_pwrite(&d->sink, range->next, data, len))
+   {
+      segment_advance(d, range, len);
+   }
+}
+
+//!
+//! Move the payload of a range response from the socket to its offset of
+//! the file
+//!
+static ssize_t segment_splice(CLOUD_SESSION_T *s, int index, int fd, size_t len, void *arg)
+{
+   SEGMENT_DOWNLOAD_T *d = (SEGMENT_DOWNLOAD_T *)arg;
+   SEGMENT_SLOT_T *slot = segment_findSlot(d, s);
+   SEGMENT_RANGE_T *range;
+   ssize_t n;
+
+   if ((NULL == slot) || !segment_accept(d, slot, s) ||
+       (d->ranges[slot->range].next >= d->ranges[slot->range].end))
+   {
+      errno = EOPNOTSUPP;
+      return -1;
+   }
+   range = &d->ranges[slot->range];
+   if (len > (range->end - range->next))
+   {
+      len = range->end - range->next;
+   }
+   n = sink_spliceAt(&d->sink, fd, len, range->next);
+   if (n > 0)
+   {
+      segment_advance(d, range, n);
+   }
+
+   return n;
+}
+
+//!
+//! Check a response that ends without payload, such as the answer for an
+//! empty file
+//!
+static void segment_response(CLOUD_SESSION_T *s, int index, int httpStatus, void *arg)
+{
+   SEGMENT_DOWNLOAD_T *d = (SEGMENT_DOWNLOAD_T *)arg;
+   SEGMENT_SLOT_T *slot = segment_findSlot(d, s);
+
+   if (NULL != slot)
+   {
+      segment_accept(d, slot, s);
+   }
+}
+
+//!
+//! Give the session of a slot up at the end of a range request, and count
+//! a request that fetched nothing against its range.
+//!
+static void segment_finishSlot(SEGMENT_DOWNLOAD_T *d, SEGMENT_SLOT_T *slot)
+{
+   CLOUD_SESSION_T *s = slot->session;
+   SEGMENT_RANGE_T *range = &d->ranges[slot->range];
+
+   if (d->whole && (UINT64_MAX == range->end) && (slot->accepted > 0) &&
+       (CLOUD_SESSION_RECV_SUCCESS == s->status))
+   {
+      /* The length of a file sent in one piece is known once it is received */
+      range->end = range->next;
+      d->total = (int64_t)range->next;
+   }
+   if (range->next < range->end)
+   {
+      if (d->whole)
+      {
+         /*
+          * A file sent in one piece is asked for again from where it stopped
+          * with If-Range, and starts over unless the server can tell its
+          * version. Every attempt counts, as the server may ignore the range.
+          */
+         if ((0 == strlen(d->validator)) || (d->total < 0))
+         {
+            range->next = 0;
+         }
+         range->failures++;
+      }
+      else if (range->next == slot->start)
+      {
+         range->failures++;
+      }
+      else
+      {
+         range->failures = 0;
+      }
+      utils_sysLog(LOG_DEBUG, "Range %d of '%s' stopped at %llu, failures %d\n", slot->range,
+                   d->sink.path, (unsigned long long)range->next, range->failures);
+   }
+   s->responseCb = NULL;
+   s->bodyCb = NULL;
+   s->spliceCb = NULL;
+   s->responseArg = NULL;
+   pool_releaseSession(s);
+   slot->session = NULL;
+   slot->sent = false;
+   segment_saveState(d);
+}
+
+//!
+//! Give an idle slot the next range that nobody is fetching.
+//!
+static void segment_assignSlot(SEGMENT_DOWNLOAD_T *d, SEGMENT_SLOT_T *slot)
+{
+   CLOUD_SESSION_T *s;
+   int i;
+
+   for (i = 0; i < d->rangeCount; i++)
+   {
+      if ((d->ranges[i].next < d->ranges[i].end) &&
+          (d->ranges[i].failures < SEGMENT_RETRY_LIMIT) && !segment_isOwned(d, i))
+      {
+         break;
+      }
+   }
+   if (i >= d->rangeCount)
+   {
+      return;
+   }
+   s = pool_acquireSession(d->serverName, d->serverPort);
+   if (NULL == s)
+   {
+      return;
+   }
+   s->deadlines = d->deadlines;
+   s->sendFileLen = 0;
+   s->responseCb = segment_response;
+   s->bodyCb = segment_body;
+   s->spliceCb = segment_splice;
+   s->responseArg = d;
+   s->wakeCb = d->wakeCb;
+   s->wakeArg = d->requestArg;
+   slot->session = s;
+   slot->range = i;
+   slot->sent = false;
+}
+
+//!
+//! Send the request of the range of a slot once its session is ready.
+//!
+static void segment_sendSlot(SEGMENT_DOWNLOAD_T *d, SEGMENT_SLOT_T *slot)
+{
+   CLOUD_SESSION_T *s = slot->session;
+   SEGMENT_RANGE_T *range = &d->ranges[slot->range];
+
+   slot->start = range->next;
+   if (!cloud_initSession(s, d->serverName, d->serverPort))
+   {
+      segment_finishSlot(d, slot);
+      return;
+   }
+   /* Stay here until the server name is resolved */
+   if (CLOUD_SESSION_RESOLVE_PENDING == s->status)
+   {
+      return;
+   }
+   s->totalBytesToSend = d->requestCb(s->sendBuf, range->next, range->end - 1,
+                                        d->validator, d->requestArg);
+   if (s->totalBytesToSend < 0)
+   {
+      segment_finishSlot(d, slot);
+      return;
+   }
+   s->requestCount = 1;
+   slot->accepted = -1;
+   slot->sent = true;
+   cloud_sessionConnectAndSend(s);
+   if (0 != s->errorCode)
+   {
+      segment_finishSlot(d, slot);
+   }
+}
+
+//!
+//! Put every idle connection to work on a range.
+//!
+static void segment_startSlots(SEGMENT_DOWNLOAD_T *d)
+{
+   SEGMENT_SLOT_T *slot;
+   int i;
+
+   for (i = 0; i < d->connections; i++)
+   {
+      slot = &d->slots[i];
+      if (NULL == slot->session)
+      {
+         segment_assignSlot(d, slot);
+      }
+      if ((NULL != slot->session) && !slot->sent)
+      {
+         segment_sendSlot(d, slot);
+      }
+   }
+}
+
+//!
+//! Give up the sessions of all slots, whatever they are fetching.
+//!
+static void segment_releaseSlots(SEGMENT_DOWNLOAD_T *d)
+{
+   CLOUD_SESSION_T *s;
+   int i;
+
+   for (i = 0; i < d->connections; i++)
+   {
+      s = d->slots[i].session;
+      if (NULL != s)
+      {
+         s->responseCb = NULL;
+         s->bodyCb = NULL;
+         s->spliceCb = NULL;
+         s->responseArg = NULL;
+         pool_releaseSession(s);
+         d->slots[i].session = NULL;
+         d->slots[i].sent = false;
+      }
+   }
+}
+
+//!
+//! Forget what was fetched of the file and get ready to ask for its first
+//! range.
+//!
+//! @return  true if the temporary file is emptied, otherwise false
+//!
+static bool segment_startOver(SEGMENT_DOWNLOAD_T *d)
+{
+   unlink(d->statePath);
+   d->total = -1;
+   d->whole = false;
+   d->unsaved = 0;
+   d->validator[0] = '\0';
+   d->changed = false;
+   if (!sink_reserve(&d->sink, 0))
+   {
+      return false;
+   }
+   d->ranges[0].next = 0;
+   d->ranges[0].end = SEGMENT_PROBE_LEN;
+   d->ranges[0].failures = 0;
+   d->rangeCount = 1;
+
+   return true;
+}
+
+//!
+//! Save the ranges still to fetch next to the file, so that an interrupted
+//! download can be resumed. The file is synced first, so the state never
+//! claims bytes that could be lost.
+//!
+static void segment_saveState(SEGMENT_DOWNLOAD_T *d)
+{
+   char tempPath[SINK_PATH_LEN + 8];
+   FILE *f;
+   int i;
+
+   if (d->whole || (d->total < 0) || d->sink.failed || !sink_isOpen(&d->sink))
+   {
+      return;
+   }
+   d->unsaved = 0;
+   if (fdatasync(d->sink.fd) < 0)
+   {
+      utils_sysLog(LOG_ERR, "Sync '%s' errno: %s\n", d->sink.tempPath, strerror(errno));
+      return;
+   }
+   sprintf(tempPath, "%s.new", d->statePath);
+   f = fopen(tempPath, "w");
+   if (NULL == f)
+   {
+      utils_sysLog(LOG_ERR, "Open '%s' errno: %s\n", tempPath, strerror(errno));
+      return;
+   }
+   fprintf(f, "%lld\n%s\n", (long long)d->total, d->validator);
+   for (i = 0; i < d->rangeCount; i++)
+   {
+      fprintf(f, "%llu %llu\n", (unsigned long long)d->ranges[i].next,
+              (unsigned long long)d->ranges[i].end);
+   }
+   if ((0 != fclose(f)) || (rename(tempPath, d->statePath) < 0))
+   {
+      utils_sysLog(LOG_ERR, "Save '%s' errno: %s\n", d->statePath, strerror(errno));
+      unlink(tempPath);
+   }
+}
+
+//!
+//! Load the ranges left by an interrupted download of the file. The state
+//! is only used if the temporary file still has the length of the file,
+//! and if it has a validator to ask the server for the same version.
+//!
+//! @return  true if the download can be resumed, otherwise false
+//!
+static bool segment_loadState(SEGMENT_DOWNLOAD_T *d)
+{
+   unsigned long long next;
+   unsigned long long end;
+   long long total;
+   struct stat st;
+   char line[PARSE_VALIDATOR_LEN + 2];
+   bool valid;
+   FILE *f;
+
+   f = fopen(d->statePath, "r");
+   if (NULL == f)
+   {
+      return false;
+   }
+   valid = (NULL != fgets(line, sizeof(line), f)) && (1 == sscanf(line, "%lld", &total)) &&
+           (total >= 0) && (NULL != fgets(line, sizeof(line), f));
+   if (valid)
+   {
+      line[strcspn(line, "\r\n")] = '\0';
+      valid = (0 != strlen(line)) && (strlen(line) < PARSE_VALIDATOR_LEN);
+      strncpy(d->validator, line, PARSE_VALIDATOR_LEN - 1);
+   }
+   d->rangeCount = 0;
+   while (valid && (d->rangeCount <= SEGMENT_MAX) &&
+          (2 == fscanf(f, "%llu %llu", &next, &end)))
+   {
+      valid = (next <= end) && (end <= (unsigned long long)total);
+      d->ranges[d->rangeCount].next = next;
+      d->ranges[d->rangeCount].end = end;
+      d->ranges[d->rangeCount].failures = 0;
+      d->rangeCount++;
+   }
+   /* More ranges than a download can have, or anything else left over, is not a state */
+   valid = valid && (EOF == fscanf(f, " %*c"));
+   fclose(f);
+   if (!valid || (0 == d->rangeCount) || (fstat(d->sink.fd, &st) < 0) ||
+       (st.st_size != total))
+   {
+      utils_sysLog(LOG_INFO, "Cannot resume '%s'\n", d->sink.path);
+      d->validator[0] = '\0';
+      d->rangeCount = 0;
+      return false;
+   }
+   d->total = total;
+
+   return true;
+}
+
+//!
+//! Start or resume the segmented download of a file.
+//!
+//! The file is fetched over up to the given number of connections. The
+//! first request asks for the start of the file, its response tells the
+//! length of the file and the rest is then split between the connections.
+//! A download interrupted before carries on from the ranges saved with it.
+//!
+//! @param[in,out] d  Pointer to segmented download
+//! @param[in] path  Local file to write
+//! @param[in] serverName  Server of the file
+//! @param[in] serverPort  Server port number
+//! @param[in] connections  Connections to use
+//!
+//! @return  true if the download is started, otherwise false
+//!
+bool segment_begin(SEGMENT_DOWNLOAD_T *d, const char *path, char *serverName,
+                   uint16_t serverPort, int connections)
+{
+   uint64_t left = 0;
+   int i;
+
+   segment_end(d);
+   if ((strlen(path) + strlen(SEGMENT_STATE_SUFFIX)) >= SINK_PATH_LEN)
+   {
+      utils_sysLog(LOG_ERR, "File name '%s' is too long\n", path);
+      return false;
+   }
+   sprintf(d->statePath, "%s%s", path, SEGMENT_STATE_SUFFIX);
+   d->serverName = serverName;
+   d->serverPort = serverPort;
+   d->connections = (connections < 1) ? 1 : connections;
+   if (d->connections > SEGMENT_MAX)
+   {
+      d->connections = SEGMENT_MAX;
+   }
+   if (d->connections > POOL_MAX_SESSIONS)
+   {
+      d->connections = POOL_MAX_SESSIONS;
+   }
+   memset(d->slots, 0, sizeof(d->slots));
+   d->total = -1;
+   d->whole = false;
+   d->unsaved = 0;
+   d->validator[0] = '\0';
+   d->changed = false;
+   d->restarts = 0;
+
+   if (!sink_openAt(&d->sink, path, true))
+   {
+      return false;
+   }
+   if (segment_loadState(d))
+   {
+      for (i = 0; i < d->rangeCount; i++)
+      {
+         left += d->ranges[i].end - d->ranges[i].next;
+      }
+      utils_sysLog(LOG_INFO, "Resuming '%s', %llu of %lld bytes left\n", path,
+                   (unsigned long long)left, (long long)d->total);
+   }
+   else if (!segment_startOver(d))
+   {
+      sink_abort(&d->sink);
+      return false;
+   }
+
+   return true;
+}
+
+//!
+//! Drive the connections of a segmented download.
+//!
+//! Finished range requests are given up and ranges that are not complete
+//! are asked for again from where they stopped. Once every range is
+//! fetched the file replaces the target file.
+//!
+//! @param[in,out] d  Pointer to segmented download
+//!
+//! @return  Status of the download
+//!
+SEGMENT_STATUS_T segment_process(SEGMENT_DOWNLOAD_T *d)
+{
+   SEGMENT_SLOT_T *slot;
+   CLOUD_SESSION_T *s;
+   bool busy = false;
+   bool done;
+   int i;
+
+   if (!sink_isOpen(&d->sink))
+   {
+      return SEGMENT_FAILED;
+   }
+   for (i = 0; i < d->connections; i++)
+   {
+      slot = &d->slots[i];
+      s = slot->session;
+      if ((NULL != s) && slot->sent &&
+          (cloud_sessionSendRecvAll(s) || (CLOUD_SESSION_FAILED == s->status)))
+      {
+         segment_finishSlot(d, slot);
+      }
+   }
+   if (d->changed)
+   {
+      /* Bytes of two versions of the file cannot be mixed */
+      segment_releaseSlots(d);
+      if (++d->restarts > SEGMENT_RETRY_LIMIT)
+      {
+         utils_sysLog(LOG_INFO, "'%s' keeps changing on the server\n", d->sink.path);
+         unlink(d->statePath);
+         return SEGMENT_FAILED;
+      }
+      utils_sysLog(LOG_INFO, "'%s' changed on the server, starting over\n", d->sink.path);
+      if (!segment_startOver(d))
+      {
+         return SEGMENT_FAILED;
+      }
+   }
+   segment_startSlots(d);
+
+   done = (d->total >= 0);
+   for (i = 0; i < d->rangeCount; i++)
+   {
+      if (d->ranges[i].next < d->ranges[i].end)
+      {
+         done = false;
+         if (d->ranges[i].failures >= SEGMENT_RETRY_LIMIT)
+         {
+            utils_sysLog(LOG_INFO, "Giving up on bytes %llu-%llu of '%s'\n",
+                         (unsigned long long)d->ranges[i].next,
+                         (unsigned long long)(d->ranges[i].end - 1), d->sink.path);
+            return SEGMENT_FAILED;
+         }
+      }
+   }
+   for (i = 0; i < d->connections; i++)
+   {
+      busy = busy || (NULL != d->slots[i].session);
+   }
+   if (d->sink.failed)
+   {
+      return SEGMENT_FAILED;
+   }
+   if (!done || busy)
+   {
+      return SEGMENT_PENDING;
+   }
+   if (!sink_commit(&d->sink))
+   {
+      unlink(d->statePath);
+      return SEGMENT_FAILED;
+   }
+   unlink(d->statePath);
+   utils_sysLog(LOG_INFO, "Saved %lld bytes to local file '%s'", (long long)d->total, d->sink.path);
+
+   return SEGMENT_COMPLETED;
+}
+
+//!
+//! Stop a segmented download. The connections are given up and a download
+//! that is not complete keeps its temporary file and its state, to be
+//! resumed by the next segment_begin() of the file, unless it cannot be
+//! resumed.
+//!
+//! @param[in,out] d  Pointer to segmented download
+//!
+void segment_end(SEGMENT_DOWNLOAD_T *d)
+{
+   segment_releaseSlots(d);
+   if (d->whole || (d->total < 0) || (0 == strlen(d->validator)))
+   {
+      /* Nothing was fetched that could be resumed as the same version */
+      sink_abort(&d->sink);
+   }
+   else
+   {
+      segment_saveState(d);
+      sink_close(&d->sink);
+   }
+}
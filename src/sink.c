@@ -0,0 +1,580 @@
+//******************************************************************************
+//!
+//! Author:  Ying Xiong
+//! Created: Oct 2026
+//!
+//******************************************************************************
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "sink.h"
+#include "utils.h"
+
+//
+// Function Prototypes
+//
+static void sink_reset(SINK_T *k);
+static bool sink_create(SINK_T *k);
+static bool sink_flush(SINK_T *k);
+static bool sink_writeFile(int fd, const char *data, size_t len);
+static bool sink_setPath(SINK_T *k, const char *path);
+static ssize_t sink_spliceTo(SINK_T *k, int fd, size_t len, loff_t *offset);
+
+//
+// Local Variables
+//
+static char dropBuf[SINK_BUF_LEN];    /* Bytes spliced for a failed download are read into it */
+
+//!
+//! Initialize a sink that has no file open.
+//!
+//! @param[out] k  Pointer to sink
+//!
+void sink_init(SINK_T *k)
+{
+   k->pipeFd[0] = -1;
+   k->pipeFd[1] = -1;
+   k->buf = NULL;
+   sink_reset(k);
+}
+
+//!
+//! Start writing a download to a temporary file next to the target file.
+//!
+//! The temporary file is only created once the write buffer has to be
+//! written out, so a download that fits in the buffer and is dropped
+//! leaves the disk untouched. The bytes are hashed as they are written.
+//!
+//! @param[in,out] k  Pointer to sink
+//! @param[in] path  Target file
+//! @param[in] expected  Length of the download, -1 if unknown
+//!
+//! @return  true if the download can be written, otherwise false
+//!
+bool sink_open(SINK_T *k, const char *path, int64_t expected)
+{
+   sink_abort(k);
+   if (!sink_setPath(k, path))
+   {
+      return false;
+   }
+   k->expected = expected;
+   k->active = true;
+
+   return true;
+}
+
+//!
+//! Start writing a download to a temporary file next to the target file
+//! at the offsets given with each write, so that parts of the download
+//! can arrive in any order.
+//!
+//! @param[in,out] k  Pointer to sink
+//! @param[in] path  Target file
+//! @param[in] keep  Keep what an earlier attempt left in the temporary file
+//!
+//! @return  true if the temporary file is open, otherwise false
+//!
+bool sink_openAt(SINK_T *k, const char *path, bool keep)
+{
+   sink_abort(k);
+   if (!sink_setPath(k, path))
+   {
+      return false;
+   }
+
+   k->fd = open(k->tempPath, O_WRONLY | O_CREAT | O_CLOEXEC | (keep ? 0 : O_TRUNC), 0644);
+   if (k->fd < 0)
+   {
+      utils_sysLog(LOG_ERR, "Open '%s' errno: %s\n", k->tempPath, strerror(errno));
+      return false;
+   }
+   k->active = true;
+   k->hashValid = false;
+
+   return true;
+}
+
+//!
+//! Set the length of a download written at offsets and reserve its space.
+//!
+//! @param[in,out] k  Pointer to sink
+//! @param[in] size  Length of the download
+//!
+//! @return  true if the file has the length, otherwise false
+//!
+bool sink_reserve(SINK_T *k, uint64_t size)
+{
+   if ((k->fd < 0) || k->failed)
+   {
+      return false;
+   }
+   if ((ftruncate(k->fd, (off_t)size) < 0) ||
+       ((size > 0) && (fallocate(k->fd, 0, 0, (off_t)size) < 0) &&
+        (EOPNOTSUPP != errno) && (ENOSYS != errno)))
+   {
+      utils_sysLog(LOG_ERR, "Reserve %llu bytes for '%s' errno: %s\n",
+                   (unsigned long long)size, k->tempPath, strerror(errno));
+      k->failed = true;
+      return false;
+   }
+
+   return true;
+}
+
+//!
+//! Determine if the sink has a file open.
+//!
+//! @param[in] k  Pointer to sink
+//! @return  true if a download is being written, otherwise false
+//!
+bool sink_isOpen(const SINK_T *k)
+{
+   return k->active;
+}
+
+//!
+//! Write the next bytes of the download.
+//!
+//! Small writes are collected in the write buffer of the sink, which is
+//! only allocated while a download is written. After a failed write the
+//! rest of the download is dropped.
+//!
+//! @param[in,out] k  Pointer to sink
+//! @param[in] data  Bytes to write
+//! @param[in] len  Number of bytes to write
+//!
+//! @return  true if the bytes were taken, otherwise false
+//!
+bool sink_write(SINK_T *k, const char *data, size_t len)
+{
+   size_t n;
+
+   if (!k->active || k->failed)
+   {
+      return false;
+   }
+   k->written += len;
+   hash_update(&k->hash, data, len);
+   while (len > 0)
+   {
+      if ((0 == k->bufLen) && (len >= SINK_BUF_LEN))
+      {
+         /* Large spans go straight to the file */
+         n = len;
+         k->failed = !(((k->fd >= 0) || sink_create(k)) && sink_writeFile(k->fd, data, n));
+      }
+      else if ((NULL == k->buf) && (NULL == (k->buf = malloc(SINK_BUF_LEN))))
+      {
+         n = 0;
+         k->failed = true;
+      }
+      else
+      {
+         n = SINK_BUF_LEN - k->bufLen;
+         if (n > len)
+         {
+            n = len;
+         }
+         memcpy(&k->buf[k->bufLen], data, n);
+         k->bufLen += n;
+         if ((SINK_BUF_LEN == k->bufLen) && !sink_flush(k))
+         {
+            k->failed = true;
+         }
+      }
+      if (k->failed)
+      {
+         utils_sysLog(LOG_ERR, "Write '%s' errno: %s\n", k->tempPath, strerror(errno));
+         return false;
+      }
+      data += n;
+      len -= n;
+   }
+
+   return true;
+}
+
+//!
+//! Move the next bytes of the download from a socket to the file without
+//! copying them to user space.
+//!
+//! The bytes pass through a pipe of the sink, which is empty again when
+//! this returns. The socket must be nonblocking. Bytes taken from the
+//! socket are counted even if writing them to the file fails, so the
+//! caller stays in step with the stream and the download is dropped at
+//! commit.
+//!
+//! @param[in,out] k  Pointer to sink
+//! @param[in] fd  Socket to read from
+//! @param[in] len  Maximum number of bytes to move
+//!
+//! @return  Bytes moved, 0 if the socket was closed, or -1 with errno set
+//!
+ssize_t sink_splice(SINK_T *k, int fd, size_t len)
+{
+   if (!k->active ||
+       (!k->failed && (!sink_flush(k) || ((k->fd < 0) && !sink_create(k)))))
+   {
+      k->failed = true;
+      errno = EBADF;
+      return -1;
+   }
+   /* The bytes never pass through user space to be hashed */
+   k->hashValid = false;
+
+   return sink_spliceTo(k, fd, len, NULL);
+}
+
+//!
+//! Write bytes of the download at an offset of the file.
+//!
+//! @param[in,out] k  Pointer to sink
+//! @param[in] offset  Offset of the bytes in the download
+//! @param[in] data  Bytes to write
+//! @param[in] len  Number of bytes to write
+//!
+//! @return  true if the bytes were written, otherwise false
+//!
+bool sink_pwrite(SINK_T *k, uint64_t offset, const char *data, size_t len)
+{
+   ssize_t n;
+
+   if ((k->fd < 0) || k->failed)
+   {
+      return false;
+   }
+   k->written += len;
+   while (len > 0)
+   {
+      n = pwrite(k->fd, data, len, (off_t)offset);
+      if (n < 0)
+      {
+         if (EINTR == errno)
+         {
+            continue;
+         }
+         utils_sysLog(LOG_ERR, "Write '%s' errno: %s\n", k->tempPath, strerror(errno));
+         k->failed = true;
+         return false;
+      }
+      data += n;
+      offset += n;
+      len -= n;
+   }
+
+   return true;
+}
+
+//!
+//! Move bytes of the download from a socket to an offset of the file
+//! without copying them to user space, as sink_splice() does.
+//!
+//! @param[in,out] k  Pointer to sink
+//! @param[in] fd  Socket to read from
+//! @param[in] len  Maximum number of bytes to move
+//! @param[in] offset  Offset of the bytes in the download
+//!
+//! @return  Bytes moved, 0 if the socket was closed, or -1 with errno set
+//!
+ssize_t sink_spliceAt(SINK_T *k, int fd, size_t len, uint64_t offset)
+{
+   loff_t off = (loff_t)offset;
+
+   if (k->fd < 0)
+   {
+      errno = EBADF;
+      return -1;
+   }
+
+   return sink_spliceTo(k, fd, len, &off);
+}
+
+//!
+//! Get the hash of the download written so far.
+//!
+//! @param[in] k  Pointer to sink
+//! @param[out] digest  Hash of the bytes written
+//!
+//! @return  true if every byte was hashed, false if bytes were spliced or
+//!          written at offsets
+//!
+bool sink_digest(const SINK_T *k, uint64_t *digest)
+{
+   if (!k->hashValid)
+   {
+      return false;
+   }
+   *digest = hash_final(&k->hash);
+
+   return true;
+}
+
+//!
+//! Finish the download and atomically replace the target file with it.
+//!
+//! The download is dropped when a write failed or fewer bytes than
+//! expected were written.
+//!
+//! @param[in,out] k  Pointer to sink
+//!
+//! @return  true if the target file was replaced, otherwise false
+//!
+bool sink_commit(SINK_T *k)
+{
+   bool done = false;
+
+   if (!k->active)
+   {
+      return false;
+   }
+   if (!k->failed && sink_flush(k) && ((k->fd >= 0) || sink_create(k)))
+   {
+      if ((k->expected >= 0) && (k->written != (uint64_t)k->expected))
+      {
+         utils_sysLog(LOG_ERR, "Received %llu of %lld bytes for '%s'\n",
+                      (unsigned long long)k->written, (long long)k->expected, k->path);
+      }
+      else if (fdatasync(k->fd) < 0)
+      {
+         utils_sysLog(LOG_ERR, "Sync '%s' errno: %s\n", k->tempPath, strerror(errno));
+      }
+      else if (rename(k->tempPath, k->path) < 0)
+      {
+         utils_sysLog(LOG_ERR, "Rename '%s' errno: %s\n", k->tempPath, strerror(errno));
+      }
+      else
+      {
+         done = true;
+      }
+   }
+   if (done)
+   {
+      close(k->fd);
+      k->fd = -1;
+      k->active = false;
+   }
+   else
+   {
+      sink_abort(k);
+   }
+
+   return done;
+}
+
+//!
+//! Stop writing the download, keeping its temporary file so that a later
+//! attempt can carry on where this one stopped.
+//!
+//! @param[in,out] k  Pointer to sink
+//!
+void sink_close(SINK_T *k)
+{
+   if (k->fd >= 0)
+   {
+      if (!k->failed)
+      {
+         sink_flush(k);
+      }
+      close(k->fd);
+   }
+   sink_reset(k);
+}
+
+//!
+//! Drop the download and remove its temporary file.
+//!
+//! @param[in,out] k  Pointer to sink
+//!
+void sink_abort(SINK_T *k)
+{
+   if (k->fd >= 0)
+   {
+      close(k->fd);
+      unlink(k->tempPath);
+   }
+   sink_reset(k);
+}
+
+//!
+//! Forget the current download and give back its write buffer.
+//!
+//! @param[out] k  Pointer to sink
+//!
+static void sink_reset(SINK_T *k)
+{
+   free(k->buf);
+   k->buf = NULL;
+   k->active = false;
+   k->fd = -1;
+   k->path[0] = '\0';
+   k->tempPath[0] = '\0';
+   k->expected = -1;
+   k->written = 0;
+   k->failed = false;
+   k->bufLen = 0;
+   hash_init(&k->hash);
+   k->hashValid = true;
+}
+
+//!
+//! Create the temporary file of the download when the first bytes have to
+//! be written to it.
+//!
+//! When the length is known the space is reserved up front, so the file
+//! is laid out in one piece and a full disk is found before any data is
+//! written.
+//!
+//! @param[in,out] k  Pointer to sink
+//!
+//! @return  true if the file is created, otherwise false
+//!
+static bool sink_create(SINK_T *k)
+{
+   k->fd = open(k->tempPath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+   if (k->fd < 0)
+   {
+      utils_sysLog(LOG_ERR, "Open '%s' errno: %s\n", k->tempPath, strerror(errno));
+      k->failed = true;
+      return false;
+   }
+   if ((k->expected > 0) && (fallocate(k->fd, 0, 0, k->expected) < 0) &&
+       (EOPNOTSUPP != errno) && (ENOSYS != errno))
+   {
+      utils_sysLog(LOG_ERR, "Reserve %lld bytes for '%s' errno: %s\n",
+                   (long long)k->expected, k->tempPath, strerror(errno));
+      k->failed = true;
+      return false;
+   }
+
+   return true;
+}
+
+//!
+//! Write out the bytes collected in the write buffer.
+//!
+//! @param[in,out] k  Pointer to sink
+//!
+//! @return  true if the buffer was written, otherwise false
+//!
+static bool sink_flush(SINK_T *k)
+{
+   bool ok = true;
+
+   if (k->bufLen > 0)
+   {
+      ok = ((k->fd >= 0) || sink_create(k)) && sink_writeFile(k->fd, k->buf, k->bufLen);
+      k->bufLen = 0;
+   }
+
+   return ok;
+}
+
+//!
+//! Write all bytes to a file, continuing after short writes.
+//!
+//! @return  true if all bytes were written, otherwise false
+//!
+static bool sink_writeFile(int fd, const char *data, size_t len)
+{
+   ssize_t n;
+
+   while (len > 0)
+   {
+      n = write(fd, data, len);
+      if (n < 0)
+      {
+         if (EINTR == errno)
+         {
+            continue;
+         }
+         return false;
+      }
+      data += n;
+      len -= n;
+   }
+
+   return true;
+}
+
+//!
+//! Set the target file and the temporary file next to it.
+//!
+//! @return  true if the file names fit, otherwise false
+//!
+static bool sink_setPath(SINK_T *k, const char *path)
+{
+   if ((strlen(path) + strlen(SINK_TEMP_SUFFIX)) >= SINK_PATH_LEN)
+   {
+      utils_sysLog(LOG_ERR, "File name '%s' is too long\n", path);
+      return false;
+   }
+   strcpy(k->path, path);
+   sprintf(k->tempPath, "%s%s", path, SINK_TEMP_SUFFIX);
+
+   return true;
+}
+
+//!
+//! Move bytes from a socket to the file through the pipe of the sink.
+//!
+//! @param[in,out] k  Pointer to sink
+//! @param[in] fd  Socket to read from
+//! @param[in] len  Maximum number of bytes to move
+//! @param[in,out] offset  File offset to write at, NULL for the file position
+//!
+//! @return  Bytes moved, 0 if the socket was closed, or -1 with errno set
+//!
+static ssize_t sink_spliceTo(SINK_T *k, int fd, size_t len, loff_t *offset)
+{
+   ssize_t n;
+   ssize_t moved;
+   ssize_t total;
+
+   if (k->pipeFd[0] < 0)
+   {
+      if (pipe2(k->pipeFd, O_CLOEXEC | O_NONBLOCK) < 0)
+      {
+         utils_sysLog(LOG_ERR, "Pipe errno: %s\n", strerror(errno));
+         return -1;
+      }
+      /* A larger pipe moves more per system call, the default is kept if refused */
+      fcntl(k->pipeFd[1], F_SETPIPE_SZ, SINK_PIPE_LEN);
+   }
+
+   total = splice(fd, NULL, k->pipeFd[1], NULL, len, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+   if (total <= 0)
+   {
+      return total;
+   }
+   k->written += total;
+   for (moved = 0; moved < total; moved += n)
+   {
+      n = -1;
+      if (!k->failed)
+      {
+         n = splice(k->pipeFd[0], NULL, k->fd, offset, total - moved, SPLICE_F_MOVE);
+         if (n <= 0)
+         {
+            utils_sysLog(LOG_ERR, "Splice to '%s' errno: %s\n", k->tempPath, strerror(errno));
+            k->failed = true;
+         }
+      }
+      if (k->failed)
+      {
+         /* Drop the bytes so that the pipe is empty for the next download */
+         n = read(k->pipeFd[0], dropBuf, ((total - moved) < SINK_BUF_LEN) ? (total - moved) : SINK_BUF_LEN);
+         if (n <= 0)
+         {
+            break;
+         }
+      }
+   }
+
+   return total;
+}
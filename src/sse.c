@@ -0,0 +1,229 @@
+//******************************************************************************
+//!
+//! Author:  Ying Xiong
+//! Created: Oct 2026
+//!
+//******************************************************************************
+
+#include <string.h>
+#include "sse.h"
+
+#define DATA_FIELD_STR   "data"
+#define EVENT_FIELD_STR  "event"
+#define ID_FIELD_STR     "id"
+
+//
+// Function Prototypes
+//
+static bool sse_isField(const SSE_PARSER_T *p, const char *name);
+static void sse_valueStart(SSE_PARSER_T *p);
+static void sse_valueBytes(SSE_PARSER_T *p, const char *data, size_t len);
+static void sse_lineEnd(SSE_PARSER_T *p);
+
+//!
+//! Get an event stream parser ready for the first byte of a stream.
+//!
+//! @param[out] p  Pointer to event stream parser
+//! @param[in] dataCb  Called with the data of each event
+//! @param[in] eventCb  Called when an event is complete
+//! @param[in] arg  Argument passed back to the callbacks
+//!
+void sse_init(SSE_PARSER_T *p, SSE_DATA_CB_T dataCb, SSE_EVENT_CB_T eventCb, void *arg)
+{
+   p->lastId[0] = '\0';
+   p->dataCb = dataCb;
+   p->eventCb = eventCb;
+   p->arg = arg;
+   sse_reset(p);
+}
+
+//!
+//! Get the parser ready for a new stream. The last event ID is kept, so
+//! that the new stream can carry on after it.
+//!
+//! @param[in,out] p  Pointer to event stream parser
+//!
+void sse_reset(SSE_PARSER_T *p)
+{
+   p->state = SSE_FIELD;
+   p->crSeen = false;
+   p->fieldLen = 0;
+   p->valueLen = 0;
+   p->dataLines = 0;
+   p->event[0] = '\0';
+}
+
+//!
+//! Parse the next bytes of an event stream.
+//!
+//! Lines may end with CRLF, LF or CR, and may be split across calls. The
+//! data of an event is passed to the data callback as it is found, and
+//! the event callback is called at the blank line that ends the event.
+//! Comment lines and unknown fields are skipped.
+//!
+//! @param[in,out] p  Pointer to event stream parser
+//! @param[in] data  Newly arrived bytes
+//! @param[in] len  Number of newly arrived bytes
+//!
+void sse_parse(SSE_PARSER_T *p, const char *data, size_t len)
+{
+   const char *end;
+   size_t n;
+
+   while (len > 0)
+   {
+      if (p->crSeen)
+      {
+         p->crSeen = false;
+         if ('\n' == *data)
+         {
+            data++;
+            len--;
+            continue;
+         }
+      }
+      switch (p->state)
+      {
+         case SSE_FIELD:
+            if (('\r' == *data) || ('\n' == *data))
+            {
+               p->crSeen = ('\r' == *data);
+               sse_lineEnd(p);
+            }
+            else if (':' == *data)
+            {
+               p->state = SSE_VALUE_START;
+            }
+            else
+            {
+               /* A name too long to keep matches no known field */
+               if (p->fieldLen < SSE_FIELD_LEN)
+               {
+                  p->field[p->fieldLen] = *data;
+               }
+               p->fieldLen++;
+            }
+            data++;
+            len--;
+            break;
+         case SSE_VALUE_START:
+            sse_valueStart(p);
+            p->state = SSE_VALUE;
+            if (' ' == *data)
+            {
+               /* A single space after the colon is not part of the value */
+               data++;
+               len--;
+            }
+            break;
+         case SSE_VALUE:
+            for (end = data; (end < (data + len)) && ('\r' != *end) && ('\n' != *end); end++)
+            {
+            }
+            n = end - data;
+            sse_valueBytes(p, data, n);
+            data += n;
+            len -= n;
+            if (len > 0)
+            {
+               p->crSeen = ('\r' == *data);
+               sse_lineEnd(p);
+               data++;
+               len--;
+            }
+            break;
+         default:
+            break;
+      }
+   }
+}
+
+//!
+//! Determine if the field of the current line has a name.
+//!
+static bool sse_isField(const SSE_PARSER_T *p, const char *name)
+{
+   return ((p->fieldLen == strlen(name)) && (0 == memcmp(p->field, name, p->fieldLen)));
+}
+
+//!
+//! Start the value of the current line. The data lines of an event are
+//! joined with a line feed.
+//!
+static void sse_valueStart(SSE_PARSER_T *p)
+{
+   p->valueLen = 0;
+   if (sse_isField(p, DATA_FIELD_STR))
+   {
+      if ((p->dataLines > 0) && (NULL != p->dataCb))
+      {
+         p->dataCb(p->arg, "\n", 1);
+      }
+      p->dataLines++;
+   }
+}
+
+//!
+//! Take the next bytes of the value of the current line.
+//!
+static void sse_valueBytes(SSE_PARSER_T *p, const char *data, size_t len)
+{
+   size_t n;
+
+   if (0 == len)
+   {
+      return;
+   }
+   if (sse_isField(p, DATA_FIELD_STR))
+   {
+      if (NULL != p->dataCb)
+      {
+         p->dataCb(p->arg, data, len);
+      }
+   }
+   else if (sse_isField(p, EVENT_FIELD_STR) || sse_isField(p, ID_FIELD_STR))
+   {
+      /* Truncated when longer */
+      n = SSE_VALUE_LEN - 1 - p->valueLen;
+      if (n > len)
+      {
+         n = len;
+      }
+      memcpy(&p->value[p->valueLen], data, n);
+      p->valueLen += n;
+   }
+}
+
+//!
+//! Interpret the end of a line. A blank line ends the event.
+//!
+static void sse_lineEnd(SSE_PARSER_T *p)
+{
+   if ((SSE_FIELD == p->state) && (0 == p->fieldLen))
+   {
+      if ((p->dataLines > 0) && (NULL != p->eventCb))
+      {
+         p->eventCb(p->arg, ('\0' != p->event[0]) ? p->event : SSE_DEFAULT_EVENT, p->lastId);
+      }
+      p->dataLines = 0;
+      p->event[0] = '\0';
+      return;
+   }
+   if (SSE_FIELD == p->state)
+   {
+      /* A field without a colon has an empty value */
+      sse_valueStart(p);
+   }
+   p->value[p->valueLen] = '\0';
+   if (sse_isField(p, EVENT_FIELD_STR))
+   {
+      strcpy(p->event, p->value);
+   }
+   else if (sse_isField(p, ID_FIELD_STR))
+   {
+      strcpy(p->lastId, p->value);
+   }
+   p->state = SSE_FIELD;
+   p->fieldLen = 0;
+   p->valueLen = 0;
+}
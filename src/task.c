@@ -6,11 +6,28 @@
  *  @created:    May, 2020
  ***************************************************************************************************/
 
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <libgen.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
-#include "private.h"
+#include <unistd.h>
+#include <sys/stat.h>
+#include "public.h"
 #include "cloud.h"
 #include "parse.h"
+#include "dns.h"
+#include "event.h"
+#include "hash.h"
+#include "pool.h"
+#include "publish.h"
+#include "segment.h"
+#include "sink.h"
+#include "sse.h"
 #include "utils.h"
+#include "ws.h"
 #include "task.h"
 
 //
@@ -24,277 +41,1159 @@
 #define TASK_SEND_DELAY  1
 #endif
 #define TASK_SEND_LIMIT  3
-#define TASK_SEND_TIMER  5
+
+/* Session deadlines in milliseconds */
+#define TASK_DNS_TIMER   1000
+#define TASK_CONN_TIMER  200
+#define TASK_RECV_TIMER  2000
+#define TASK_SEND_TIMER  5000
+
+/* Pause before a failed transaction is tried again, milliseconds */
+#define TASK_RETRY_DELAY 1000
+
+/* Largest change of the time between polls, in percent of it either way */
+#define TASK_JITTER_PCT  10
 
 //
-// Local Variables
+// Request being assambled in a send buffer
 //
-static bool task_completed = false;
-static int send_errors = 0;
-static int send_len = 0;
-#ifndef WEBGET
-static uint32_t timer_start;
-static uint32_t timer_count;
-#endif
-static char device_name[DEVICE_NAME_LEN];
-static char device_addr[DEVICE_ADDR_LEN];
-static char target_file[TARGET_FILE_LEN];
-static char server_name[SERVER_NAME_LEN];
-static int server_port;
-
-static char cloudSendBuf[CLOUD_SEND_BUF_LEN];
-static char cloudRecvBuf[CLOUD_RECV_BUF_LEN];
-
-static CLOUD_DIAGS_T sendDiags;
-static CLOUD_SESSION_T sendSession =
-{
-   "",
-   CLOUD_INVALID_SOCKET,
-   CLOUD_SESSION_IDLE,
-   0,
-   0,
-   0,
-   0,
-   0,
-   0,
-   0,
-   &cloudSendBuf[0],
-   &cloudRecvBuf[0],
-   sizeof(cloudRecvBuf),
-   false,
-   false,
-   &sendDiags
-};
+typedef struct
+{
+   char *buf;                         //!< Send buffer
+   size_t size;                       //!< Size of the send buffer
+   size_t len;                        //!< Bytes of the request so far
+   bool truncated;                    //!< Part of the request did not fit
+}
+TASK_MSG_T;
+
+/* Longest wait a subscription asks the server to hold the request, seconds */
+#define TASK_WAIT_MAX    3600
 
 //
-// Global Variables
+// Local Variables
 //
-int fsm_state = FSM_INIT_STATE;
-SEND_STATUS_T send_status = SEND_NOT_READY;
+static TASK_T *runHead = NULL;        /* Tasks to run on the next pass, in order */
+static TASK_T *runTail = NULL;
+static TASK_T *waitHead = NULL;       /* Tasks waiting for a session, in order */
+static TASK_T *waitTail = NULL;
+static int runningCount = 0;          /* Tasks started and not completed */
+#ifndef WEBGET
+static unsigned int jitterSeed = 0;   /* State of the random jitter of the polls */
+#endif
+
+//!
+//! Queue a task to run on the next pass, which does not wait for events
+//!
+static void queueTask(TASK_T *t)
+{
+   if (t->runQueued || t->completed)
+   {
+      return;
+   }
+   t->runQueued = true;
+   t->runNext = NULL;
+   if (NULL == runTail)
+   {
+      runHead = t;
+   }
+   else
+   {
+      runTail->runNext = t;
+   }
+   runTail = t;
+}
+
+//!
+//! Timer callback of a task that is due
+//!
+static void wakeTask(void *arg)
+{
+   queueTask((TASK_T *)arg);
+}
+
+//!
+//! Run a task again after a delay, replacing the one it had set
+//!
+static void scheduleTask(TASK_T *t, uint32_t delayMs)
+{
+   event_addTimer(&t->timer, delayMs);
+}
+
+//!
+//! Put a task that found all sessions busy in the queue of those woken up
+//! when a session to their server is given back, so that waiting tasks
+//! cost nothing
+//!
+static void waitSession(TASK_T *t)
+{
+   t->waitNext = NULL;
+   if (NULL == waitTail)
+   {
+      waitHead = t;
+   }
+   else
+   {
+      waitTail->waitNext = t;
+   }
+   waitTail = t;
+}
+
+//!
+//! Pool release callback, runs the first waiting task that can have a
+//! session now
+//!
+static void sessionReleased(void)
+{
+   TASK_T **link;
+   TASK_T *t;
+   TASK_T *prev = NULL;
+
+   for (link = &waitHead; NULL != (t = *link); link = &t->waitNext)
+   {
+      if (pool_isAvailable(t->serverName, t->serverPort))
+      {
+         *link = t->waitNext;
+         if (waitTail == t)
+         {
+            waitTail = prev;
+         }
+         t->waitNext = NULL;
+         queueTask(t);
+         break;
+      }
+      prev = t;
+   }
+}
 
-bool initialized = false;
-bool data_sending = false;
+#ifndef WEBGET
+//!
+//! Get the phase of a device, the time from its start to its first poll.
+//! It is taken from the MAC address and the identifier so that devices
+//! started together, as after a power failure, spread their polls over the
+//! whole interval, and a device keeps its phase from one start to the next.
+//! A device left with the default MAC address has nothing of its own to
+//! take it from, so it gets a random phase instead.
+//!
+static uint32_t phaseDelay(TASK_T *t)
+{
+   HASH_T h;
+
+   if (0 == t->sendDelay)
+   {
+      return 0;
+   }
+   if (0 == strcmp(t->deviceAddr, DEVICE_ADDR_DEF))
+   {
+      return (uint32_t)rand_r(&jitterSeed) % t->sendDelay;
+   }
+   hash_init(&h);
+   hash_update(&h, t->deviceAddr, strlen(t->deviceAddr));
+   /* Apart from the MAC address so that "ab" "c" and "a" "bc" differ */
+   hash_update(&h, "", 1);
+   hash_update(&h, t->deviceName, strlen(t->deviceName));
+
+   return (uint32_t)(hash_final(&h) % t->sendDelay);
+}
+
+//!
+//! Get the time to the next poll, the time between polls changed by a
+//! random jitter of up to TASK_JITTER_PCT percent, so that devices with the
+//! same phase drift apart instead of polling in lockstep
+//!
+static uint32_t jitterDelay(TASK_T *t)
+{
+   uint32_t range = (uint32_t)((uint64_t)t->sendDelay * TASK_JITTER_PCT / 100);
+
+   if (0 == range)
+   {
+      return t->sendDelay;
+   }
+
+   return t->sendDelay - range + (uint32_t)rand_r(&jitterSeed) % (2 * range + 1);
+}
+#endif
+
+#ifdef WEBGET
+//!
+//! Mark a task as having nothing more to do
+//!
+static void completeTask(TASK_T *t)
+{
+   if (!t->completed)
+   {
+      t->completed = true;
+      runningCount--;
+      event_cancelTimer(&t->timer);
+   }
+}
+#endif
+
+#ifdef DOWNLOAD
+//!
+//! Drop the target file being written, if any
+//!
+static void closeTargetFile(TASK_T *t)
+{
+   sink_abort(&t->sink);
+   t->sinkIndex = -1;
+}
+
+//!
+//! Open the target file of a response on its first payload bytes. The
+//! file only replaces the target once the response is complete.
+//!
+//! @return  true if the payload is written to a target file
+//!
+static bool openTargetFile(TASK_T *t, CLOUD_SESSION_T *s, int index)
+{
+   int httpStatus = s->response.statusCode;
+
+   if (index != t->sinkIndex)
+   {
+      closeTargetFile(t);
+      if ((index < t->targetCount) && parse_goodStatusCode(httpStatus) &&
+          (HTTP_BAD_REQUEST > httpStatus))
+      {
+         sink_open(&t->sink, t->localFiles[index],
+                   s->response.chunked ? -1 : s->response.contentLength);
+      }
+      t->sinkIndex = index;
+   }
+
+   return sink_isOpen(&t->sink);
+}
+
+//!
+//! Write the payload of a response to its target file as it arrives
+//!
+static void saveBody(CLOUD_SESSION_T *s, int index, const char *data, size_t len, void *arg)
+{
+   TASK_T *t = (TASK_T *)arg;
+
+#ifdef WEBPOLL
+   if (s->response.eventStream)
+   {
+      /* The events are written to the target file one at a time */
+      if ((0 == index) && (HTTP_SUCCESS == s->response.statusCode))
+      {
+         sse_parse(&t->events, data, len);
+      }
+      return;
+   }
+#endif
+   if (openTargetFile(t, s, index))
+   {
+      sink_write(&t->sink, data, len);
+   }
+}
+
+#ifdef WEBGET
+//!
+//! Move the payload of a response from the socket to its target file
+//! without copying it through the receive buffer. Polled files are not
+//! spliced, so that their hash shows when they have not changed.
+//!
+static ssize_t spliceBody(CLOUD_SESSION_T *s, int index, int fd, size_t len, void *arg)
+{
+   TASK_T *t = (TASK_T *)arg;
+
+   if (!openTargetFile(t, s, index))
+   {
+      errno = EOPNOTSUPP;
+      return -1;
+   }
+
+   return sink_splice(&t->sink, fd, len);
+}
+#endif
+
+//!
+//! Replace the target file with the content written so far, unless it is
+//! the same as the local file
+//!
+//! @return  true if the target file holds the content
+//!
+static bool commitTargetFile(TASK_T *t, int index)
+{
+   uint64_t digest = 0;
+   bool hashed;
+
+   hashed = sink_digest(&t->sink, &digest);
+   if (hashed && t->hashed[index] && (digest == t->hashes[index]) &&
+       (0 == access(t->localFiles[index], F_OK)))
+   {
+      /* Same content as the local file, which is left alone */
+      sink_abort(&t->sink);
+      t->unchangedCount++;
+      utils_sysLog(LOG_INFO, "Local file '%s' is unchanged, %u unchanged polls\n",
+                   t->localFiles[index], t->unchangedCount);
+      return true;
+   }
+   if (!sink_commit(&t->sink))
+   {
+      return false;
+   }
+   utils_sysLog(LOG_INFO, "Saved %llu bytes to local file '%s'",
+                (unsigned long long)t->sink.written, t->localFiles[index]);
+   t->hashes[index] = digest;
+   t->hashed[index] = hashed;
+#ifdef WEBPOLL
+   if ((0 == index) && (NULL != t->publish.seg))
+   {
+      /* Local readers get the new content without reading the file */
+      publish_file(&t->publish, t->localFiles[index]);
+   }
+#endif
+
+   return true;
+}
+
+#ifdef WEBPOLL
+//!
+//! Open the subscribed file on the first data bytes of an event or of a
+//! channel message
+//!
+//! @return  true if the data is written to the target file
+//!
+static bool openEventFile(TASK_T *t)
+{
+   if (!sink_isOpen(&t->sink))
+   {
+      sink_open(&t->sink, t->localFiles[0], -1);
+      t->sinkIndex = 0;
+   }
+
+   return sink_isOpen(&t->sink);
+}
+
+//!
+//! Write the data of an event to the subscribed file as it arrives
+//!
+static void saveEventData(void *arg, const char *data, size_t len)
+{
+   TASK_T *t = (TASK_T *)arg;
+
+   if (openEventFile(t))
+   {
+      sink_write(&t->sink, data, len);
+   }
+}
+
+//!
+//! Replace the subscribed file with the data of each complete event. Only
+//! events of the default type carry the content, others are dropped.
+//!
+static void saveEvent(void *arg, const char *event, const char *id)
+{
+   TASK_T *t = (TASK_T *)arg;
+
+   /* An event with empty data still has a file to replace */
+   if (!openEventFile(t))
+   {
+      return;
+   }
+   if (0 != strcmp(event, SSE_DEFAULT_EVENT))
+   {
+      utils_sysLog(LOG_DEBUG, "Skipped event '%s'\n", event);
+      sink_abort(&t->sink);
+      return;
+   }
+   commitTargetFile(t, 0);
+}
+#endif
+
+//!
+//! Finish the target file of each pipelined response as it completes, and
+//! keep its validators for the next conditional request
+//!
+static void saveResponse(CLOUD_SESSION_T *s, int index, int httpStatus, void *arg)
+{
+   TASK_T *t = (TASK_T *)arg;
+
+#ifdef WEBPOLL
+   if ((t->subscribeWait > 0) && (s->response.waitApplied || s->response.eventStream))
+   {
+      /* The server held the request, it can be renewed at once. A server
+         that ignores the wait is polled at the send delay instead. */
+      t->subscribeHeld = true;
+   }
+   if ((index < t->targetCount) && s->response.eventStream)
+   {
+      /* An event cut short by the end of the stream is dropped */
+      sink_abort(&t->sink);
+      utils_sysLog(LOG_INFO, "Event stream of '%s' ended\n", t->targetFiles[index]);
+      return;
+   }
+#endif
+   if ((index < t->targetCount) && (HTTP_NOT_MODIFIED == httpStatus))
+   {
+      t->unchangedCount++;
+      utils_sysLog(LOG_INFO, "Local file '%s' is up to date, %u unchanged polls\n",
+                   t->localFiles[index], t->unchangedCount);
+   }
+   else if ((index < t->targetCount) && parse_goodStatusCode(httpStatus) &&
+            (HTTP_BAD_REQUEST > httpStatus))
+   {
+      if (index != t->sinkIndex)
+      {
+         /* No payload was received for the file */
+         return;
+      }
+      if (!commitTargetFile(t, index))
+      {
+         return;
+      }
+      strcpy(t->etags[index], s->response.etag);
+      strcpy(t->dates[index], s->response.lastModified);
+   }
+   else
+   {
+      utils_sysLog(LOG_INFO, "Received http status %d for '%s'\n", httpStatus,
+                   (index < t->targetCount) ? t->targetFiles[index] : "");
+   }
+}
+#endif
+
+#ifndef WEBGET
+//!
+//! Report each pong of the channel, which stands for a completed poll
+//!
+static void channelPong(void *arg, uint32_t rttMs)
+{
+   TASK_T *t = (TASK_T *)arg;
+
+   t->sendErrors = 0;
+#ifdef WEBALIVE
+   utils_sysLog(LOG_INFO, "HTTP server %s is alive\n", t->serverName);
+#elif WEBPING
+   printf("ECHO from %s, count %u\n", t->serverName, t->timerCount);
+#else
+   utils_sysLog(LOG_DEBUG, "Channel to %s is alive, %u ms\n", t->serverName, rttMs);
+#endif
+}
+#endif
+
+#ifdef WEBPOLL
+//!
+//! Replace the subscribed file with each message pushed on the channel
+//!
+static void channelMessage(void *arg, WS_OPCODE_T opcode, const char *data, size_t len, bool last)
+{
+   TASK_T *t = (TASK_T *)arg;
+
+   if (!openEventFile(t))
+   {
+      return;
+   }
+   if (len > 0)
+   {
+      sink_write(&t->sink, data, len);
+   }
+   if (last)
+   {
+      commitTargetFile(t, 0);
+   }
+}
+#endif
+
+//!
+//! Append to a request being assambled in a send buffer, as long as it
+//! fits. Once something does not fit the rest is not appended either.
+//!
+static void msgAppend(TASK_MSG_T *m, const char *format, ...)
+{
+   va_list ap;
+   int n;
+
+   if (m->truncated)
+   {
+      return;
+   }
+   va_start(ap, format);
+   n = vsnprintf(m->buf + m->len, m->size - m->len, format, ap);
+   va_end(ap);
+   if ((n < 0) || ((size_t)n >= (m->size - m->len)))
+   {
+      m->truncated = true;
+      return;
+   }
+   m->len += n;
+}
+
+//!
+//! Finish a request assambled in a send buffer
+//!
+//! @return  Length of the request, -1 if it does not fit in the buffer
+//!
+static int msgEnd(const TASK_MSG_T *m, TASK_T *t)
+{
+   if (m->truncated)
+   {
+      utils_sysLog(LOG_ERR, "Request of %s to %s does not fit in %u bytes\n",
+                   t->deviceName, t->serverName, (unsigned int)m->size);
+      return -1;
+   }
+
+   return (int)m->len;
+}
+
+//!
+//! Assamble HTTP buffer to send, one pipelined request per target file
+//!
+static int assambleSendBuffer(TASK_T *t, char *msgBuf)
+{
+   TASK_MSG_T m = { msgBuf, CLOUD_SEND_BUF_LEN, 0, false };
+   bool validated;
+   int i;
+
+   for (i = 0; i < t->targetCount; i++)
+   {
+      validated = false;
+      msgAppend(&m, "GET /%s HTTP/1.1\r\n", t->targetFiles[i]);
+      msgAppend(&m, "Host: %s\r\n", t->serverName);
+      msgAppend(&m, "Device-Name: \"%s\"\r\n", t->deviceName);
+      msgAppend(&m, "Device-MAC: \"%s\"\r\n", t->deviceAddr);
+      msgAppend(&m, "Connection: keep-alive\r\n");
+#ifdef DOWNLOAD
+      /* The server answers 304 without a body while the local copy is current */
+      if (0 == access(t->localFiles[i], F_OK))
+      {
+         if (0 != strlen(t->etags[i]))
+         {
+            msgAppend(&m, "If-None-Match: %s\r\n", t->etags[i]);
+            validated = true;
+         }
+         if (0 != strlen(t->dates[i]))
+         {
+            msgAppend(&m, "If-Modified-Since: %s\r\n", t->dates[i]);
+            validated = true;
+         }
+      }
+#endif
+      if (!validated)
+      {
+         /* Caches on the way may answer a conditional request from a copy they know is current */
+         msgAppend(&m, "Pragma: no-cache\r\n");
+         msgAppend(&m, "Cache-Control: no-cache\r\n");
+      }
+#ifdef WEBPOLL
+      if (t->subscribeWait > 0)
+      {
+         /* The server streams the changes, or answers once something changes */
+         msgAppend(&m, "Accept: text/event-stream, */*\r\n");
+         msgAppend(&m, "Prefer: wait=%d\r\n", t->subscribeWait);
+         if (0 != strlen(t->events.lastId))
+         {
+            msgAppend(&m, "Last-Event-ID: %s\r\n", t->events.lastId);
+         }
+      }
+#endif
+      msgAppend(&m, "Content-Type: application/x-www-form-urlencoded\r\n");
+      msgAppend(&m, "Content-Length: 0\r\n");
+      msgAppend(&m, "\r\n");
+   }
+
+   return msgEnd(&m, t);
+}
+
+#ifndef WEBGET
+//!
+//! Assamble the HTTP request that opens the WebSocket channel
+//!
+static int assambleUpgradeRequest(TASK_T *t, char *msgBuf)
+{
+   TASK_MSG_T m = { msgBuf, CLOUD_SEND_BUF_LEN, 0, false };
+
+   msgAppend(&m, "GET /%s HTTP/1.1\r\n", t->channelPath);
+   msgAppend(&m, "Host: %s\r\n", t->serverName);
+   msgAppend(&m, "Device-Name: \"%s\"\r\n", t->deviceName);
+   msgAppend(&m, "Device-MAC: \"%s\"\r\n", t->deviceAddr);
+   msgAppend(&m, "Upgrade: websocket\r\n");
+   msgAppend(&m, "Connection: Upgrade\r\n");
+   msgAppend(&m, "Sec-WebSocket-Key: %s\r\n", ws_newKey(&t->channel));
+   msgAppend(&m, "Sec-WebSocket-Version: 13\r\n");
+   msgAppend(&m, "\r\n");
+
+   return msgEnd(&m, t);
+}
+#endif
+
+#ifdef WEBGET
+//!
+//! Assamble the HTTP header of an upload of the local file to the first
+//! target file on the server
+//!
+static int assambleUploadHeader(TASK_T *t, char *msgBuf, int length)
+{
+   TASK_MSG_T m = { msgBuf, CLOUD_SEND_BUF_LEN, 0, false };
+
+   msgAppend(&m, "%s /%s HTTP/1.1\r\n", t->uploadPost ? "POST" : "PUT", t->targetFiles[0]);
+   msgAppend(&m, "Host: %s\r\n", t->serverName);
+   msgAppend(&m, "Device-Name: \"%s\"\r\n", t->deviceName);
+   msgAppend(&m, "Device-MAC: \"%s\"\r\n", t->deviceAddr);
+   msgAppend(&m, "Connection: keep-alive\r\n");
+   msgAppend(&m, "Content-Type: application/octet-stream\r\n");
+   msgAppend(&m, "Content-Length: %d\r\n", length);
+   msgAppend(&m, "\r\n");
+
+   return msgEnd(&m, t);
+}
+
+//!
+//! Assamble HTTP request for a byte range of the first target file
+//!
+static int assambleRangeRequest(char *msgBuf, uint64_t first, uint64_t last,
+                                const char *validator, void *arg)
+{
+   TASK_T *t = (TASK_T *)arg;
+   TASK_MSG_T m = { msgBuf, CLOUD_SEND_BUF_LEN, 0, false };
+
+   msgAppend(&m, "GET /%s HTTP/1.1\r\n", t->targetFiles[0]);
+   msgAppend(&m, "Host: %s\r\n", t->serverName);
+   msgAppend(&m, "Device-Name: \"%s\"\r\n", t->deviceName);
+   msgAppend(&m, "Device-MAC: \"%s\"\r\n", t->deviceAddr);
+   msgAppend(&m, "Connection: keep-alive\r\n");
+   msgAppend(&m, "Pragma: no-cache\r\n");
+   msgAppend(&m, "Cache-Control: no-cache\r\n");
+   msgAppend(&m, "Range: bytes=%llu-%llu\r\n",
+             (unsigned long long)first, (unsigned long long)last);
+   if (0 != strlen(validator))
+   {
+      msgAppend(&m, "If-Range: %s\r\n", validator);
+   }
+   msgAppend(&m, "\r\n");
+
+   return msgEnd(&m, t);
+}
+
+//!
+//! Close the local file being uploaded, if any
+//!
+static void closeUploadFile(TASK_T *t)
+{
+   if (t->uploadFd >= 0)
+   {
+      close(t->uploadFd);
+      t->uploadFd = -1;
+   }
+}
 
-#ifdef DOWNLOAD
 //!
-//! Save the received data to a local file
+//! Attach the local file to upload to the session, to be sent after the
+//! header in the send buffer
+//!
+//! @return  true if the file is ready to be sent
 //!
-static void saveReceivedDataToFile(char *dataBuf)
+static bool attachUploadFile(TASK_T *t, CLOUD_SESSION_T *s)
 {
-   char* start;
-   int length;
-   FILE* fp;
+   struct stat st;
 
-   start = parse_getContentStart(dataBuf);
-   length = parse_getContentLength(dataBuf);
-   if ((start != NULL) && (length > 0))
+   closeUploadFile(t);
+   t->uploadFd = open(t->uploadFile, O_RDONLY | O_CLOEXEC);
+   if ((t->uploadFd < 0) || (fstat(t->uploadFd, &st) < 0))
    {
-      remove(target_file);
-      fp = fopen(target_file, "w+");
-      if (fp != NULL)
-      {
-         fwrite(start, 1, length, fp);
-         fclose(fp);
-         utils_sysLog(LOG_INFO, "Saved %d bytes to local file '%s'", length, target_file);
-      }
+      utils_sysLog(LOG_ERR, "Open '%s' errno: %s\n", t->uploadFile, strerror(errno));
+      closeUploadFile(t);
+      return false;
+   }
+   if (!S_ISREG(st.st_mode) || (st.st_size > (INT32_MAX - CLOUD_SEND_BUF_LEN)))
+   {
+      utils_sysLog(LOG_ERR, "Cannot upload '%s'\n", t->uploadFile);
+      closeUploadFile(t);
+      return false;
    }
+   s->sendFileFd = t->uploadFd;
+   s->sendFileLen = (int)st.st_size;
+
+   return true;
 }
 #endif
 
 //!
-//! Assamble HTTP buffer to send
+//! Set send status
 //!
-static int assambleSendBuffer(char *msgBuf)
+static void setSendStatus(TASK_T *t, SEND_STATUS_T status)
 {
-   char *tailPtr;
-
-   tailPtr = msgBuf;
-   tailPtr += sprintf(tailPtr, "GET /%s HTTP/1.1\r\n", target_file);
-   tailPtr += sprintf(tailPtr, "Host: %s\r\n", server_name);
-   tailPtr += sprintf(tailPtr, "Device-Name: \"%s\"\r\n", device_name);
-   tailPtr += sprintf(tailPtr, "Device-MAC: \"%s\"\r\n", device_addr);
-   tailPtr += sprintf(tailPtr, "Connection: keep-alive\r\n");
-   tailPtr += sprintf(tailPtr, "Pragma: no-cache\r\n");
-   tailPtr += sprintf(tailPtr, "Cache-Control: no-cache\r\n");
-   tailPtr += sprintf(tailPtr, "Content-Type: application/x-www-form-urlencoded\r\n");
-   tailPtr += sprintf(tailPtr, "Content-Length: 0\r\n");
-   tailPtr += sprintf(tailPtr, "\r\n\r\n");
-   *tailPtr = '\0';
+   if (t->sendStatus != status)
+   {
+      utils_sysLog(LOG_DEBUG, "Send status changed %d -> %d\n", t->sendStatus, status);
+      t->sendStatus = status;
+      /* The next sub-state runs without waiting for any event */
+      queueTask(t);
+   }
+}
 
-   return strlen(msgBuf);
+//!
+//! Set task state
+//!
+static void setState(TASK_T *t, int state)
+{
+   if (t->state != state)
+   {
+      utils_sysLog(LOG_DEBUG, "Task state changed %d -> %d\n", t->state, state);
+      t->state = state;
+      queueTask(t);
+   }
 }
 
 //!
-//! Set send status
+//! Take a session to the server from the pool and set it up for the
+//! transaction of the task. A channel or a subscription, which keeps its
+//! request open for long, has a dedicated session so that it does not hold
+//! up the polls of the other tasks.
+//!
+//! @return  true if the task has a session, otherwise false with errno
+//!          EBUSY while all sessions to the server are in use
 //!
-static void setSendStatus(SEND_STATUS_T status)
+static bool acquireSession(TASK_T *t)
 {
-   if (send_status != status)
+   CLOUD_SESSION_T *s;
+
+#ifdef WEBGET
+   s = pool_acquireSession(t->serverName, t->serverPort);
+#else
+#ifdef WEBPOLL
+   if (t->subscribeWait > 0)
+   {
+      s = pool_acquireDedicated(t->serverName, t->serverPort, &t->ownSession);
+   }
+   else
+#endif
+   if (0 != strlen(t->channelPath))
+   {
+      s = pool_acquireDedicated(t->serverName, t->serverPort, &t->ownSession);
+   }
+   else
    {
-      utils_sysLog(LOG_DEBUG, "Send status changed %d -> %d\n", send_status, status);
-      send_status = status;
+      s = pool_acquireSession(t->serverName, t->serverPort);
    }
+#endif
+   if (NULL == s)
+   {
+      return false;
+   }
+   t->sendSession = s;
+   s->name = t->deviceName;
+   s->wakeCb = wakeTask;
+   s->wakeArg = t;
+   s->deadlines.dnsMs = TASK_DNS_TIMER;
+   s->deadlines.connectMs = TASK_CONN_TIMER;
+   s->deadlines.firstByteMs = TASK_RECV_TIMER;
+   s->deadlines.totalMs = TASK_SEND_TIMER;
+   s->deadlines.idleMs = 0;
+#ifdef DOWNLOAD
+   /* A file takes as long as it takes, so long as its bytes keep coming */
+   s->deadlines.totalMs = 0;
+   s->deadlines.idleMs = TASK_RECV_TIMER;
+#endif
+   s->sendFileLen = 0;
+#ifdef WEBPOLL
+   if (t->subscribeWait > 0)
+   {
+      /* Held for the wait, or streaming events with heartbeats in between */
+      s->deadlines.firstByteMs = t->subscribeWait * 1000 + TASK_RECV_TIMER;
+      s->deadlines.idleMs = t->subscribeWait * 1000 + TASK_RECV_TIMER;
+      s->deadlines.totalMs = 0;
+   }
+   t->subscribeHeld = false;
+   sse_reset(&t->events);
+#endif
+   s->responseArg = t;
+#ifdef DOWNLOAD
+   s->responseCb = saveResponse;
+   s->bodyCb = saveBody;
+#endif
+#ifdef WEBGET
+   s->spliceCb = spliceBody;
+   if (0 != strlen(t->uploadFile))
+   {
+      /* The response to an upload is not saved */
+      s->responseCb = NULL;
+      s->bodyCb = NULL;
+      s->spliceCb = NULL;
+   }
+#else
+   /* The channel is upgraded from HTTP/1.1, the polls may go as HTTP/2 streams */
+   s->http2 = t->http2 && (0 == strlen(t->channelPath));
+   s->upgradeCb = NULL;
+   if (0 != strlen(t->channelPath))
+   {
+      /* One connection carries the pings and updates for as long as it lasts */
+      s->upgradeCb = ws_upgraded;
+      s->responseArg = &t->channel;
+      s->responseCb = NULL;
+      s->bodyCb = NULL;
+      s->deadlines.firstByteMs = TASK_RECV_TIMER;
+      s->deadlines.idleMs = t->sendDelay + TASK_RECV_TIMER;
+      s->deadlines.totalMs = 0;
+   }
+#endif
+
+   return true;
 }
 
+#ifdef WEBGET
 //!
-//! Set task state
+//! Run the segmented download of the first target file, which replaces
+//! the single session of the Send sub-state FSM
 //!
-static void setState(int state)
+static void sendSegmentActivity(TASK_T *t)
 {
-   if (fsm_state != state)
+   switch (t->sendStatus)
    {
-      utils_sysLog(LOG_DEBUG, "Task state changed %d -> %d\n", fsm_state, state);
-      fsm_state = state;
+      case SEND_NOT_READY:
+         /* Carries on from the ranges saved by an interrupted attempt */
+         if (segment_begin(&t->segments, t->localFiles[0], t->serverName, t->serverPort,
+                           t->segmentCount))
+         {
+            setSendStatus(t, SEND_CONTINUE);
+         }
+         else
+         {
+            t->dataSending = false;
+            utils_sysLog(LOG_INFO, "Failed to start segmented download\n");
+         }
+         break;
+      case SEND_CONTINUE:
+         switch (segment_process(&t->segments))
+         {
+            case SEGMENT_COMPLETED:
+               t->dataSending = false;
+               setSendStatus(t, SEND_COMPLETED);
+               break;
+            case SEGMENT_FAILED:
+               t->dataSending = false;
+               break;
+            default:
+               break;
+         }
+         break;
+      default:
+         break;
    }
 }
+#endif
 
 //!
 //! Entry function to INIT state
 //!
-void initEntry(void)
+void task_initEntry(TASK_T *t)
 {
-   setState(FSM_INIT_STATE);
-   if (initialized)
+   setState(t, FSM_INIT_STATE);
+   if (t->initialized)
    {
-      initialized = false;
+      t->initialized = false;
    }
 }
 
 //!
 //! Activity function in INIT state
 //!
-void initActivity(void)
+void task_initActivity(TASK_T *t)
 {
-   if (!initialized)
+#ifdef DOWNLOAD
+   int i;
+#endif
+#ifdef WEBGET
+   const CLOUD_DEADLINES_T deadlines = {TASK_DNS_TIMER, TASK_CONN_TIMER, TASK_RECV_TIMER, 0, TASK_RECV_TIMER};
+#endif
+
+   if (!t->initialized)
    {
-      if (0 == strlen(device_name))
+      if (0 == strlen(t->deviceName))
+      {
+         strcpy(t->deviceName, DEVICE_NAME_DEF);
+      }
+      if (0 == strlen(t->deviceAddr))
       {
-         strcpy(device_name, DEVICE_NAME_DEF);
+         strcpy(t->deviceAddr, DEVICE_ADDR_DEF);
       }
-      sendSession.name = device_name;
-      if (0 == strlen(device_addr))
+#ifdef WEBGET
+      if ((0 == t->targetCount) && (0 != strlen(t->uploadFile)))
       {
-         strcpy(device_addr, DEVICE_ADDR_DEF);
+         /* Upload to a file of the same name on the server */
+         set_target_file(t, basename(t->uploadFile));
       }
-      if (0 == strlen(target_file))
+#endif
+      if (0 == t->targetCount)
       {
-         strcpy(target_file, TARGET_FILE_DEF);
+         set_target_file(t, TARGET_FILE_DEF);
       }
-      if (0 == strlen(server_name))
+      if (0 == strlen(t->serverName))
       {
-         strcpy(server_name, SERVER_NAME_DEF);
+         strcpy(t->serverName, SERVER_NAME_DEF);
       }
-      server_port = CLOUD_TCP_PORT_HTTP;
-      utils_sysLog(LOG_INFO, "Server : %s\n", server_name);
-      utils_sysLog(LOG_INFO, "Device : %s\n", device_addr);
+      t->serverPort = CLOUD_TCP_PORT_HTTP;
+      /* Resolve the server while the rest of the task starts up */
+      dns_prefetch(t->serverName);
+      utils_sysLog(LOG_INFO, "Server : %s\n", t->serverName);
+      utils_sysLog(LOG_INFO, "Device : %s\n", t->deviceAddr);
 #ifdef DOWNLOAD
-      utils_sysLog(LOG_INFO, "Target : %s\n", target_file);
+      if ((0 != strlen(t->localDir)) && (mkdir(t->localDir, 0755) < 0) && (EEXIST != errno))
+      {
+         utils_sysLog(LOG_ERR, "Create '%s' errno: %s\n", t->localDir, strerror(errno));
+      }
+      for (i = 0; i < t->targetCount; i++)
+      {
+         utils_sysLog(LOG_INFO, "Target : %s\n", t->targetFiles[i]);
+         if (0 != strlen(t->localDir))
+         {
+            /* The devices of one process poll the same files */
+            snprintf(t->localFiles[i], SINK_PATH_LEN, "%s/%s", t->localDir, t->targetFiles[i]);
+         }
+         else
+         {
+            strcpy(t->localFiles[i], t->targetFiles[i]);
+         }
+      }
+      sink_init(&t->sink);
+#endif
+#ifdef WEBGET
+      segment_init(&t->segments, assambleRangeRequest, wakeTask, &deadlines, t);
+#endif
+#ifndef WEBGET
+#ifdef WEBPOLL
+      ws_init(&t->channel, channelMessage, channelPong, t);
+#else
+      ws_init(&t->channel, NULL, channelPong, t);
+#endif
+      if (0 != strlen(t->channelPath))
+      {
+         utils_sysLog(LOG_INFO, "Channel: %s\n", t->channelPath);
+      }
+#endif
+#ifdef WEBPOLL
+      if (((t->subscribeWait > 0) || (0 != strlen(t->channelPath))) && (t->targetCount > 1))
+      {
+         /* A held request would hold up the requests pipelined after it */
+         utils_sysLog(LOG_INFO, "Only '%s' is subscribed to\n", t->targetFiles[0]);
+         t->targetCount = 1;
+      }
+      sse_init(&t->events, saveEventData, saveEvent, t);
+      if ((0 != strlen(t->publishName)) && (NULL == t->publish.seg) &&
+          publish_open(&t->publish, t->publishName, PUBLISH_DATA_LEN))
+      {
+         utils_sysLog(LOG_INFO, "Publish: %s\n", t->publishName);
+         /* A file kept from the last run is only fetched again when it changes */
+         if (0 == access(t->localFiles[0], F_OK))
+         {
+            publish_file(&t->publish, t->localFiles[0]);
+         }
+      }
 #endif
 #ifndef WEBGET
-      timer_count = 0;
+      t->timerCount = 0;
+      t->timerStart = utils_getCurrentTimeMs();
+      t->timerDelay = phaseDelay(t);
+      utils_sysLog(LOG_DEBUG, "First poll in %u ms\n", t->timerDelay);
 #endif
-      initialized = true;
+      t->initialized = true;
    }
 }
 
 //!
 //! Entry function to IDLE state
 //!
-void idleEntry(void)
+void task_idleEntry(TASK_T *t)
 {
-   setState(FSM_IDLE_STATE);
-   if (data_sending)
+   setState(t, FSM_IDLE_STATE);
+   if (t->dataSending)
    {
-      data_sending = false;
+      t->dataSending = false;
    }
 }
 
 //!
 //! Activity function in IDLE state
 //!
-void idleActivity(void)
+void task_idleActivity(TASK_T *t)
 {
 #ifndef WEBGET
-   if ((timer_count == 0) || utils_isTimerExpired(timer_start, TASK_SEND_DELAY))
+   uint32_t delay = t->timerDelay;
+   uint32_t left;
+
+#ifdef WEBPOLL
+   if ((t->subscribeWait > 0) && t->subscribeHeld)
+   {
+      /* Changes are caught while the next request is held by the server */
+      delay = 0;
+   }
+#endif
+   left = utils_getTimeLeftMs(t->timerStart, delay);
+   if (0 == left)
+   {
+      t->dataSending = true;
+      t->timerCount++;
+      t->timerStart = utils_getCurrentTimeMs();
+      t->timerDelay = jitterDelay(t);
+   }
+   else
    {
-      data_sending = true;
-      timer_count++;
-      timer_start = utils_getCurrentTime();
+      /* Run again when the next transaction is due */
+      scheduleTask(t, left);
    }
 #else
-   data_sending = true;
+   t->dataSending = true;
 #endif
 }
 
 //!
 //! Entry function to SEND state
 //!
-void sendEntry(void)
+void task_sendEntry(TASK_T *t)
 {
-   setState(FSM_SEND_STATE);
-   setSendStatus(SEND_NOT_READY);
+   setState(t, FSM_SEND_STATE);
+   setSendStatus(t, SEND_NOT_READY);
 }
 
 //!
 //! Activity function in SEND state
 //!
-void sendActivity(void)
+void task_sendActivity(TASK_T *t)
 {
-   CLOUD_SESSION_T *s = &sendSession;
+   CLOUD_SESSION_T *s = t->sendSession;
+   uint32_t left;
 
+#ifdef WEBGET
+   if (t->segmentCount > 0)
+   {
+      sendSegmentActivity(t);
+      return;
+   }
+#endif
    /* Run Send sub-state FSM */
-   switch (send_status)
+   switch (t->sendStatus)
    {
       case SEND_NOT_READY:
-         if (cloud_initSession(&sendSession, server_name, server_port))
+         if (t->retryPending)
+         {
+            left = utils_getTimeLeftMs(t->retryStart, TASK_RETRY_DELAY);
+            if (left > 0)
+            {
+               /* A server that fails at once is not tried again in a busy loop */
+               scheduleTask(t, left);
+               break;
+            }
+            t->retryPending = false;
+         }
+         if (NULL == s)
+         {
+            if (!acquireSession(t) && (EBUSY == errno))
+            {
+               /* Woken up when another task gives a session back */
+               waitSession(t);
+               break;
+            }
+            s = t->sendSession;
+         }
+         if ((NULL != s) && cloud_initSession(s, t->serverName, t->serverPort))
          {
-            setSendStatus(SEND_STARTING);
+            /* Stay here until the server name is resolved */
+            if (CLOUD_SESSION_RESOLVE_PENDING != s->status)
+            {
+               setSendStatus(t, SEND_STARTING);
+            }
          }
          else
          {
-            data_sending = false;
+            t->dataSending = false;
 #ifdef WEBPING
-            printf("ECHO from %s failed\n", server_name);
+            printf("ECHO from %s failed\n", t->serverName);
 #else
             utils_sysLog(LOG_INFO, "Failed to initialize session\n");
 #endif
          }
          break;
       case SEND_STARTING:
-         send_len = assambleSendBuffer(s->sendBuf);
-         utils_sysLog(LOG_DEBUG, "Total %d bytes to send\n", send_len);
-         s->totalBytesToSend = send_len;
-         setSendStatus(SEND_STARTED);
+#ifdef WEBGET
+         if (0 != strlen(t->uploadFile))
+         {
+            if (!attachUploadFile(t, s))
+            {
+               t->dataSending = false;
+               break;
+            }
+            t->sendLen = assambleUploadHeader(t, s->sendBuf, s->sendFileLen);
+            if (t->sendLen >= 0)
+            {
+               t->sendLen += s->sendFileLen;
+            }
+            s->requestCount = 1;
+         }
+         else
+#else
+         if (0 != strlen(t->channelPath))
+         {
+            t->sendLen = assambleUpgradeRequest(t, s->sendBuf);
+            s->requestCount = 1;
+         }
+         else
+#endif
+         {
+            t->sendLen = assambleSendBuffer(t, s->sendBuf);
+            s->requestCount = t->targetCount;
+         }
+         if (t->sendLen < 0)
+         {
+            t->dataSending = false;
+            break;
+         }
+         utils_sysLog(LOG_DEBUG, "Total %d bytes to send\n", t->sendLen);
+         s->totalBytesToSend = t->sendLen;
+         setSendStatus(t, SEND_STARTED);
          break;
       case SEND_STARTED:
          cloud_sessionConnectAndSend(s);
          if (0 == s->errorCode)
          {
-            setSendStatus(SEND_CONTINUE);
+            setSendStatus(t, SEND_CONTINUE);
          }
          else
          {
-            data_sending = false;
+            t->dataSending = false;
 #ifdef WEBPING
-            printf("ECHO from %s failed\n", server_name);
+            printf("ECHO from %s failed\n", t->serverName);
 #else
             utils_sysLog(LOG_INFO, "Failed to create connection\n");
 #endif
          }
          break;
       case SEND_CONTINUE:
-         if (cloud_sessionSendRecvAll(s, TASK_SEND_TIMER))
+         if (cloud_sessionSendRecvAll(s))
          {
-            data_sending = false;
-            if (HTTP_BAD_REQUEST > sendSession.httpStatus)
+            t->dataSending = false;
+            if (s->upgraded)
+            {
+               /* Counted as a failed poll, the channel is opened again later */
+               utils_sysLog(LOG_INFO, "Channel to %s closed\n", t->serverName);
+            }
+            else if (HTTP_BAD_REQUEST > s->httpStatus)
             {
-               setSendStatus(SEND_COMPLETED);
+               setSendStatus(t, SEND_COMPLETED);
             }
             else
             {
-               utils_sysLog(LOG_INFO, "Received http status %d\n", sendSession.httpStatus);
+               utils_sysLog(LOG_INFO, "Received http status %d\n", s->httpStatus);
+            }
+         }
+#ifndef WEBGET
+         else if (ws_isOpen(&t->channel))
+         {
+            left = utils_getTimeLeftMs(t->timerStart, t->sendDelay);
+            if ((0 == t->channel.pings) || (0 == left))
+            {
+               /* The first ping is counted by the idle state that opened the channel */
+               if (ws_ping(&t->channel) && (t->channel.pings > 1))
+               {
+                  t->timerCount++;
+               }
+               t->timerStart = utils_getCurrentTimeMs();
+               left = t->sendDelay;
             }
+            /* Run again when the next ping is due */
+            scheduleTask(t, left);
          }
+#endif
          break;
       default:
          break;
@@ -304,42 +1203,52 @@ void sendActivity(void)
 //!
 //! Exit function from SEND state
 //!
-void sendExit(void)
+void task_sendExit(TASK_T *t)
 {
-   if (SEND_COMPLETED == send_status)
-   {
-      send_errors = 0;
 #ifdef DOWNLOAD
-      saveReceivedDataToFile(sendSession.recvBuf);
+   /* A download that did not complete leaves the target file untouched */
+   closeTargetFile(t);
+#endif
+#ifdef WEBGET
+   closeUploadFile(t);
+   /* An unfinished segmented download is kept to be resumed */
+   segment_end(&t->segments);
+#else
+   ws_close(&t->channel, WS_CLOSE_NORMAL);
 #endif
+   t->retryPending = (SEND_COMPLETED != t->sendStatus);
+   t->retryStart = utils_getCurrentTimeMs();
+   if (SEND_COMPLETED == t->sendStatus)
+   {
+      t->sendErrors = 0;
 #ifdef WEBGET
-      task_completed = true;
+      completeTask(t);
       printf("Program exited successfully\n");
 #elif WEBALIVE
-      utils_sysLog(LOG_INFO, "HTTP server %s is alive\n", server_name);
+      utils_sysLog(LOG_INFO, "HTTP server %s is alive\n", t->serverName);
 #elif WEBPING
-      printf("ECHO from %s, count %u\n", server_name, timer_count);
+      printf("ECHO from %s, count %u\n", t->serverName, t->timerCount);
 #endif
    }
    else
    {
-      send_errors++;
-      utils_sysLog(LOG_DEBUG, "Send session failures %d\n", send_errors);
+      t->sendErrors++;
+      utils_sysLog(LOG_DEBUG, "Send session failures %d\n", t->sendErrors);
 #ifdef WEBGET
-      if ((send_errors >= TASK_SEND_LIMIT) || (SEND_CONTINUE != send_status))
+      if ((t->sendErrors >= TASK_SEND_LIMIT) || (SEND_CONTINUE != t->sendStatus))
       {
-         task_completed = true;
+         completeTask(t);
          printf("Program exited unexpectedly\n");
       }
 #else
-      if (send_errors >= TASK_SEND_LIMIT)
+      if (t->sendErrors >= TASK_SEND_LIMIT)
       {
-         send_errors = 0;
-         initialized = false;
-         if (SEND_CONTINUE == send_status)
+         t->sendErrors = 0;
+         t->initialized = false;
+         if (SEND_CONTINUE == t->sendStatus)
          {
 #ifdef WEBPING
-            printf("ECHO from %s failed\n", server_name);
+            printf("ECHO from %s failed\n", t->serverName);
 #else
             utils_sysLog(LOG_INFO, "Failed to receive response\n");
 #endif
@@ -347,75 +1256,265 @@ void sendExit(void)
       }
 #endif /* WEBGET */
    }
-   cloud_closeSession(&sendSession);
+   if (NULL != t->sendSession)
+   {
+      pool_releaseSession(t->sendSession);
+      t->sendSession = NULL;
+   }
 }
 
 //!
 //! Reset Cloud session status
 //!
-void resetSessionStatus(void)
+void task_resetSessionStatus(TASK_T *t)
 {
-	cloud_resetSessionStatus(&sendSession);
+   if (NULL != t->sendSession)
+   {
+      cloud_resetSessionStatus(t->sendSession);
+   }
 }
 
 //!
 //! Check if any sesssion error happened
 //!
-bool checkSessionError(void)
+bool task_checkSessionError(TASK_T *t)
 {
-   CLOUD_SESSION_T *s = &sendSession;
+   CLOUD_SESSION_T *s = t->sendSession;
 
+   if (NULL == s)
+   {
+      return false;
+   }
    return (s->timeout || s->recvComplete || (0 != s->errorCode));
 }
 
+//!
+//! Initialize a task context with no options set
+//!
+void task_init(TASK_T *t)
+{
+   memset(t, 0, sizeof(TASK_T));
+   t->state = FSM_INIT_STATE;
+   t->sendStatus = SEND_NOT_READY;
+#ifdef DOWNLOAD
+   t->sinkIndex = -1;
+#endif
+#ifdef WEBGET
+   t->uploadFd = -1;
+#else
+   t->sendDelay = TASK_SEND_DELAY * 1000;
+#endif
+}
+
+//!
+//! Start the state machine of a task, which enters the INIT state on the
+//! next pass
+//!
+void task_start(TASK_T *t)
+{
+   fsm_start(&t->workspace, t);
+   wheel_initTimer(&t->timer, wakeTask, t);
+   pool_setReleaseCallback(sessionReleased);
+#ifndef WEBGET
+   if (0 == jitterSeed)
+   {
+      jitterSeed = utils_getCurrentTimeMs() ^ (unsigned int)getpid();
+   }
+#endif
+   runningCount++;
+   queueTask(t);
+}
+
+//!
+//! Run the tasks that are due once: those queued by their timers, by a
+//! change of state, or by their sessions, which wake them up when there is
+//! something to act on. Tasks that are not due cost nothing, however many,
+//! whether idle or waiting on their sessions.
+//!
+//! @return true if a task is queued to run again at once
+//!
+bool task_runDue(void)
+{
+   TASK_T *t;
+   TASK_T *next;
+
+   t = runHead;
+   runHead = NULL;
+   runTail = NULL;
+   for (; NULL != t; t = next)
+   {
+      next = t->runNext;
+      t->runNext = NULL;
+      t->runQueued = false;
+      fsm_run(&t->workspace);
+      if (t->workspace.transition)
+      {
+         /* The entry action of the new state runs on the next pass */
+         queueTask(t);
+      }
+   }
+
+   return (NULL != runHead);
+}
+
+//!
+//! Get the number of tasks started and not completed
+//!
+int task_getRunning(void)
+{
+   return runningCount;
+}
+
 //!
 //! Get task completed flag
 //!
-bool get_task_completed(void)
+bool get_task_completed(TASK_T *t)
 {
-   return task_completed;
+   return t->completed;
 }
 
 //!
 //! Set server name (URL or IP address)
 //!
-void set_server_name(char *name)
+void set_server_name(TASK_T *t, char *name)
 {
    if (strlen(name) < SERVER_NAME_LEN)
    {
-      strcpy(server_name, name);
+      strcpy(t->serverName, name);
    }
 }
 
 //!
-//! Set targted file name
+//! Add a targeted file name, all targets are requested in one pipeline
 //!
-void set_target_file(char *file)
+void set_target_file(TASK_T *t, char *file)
+{
+   if ((strlen(file) > 0) && (strlen(file) < TARGET_FILE_LEN) &&
+       (t->targetCount < TARGET_FILE_MAX))
+   {
+      strcpy(t->targetFiles[t->targetCount++], file);
+   }
+}
+
+#ifdef WEBGET
+//!
+//! Set local file to upload instead of downloading the target files
+//!
+void set_upload_file(TASK_T *t, char *file)
 {
    if (strlen(file) < TARGET_FILE_LEN)
    {
-      strcpy(target_file, file);
+      strcpy(t->uploadFile, file);
+   }
+}
+
+//!
+//! Upload with POST instead of PUT
+//!
+void set_upload_post(TASK_T *t, bool post)
+{
+   t->uploadPost = post;
+}
+
+//!
+//! Fetch the first target file in ranges over up to this many connections
+//!
+void set_segment_count(TASK_T *t, int count)
+{
+   if ((count > 0) && (count <= SEGMENT_MAX))
+   {
+      t->segmentCount = count;
+   }
+}
+#endif
+
+#ifndef WEBGET
+//!
+//! Keep a WebSocket channel open to this path on the server, instead of
+//! a new HTTP transaction each poll
+//!
+void set_channel_path(TASK_T *t, char *path)
+{
+   if (strlen(path) < TARGET_FILE_LEN)
+   {
+      strcpy(t->channelPath, path);
+   }
+}
+
+//!
+//! Set the time between polls or pings, 0 keeps the default
+//!
+void set_send_delay(TASK_T *t, uint32_t delayMs)
+{
+   if (delayMs > 0)
+   {
+      t->sendDelay = delayMs;
+   }
+}
+
+//!
+//! Send the requests as HTTP/2 streams on one cleartext connection
+//!
+void set_http2(TASK_T *t, bool http2)
+{
+   t->http2 = http2;
+}
+#endif
+
+#ifdef WEBPOLL
+//!
+//! Keep the local files in this directory, created if needed
+//!
+void set_local_dir(TASK_T *t, char *dir)
+{
+   if (strlen(dir) < DEVICE_NAME_LEN)
+   {
+      strcpy(t->localDir, dir);
+   }
+}
+
+//!
+//! Publish the first target file to a shared memory segment of this name
+//!
+void set_publish_name(TASK_T *t, char *name)
+{
+   if (strlen(name) < PUBLISH_NAME_LEN)
+   {
+      strcpy(t->publishName, name);
    }
 }
 
+//!
+//! Subscribe to the first target file instead of polling it, the server
+//! may hold each request up to this many seconds
+//!
+void set_subscribe_wait(TASK_T *t, int seconds)
+{
+   if ((seconds > 0) && (seconds <= TASK_WAIT_MAX))
+   {
+      t->subscribeWait = seconds;
+   }
+}
+#endif
+
 //!
 //! Set client device MAC address
 //!
-void set_device_addr(char *addr)
+void set_device_addr(TASK_T *t, char *addr)
 {
    if (strlen(addr) < DEVICE_ADDR_LEN)
    {
-      strcpy(device_addr, addr);
+      strcpy(t->deviceAddr, addr);
    }
 }
 
 //!
 //! Set client device name
 //!
-void set_device_name(char *name)
+void set_device_name(TASK_T *t, char *name)
 {
    if (strlen(name) < DEVICE_NAME_LEN)
    {
-      strcpy(device_name, name);
+      strcpy(t->deviceName, name);
    }
 }
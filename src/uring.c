@@ -0,0 +1,585 @@
+//******************************************************************************
+//!
+//! Author:  Ying Xiong
+//! Created: Oct 2026
+//!
+//******************************************************************************
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include "uring.h"
+#include "utils.h"
+
+#ifdef CLOUD_IO_URING
+
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include "event.h"
+
+//
+// Request Slot
+//
+typedef struct
+{
+   URING_CALLBACK_T callback;         //!< Completion callback, NULL once canceled
+   void *arg;                         //!< Callback argument
+   int fd;                            //!< Descriptor of the operation
+   bool inUse;                        //!< The request is in flight
+   int nextFree;                      //!< Next slot in the free list
+}
+URING_REQUEST_T;
+
+//
+// Submission and Completion Rings
+//
+typedef struct
+{
+   unsigned *head;
+   unsigned *tail;
+   unsigned *mask;
+   unsigned *array;
+   struct io_uring_sqe *sqes;
+   unsigned pending;                  //!< SQEs queued since the last submit
+}
+URING_SQ_T;
+
+typedef struct
+{
+   unsigned *head;
+   unsigned *tail;
+   unsigned *mask;
+   struct io_uring_cqe *cqes;
+}
+URING_CQ_T;
+
+//
+// Local Variables
+//
+static int ringFd = -1;
+static URING_SQ_T sq;
+static URING_CQ_T cq;
+static EVENT_HANDLER_T ringHandler;
+static struct io_uring_buf_ring *bufRing;
+static char *bufBase;
+static unsigned short bufTail;
+static URING_REQUEST_T requests[URING_MAX_REQUESTS + 1]; /* request 0 is URING_NO_REQUEST */
+static int freeRequest = URING_NO_REQUEST;
+
+//!
+//! Thin wrappers of the io_uring system calls.
+//!
+static int uring_setup(unsigned entries, struct io_uring_params *p)
+{
+   return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int uring_enter(unsigned toSubmit, unsigned minComplete, unsigned flags)
+{
+   return (int)syscall(__NR_io_uring_enter, ringFd, toSubmit, minComplete, flags, NULL, 0);
+}
+
+static int uring_register(unsigned opcode, void *arg, unsigned nrArgs)
+{
+   return (int)syscall(__NR_io_uring_register, ringFd, opcode, arg, nrArgs);
+}
+
+//!
+//! Check that the kernel supports every operation used here.
+//!
+static bool uring_probeOps(void)
+{
+   static const uint8_t ops[] = { IORING_OP_CONNECT, IORING_OP_SEND, IORING_OP_RECV,
+                                  IORING_OP_ASYNC_CANCEL, IORING_OP_CLOSE };
+   struct io_uring_probe *probe;
+   bool supported = true;
+   size_t len;
+   size_t i;
+
+   len = sizeof(struct io_uring_probe) + IORING_OP_LAST * sizeof(struct io_uring_probe_op);
+   probe = calloc(1, len);
+   if ((NULL == probe) || (uring_register(IORING_REGISTER_PROBE, probe, IORING_OP_LAST) < 0))
+   {
+      free(probe);
+      return false;
+   }
+   for (i = 0; i < sizeof(ops); i++)
+   {
+      if ((ops[i] > probe->last_op) || !(probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED))
+      {
+         supported = false;
+      }
+   }
+   free(probe);
+
+   return supported;
+}
+
+//!
+//! Hand a receive buffer back to the kernel.
+//!
+static void uring_recycleBuffer(unsigned short bid)
+{
+   struct io_uring_buf *buf = &bufRing->bufs[bufTail & (URING_BUF_COUNT - 1)];
+
+   buf->addr = (uint64_t)(uintptr_t)(bufBase + (size_t)bid * URING_BUF_LEN);
+   buf->len = URING_BUF_LEN;
+   buf->bid = bid;
+   bufTail++;
+   __atomic_store_n(&bufRing->tail, bufTail, __ATOMIC_RELEASE);
+}
+
+//!
+//! Register the provided buffer ring used by multishot receives.
+//!
+static bool uring_setupBuffers(void)
+{
+   struct io_uring_buf_reg reg;
+   size_t ringLen = URING_BUF_COUNT * sizeof(struct io_uring_buf);
+   unsigned short i;
+
+   bufRing = mmap(NULL, ringLen, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+   if (MAP_FAILED == bufRing)
+   {
+      bufRing = NULL;
+      return false;
+   }
+   bufBase = malloc((size_t)URING_BUF_COUNT * URING_BUF_LEN);
+   if (NULL == bufBase)
+   {
+      return false;
+   }
+   memset(&reg, 0, sizeof(reg));
+   reg.ring_addr = (uint64_t)(uintptr_t)bufRing;
+   reg.ring_entries = URING_BUF_COUNT;
+   reg.bgid = URING_BUF_GROUP;
+   if (uring_register(IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+   {
+      return false;
+   }
+   for (i = 0; i < URING_BUF_COUNT; i++)
+   {
+      uring_recycleBuffer(i);
+   }
+
+   return true;
+}
+
+//!
+//! Map the submission and completion rings.
+//!
+static bool uring_mapRings(struct io_uring_params *p)
+{
+   size_t sqLen = p->sq_off.array + p->sq_entries * sizeof(unsigned);
+   size_t cqLen = p->cq_off.cqes + p->cq_entries * sizeof(struct io_uring_cqe);
+   char *sqPtr;
+   char *cqPtr;
+
+   if (!(p->features & IORING_FEAT_SINGLE_MMAP))
+   {
+      return false;
+   }
+   if (cqLen > sqLen)
+   {
+      sqLen = cqLen;
+   }
+   sqPtr = mmap(NULL, sqLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+   if (MAP_FAILED == sqPtr)
+   {
+      return false;
+   }
+   cqPtr = sqPtr;
+   sq.sqes = mmap(NULL, p->sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+   if (MAP_FAILED == sq.sqes)
+   {
+      return false;
+   }
+   sq.head = (unsigned *)(sqPtr + p->sq_off.head);
+   sq.tail = (unsigned *)(sqPtr + p->sq_off.tail);
+   sq.mask = (unsigned *)(sqPtr + p->sq_off.ring_mask);
+   sq.array = (unsigned *)(sqPtr + p->sq_off.array);
+   cq.head = (unsigned *)(cqPtr + p->cq_off.head);
+   cq.tail = (unsigned *)(cqPtr + p->cq_off.tail);
+   cq.mask = (unsigned *)(cqPtr + p->cq_off.ring_mask);
+   cq.cqes = (struct io_uring_cqe *)(cqPtr + p->cq_off.cqes);
+
+   return true;
+}
+
+//!
+//! Take a request slot.
+//!
+static int uring_allocRequest(URING_CALLBACK_T cb, void *arg, int fd)
+{
+   int req = freeRequest;
+
+   if (URING_NO_REQUEST == req)
+   {
+      utils_sysLog(LOG_ERR, "io_uring out of request slots\n");
+      return URING_NO_REQUEST;
+   }
+   freeRequest = requests[req].nextFree;
+   requests[req].callback = cb;
+   requests[req].arg = arg;
+   requests[req].fd = fd;
+   requests[req].inUse = true;
+
+   return req;
+}
+
+//!
+//! Return a request slot to the free list.
+//!
+static void uring_freeRequest(int req)
+{
+   requests[req].inUse = false;
+   requests[req].callback = NULL;
+   requests[req].nextFree = freeRequest;
+   freeRequest = req;
+}
+
+//!
+//! Get the next free submission queue entry, submitting the queued ones
+//! first if the queue is full.
+//!
+static struct io_uring_sqe* uring_getSqe(void)
+{
+   struct io_uring_sqe *sqe;
+   unsigned tail = *sq.tail;
+   unsigned index;
+
+   if ((tail - __atomic_load_n(sq.head, __ATOMIC_ACQUIRE)) > *sq.mask)
+   {
+      uring_submit();
+      if ((tail - __atomic_load_n(sq.head, __ATOMIC_ACQUIRE)) > *sq.mask)
+      {
+         return NULL;
+      }
+   }
+   index = tail & *sq.mask;
+   sqe = &sq.sqes[index];
+   memset(sqe, 0, sizeof(struct io_uring_sqe));
+   sq.array[index] = index;
+   __atomic_store_n(sq.tail, tail + 1, __ATOMIC_RELEASE);
+   sq.pending++;
+
+   return sqe;
+}
+
+//!
+//! Queue an operation on behalf of a new request.
+//!
+//! @return  Request id, or URING_NO_REQUEST if nothing could be queued
+//!
+static int uring_queue(uint8_t opcode, int fd, URING_CALLBACK_T cb, void *arg, struct io_uring_sqe **sqe)
+{
+   int req = uring_allocRequest(cb, arg, fd);
+
+   if (URING_NO_REQUEST == req)
+   {
+      return URING_NO_REQUEST;
+   }
+   *sqe = uring_getSqe();
+   if (NULL == *sqe)
+   {
+      uring_freeRequest(req);
+      return URING_NO_REQUEST;
+   }
+   (*sqe)->opcode = opcode;
+   (*sqe)->fd = fd;
+   (*sqe)->user_data = (uint64_t)req;
+
+   return req;
+}
+
+//!
+//! Dispatch a completion to its request.
+//!
+static void uring_complete(struct io_uring_cqe *cqe)
+{
+   URING_REQUEST_T *r;
+   const char *data = NULL;
+   unsigned short bid = 0;
+   bool hasBuffer;
+   bool more;
+
+   if ((URING_NO_REQUEST == cqe->user_data) || (cqe->user_data > URING_MAX_REQUESTS))
+   {
+      return;
+   }
+   r = &requests[cqe->user_data];
+   more = (0 != (cqe->flags & IORING_CQE_F_MORE));
+   hasBuffer = (0 != (cqe->flags & IORING_CQE_F_BUFFER));
+   if (hasBuffer)
+   {
+      bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+      data = bufBase + (size_t)bid * URING_BUF_LEN;
+   }
+   if (r->inUse && (NULL != r->callback))
+   {
+      r->callback(r->arg, r->fd, cqe->res, data, more);
+   }
+   if (hasBuffer)
+   {
+      uring_recycleBuffer(bid);
+   }
+   if (!more && r->inUse)
+   {
+      uring_freeRequest((int)cqe->user_data);
+   }
+}
+
+//!
+//! Event loop callback of the ring, reaps all available completions.
+//!
+static void uring_ringEvent(void *arg, uint32_t events)
+{
+   unsigned head = *cq.head;
+
+   while (head != __atomic_load_n(cq.tail, __ATOMIC_ACQUIRE))
+   {
+      uring_complete(&cq.cqes[head & *cq.mask]);
+      head++;
+      __atomic_store_n(cq.head, head, __ATOMIC_RELEASE);
+   }
+}
+
+//!
+//! Create the ring and add it to the event loop.
+//!
+//! The ring descriptor becomes readable when completions are posted, so
+//! the completions are reaped from the shared epoll event loop.
+//!
+//! @return  true if io_uring is used for session I/O, otherwise false
+//!
+bool uring_init(void)
+{
+   struct io_uring_params params;
+   int i;
+
+   if (ringFd >= 0)
+   {
+      return true;
+   }
+   memset(&params, 0, sizeof(params));
+   params.flags = IORING_SETUP_CQSIZE;
+   params.cq_entries = URING_CQ_ENTRIES;
+   ringFd = uring_setup(URING_SQ_ENTRIES, &params);
+   if (ringFd < 0)
+   {
+      utils_sysLog(LOG_INFO, "io_uring not available: %s\n", strerror(errno));
+      return false;
+   }
+   if (!uring_mapRings(&params) || !uring_probeOps() || !uring_setupBuffers())
+   {
+      utils_sysLog(LOG_INFO, "io_uring lacks required features\n");
+      close(ringFd);
+      ringFd = -1;
+      return false;
+   }
+   event_initHandler(&ringHandler, uring_ringEvent, NULL);
+   if (!event_addHandler(&ringHandler, ringFd, EPOLLIN))
+   {
+      close(ringFd);
+      ringFd = -1;
+      return false;
+   }
+   for (i = URING_MAX_REQUESTS; i > URING_NO_REQUEST; i--)
+   {
+      uring_freeRequest(i);
+   }
+   utils_sysLog(LOG_INFO, "Using io_uring for session I/O\n");
+
+   return true;
+}
+
+//!
+//! Check whether session I/O goes through io_uring.
+//!
+bool uring_isActive(void)
+{
+   return (ringFd >= 0);
+}
+
+//!
+//! Queue a connect.
+//!
+//! @return  Request id, or URING_NO_REQUEST
+//!
+int uring_connect(int fd, const struct sockaddr *addr, socklen_t addrLen, URING_CALLBACK_T cb, void *arg)
+{
+   struct io_uring_sqe *sqe;
+   int req;
+
+   req = uring_queue(IORING_OP_CONNECT, fd, cb, arg, &sqe);
+   if (URING_NO_REQUEST != req)
+   {
+      sqe->addr = (uint64_t)(uintptr_t)addr;
+      sqe->off = addrLen;
+   }
+
+   return req;
+}
+
+//!
+//! Queue a send.
+//!
+//! @return  Request id, or URING_NO_REQUEST
+//!
+int uring_send(int fd, const void *buf, size_t len, int flags, URING_CALLBACK_T cb, void *arg)
+{
+   struct io_uring_sqe *sqe;
+   int req;
+
+   req = uring_queue(IORING_OP_SEND, fd, cb, arg, &sqe);
+   if (URING_NO_REQUEST != req)
+   {
+      sqe->addr = (uint64_t)(uintptr_t)buf;
+      sqe->len = len;
+      sqe->msg_flags = flags;
+   }
+
+   return req;
+}
+
+//!
+//! Queue a multishot receive using the provided buffer ring.
+//!
+//! The request stays armed and completes once per chunk received until
+//! the peer closes, an error occurs or the buffers run out (-ENOBUFS).
+//!
+//! @return  Request id, or URING_NO_REQUEST
+//!
+int uring_recvMultishot(int fd, URING_CALLBACK_T cb, void *arg)
+{
+   struct io_uring_sqe *sqe;
+   int req;
+
+   req = uring_queue(IORING_OP_RECV, fd, cb, arg, &sqe);
+   if (URING_NO_REQUEST != req)
+   {
+      sqe->ioprio = IORING_RECV_MULTISHOT;
+      sqe->flags = IOSQE_BUFFER_SELECT;
+      sqe->buf_group = URING_BUF_GROUP;
+   }
+
+   return req;
+}
+
+//!
+//! Cancel a request.
+//!
+//! The callback is not called again, the slot is freed once the kernel
+//! reports the final completion of the request.
+//!
+//! @param[in,out] req  Request id, set to URING_NO_REQUEST
+//!
+void uring_cancel(int *req)
+{
+   struct io_uring_sqe *sqe;
+
+   if ((URING_NO_REQUEST == *req) || !requests[*req].inUse)
+   {
+      *req = URING_NO_REQUEST;
+      return;
+   }
+   requests[*req].callback = NULL;
+   sqe = uring_getSqe();
+   if (NULL != sqe)
+   {
+      sqe->opcode = IORING_OP_ASYNC_CANCEL;
+      sqe->addr = (uint64_t)*req;
+   }
+   *req = URING_NO_REQUEST;
+}
+
+//!
+//! Close a descriptor with the next batch of submissions.
+//!
+void uring_close(int fd)
+{
+   struct io_uring_sqe *sqe = uring_getSqe();
+
+   if (NULL == sqe)
+   {
+      close(fd);
+      return;
+   }
+   sqe->opcode = IORING_OP_CLOSE;
+   sqe->fd = fd;
+}
+
+//!
+//! Submit all queued operations with a single system call.
+//!
+void uring_submit(void)
+{
+   int retVal;
+
+   while (sq.pending > 0)
+   {
+      retVal = uring_enter(sq.pending, 0, 0);
+      if (retVal <= 0)
+      {
+         if ((retVal < 0) && (EINTR == errno))
+         {
+            continue;
+         }
+         if ((retVal < 0) && (EAGAIN != errno) && (EBUSY != errno))
+         {
+            utils_sysLog(LOG_ERR, "io_uring submit errno: %s\n", strerror(errno));
+         }
+         break;
+      }
+      sq.pending -= retVal;
+   }
+}
+
+#else /* CLOUD_IO_URING */
+
+//
+// io_uring support is not built in, the cloud sessions use epoll.
+//
+bool uring_init(void)
+{
+   return false;
+}
+
+bool uring_isActive(void)
+{
+   return false;
+}
+
+int uring_connect(int fd, const struct sockaddr *addr, socklen_t addrLen, URING_CALLBACK_T cb, void *arg)
+{
+   return URING_NO_REQUEST;
+}
+
+int uring_send(int fd, const void *buf, size_t len, int flags, URING_CALLBACK_T cb, void *arg)
+{
+   return URING_NO_REQUEST;
+}
+
+int uring_recvMultishot(int fd, URING_CALLBACK_T cb, void *arg)
+{
+   return URING_NO_REQUEST;
+}
+
+void uring_cancel(int *req)
+{
+   *req = URING_NO_REQUEST;
+}
+
+void uring_close(int fd)
+{
+   close(fd);
+}
+
+void uring_submit(void)
+{
+}
+
+#endif /* CLOUD_IO_URING */
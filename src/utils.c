@@ -9,6 +9,7 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <sys/time.h>
+#include <time.h>
 #include "utils.h"
 
 #define MSG_BUFF_SIZE  1023
@@ -29,6 +30,17 @@ uint32_t utils_getCurrentTime(void)
    return (uint32_t)(curr_time.tv_sec);
 }
 
+//!
+//! Get the current monotonic time in milliseconds
+//!
+uint32_t utils_getCurrentTimeMs(void)
+{
+   struct timespec curr_time;
+
+   clock_gettime(CLOCK_MONOTONIC, &curr_time);
+   return (uint32_t)(curr_time.tv_sec * 1000 + curr_time.tv_nsec / 1000000);
+}
+
 //!
 //! Check the log level and if okay, send it to syslog
 //!
@@ -63,3 +75,18 @@ bool utils_isTimerExpired(uint32_t start_time, uint32_t delta_time)
    }
    return expired;
 }
+
+//!
+//! Get the time left in milliseconds before a timer started with
+//! utils_getCurrentTimeMs() expires, 0 once it has expired
+//!
+uint32_t utils_getTimeLeftMs(uint32_t start_time, uint32_t delta_time)
+{
+   uint32_t elapsed = utils_getCurrentTimeMs() - start_time;
+
+   if (elapsed >= delta_time)
+   {
+      return 0;
+   }
+   return (delta_time - elapsed);
+}
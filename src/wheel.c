@@ -0,0 +1,258 @@
+//******************************************************************************
+//!
+//! Author:  Ying Xiong
+//! Created: Oct 2026
+//!
+//******************************************************************************
+
+#include <stddef.h>
+#include <string.h>
+#include "wheel.h"
+
+//
+// Local Defines
+//
+#define WHEEL_SLOT_MASK  (WHEEL_SLOTS - 1)
+
+//!
+//! Link a timer into the slot for its due time, in the lowest level whose
+//! span holds it. The timer is due no sooner than the time of the wheel.
+//!
+static void wheel_link(WHEEL_T *w, WHEEL_TIMER_T *timer)
+{
+   WHEEL_TIMER_T **head;
+   uint32_t delta = timer->due - w->now;
+   int level = 0;
+   int index;
+
+   while ((level < WHEEL_LEVELS - 1) && (delta >> ((level + 1) * WHEEL_SLOT_BITS)))
+   {
+      level++;
+   }
+   index = (timer->due >> (level * WHEEL_SLOT_BITS)) & WHEEL_SLOT_MASK;
+   head = &w->slots[level][index];
+   timer->next = *head;
+   if (NULL != *head)
+   {
+      (*head)->pprev = &timer->next;
+   }
+   *head = timer;
+   timer->pprev = head;
+   timer->slot = (uint16_t)(level * WHEEL_SLOTS + index);
+   w->occupied[level] |= 1ULL << index;
+}
+
+//!
+//! Take a timer out of its slot
+//!
+static void wheel_unlink(WHEEL_T *w, WHEEL_TIMER_T *timer)
+{
+   int level = timer->slot / WHEEL_SLOTS;
+   int index = timer->slot % WHEEL_SLOTS;
+
+   *timer->pprev = timer->next;
+   if (NULL != timer->next)
+   {
+      timer->next->pprev = timer->pprev;
+   }
+   if (NULL == w->slots[level][index])
+   {
+      w->occupied[level] &= ~(1ULL << index);
+   }
+   timer->next = NULL;
+   timer->pprev = NULL;
+}
+
+//!
+//! Move the timers of the slot of a level the wheel has turned to down to
+//! the levels below, those of the levels above first
+//!
+static void wheel_cascade(WHEEL_T *w, int level)
+{
+   WHEEL_TIMER_T *timer;
+   int index = (w->now >> (level * WHEEL_SLOT_BITS)) & WHEEL_SLOT_MASK;
+
+   if ((0 == index) && (level + 1 < WHEEL_LEVELS))
+   {
+      wheel_cascade(w, level + 1);
+   }
+   while (NULL != (timer = w->slots[level][index]))
+   {
+      wheel_unlink(w, timer);
+      wheel_link(w, timer);
+   }
+}
+
+//!
+//! Initialize a wheel with no timers
+//!
+//! @param[in] w    Wheel
+//! @param[in] now  Current time in milliseconds
+//!
+void wheel_init(WHEEL_T *w, uint32_t now)
+{
+   memset(w, 0, sizeof(WHEEL_T));
+   w->now = now;
+}
+
+//!
+//! Initialize a timer that is not pending
+//!
+void wheel_initTimer(WHEEL_TIMER_T *timer, WHEEL_CALLBACK_T callback, void *arg)
+{
+   memset(timer, 0, sizeof(WHEEL_TIMER_T));
+   timer->callback = callback;
+   timer->arg = arg;
+}
+
+//!
+//! Set a timer to be due at a given time, replacing the time it was due
+//! if it is pending. A time that has passed is due on the next turn, one
+//! further away than WHEEL_DELAY_MAX is due then, for the owner to set
+//! again.
+//!
+//! @param[in] w      Wheel
+//! @param[in] timer  Timer
+//! @param[in] due    Time the timer is due in milliseconds
+//!
+void wheel_add(WHEEL_T *w, WHEEL_TIMER_T *timer, uint32_t due)
+{
+   if (NULL != timer->pprev)
+   {
+      wheel_unlink(w, timer);
+   }
+   else
+   {
+      w->count++;
+   }
+   if ((int32_t)(due - w->now) <= 0)
+   {
+      due = w->now + 1;
+   }
+   else if ((due - w->now) > WHEEL_DELAY_MAX)
+   {
+      due = w->now + WHEEL_DELAY_MAX;
+   }
+   timer->due = due;
+   wheel_link(w, timer);
+}
+
+//!
+//! Cancel a timer if it is pending
+//!
+void wheel_cancel(WHEEL_T *w, WHEEL_TIMER_T *timer)
+{
+   if (NULL != timer->pprev)
+   {
+      wheel_unlink(w, timer);
+      w->count--;
+   }
+}
+
+//!
+//! Check if a timer is pending
+//!
+bool wheel_isPending(const WHEEL_TIMER_T *timer)
+{
+   return (NULL != timer->pprev);
+}
+
+//!
+//! Get the time until the wheel has to be advanced. That is exact for a
+//! timer of level 0; for the levels above it is the turn their next timer
+//! moves down, which is never later than it is due.
+//!
+//! @param[in] w    Wheel
+//! @param[in] now  Current time in milliseconds
+//!
+//! @return  Milliseconds, 0 if a timer is due, or WHEEL_NO_TIMER
+//!
+uint32_t wheel_nextDue(const WHEEL_T *w, uint32_t now)
+{
+   uint32_t nearest = WHEEL_NO_TIMER;
+   uint32_t turn;
+   uint32_t due;
+   uint64_t bits;
+   int shift;
+   int index;
+   int level;
+
+   if (0 == w->count)
+   {
+      return WHEEL_NO_TIMER;
+   }
+   for (level = 0; level < WHEEL_LEVELS; level++)
+   {
+      bits = w->occupied[level];
+      if (0 == bits)
+      {
+         continue;
+      }
+      /* Look from the slot after the one the level has turned to */
+      shift = level * WHEEL_SLOT_BITS;
+      turn = (w->now >> shift) + 1;
+      index = turn & WHEEL_SLOT_MASK;
+      if (0 != index)
+      {
+         bits = (bits >> index) | (bits << (WHEEL_SLOTS - index));
+      }
+      due = (turn + (uint32_t)__builtin_ctzll(bits)) << shift;
+      if ((WHEEL_NO_TIMER == nearest) || ((int32_t)(due - nearest) < 0))
+      {
+         nearest = due;
+      }
+   }
+   if (WHEEL_NO_TIMER == nearest)
+   {
+      return WHEEL_NO_TIMER;
+   }
+   return ((int32_t)(nearest - now) > 0) ? (nearest - now) : 0;
+}
+
+//!
+//! Turn the wheel up to the current time and run the callbacks of the
+//! timers that are due. A callback may add or cancel timers.
+//!
+//! @param[in] w    Wheel
+//! @param[in] now  Current time in milliseconds
+//!
+void wheel_advance(WHEEL_T *w, uint32_t now)
+{
+   WHEEL_TIMER_T *timer;
+   uint32_t skip;
+   int index;
+
+   while ((int32_t)(now - w->now) > 0)
+   {
+      if (0 == w->count)
+      {
+         w->now = now;
+         break;
+      }
+      if (0 == w->occupied[0])
+      {
+         /* Nothing is due before the levels above turn */
+         skip = w->now | WHEEL_SLOT_MASK;
+         if (skip != w->now)
+         {
+            w->now = ((int32_t)(now - skip) < 0) ? now : skip;
+            continue;
+         }
+      }
+      w->now++;
+      index = w->now & WHEEL_SLOT_MASK;
+      if (0 == index)
+      {
+         wheel_cascade(w, 1);
+      }
+      while (NULL != (timer = w->slots[0][index]))
+      {
+         wheel_unlink(w, timer);
+         w->count--;
+         if (NULL != timer->callback)
+         {
+            timer->callback(timer->arg);
+         }
+      }
+   }
+}
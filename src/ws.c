@@ -0,0 +1,553 @@
+//******************************************************************************
+//!
+//! Author:  Ying Xiong
+//! Created: Oct 2026
+//!
+//******************************************************************************
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/random.h>
+#include "ws.h"
+#include "utils.h"
+
+//
+// Local Defines
+//
+#define WS_GUID           "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+#define WS_NONCE_LEN      (16)
+#define WS_SHA1_LEN       (20)
+#define WS_ACCEPT_LEN     (29)
+#define WS_MASK_LEN       (4)
+
+//
+// Function Prototypes
+//
+static void ws_sha1Block(uint32_t h[5], const uint8_t *p);
+static bool ws_parse(WS_T *w, const char *data, size_t len);
+static bool ws_frameEnd(WS_T *w);
+static bool ws_sendFrame(WS_T *w, WS_OPCODE_T opcode, bool fin, const char *data, size_t len);
+
+//!
+//! Fill a buffer with random bytes for keys and masks.
+//!
+static void ws_random(void *buf, size_t len)
+{
+   static uint64_t state = 0;
+   uint8_t *p = buf;
+
+   if (getrandom(buf, len, 0) == (ssize_t)len)
+   {
+      return;
+   }
+   /* Without the kernel source the bytes are only hard to guess, not random */
+   if (0 == state)
+   {
+      state = ((uint64_t)getpid() << 32) ^ utils_getCurrentTimeMs() ^ 0x9E3779B97F4A7C15ULL;
+   }
+   while (len-- > 0)
+   {
+      state ^= state << 13;
+      state ^= state >> 7;
+      state ^= state << 17;
+      *p++ = (uint8_t)state;
+   }
+}
+
+//!
+//! Compute the SHA-1 digest of a buffer, which the handshake uses to prove
+//! that the server understood the request.
+//!
+static void ws_sha1(const uint8_t *data, size_t len, uint8_t digest[WS_SHA1_LEN])
+{
+   uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+   uint8_t block[128];
+   uint64_t bits = (uint64_t)len * 8;
+   size_t tail;
+   int i;
+
+   for (; len >= 64; data += 64, len -= 64)
+   {
+      ws_sha1Block(h, data);
+   }
+   /* The padding and the length take one or two more blocks */
+   memset(block, 0, sizeof(block));
+   memcpy(block, data, len);
+   block[len] = 0x80;
+   tail = (len < 56) ? 64 : 128;
+   for (i = 0; i < 8; i++)
+   {
+      block[tail - 1 - i] = (uint8_t)(bits >> (i * 8));
+   }
+   ws_sha1Block(h, block);
+   if (128 == tail)
+   {
+      ws_sha1Block(h, block + 64);
+   }
+   for (i = 0; i < WS_SHA1_LEN; i++)
+   {
+      digest[i] = (uint8_t)(h[i / 4] >> (24 - (i % 4) * 8));
+   }
+}
+
+//!
+//! Mix one 64 byte block into the SHA-1 state.
+//!
+static void ws_sha1Block(uint32_t h[5], const uint8_t *p)
+{
+   uint32_t w[80];
+   uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+   uint32_t f, k, t;
+   int i;
+
+   for (i = 0; i < 16; i++)
+   {
+      w[i] = ((uint32_t)p[i * 4] << 24) | ((uint32_t)p[i * 4 + 1] << 16) |
+             ((uint32_t)p[i * 4 + 2] << 8) | p[i * 4 + 3];
+   }
+   for (; i < 80; i++)
+   {
+      t = w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16];
+      w[i] = (t << 1) | (t >> 31);
+   }
+   for (i = 0; i < 80; i++)
+   {
+      if (i < 20)
+      {
+         f = (b & c) | (~b & d);
+         k = 0x5A827999;
+      }
+      else if (i < 40)
+      {
+         f = b ^ c ^ d;
+         k = 0x6ED9EBA1;
+      }
+      else if (i < 60)
+      {
+         f = (b & c) | (b & d) | (c & d);
+         k = 0x8F1BBCDC;
+      }
+      else
+      {
+         f = b ^ c ^ d;
+         k = 0xCA62C1D6;
+      }
+      t = ((a << 5) | (a >> 27)) + f + e + k + w[i];
+      e = d;
+      d = c;
+      c = (b << 30) | (b >> 2);
+      b = a;
+      a = t;
+   }
+   h[0] += a;
+   h[1] += b;
+   h[2] += c;
+   h[3] += d;
+   h[4] += e;
+}
+
+//!
+//! Encode bytes in base64, NUL terminated.
+//!
+static void ws_base64(const uint8_t *in, size_t len, char *out)
+{
+   static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+   uint32_t v;
+
+   for (; len >= 3; in += 3, len -= 3)
+   {
+      v = ((uint32_t)in[0] << 16) | ((uint32_t)in[1] << 8) | in[2];
+      *out++ = alphabet[(v >> 18) & 0x3F];
+      *out++ = alphabet[(v >> 12) & 0x3F];
+      *out++ = alphabet[(v >> 6) & 0x3F];
+      *out++ = alphabet[v & 0x3F];
+   }
+   if (len > 0)
+   {
+      v = ((uint32_t)in[0] << 16) | ((len > 1) ? ((uint32_t)in[1] << 8) : 0);
+      *out++ = alphabet[(v >> 18) & 0x3F];
+      *out++ = alphabet[(v >> 12) & 0x3F];
+      *out++ = (len > 1) ? alphabet[(v >> 6) & 0x3F] : '=';
+      *out++ = '=';
+   }
+   *out = '\0';
+}
+
+//!
+//! Initialize a WebSocket channel that is not connected.
+//!
+//! @param[out] w  Pointer to channel
+//! @param[in] messageCb  Called with the messages received, or NULL
+//! @param[in] pongCb  Called with the pongs received, or NULL
+//! @param[in] arg  Argument passed back to the callbacks
+//!
+void ws_init(WS_T *w, WS_MESSAGE_CB_T messageCb, WS_PONG_CB_T pongCb, void *arg)
+{
+   memset(w, 0, sizeof(WS_T));
+   w->messageCb = messageCb;
+   w->pongCb = pongCb;
+   w->arg = arg;
+}
+
+//!
+//! Start a new handshake of the channel.
+//!
+//! @param[in,out] w  Pointer to channel
+//!
+//! @return  Value of the Sec-WebSocket-Key header of the upgrade request
+//!
+const char* ws_newKey(WS_T *w)
+{
+   uint8_t nonce[WS_NONCE_LEN];
+
+   ws_random(nonce, sizeof(nonce));
+   ws_base64(nonce, sizeof(nonce), w->key);
+   w->session = NULL;
+   w->status = WS_CONNECTING;
+   w->headerLen = 0;
+   w->headerNeed = 2;
+   w->inPayload = false;
+   w->message = WS_CONTINUATION;
+   w->pings = 0;
+   w->pongs = 0;
+
+   return w->key;
+}
+
+//!
+//! Take over a cloud session once the server switches protocols. Set as
+//! the upgrade callback of the session, with the channel as argument.
+//!
+//! The first call checks the handshake response, the later ones parse
+//! the frames received.
+//!
+//! @return  false to fail the session, otherwise true
+//!
+bool ws_upgraded(CLOUD_SESSION_T *s, const char *data, size_t len, void *arg)
+{
+   WS_T *w = (WS_T *)arg;
+   char buf[WS_KEY_LEN + sizeof(WS_GUID)];
+   uint8_t digest[WS_SHA1_LEN];
+   char accept[WS_ACCEPT_LEN];
+
+   if (WS_CONNECTING != w->status)
+   {
+      return ws_parse(w, data, len);
+   }
+   sprintf(buf, "%s%s", w->key, WS_GUID);
+   ws_sha1((const uint8_t *)buf, strlen(buf), digest);
+   ws_base64(digest, sizeof(digest), accept);
+   if (!s->response.upgradeWebSocket || (0 != strcmp(s->response.websocketAccept, accept)))
+   {
+      utils_sysLog(LOG_ERR, "%s>> WebSocket handshake not accepted\n", s->name);
+      return false;
+   }
+   w->session = s;
+   w->status = WS_OPEN;
+   utils_sysLog(LOG_INFO, "%s>> WebSocket channel open\n", s->name);
+
+   return true;
+}
+
+//!
+//! Determine if messages can be sent on the channel.
+//!
+bool ws_isOpen(const WS_T *w)
+{
+   return ((WS_OPEN == w->status) && (NULL != w->session));
+}
+
+//!
+//! Send a message, in frames of up to WS_FRAME_LEN bytes.
+//!
+//! @param[in,out] w  Pointer to channel
+//! @param[in] opcode  WS_TEXT or WS_BINARY
+//! @param[in] data  Payload of the message
+//! @param[in] len  Bytes of payload
+//!
+//! @return  true if the message is queued on the session, otherwise false
+//!
+bool ws_send(WS_T *w, WS_OPCODE_T opcode, const char *data, size_t len)
+{
+   bool first = true;
+   bool sent;
+   size_t n;
+
+   if (!ws_isOpen(w))
+   {
+      return false;
+   }
+   do
+   {
+      n = (len > WS_FRAME_LEN) ? WS_FRAME_LEN : len;
+      sent = ws_sendFrame(w, first ? opcode : WS_CONTINUATION, (n == len), data, n);
+      first = false;
+      data += n;
+      len -= n;
+   }
+   while (sent && (len > 0));
+
+   return sent;
+}
+
+//!
+//! Ping the server, the pong is a cheap sign that it is alive.
+//!
+//! @param[in,out] w  Pointer to channel
+//!
+//! @return  true if the ping is queued on the session, otherwise false
+//!
+bool ws_ping(WS_T *w)
+{
+   if (!ws_isOpen(w))
+   {
+      return false;
+   }
+   w->pingTime = utils_getCurrentTimeMs();
+   w->pings++;
+
+   return ws_sendFrame(w, WS_PING, true, "", 0);
+}
+
+//!
+//! Start the closing handshake of the channel.
+//!
+//! @param[in,out] w  Pointer to channel
+//! @param[in] code  Status code of the close
+//!
+void ws_close(WS_T *w, uint16_t code)
+{
+   char payload[2];
+
+   if (ws_isOpen(w))
+   {
+      payload[0] = (char)(code >> 8);
+      payload[1] = (char)code;
+      ws_sendFrame(w, WS_CLOSE, true, payload, sizeof(payload));
+      w->status = WS_CLOSING;
+   }
+}
+
+//!
+//! Give up on a channel that broke the protocol.
+//!
+//! @return  false, to fail the session
+//!
+static bool ws_fail(WS_T *w, const char *reason)
+{
+   utils_sysLog(LOG_ERR, "%s>> WebSocket %s\n", w->session->name, reason);
+   ws_close(w, WS_CLOSE_PROTOCOL);
+
+   return false;
+}
+
+//!
+//! Check the header of a frame once it is complete.
+//!
+//! @return  false if the frame breaks the protocol, otherwise true
+//!
+static bool ws_frameStart(WS_T *w)
+{
+   uint8_t code = w->header[1] & 0x7F;
+   uint64_t length = code;
+   int i;
+
+   if (126 == code)
+   {
+      length = ((uint64_t)w->header[2] << 8) | w->header[3];
+   }
+   else if (127 == code)
+   {
+      for (length = 0, i = 2; i < 10; i++)
+      {
+         length = (length << 8) | w->header[i];
+      }
+   }
+   w->fin = (0 != (w->header[0] & 0x80));
+   w->opcode = (WS_OPCODE_T)(w->header[0] & 0x0F);
+   if (0 != (w->header[0] & 0x70))
+   {
+      return ws_fail(w, "frame with reserved bits");
+   }
+   if (0 != (w->header[1] & 0x80))
+   {
+      return ws_fail(w, "frame masked by the server");
+   }
+   if (0 != (w->opcode & 0x8))
+   {
+      /* Control frames may come between the fragments of a message */
+      if ((WS_CLOSE != w->opcode) && (WS_PING != w->opcode) && (WS_PONG != w->opcode))
+      {
+         return ws_fail(w, "frame with unknown opcode");
+      }
+      if (!w->fin || (length > WS_CONTROL_LEN))
+      {
+         return ws_fail(w, "control frame fragmented or too long");
+      }
+   }
+   else if (WS_CONTINUATION == w->opcode)
+   {
+      if (WS_CONTINUATION == w->message)
+      {
+         return ws_fail(w, "continuation without a message");
+      }
+   }
+   else if ((WS_TEXT != w->opcode) && (WS_BINARY != w->opcode))
+   {
+      return ws_fail(w, "frame with unknown opcode");
+   }
+   else if (WS_CONTINUATION != w->message)
+   {
+      return ws_fail(w, "message inside a fragmented message");
+   }
+   else
+   {
+      w->message = w->opcode;
+   }
+   w->remaining = length;
+   w->controlLen = 0;
+   w->inPayload = true;
+
+   return (0 == w->remaining) ? ws_frameEnd(w) : true;
+}
+
+//!
+//! Parse the next bytes received on the channel.
+//!
+//! Frames may be split across calls. The payload of data frames is passed
+//! to the message callback as it arrives, control frames are collected
+//! and answered once complete.
+//!
+//! @return  false if the server broke the protocol, otherwise true
+//!
+static bool ws_parse(WS_T *w, const char *data, size_t len)
+{
+   size_t n;
+
+   while (len > 0)
+   {
+      if (!w->inPayload)
+      {
+         n = w->headerNeed - w->headerLen;
+         n = (n > len) ? len : n;
+         memcpy(&w->header[w->headerLen], data, n);
+         w->headerLen += n;
+         data += n;
+         len -= n;
+         if ((2 == w->headerLen) && (2 == w->headerNeed))
+         {
+            /* The second byte tells how long the rest of the header is */
+            n = w->header[1] & 0x7F;
+            w->headerNeed += (126 == n) ? 2 : ((127 == n) ? 8 : 0);
+         }
+         if ((w->headerLen == w->headerNeed) && !ws_frameStart(w))
+         {
+            return false;
+         }
+         continue;
+      }
+      n = (len > w->remaining) ? (size_t)w->remaining : len;
+      if (0 != (w->opcode & 0x8))
+      {
+         memcpy(&w->control[w->controlLen], data, n);
+         w->controlLen += n;
+      }
+      else if (NULL != w->messageCb)
+      {
+         w->messageCb(w->arg, w->message, data, n, false);
+      }
+      data += n;
+      len -= n;
+      w->remaining -= n;
+      if ((0 == w->remaining) && !ws_frameEnd(w))
+      {
+         return false;
+      }
+   }
+
+   return true;
+}
+
+//!
+//! Act on a frame once its payload is complete.
+//!
+//! @return  false to fail the session, otherwise true
+//!
+static bool ws_frameEnd(WS_T *w)
+{
+   uint16_t code = WS_CLOSE_NORMAL;
+
+   w->inPayload = false;
+   w->headerLen = 0;
+   w->headerNeed = 2;
+   switch (w->opcode)
+   {
+      case WS_PING:
+         return ws_sendFrame(w, WS_PONG, true, w->control, w->controlLen);
+      case WS_PONG:
+         w->pongs++;
+         if (NULL != w->pongCb)
+         {
+            w->pongCb(w->arg, utils_getCurrentTimeMs() - w->pingTime);
+         }
+         break;
+      case WS_CLOSE:
+         if (w->controlLen >= 2)
+         {
+            code = ((uint16_t)(uint8_t)w->control[0] << 8) | (uint8_t)w->control[1];
+         }
+         utils_sysLog(LOG_INFO, "%s>> WebSocket channel closed by server, code %u\n",
+                      w->session->name, code);
+         /* The server closes the connection once the close is echoed */
+         ws_close(w, code);
+         break;
+      default:
+         if (w->fin)
+         {
+            if (NULL != w->messageCb)
+            {
+               w->messageCb(w->arg, w->message, "", 0, true);
+            }
+            w->message = WS_CONTINUATION;
+         }
+         break;
+   }
+
+   return true;
+}
+
+//!
+//! Queue one masked frame on the session.
+//!
+//! @return  true if the frame is queued, otherwise false
+//!
+static bool ws_sendFrame(WS_T *w, WS_OPCODE_T opcode, bool fin, const char *data, size_t len)
+{
+   uint8_t frame[WS_HEADER_LEN + WS_FRAME_LEN];
+   uint8_t *mask;
+   size_t n = 2;
+   size_t i;
+
+   frame[0] = (fin ? 0x80 : 0) | opcode;
+   if (len < 126)
+   {
+      frame[1] = 0x80 | (uint8_t)len;
+   }
+   else
+   {
+      frame[1] = 0x80 | 126;
+      frame[n++] = (uint8_t)(len >> 8);
+      frame[n++] = (uint8_t)len;
+   }
+   /* Every client frame is masked with a new key */
+   mask = &frame[n];
+   ws_random(mask, WS_MASK_LEN);
+   n += WS_MASK_LEN;
+   for (i = 0; i < len; i++)
+   {
+      frame[n + i] = (uint8_t)data[i] ^ mask[i % WS_MASK_LEN];
+   }
+
+   return cloud_sessionWrite(w->session, (const char *)frame, n + len);
+}
@@ -0,0 +1,53 @@
+#!/usr/bin/env python3
+#
+# DNS stub for the resolver tests
+#
+# Answers A queries for the names given as NAME=ADDRESS arguments, and
+# answers other queries with no data. Each answer is preceded by a forged
+# one whose query id is off by one and whose address is ADDRESS of -f, so
+# a resolver that does not match answers to its queries by id picks the
+# forged address. The id of each query is written to the log file.
+#
+# Usage: stub_dns.py -l <id log> [-f <forged address>] NAME=ADDRESS ...
+#
+import argparse
+import socket
+import struct
+
+parser = argparse.ArgumentParser()
+parser.add_argument('-l', dest='log', required=True)
+parser.add_argument('-f', dest='forged', default='127.0.0.99')
+parser.add_argument('names', nargs='+')
+args = parser.parse_args()
+hosts = dict(n.split('=', 1) for n in args.names)
+
+
+def answer(qid, question, address):
+    head = struct.pack('>HHHHHH', qid, 0x8180, 1, 1 if address else 0, 0, 0)
+    body = question
+    if address:
+        body += b'\xc0\x0c' + struct.pack('>HHIH', 1, 1, 1, 4) + socket.inet_aton(address)
+    return head + body
+
+
+sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+sock.bind(('127.0.0.1', 53))
+log = open(args.log, 'a', buffering=1)
+while True:
+    data, peer = sock.recvfrom(512)
+    if len(data) < 12:
+        continue
+    qid = struct.unpack('>H', data[:2])[0]
+    off = 12
+    labels = []
+    while off < len(data) and data[off]:
+        labels.append(data[off + 1:off + 1 + data[off]].decode('ascii', 'replace'))
+        off += data[off] + 1
+    question = data[12:off + 5]
+    name = '.'.join(labels)
+    qtype = struct.unpack('>H', data[off + 1:off + 3])[0]
+    log.write('%d %s %d\n' % (qid, name, qtype))
+    address = hosts.get(name) if 1 == qtype else None
+    if address:
+        sock.sendto(answer(qid ^ 1, question, args.forged), peer)
+    sock.sendto(answer(qid, question, address), peer)
@@ -0,0 +1,398 @@
+#!/usr/bin/env python3
+#
+# HTTP/2 cleartext stub for the -2 tests
+#
+# Takes connections with prior knowledge and serves the files of a
+# directory with strong ETags. The responses of the streams that are open
+# together are sent in reverse order of the requests and their payload is
+# interleaved, within the flow control windows granted by the client, so
+# a client that expects them in order or one at a time falls over. The
+# request headers are HPACK decoded with the dynamic table and Huffman
+# coding. Each connection and request is written to the log file.
+#
+# Usage: stub_h2c.py -l <log> -d <directory> <address>
+#
+import argparse
+import hashlib
+import os
+import select
+import socket
+import struct
+import threading
+
+PREFACE = b'PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n'
+DATA, HEADERS, RST_STREAM, SETTINGS, PING, GOAWAY, WINDOW_UPDATE, CONTINUATION = 0, 1, 3, 4, 6, 7, 8, 9
+END_STREAM, ACK, END_HEADERS, PADDED, PRIORITY = 0x1, 0x1, 0x4, 0x8, 0x20
+FRAME_LEN = 16384
+
+STATIC = [
+    (':authority', ''), (':method', 'GET'), (':method', 'POST'), (':path', '/'),
+    (':path', '/index.html'), (':scheme', 'http'), (':scheme', 'https'), (':status', '200'),
+    (':status', '204'), (':status', '206'), (':status', '304'), (':status', '400'),
+    (':status', '404'), (':status', '500'), ('accept-charset', ''),
+    ('accept-encoding', 'gzip, deflate'), ('accept-language', ''), ('accept-ranges', ''),
+    ('accept', ''), ('access-control-allow-origin', ''), ('age', ''), ('allow', ''),
+    ('authorization', ''), ('cache-control', ''), ('content-disposition', ''),
+    ('content-encoding', ''), ('content-language', ''), ('content-length', ''),
+    ('content-location', ''), ('content-range', ''), ('content-type', ''), ('cookie', ''),
+    ('date', ''), ('etag', ''), ('expect', ''), ('expires', ''), ('from', ''), ('host', ''),
+    ('if-match', ''), ('if-modified-since', ''), ('if-none-match', ''), ('if-range', ''),
+    ('if-unmodified-since', ''), ('last-modified', ''), ('link', ''), ('location', ''),
+    ('max-forwards', ''), ('proxy-authenticate', ''), ('proxy-authorization', ''),
+    ('range', ''), ('referer', ''), ('refresh', ''), ('retry-after', ''), ('server', ''),
+    ('set-cookie', ''), ('strict-transport-security', ''), ('transfer-encoding', ''),
+    ('user-agent', ''), ('vary', ''), ('via', ''), ('www-authenticate', ''),
+]
+
+# Huffman code and length in bits of each symbol (RFC 7541 Appendix B)
+HUFFMAN = [
+    (0x1ff8, 13), (0x7fffd8, 23), (0xfffffe2, 28), (0xfffffe3, 28), (0xfffffe4, 28), (0xfffffe5, 28),
+    (0xfffffe6, 28), (0xfffffe7, 28), (0xfffffe8, 28), (0xffffea, 24), (0x3ffffffc, 30), (0xfffffe9, 28),
+    (0xfffffea, 28), (0x3ffffffd, 30), (0xfffffeb, 28), (0xfffffec, 28), (0xfffffed, 28), (0xfffffee, 28),
+    (0xfffffef, 28), (0xffffff0, 28), (0xffffff1, 28), (0xffffff2, 28), (0x3ffffffe, 30), (0xffffff3, 28),
+    (0xffffff4, 28), (0xffffff5, 28), (0xffffff6, 28), (0xffffff7, 28), (0xffffff8, 28), (0xffffff9, 28),
+    (0xffffffa, 28), (0xffffffb, 28), (0x14, 6), (0x3f8, 10), (0x3f9, 10), (0xffa, 12),
+    (0x1ff9, 13), (0x15, 6), (0xf8, 8), (0x7fa, 11), (0x3fa, 10), (0x3fb, 10),
+    (0xf9, 8), (0x7fb, 11), (0xfa, 8), (0x16, 6), (0x17, 6), (0x18, 6),
+    (0x0, 5), (0x1, 5), (0x2, 5), (0x19, 6), (0x1a, 6), (0x1b, 6),
+    (0x1c, 6), (0x1d, 6), (0x1e, 6), (0x1f, 6), (0x5c, 7), (0xfb, 8),
+    (0x7ffc, 15), (0x20, 6), (0xffb, 12), (0x3fc, 10), (0x1ffa, 13), (0x21, 6),
+    (0x5d, 7), (0x5e, 7), (0x5f, 7), (0x60, 7), (0x61, 7), (0x62, 7),
+    (0x63, 7), (0x64, 7), (0x65, 7), (0x66, 7), (0x67, 7), (0x68, 7),
+    (0x69, 7), (0x6a, 7), (0x6b, 7), (0x6c, 7), (0x6d, 7), (0x6e, 7),
+    (0x6f, 7), (0x70, 7), (0x71, 7), (0x72, 7), (0xfc, 8), (0x73, 7),
+    (0xfd, 8), (0x1ffb, 13), (0x7fff0, 19), (0x1ffc, 13), (0x3ffc, 14), (0x22, 6),
+    (0x7ffd, 15), (0x3, 5), (0x23, 6), (0x4, 5), (0x24, 6), (0x5, 5),
+    (0x25, 6), (0x26, 6), (0x27, 6), (0x6, 5), (0x74, 7), (0x75, 7),
+    (0x28, 6), (0x29, 6), (0x2a, 6), (0x7, 5), (0x2b, 6), (0x76, 7),
+    (0x2c, 6), (0x8, 5), (0x9, 5), (0x2d, 6), (0x77, 7), (0x78, 7),
+    (0x79, 7), (0x7a, 7), (0x7b, 7), (0x7ffe, 15), (0x7fc, 11), (0x3ffd, 14),
+    (0x1ffd, 13), (0xffffffc, 28), (0xfffe6, 20), (0x3fffd2, 22), (0xfffe7, 20), (0xfffe8, 20),
+    (0x3fffd3, 22), (0x3fffd4, 22), (0x3fffd5, 22), (0x7fffd9, 23), (0x3fffd6, 22), (0x7fffda, 23),
+    (0x7fffdb, 23), (0x7fffdc, 23), (0x7fffdd, 23), (0x7fffde, 23), (0xffffeb, 24), (0x7fffdf, 23),
+    (0xffffec, 24), (0xffffed, 24), (0x3fffd7, 22), (0x7fffe0, 23), (0xffffee, 24), (0x7fffe1, 23),
+    (0x7fffe2, 23), (0x7fffe3, 23), (0x7fffe4, 23), (0x1fffdc, 21), (0x3fffd8, 22), (0x7fffe5, 23),
+    (0x3fffd9, 22), (0x7fffe6, 23), (0x7fffe7, 23), (0xffffef, 24), (0x3fffda, 22), (0x1fffdd, 21),
+    (0xfffe9, 20), (0x3fffdb, 22), (0x3fffdc, 22), (0x7fffe8, 23), (0x7fffe9, 23), (0x1fffde, 21),
+    (0x7fffea, 23), (0x3fffdd, 22), (0x3fffde, 22), (0xfffff0, 24), (0x1fffdf, 21), (0x3fffdf, 22),
+    (0x7fffeb, 23), (0x7fffec, 23), (0x1fffe0, 21), (0x1fffe1, 21), (0x3fffe0, 22), (0x1fffe2, 21),
+    (0x7fffed, 23), (0x3fffe1, 22), (0x7fffee, 23), (0x7fffef, 23), (0xfffea, 20), (0x3fffe2, 22),
+    (0x3fffe3, 22), (0x3fffe4, 22), (0x7ffff0, 23), (0x3fffe5, 22), (0x3fffe6, 22), (0x7ffff1, 23),
+    (0x3ffffe0, 26), (0x3ffffe1, 26), (0xfffeb, 20), (0x7fff1, 19), (0x3fffe7, 22), (0x7ffff2, 23),
+    (0x3fffe8, 22), (0x1ffffec, 25), (0x3ffffe2, 26), (0x3ffffe3, 26), (0x3ffffe4, 26), (0x7ffffde, 27),
+    (0x7ffffdf, 27), (0x3ffffe5, 26), (0xfffff1, 24), (0x1ffffed, 25), (0x7fff2, 19), (0x1fffe3, 21),
+    (0x3ffffe6, 26), (0x7ffffe0, 27), (0x7ffffe1, 27), (0x3ffffe7, 26), (0x7ffffe2, 27), (0xfffff2, 24),
+    (0x1fffe4, 21), (0x1fffe5, 21), (0x3ffffe8, 26), (0x3ffffe9, 26), (0xffffffd, 28), (0x7ffffe3, 27),
+    (0x7ffffe4, 27), (0x7ffffe5, 27), (0xfffec, 20), (0xfffff3, 24), (0xfffed, 20), (0x1fffe6, 21),
+    (0x3fffe9, 22), (0x1fffe7, 21), (0x1fffe8, 21), (0x7ffff3, 23), (0x3fffea, 22), (0x3fffeb, 22),
+    (0x1ffffee, 25), (0x1ffffef, 25), (0xfffff4, 24), (0xfffff5, 24), (0x3ffffea, 26), (0x7ffff4, 23),
+    (0x3ffffeb, 26), (0x7ffffe6, 27), (0x3ffffec, 26), (0x3ffffed, 26), (0x7ffffe7, 27), (0x7ffffe8, 27),
+    (0x7ffffe9, 27), (0x7ffffea, 27), (0x7ffffeb, 27), (0xffffffe, 28), (0x7ffffec, 27), (0x7ffffed, 27),
+    (0x7ffffee, 27), (0x7ffffef, 27), (0x7fffff0, 27), (0x3ffffee, 26), (0x3fffffff, 30),
+]
+HUFFMAN_DECODE = {(length, code): sym for sym, (code, length) in enumerate(HUFFMAN)}
+
+
+class Decoder:
+    def __init__(self):
+        self.table = []
+        self.size = 0
+        self.max_size = 4096
+
+    def integer(self, block, pos, prefix):
+        mask = (1 << prefix) - 1
+        value = block[pos] & mask
+        pos += 1
+        if value < mask:
+            return value, pos
+        shift = 0
+        while True:
+            byte = block[pos]
+            pos += 1
+            value += (byte & 0x7f) << shift
+            shift += 7
+            if not byte & 0x80:
+                return value, pos
+
+    def string(self, block, pos):
+        huffman = block[pos] & 0x80
+        length, pos = self.integer(block, pos, 7)
+        raw = block[pos:pos + length]
+        if len(raw) != length:
+            raise ValueError('string is cut short')
+        pos += length
+        if not huffman:
+            return raw.decode('latin-1'), pos
+        out = bytearray()
+        code = 0
+        bits = 0
+        for byte in raw:
+            for i in range(7, -1, -1):
+                code = (code << 1) | ((byte >> i) & 1)
+                bits += 1
+                sym = HUFFMAN_DECODE.get((bits, code))
+                if sym is not None:
+                    if 256 == sym:
+                        raise ValueError('EOS in a string')
+                    out.append(sym)
+                    code = 0
+                    bits = 0
+        if bits > 7 or code != (1 << bits) - 1:
+            raise ValueError('Huffman padding is not EOS')
+        return out.decode('latin-1'), pos
+
+    def entry(self, index):
+        if 0 == index:
+            raise ValueError('index 0')
+        if index <= len(STATIC):
+            return STATIC[index - 1]
+        return self.table[index - len(STATIC) - 1]
+
+    def add(self, name, value):
+        self.table.insert(0, (name, value))
+        self.size += len(name) + len(value) + 32
+        self.evict()
+
+    def evict(self):
+        while self.size > self.max_size:
+            name, value = self.table.pop()
+            self.size -= len(name) + len(value) + 32
+
+    def decode(self, block):
+        fields = []
+        pos = 0
+        while pos < len(block):
+            byte = block[pos]
+            if byte & 0x80:
+                index, pos = self.integer(block, pos, 7)
+                fields.append(self.entry(index))
+                continue
+            if 0x20 == byte & 0xe0:
+                self.max_size, pos = self.integer(block, pos, 5)
+                if self.max_size > 4096:
+                    raise ValueError('table size is over the setting')
+                self.evict()
+                continue
+            prefix = 6 if byte & 0x40 else 4
+            index, pos = self.integer(block, pos, prefix)
+            if index:
+                name = self.entry(index)[0]
+            else:
+                name, pos = self.string(block, pos)
+            value, pos = self.string(block, pos)
+            if name != name.lower():
+                raise ValueError('header name %r is not in lower case' % name)
+            if byte & 0x40:
+                self.add(name, value)
+            fields.append((name, value))
+        return fields
+
+
+def integer(value, prefix, flags):
+    mask = (1 << prefix) - 1
+    if value < mask:
+        return bytes([flags | value])
+    out = bytearray([flags | mask])
+    value -= mask
+    while value >= 0x80:
+        out.append((value & 0x7f) | 0x80)
+        value >>= 7
+    out.append(value)
+    return bytes(out)
+
+
+def literal(name, value):
+    # Without indexing, new name, no Huffman coding
+    name = name.encode()
+    value = value.encode()
+    return b'\x00' + integer(len(name), 7, 0) + name + integer(len(value), 7, 0) + value
+
+
+def frame(ftype, flags, sid, payload=b''):
+    return struct.pack('>I', len(payload))[1:] + struct.pack('>BBI', ftype, flags, sid) + payload
+
+
+class Connection:
+    def __init__(self, sock, number):
+        self.sock = sock
+        self.number = number
+        self.buf = b''
+        self.decoder = Decoder()
+        self.conn_window = 65535
+        self.initial_window = 65535
+        self.streams = {}
+        self.block = b''
+        self.block_id = 0
+        self.block_end = False
+
+    def run(self):
+        while len(self.buf) < len(PREFACE):
+            data = self.sock.recv(65536)
+            if not data:
+                return
+            self.buf += data
+        if not self.buf.startswith(PREFACE):
+            log('ERROR no preface')
+            return
+        self.buf = self.buf[len(PREFACE):]
+        log('CONN %d' % self.number)
+        self.sock.sendall(frame(SETTINGS, 0, 0))
+        while True:
+            while self.next_frame():
+                pass
+            self.send_data()
+            ready = select.select([self.sock], [], [], 1.0 if not self.sendable() else 0)[0]
+            if ready:
+                data = self.sock.recv(65536)
+                if not data:
+                    return
+                self.buf += data
+
+    def next_frame(self):
+        if len(self.buf) < 9:
+            return False
+        length = struct.unpack('>I', b'\x00' + self.buf[:3])[0]
+        if len(self.buf) < 9 + length:
+            return False
+        ftype, flags, sid = struct.unpack('>BBI', self.buf[3:9])
+        sid &= 0x7fffffff
+        payload = self.buf[9:9 + length]
+        self.buf = self.buf[9 + length:]
+        if self.block_id and (CONTINUATION != ftype or sid != self.block_id):
+            raise ValueError('header block is interrupted')
+        if SETTINGS == ftype and not flags & ACK:
+            for i in range(0, len(payload), 6):
+                ident, value = struct.unpack('>HI', payload[i:i + 6])
+                if 4 == ident:
+                    log('INITIAL_WINDOW %d' % value)
+                    for st in self.streams.values():
+                        st['window'] += value - self.initial_window
+                    self.initial_window = value
+            self.sock.sendall(frame(SETTINGS, ACK, 0))
+        elif WINDOW_UPDATE == ftype:
+            increment = struct.unpack('>I', payload)[0] & 0x7fffffff
+            if 0 == sid:
+                self.conn_window += increment
+            elif sid in self.streams:
+                self.streams[sid]['window'] += increment
+        elif PING == ftype and not flags & ACK:
+            self.sock.sendall(frame(PING, ACK, 0, payload))
+        elif HEADERS == ftype:
+            pos = 0
+            pad = 0
+            if flags & PADDED:
+                pad = payload[0]
+                pos = 1
+            if flags & PRIORITY:
+                pos += 5
+            self.block = payload[pos:len(payload) - pad]
+            self.block_id = sid
+            self.block_end = bool(flags & END_STREAM)
+            if flags & END_HEADERS:
+                self.request()
+        elif CONTINUATION == ftype:
+            self.block += payload
+            if flags & END_HEADERS:
+                self.request()
+        elif DATA == ftype and len(payload) > 0:
+            log('ERROR request body on stream %d' % sid)
+        elif RST_STREAM == ftype:
+            self.streams.pop(sid, None)
+        elif GOAWAY == ftype:
+            raise ConnectionError('client going away')
+        return True
+
+    def request(self):
+        sid = self.block_id
+        self.block_id = 0
+        fields = dict(self.decoder.decode(self.block))
+        if not self.block_end:
+            log('ERROR stream %d does not end with its header' % sid)
+        for name in (':method', ':scheme', ':path', ':authority'):
+            if name not in fields:
+                log('ERROR stream %d has no %s' % (sid, name))
+        path = fields.get(':path', '/')
+        try:
+            with open(os.path.join(args.root, os.path.basename(path)), 'rb') as f:
+                data = f.read()
+        except OSError:
+            data = None
+        if data is None:
+            status, etag, data = '404', None, b''
+        else:
+            etag = '"%s"' % hashlib.md5(data).hexdigest()
+            status = '304' if fields.get('if-none-match') == etag else '200'
+            data = b'' if '304' == status else data
+        log('STREAM %d %s %s %s' % (sid, fields.get(':method'), path, status))
+        block = b'\x08' + integer(len(status), 7, 0) + status.encode()
+        if etag:
+            block += literal('etag', etag)
+        if '304' != status:
+            block += literal('content-length', str(len(data)))
+        self.streams[sid] = {'header': block, 'data': data, 'pos': 0,
+                             'window': self.initial_window, 'sent': False}
+
+    def sendable(self):
+        for st in self.streams.values():
+            if not st['sent'] or (st['pos'] < len(st['data']) and st['window'] > 0 and
+                                  self.conn_window > 0):
+                return True
+        return False
+
+    def send_data(self):
+        # The last request is answered first, one frame per stream in turn
+        out = b''
+        for sid in sorted(self.streams, reverse=True):
+            st = self.streams[sid]
+            if not st['sent']:
+                out += frame(HEADERS, END_HEADERS | (END_STREAM if not st['data'] else 0), sid,
+                             st['header'])
+                st['sent'] = True
+        for sid in sorted(self.streams, reverse=True):
+            st = self.streams[sid]
+            n = min(FRAME_LEN, len(st['data']) - st['pos'], st['window'], self.conn_window)
+            if n <= 0:
+                continue
+            end = st['pos'] + n == len(st['data'])
+            out += frame(DATA, END_STREAM if end else 0, sid, st['data'][st['pos']:st['pos'] + n])
+            st['pos'] += n
+            st['window'] -= n
+            self.conn_window -= n
+        for sid in [s for s, st in self.streams.items() if st['sent'] and st['pos'] == len(st['data'])]:
+            del self.streams[sid]
+        if out:
+            self.sock.sendall(out)
+
+
+def serve(sock, number):
+    try:
+        Connection(sock, number).run()
+    except (OSError, ValueError, ConnectionError) as e:
+        log('CLOSED %d %s' % (number, e))
+    finally:
+        sock.close()
+
+
+lock = threading.Lock()
+
+
+def log(line):
+    with lock:
+        logfile.write(line + '\n')
+
+
+parser = argparse.ArgumentParser()
+parser.add_argument('-l', dest='log', required=True)
+parser.add_argument('-d', dest='root', required=True)
+parser.add_argument('addr')
+args = parser.parse_args()
+logfile = open(args.log, 'a', buffering=1)
+server = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+server.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+server.bind((args.addr, 80))
+server.listen(64)
+count = 0
+while True:
+    client, peer = server.accept()
+    count += 1
+    threading.Thread(target=serve, args=(client, count), daemon=True).start()
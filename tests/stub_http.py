@@ -0,0 +1,131 @@
+#!/usr/bin/env python3
+#
+# HTTP/1.1 stub for the subscription tests
+#
+# Serves the files of a directory with strong ETags. In the modes that
+# take a subscription:
+#   plain     ignores Prefer: wait and answers at once
+#   longpoll  holds a conditional request until the file changes or the
+#             wait is over, and confirms it with Preference-Applied
+#   sse       streams each version of the file as an event to a client
+#             that accepts text/event-stream
+# PUT and POST store the body as the file. With -r a body is sent or
+# received at no more than the given bytes per second.
+# Each request line is written to the log file.
+#
+# Usage: stub_http.py -l <request log> -d <directory> -m <mode> [-r <rate>] <address>
+#
+import argparse
+import hashlib
+import os
+import re
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+parser = argparse.ArgumentParser()
+parser.add_argument('-l', dest='log', required=True)
+parser.add_argument('-d', dest='root', required=True)
+parser.add_argument('-m', dest='mode', default='plain', choices=['plain', 'longpoll', 'sse'])
+parser.add_argument('-r', dest='rate', type=int, default=0)
+parser.add_argument('addr')
+args = parser.parse_args()
+log = open(args.log, 'a', buffering=1)
+
+
+def current(name):
+    try:
+        with open(os.path.join(args.root, name), 'rb') as f:
+            data = f.read()
+    except OSError:
+        return None, None
+    return data, '"%s"' % hashlib.md5(data).hexdigest()
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = 'HTTP/1.1'
+
+    def log_message(self, fmt, *a):
+        pass
+
+    def do_GET(self):
+        log.write('%.3f %s\n' % (time.time(), self.requestline))
+        name = self.path.lstrip('/')
+        data, etag = current(name)
+        if data is None:
+            self.send_response(404)
+            self.send_header('Content-Length', '0')
+            self.end_headers()
+            return
+        wait = re.search(r'wait=(\d+)', self.headers.get('Prefer') or '')
+        if 'sse' == args.mode and 'text/event-stream' in (self.headers.get('Accept') or ''):
+            self.stream(name)
+            return
+        if 'longpoll' == args.mode and wait and self.headers.get('If-None-Match') == etag:
+            end = time.time() + int(wait.group(1))
+            while time.time() < end and current(name)[1] == etag:
+                time.sleep(0.02)
+            data, etag = current(name)
+        self.send_response(304 if self.headers.get('If-None-Match') == etag else 200)
+        self.send_header('ETag', etag)
+        if 'longpoll' == args.mode and wait:
+            self.send_header('Preference-Applied', 'wait=%s' % wait.group(1))
+        if self.headers.get('If-None-Match') == etag:
+            self.end_headers()
+            return
+        self.send_header('Content-Length', str(len(data)))
+        self.end_headers()
+        self.send_body(data)
+
+    def do_PUT(self):
+        log.write('%.3f %s\n' % (time.time(), self.requestline))
+        length = int(self.headers.get('Content-Length') or 0)
+        piece = max(1, args.rate // 10) if args.rate else length
+        data = b''
+        while len(data) < length:
+            chunk = self.rfile.read(min(piece, length - len(data)))
+            if not chunk:
+                return
+            data += chunk
+            if args.rate:
+                time.sleep(0.1)
+        with open(os.path.join(args.root, self.path.lstrip('/')), 'wb') as f:
+            f.write(data)
+        log.write('%.3f STORED %s %d\n' % (time.time(), self.path, len(data)))
+        self.send_response(204)
+        self.end_headers()
+
+    do_POST = do_PUT
+
+    def send_body(self, data):
+        if 0 == args.rate:
+            self.wfile.write(data)
+            return
+        piece = max(1, args.rate // 10)
+        for i in range(0, len(data), piece):
+            self.wfile.write(data[i:i + piece])
+            self.wfile.flush()
+            time.sleep(0.1)
+
+    def stream(self, name):
+        self.send_response(200)
+        self.send_header('Content-Type', 'text/event-stream')
+        self.send_header('Transfer-Encoding', 'chunked')
+        self.end_headers()
+        last = None
+        while True:
+            data, etag = current(name)
+            if etag != last:
+                event = b'id: ' + etag.encode() + b'\n'
+                event += b''.join(b'data: ' + line + b'\n' for line in data.split(b'\n'))
+                event += b'\n'
+                try:
+                    self.wfile.write(b'%x\r\n' % len(event) + event + b'\r\n')
+                    self.wfile.flush()
+                except OSError:
+                    return
+                last = etag
+            time.sleep(0.02)
+
+
+ThreadingHTTPServer.daemon_threads = True
+ThreadingHTTPServer((args.addr, 80), Handler).serve_forever()
@@ -0,0 +1,181 @@
+#!/bin/bash
+#
+# Run webpoll or webget against the stub servers, in a network namespace of its own
+# where the stubs can take the DNS and HTTP ports of loopback addresses and
+# the resolver configuration points at the DNS stub.
+#
+#   dns       names resolve through the DNS stub, forged answers are dropped
+#             and each query has an id of its own
+#   longpoll  a held subscription is renewed at once and sees a change
+#   plain     a server that does not hold the request is polled at -t
+#   sse       an event stream replaces the file with each event
+#   h2c       the polls of -2 share one connection, the streams have windows
+#             from the start and the responses come out of order
+#   slow      a body that takes longer than the old total deadline is
+#             fetched whole, alone and in ranges (webget)
+#   upload    a body that the server takes longer than the old total
+#             deadline to read is uploaded with one request (webget)
+#
+# Usage: stub_test.sh <case> <webpoll or webget binary>
+#
+# Exits 77 when the test cannot run here. Set STUB_TEST_KEEP to a directory
+# to keep the files and logs of the run there.
+#
+CASE=$1
+TOOL=$(realpath "$2")
+TESTS=$(cd "$(dirname "$0")" && pwd)
+SKIP=77
+
+if [ -z "$STUB_TEST_NS" ]; then
+    if ! command -v python3 > /dev/null || ! unshare -rnm true 2> /dev/null; then
+        echo "SKIP: needs python3 and unprivileged namespaces"
+        exit $SKIP
+    fi
+    STUB_TEST_NS=1 exec unshare -rnm "$0" "$CASE" "$TOOL"
+fi
+if ! ip link set lo up 2> /dev/null; then
+    echo "SKIP: cannot bring the loopback interface up"
+    exit $SKIP
+fi
+
+WORK=$(mktemp -d)
+PIDS=""
+cleanup()
+{
+    for pid in $PIDS; do
+        kill $pid 2> /dev/null
+    done
+    [ -n "$STUB_TEST_KEEP" ] && cp -r "$WORK" "$STUB_TEST_KEEP"
+    rm -rf "$WORK"
+}
+trap cleanup EXIT
+mkdir -p "$WORK/www" "$WORK/dev"
+cd "$WORK/dev"
+
+fail()
+{
+    echo "FAIL: $1"
+    for f in ../*.log tool.log; do
+        [ -e "$f" ] && { echo "--- $f"; tail -n 40 "$f"; }
+    done
+    exit 1
+}
+
+stub()
+{
+    python3 "$TESTS/$1" "${@:2}" 2>> ../stub.log &
+    PIDS="$PIDS $!"
+}
+
+# Wait for a stub to listen on port 80 of an address
+listening()
+{
+    for i in $(seq 50); do
+        python3 -c "import socket; socket.create_connection(('$1', 80), 0.1)" 2> /dev/null && return 0
+        sleep 0.1
+    done
+    fail "stub on $1 does not listen"
+}
+
+# Run the tool for a number of seconds
+run()
+{
+    timeout "$1" "$TOOL" "${@:2}" >> tool.log 2>&1
+}
+
+requests()
+{
+    grep -c "GET /$1 " ../http.log
+}
+
+case "$CASE" in
+dns)
+    echo "nameserver 127.0.0.1" > "$WORK/resolv.conf"
+    mount --bind "$WORK/resolv.conf" /etc/resolv.conf || exit $SKIP
+    echo "hello" > ../www/hello.txt
+    stub stub_http.py -l ../http.log -d ../www -m plain 127.0.0.5
+    stub stub_dns.py -l ../dns.log poll.test=127.0.0.5
+    listening 127.0.0.5
+    run 3 -s poll.test -m 00:11:22:33:44:01 -i dev1 -f hello.txt -t 500
+    cmp -s hello.txt ../www/hello.txt || fail "file not fetched through the DNS stub"
+    ids=$(awk '{ print $1 }' ../dns.log)
+    [ $(echo "$ids" | wc -l) -ge 2 ] || fail "fewer than two queries"
+    [ $(echo "$ids" | sort -u | wc -l) -eq $(echo "$ids" | wc -l) ] || fail "query id used twice"
+    echo "$ids" | awk 'NR > 1 && $1 == prev + 1 { counted = 1 } { prev = $1 } END { exit counted }' ||
+        fail "query ids count up"
+    ;;
+longpoll)
+    echo "v1" > ../www/sub.conf
+    stub stub_http.py -l ../http.log -d ../www -m longpoll 127.0.0.5
+    listening 127.0.0.5
+    run 4.5 -s 127.0.0.5 -m 00:11:22:33:44:01 -i dev1 -f sub.conf -w 1 -t 10000 &
+    sleep 2
+    echo "v2" > ../www/sub.conf
+    wait $!
+    cmp -s sub.conf ../www/sub.conf || fail "change not seen while held"
+    [ $(requests sub.conf) -ge 3 ] || fail "held subscription not renewed at once"
+    ;;
+plain)
+    echo "v1" > ../www/sub.conf
+    stub stub_http.py -l ../http.log -d ../www -m plain 127.0.0.5
+    listening 127.0.0.5
+    run 3 -s 127.0.0.5 -m 00:11:22:33:44:01 -i dev1 -f sub.conf -w 1 -t 10000
+    cmp -s sub.conf ../www/sub.conf || fail "file not fetched"
+    [ $(requests sub.conf) -eq 1 ] || fail "server that ignores the wait polled without delay"
+    ;;
+sse)
+    echo "v1" > ../www/sub.conf
+    stub stub_http.py -l ../http.log -d ../www -m sse 127.0.0.5
+    listening 127.0.0.5
+    run 3 -s 127.0.0.5 -m 00:11:22:33:44:01 -i dev1 -f sub.conf -w 5 -t 10000 &
+    sleep 1.5
+    echo "v2" > ../www/sub.conf
+    wait $!
+    cmp -s sub.conf ../www/sub.conf || fail "event not written to the file"
+    [ $(requests sub.conf) -le 2 ] || fail "event stream reopened"
+    ;;
+h2c)
+    head -c 300000 /dev/urandom > ../www/big.bin
+    head -c 70000 /dev/urandom > ../www/mid.bin
+    echo "hello" > ../www/hello.txt
+    stub stub_h2c.py -l ../h2c.log -d ../www 127.0.0.30
+    listening 127.0.0.30
+    run 3.5 -2 -s 127.0.0.30 -m 00:11:22:33:44:01 -i dev1 -f big.bin -f mid.bin -f hello.txt -t 1000
+    for f in big.bin mid.bin hello.txt; do
+        cmp -s $f ../www/$f || fail "$f not fetched over HTTP/2"
+    done
+    grep -q "ERROR\|CLOSED" ../h2c.log && fail "stub reported a protocol error"
+    grep -q "^INITIAL_WINDOW 0$" ../h2c.log && fail "streams start without a window"
+    [ $(grep -c "^CONN" ../h2c.log) -eq 1 ] || fail "polls did not share one connection"
+    [ $(grep -c "STREAM .* 304$" ../h2c.log) -ge 3 ] || fail "conditional polls not answered 304"
+    ;;
+slow)
+    head -c 1300000 /dev/urandom > ../www/big.bin
+    stub stub_http.py -l ../http.log -d ../www -m plain -r 200000 127.0.0.5
+    listening 127.0.0.5
+    start=$(date +%s)
+    run 20 -s 127.0.0.5 -m 00:11:22:33:44:01 -i dev1 -f big.bin
+    cmp -s big.bin ../www/big.bin || fail "slow body not fetched"
+    [ $(( $(date +%s) - start )) -ge 6 ] || fail "body not throttled"
+    rm big.bin
+    run 20 -s 127.0.0.5 -m 00:11:22:33:44:01 -i dev1 -f big.bin -n 2
+    cmp -s big.bin ../www/big.bin || fail "slow body not fetched over ranges"
+    [ $(requests big.bin) -eq 2 ] || fail "slow body fetched more than once"
+    ;;
+upload)
+    head -c 1300000 /dev/urandom > up.bin
+    stub stub_http.py -l ../http.log -d ../www -m plain -r 200000 127.0.0.5
+    listening 127.0.0.5
+    start=$(date +%s)
+    run 20 -s 127.0.0.5 -m 00:11:22:33:44:01 -i dev1 -f up.bin -u up.bin
+    cmp -s up.bin ../www/up.bin || fail "slow upload not stored"
+    [ $(( $(date +%s) - start )) -ge 6 ] || fail "upload not throttled"
+    [ $(grep -c "PUT /up.bin " ../http.log) -eq 1 ] || fail "upload sent more than once"
+    ;;
+*)
+    echo "Unknown case $CASE"
+    exit 2
+    ;;
+esac
+echo "PASS: $CASE"
+exit 0